@@ -7,6 +7,7 @@
 #include "MsrHandler.hpp"
 #include "numa.hpp"
 #include "tests/tests.hpp"
+#include "utils/worker_pool.hpp"
 
 using namespace std;
 namespace kmercounter {
@@ -16,7 +17,11 @@ class Application {
   NumaPolicyThreads *np;
   NumaPolicyQueues *npq;
   Tests test;
-  std::vector<std::thread> threads;
+  WorkerPool *pool = nullptr;
+  /// The table of every shard, kept from one run of a sweep to the next.
+  std::vector<BaseHashTable *> tables;
+  /// The `config.ht_size` the kept tables were allocated with.
+  uint64_t tables_size = 0;
   Shard *shards;
   MsrHandler *msr_ctrl;
 
@@ -25,7 +30,14 @@ class Application {
   int process(int argc, char **argv);
   int spawn_shard_threads_bqueues();
   int spawn_shard_threads();
-  void shard_thread(int tid, std::barrier<std::function<void()>>* barrier);
+  /// Run the configured test for every thread count and repetition of the
+  /// sweep, on the same threads, tables and inputs.
+  int run_sweep();
+  void shard_thread(int tid, SpinBarrier *barrier);
+  /// Allocate the missing tables of the configured threads, each on the
+  /// thread that runs its shard, after dropping them all if the table size
+  /// changed; with `clear`, empty the tables that are kept.
+  void setup_tables(bool clear);
 
   Application() {
     this->n = new Numa();
@@ -2,17 +2,25 @@
 #define __RW_RATIO_TEST_HPP__
 
 #include <atomic>
-#include <barrier>
 #include <vector>
 
 #include "hashtables/base_kht.hpp"
 #include "types.hpp"
+#include "utils/spin_barrier.hpp"
 
 namespace kmercounter {
 class RWRatioTest {
  public:
   void run(Shard& shard, BaseHashTable& hashtable, unsigned int total_ops,
-                             std::barrier<std::function<void()>> *sync_barrier);
+                             SpinBarrier *sync_barrier);
+
+  /// The RW ratio mix arriving at a fixed rate, with bursts, and served by a
+  /// pool of workers that grows and shrinks with the load. Shard 0 releases
+  /// the requests and resizes the pool; the others insert or find as it
+  /// tells them. Needs a shared table (CASHTPP).
+  void run_elastic(Shard& shard, BaseHashTable& hashtable,
+                   unsigned int total_ops,
+                   SpinBarrier *sync_barrier);
 };
 }  // namespace kmercounter
 
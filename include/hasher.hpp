@@ -9,6 +9,7 @@
 #include "xxHash/xxhash.h"
 #include "cityhash/src/city.h"
 #include "cityhash/src/citycrc.h"
+#include "utils/wide_key.hpp"
 
 
 namespace kmercounter {
@@ -17,6 +18,10 @@ namespace kmercounter {
 using key_type = std::uint32_t;
 #elif (KEY_LEN == 8)
 using key_type = std::uint64_t;
+#elif (KEY_LEN == 16)
+using key_type = WideKey<2>;
+#elif (KEY_LEN == 32)
+using key_type = WideKey<4>;
 #endif
 
 class Hasher {
@@ -33,18 +38,25 @@ public:
 #elif defined(XX_HASH_3)
     hash_val = XXH3_64bits(buff, len);
 #elif defined(CRC_HASH)
-    assert(len == sizeof(std::uint64_t));
+    assert(len == sizeof(std::uint32_t) || len % sizeof(std::uint64_t) == 0);
     if (len == sizeof(std::uint32_t)) {
       hash_val = _mm_crc32_u32(0xffffffff, *static_cast<const std::uint32_t *>(buff));
     } else if (len == sizeof(std::uint64_t)) {
       hash_val = _mm_crc32_u64(0xffffffff, *static_cast<const std::uint64_t *>(buff));
+    } else {
+      // Wide keys; chain the CRC over the words.
+      const auto words = static_cast<const std::uint64_t *>(buff);
+      hash_val = 0xffffffff;
+      for (uint64_t i = 0; i < len / sizeof(std::uint64_t); i++) {
+        hash_val = _mm_crc32_u64(hash_val, words[i]);
+      }
     }
 #elif defined(CITY_CRC_HASH)
     hash_val = CityHashCrc128((const char *)buff, len);
 #elif defined(WYHASH)
     hash_val = wyhash((const char *)buff, len, 0, _wyp);
 #elif defined(DIRECT_INDEX)
-    hash_val = *((key_type*) buff);
+    hash_val = static_cast<uint64_t>(*((key_type*) buff));
 #else
     static_assert(false, "Hasher is not specified.");
 #endif
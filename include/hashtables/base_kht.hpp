@@ -7,6 +7,7 @@
 
 #include "Latency.hpp"
 #include "types.hpp"
+#include "utils/kmer_spectrum.hpp"
 
 using namespace std;
 namespace kmercounter {
@@ -22,6 +23,16 @@ class BaseHashTable {
 
   virtual void flush_insert_queue(collector_type* collector = nullptr) = 0;
 
+  /// Insert `count` occurrences of the key of `data` at once, e.g., a count
+  /// that was merged before it reached the table. By default, one insert per
+  /// occurrence.
+  virtual void insert_count(const void *data, uint64_t count,
+                            collector_type *collector = nullptr) {
+    for (uint64_t i = 0; i < count; i++) {
+      this->insert_noprefetch(data, collector);
+    }
+  }
+
   // NEVER NEVER NEVER USE KEY OR ID 0
   // Your inserts will be ignored if you do (we use these as empty markers)
   virtual void find_batch(const InsertFindArguments &kp, ValuePairs &vp, collector_type* collector = nullptr) = 0;
@@ -34,16 +45,30 @@ class BaseHashTable {
 
   virtual size_t get_fill() const = 0;
 
+  /// Empty the table for another run. A table shared by all threads is
+  /// emptied as a whole; a partitioned one, only the partition of this
+  /// object.
+  virtual void clear() = 0;
+
   virtual size_t get_capacity() const = 0;
 
   virtual size_t get_max_count() const = 0;
 
   virtual void print_to_file(std::string &outfile) const = 0;
 
+  /// Add the entries of the `part_id`-th of `num_parts` equal slices of the
+  /// table to `spectrum`, so that threads can scan a table together.
+  virtual void collect_spectrum(uint64_t part_id, uint64_t num_parts,
+                                KmerSpectrum<key_type> &spectrum) const = 0;
+
   virtual uint64_t read_hashtable_element(const void *data) = 0;
 
   virtual void prefetch_queue(QueueType qtype) = 0;
 
+  /// Bring the slot the key of `data` hashes to into the cache, for writing
+  /// or reading, on behalf of a thread that will insert or find it soon.
+  virtual void prefetch_slot(const void *data, bool write) = 0;
+
   virtual ~BaseHashTable() {}
 
   uint64_t num_reprobes = 0;
@@ -32,7 +32,7 @@ class HTBatchFinder {
   /// Find a key. `id` is used to track the find operation.
   /// Set `parition_id` to the actual partition if you have more than one
   /// partition when using PartitionedHT.
-  void find(const uint64_t key, const uint64_t id,
+  void find(const key_type key, const uint64_t id,
             const uint64_t partition_id = 0) {
     // Append kv to `buffer_`
     buffer_[buffer_size_].key = key;
@@ -14,7 +14,7 @@ class HTBatchInserter {
   ~HTBatchInserter() { flush(); }
 
   // Insert one kv pair.
-  inline void insert(const uint64_t key, const uint64_t value) {
+  inline void insert(const key_type key, const uint64_t value) {
     // Append kv to `buffer_`
     buffer_[buffer_size_].key = key;
     buffer_[buffer_size_].value = value;
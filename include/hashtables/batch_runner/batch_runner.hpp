@@ -1,6 +1,8 @@
 #ifndef BATCH_RUNNER_BATCH_RUNNER_HPP
 #define BATCH_RUNNER_BATCH_RUNNER_HPP
 
+#include <span>
+
 #include "batch_finder.hpp"
 #include "batch_inserter.hpp"
 #include "hashtables/base_kht.hpp"
@@ -20,7 +22,7 @@ class HTBatchRunner : public HTBatchInserter<N>, public HTBatchFinder<N> {
   ~HTBatchRunner() { flush(); }
 
   /// Insert one kv pair.
-  void insert(const uint64_t key, const uint64_t value) {
+  void insert(const key_type key, const uint64_t value) {
     if (config.no_prefetch) {
       KeyValuePair kv;
       kv.key = key;
@@ -41,6 +43,22 @@ class HTBatchRunner : public HTBatchInserter<N>, public HTBatchFinder<N> {
     }
   }
 
+  /// Insert a batch of keys with the same value.
+  void insert_batch(std::span<const uint64_t> keys, const uint64_t value) {
+    if (config.no_prefetch) {
+      KeyValuePair kv;
+      kv.value = value;
+      for (const auto key : keys) {
+        kv.key = key;
+        HTBatchInserter<N>::insert_noprefetch(kv);
+      }
+    } else {
+      for (const auto key : keys) {
+        HTBatchInserter<N>::insert(key, value);
+      }
+    }
+  }
+
   void *find(const KeyValuePair &kv) {
     if (config.no_prefetch) {
       return HTBatchFinder<N>::find_noprefetch(kv);
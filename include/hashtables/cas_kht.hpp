@@ -82,6 +82,15 @@ class CASHashTable : public BaseHashTable {
 
   void prefetch_queue(QueueType qtype) override {}
 
+  void prefetch_slot(const void *data, bool write) override {
+    KV *slot = &this->hashtable[this->hash(data) & (this->capacity - 1)];
+    if (write) {
+      prefetch_object<true /* write */>(slot, sizeof(*slot));
+    } else {
+      prefetch_object<false /* write */>(slot, sizeof(*slot));
+    }
+  }
+
   void insert_noprefetch(const void *data, collector_type* collector) override {
 #ifdef LATENCY_COLLECTION
     const auto timer_start = collector->sync_start();
@@ -246,7 +255,7 @@ class CASHashTable : public BaseHashTable {
 
     // return empty_element if nothing is found
     if (!found) {
-      printf("key %" PRIu64 " not found at idx %" PRIu64 " | hash %" PRIu64 "\n", item->key, idx, hash);
+      printf("key %" PRIu64 " not found at idx %" PRIu64 " | hash %" PRIu64 "\n", static_cast<uint64_t>(item->key), idx, hash);
       curr = nullptr;
     }
 
@@ -261,6 +270,12 @@ class CASHashTable : public BaseHashTable {
     }
   }
 
+  void clear() override {
+    memset(this->hashtable, 0, this->capacity * sizeof(KV));
+    empty_slot_ = 0;
+    empty_slot_exists_ = false;
+  }
+
   size_t get_fill() const override {
     size_t count = 0;
     for (size_t i = 0; i < this->capacity; i++) {
@@ -283,6 +298,18 @@ class CASHashTable : public BaseHashTable {
     return count;
   }
 
+  void collect_spectrum(uint64_t part_id, uint64_t num_parts,
+                        KmerSpectrum<key_type> &spectrum) const override {
+    KV *ht = this->hashtable;
+    const size_t begin = this->capacity * part_id / num_parts;
+    const size_t end = this->capacity * (part_id + 1) / num_parts;
+    for (size_t i = begin; i < end; i++) {
+      if (!ht[i].is_empty()) {
+        spectrum.add(ht[i].get_key(), ht[i].get_value());
+      }
+    }
+  }
+
   void print_to_file(std::string &outfile) const override {
     std::ofstream f(outfile);
     if (!f) {
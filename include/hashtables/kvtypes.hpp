@@ -2,6 +2,7 @@
 #define __KV_TYPES_HPP__
 
 #include <plog/Log.h>
+#include <x86intrin.h>
 
 #include <cassert>
 #include <cstring>
@@ -19,9 +20,18 @@ struct Kmer_base {
 using key_type = std::uint32_t;
 #elif (KEY_LEN == 8)
 using key_type = std::uint64_t;
+#elif (KEY_LEN == 16)
+using key_type = WideKey<2>;
+#elif (KEY_LEN == 32)
+using key_type = WideKey<4>;
 #endif
 
+#if (KEY_LEN <= 8)
 using value_type = key_type;
+#else
+// Wide keys are long KMers; the values are still counts.
+using value_type = std::uint64_t;
+#endif
 
 struct Kmer_KV {
   Kmer_base kb;              // 20 + 2 bytes
@@ -99,7 +109,7 @@ struct ItemQueue {
 #ifdef COMPARE_HASH
   uint64_t key_hash;  // 8 bytes
 #endif
-} PACKED;
+} KEY_PACKED;
 std::ostream& operator<<(std::ostream& os, const ItemQueue& q);
 
 // FIXME: @David paritioned gets the insert count wrong somehow
@@ -108,6 +118,22 @@ struct Aggr_KV {
 
   key_type key;
   value_type count;
+#if (KEY_LEN > 8)
+  // Wide keys cannot be swapped in with a single CAS; the CAS engine claims
+  // the entry through `state` and publishes the key after writing it.
+  uint64_t state;
+
+  static constexpr uint64_t EMPTY = 0;
+  static constexpr uint64_t CLAIMED = 1;
+  static constexpr uint64_t PUBLISHED = 2;
+
+  /// Wait until the claiming thread has finished writing the key.
+  inline void wait_published() const {
+    while (__atomic_load_n(&this->state, __ATOMIC_ACQUIRE) == CLAIMED) {
+      _mm_pause();
+    }
+  }
+#endif
 
   friend std::ostream &operator<<(std::ostream &strm, const Aggr_KV &k) {
     return strm << k.key << " : " << k.count;
@@ -127,6 +153,16 @@ struct Aggr_KV {
   }
 
   inline bool insert_cas(queue *elem) {
+#if (KEY_LEN > 8)
+    // The first count goes in before the key is published, so a find never
+    // sees the key without it.
+    auto success = __sync_bool_compare_and_swap(&this->state, EMPTY, CLAIMED);
+    if (success) {
+      this->key = elem->key;
+      this->count += 1;
+      __atomic_store_n(&this->state, PUBLISHED, __ATOMIC_RELEASE);
+    }
+#else
     const Aggr_KV empty = this->get_empty_key();
     auto success =
         __sync_bool_compare_and_swap(&this->key, empty.key, elem->key);
@@ -134,6 +170,7 @@ struct Aggr_KV {
     if (success) {
       this->update_cas(elem);
     }
+#endif
     return success;
   }
 
@@ -151,6 +188,9 @@ struct Aggr_KV {
   inline bool compare_key(const void *from) {
     ItemQueue *elem =
         const_cast<ItemQueue *>(reinterpret_cast<const ItemQueue *>(from));
+#if (KEY_LEN > 8)
+    this->wait_published();
+#endif
     return this->key == elem->key;
   }
 
@@ -165,8 +205,8 @@ struct Aggr_KV {
         : "rbx");
   }
 
-  inline uint64_t get_key() const { return this->key; }
-  inline uint16_t get_value() const { return this->count; }
+  inline key_type get_key() const { return this->key; }
+  inline value_type get_value() const { return this->count; }
 
   inline constexpr size_t data_length() const { return sizeof(Aggr_KV); }
 
@@ -177,6 +217,9 @@ struct Aggr_KV {
   inline Aggr_KV get_empty_key() {
     Aggr_KV empty;
     empty.key = empty.count = 0;
+#if (KEY_LEN > 8)
+    empty.state = EMPTY;
+#endif
     return empty;
   }
 
@@ -190,6 +233,9 @@ struct Aggr_KV {
         const_cast<ItemQueue *>(reinterpret_cast<const ItemQueue *>(data));
     auto found = false;
     *retry = 0;
+#if (KEY_LEN > 8)
+    this->wait_published();
+#endif
     if (this->is_empty()) {
       goto exit;
     } else if (this->key == elem->key) {
@@ -462,12 +508,18 @@ struct Aggr_KV {
 #endif
   };
 #endif
-} PACKED;
+} KEY_PACKED;
+
+#if (KEY_LEN == 16)
+static_assert(sizeof(Aggr_KV) == 32, "Wide Aggr_KV must be half a cacheline");
+#elif (KEY_LEN == 32)
+static_assert(sizeof(Aggr_KV) == 48, "Unexpected size of wide Aggr_KV");
+#endif
 
 struct KVPair {
   key_type key;
   value_type value;
-} PACKED;
+} KEY_PACKED;
 
 std::ostream &operator<<(std::ostream &strm, const KVPair &item);
 
@@ -492,6 +544,9 @@ struct Item {
     return true;
   }
 
+#if (KEY_LEN <= 8)
+  // Wide keys cannot be swapped in with a single CAS; only `Aggr_KV` claims
+  // them, see the check on `KVType` below.
   inline bool insert_cas(queue *elem) {
     const Item empty = this->get_empty_key();
 
@@ -503,6 +558,7 @@ struct Item {
     }
     return success;
   }
+#endif
 
   inline bool update_cas(queue *elem) {
     auto ret = false;
@@ -537,7 +593,7 @@ struct Item {
     this->kvpair.value = elem->value;
   }
 
-  inline uint64_t get_key() const { return this->kvpair.key; }
+  inline key_type get_key() const { return this->kvpair.key; }
   inline uint64_t get_value() const { return this->kvpair.value; }
 
   inline Item get_empty_key() {
@@ -685,7 +741,7 @@ struct Item {
         : "rbx", "r12", "r13", "r14", "r15", "cc", "memory");
     return found;
   };
-} PACKED;
+} KEY_PACKED;
 
 struct Value {
   value_type value;
@@ -749,6 +805,9 @@ struct Value {
 
 
 #ifdef NOAGGR
+#if (KEY_LEN > 8)
+#error "Wide keys (KEY_LEN > 8) are only supported in aggregation mode (AGGR)"
+#endif
 using KVType = Item;
 #else
 using KVType = Aggr_KV;
@@ -0,0 +1,110 @@
+#ifndef HASHTABLES_PARTITION_MAP_HPP
+#define HASHTABLES_PARTITION_MAP_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace kmercounter {
+/// Which thread owns which partition of a partitioned table.
+/// A table of M partitions is spread over N owners, M >= N, so that a
+/// partition can be small enough to stay in the cache of its owner, and can
+/// change hands when the load does. Partition p starts with owner p % N.
+/// The map only changes at phase boundaries, when no one routes to or
+/// inserts into the partitions; within a phase it is read-only.
+/// The owners count the operations on their partitions with `add_load`, and
+/// `rebalance` moves partitions from the most to the least loaded owners
+/// before the next phase.
+class PartitionMap {
+ public:
+  PartitionMap(uint32_t num_partitions, uint32_t num_owners)
+      : owners_(num_partitions),
+        loads_(num_partitions),
+        parts_(num_owners) {
+    assert(num_partitions >= num_owners && num_owners > 0);
+    for (uint32_t p = 0; p < num_partitions; p++) {
+      owners_[p] = p % num_owners;
+      parts_[p % num_owners].push_back(p);
+    }
+  }
+
+  uint32_t num_partitions() const { return owners_.size(); }
+  uint32_t num_owners() const { return parts_.size(); }
+
+  uint32_t owner_of(uint32_t part) const { return owners_[part]; }
+
+  const std::vector<uint32_t> &partitions_of(uint32_t owner) const {
+    return parts_[owner];
+  }
+
+  /// Count `ops` operations on `part`; only its owner may call this.
+  void add_load(uint32_t part, uint64_t ops) { loads_[part] += ops; }
+
+  uint64_t load_of(uint32_t part) const { return loads_[part]; }
+
+  /// Hand `part` over to `owner`.
+  void move(uint32_t part, uint32_t owner) {
+    auto &from = parts_[owners_[part]];
+    from.erase(std::find(from.begin(), from.end(), part));
+    parts_[owner].push_back(part);
+    owners_[part] = owner;
+  }
+
+  /// Move partitions until no owner carries more than `tolerance` above the
+  /// mean load, or no move helps, and start counting the next phase.
+  /// Every owner keeps at least one partition. Returns the number of moves.
+  uint32_t rebalance(double tolerance = 0.1) {
+    std::vector<uint64_t> owner_loads(parts_.size());
+    uint64_t total = 0;
+    for (uint32_t p = 0; p < owners_.size(); p++) {
+      owner_loads[owners_[p]] += loads_[p];
+      total += loads_[p];
+    }
+    const double limit = (1 + tolerance) * total / parts_.size();
+
+    uint32_t moves = 0;
+    // Every move narrows the gap between the two owners it touches, so the
+    // spread of the loads shrinks; a move per partition is plenty.
+    for (uint32_t round = 0; round < owners_.size(); round++) {
+      const auto [lo, hi] =
+          std::minmax_element(owner_loads.begin(), owner_loads.end());
+      if (*hi <= limit || parts_[hi - owner_loads.begin()].size() < 2) {
+        break;
+      }
+      // The partition that brings the two owners closest together.
+      const uint64_t gap = *hi - *lo;
+      uint32_t best = owners_.size();
+      uint64_t best_spread = gap;
+      for (auto p : parts_[hi - owner_loads.begin()]) {
+        if (loads_[p] == 0 || loads_[p] >= gap) {
+          continue;
+        }
+        const uint64_t twice = 2 * loads_[p];
+        const uint64_t spread = twice > gap ? twice - gap : gap - twice;
+        if (spread < best_spread) {
+          best = p;
+          best_spread = spread;
+        }
+      }
+      if (best == owners_.size()) {
+        break;
+      }
+      *hi -= loads_[best];
+      *lo += loads_[best];
+      this->move(best, lo - owner_loads.begin());
+      moves++;
+    }
+
+    std::fill(loads_.begin(), loads_.end(), 0);
+    return moves;
+  }
+
+ private:
+  std::vector<uint32_t> owners_;
+  std::vector<uint64_t> loads_;
+  std::vector<std::vector<uint32_t>> parts_;
+};
+}  // namespace kmercounter
+
+#endif  // HASHTABLES_PARTITION_MAP_HPP
@@ -39,7 +39,8 @@ namespace {
 // utility constants and lambdas for SIMD operations
 constexpr size_t KV_PER_CACHE_LINE = CACHE_LINE_SIZE / KV_SIZE;
 
-const size_t MAX_PARTITIONS = 64;
+// Partition ids are uint8_t; a table may have more partitions than threads.
+const size_t MAX_PARTITIONS = 256;
 
 // cacheline
 //       <------------------------ cacheline ------------------------->
@@ -445,7 +446,8 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     return;
   }
 
-  void __insert_noprefetch_branched(const void *data, collector_type* collector) {
+  /// Returns the entry of the key, or nullptr if the table is full.
+  KV *__insert_noprefetch_branched(const void *data, collector_type* collector) {
     KVQ *key_data = const_cast<KVQ *>(reinterpret_cast<const KVQ *>(data));
     uint64_t hash = 0;
 
@@ -483,12 +485,13 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
 #endif
 
         if (0) {
-          printf("inserted key %" PRIu64 " at idx %zu | hash %" PRIu64 "\n", key_data->key,
-                 idx, hash);
+          printf("inserted key %" PRIu64 " at idx %zu | hash %" PRIu64 "\n",
+                 static_cast<uint64_t>(key_data->key), idx, hash);
         }
-        break;
+        return curr;
       }
     }
+    return nullptr;
   }
 
   void insert_noprefetch(const void *data, collector_type* collector) override {
@@ -503,6 +506,20 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     }
   }
 
+  void insert_count(const void *data, uint64_t count,
+                    collector_type *collector) override {
+    if constexpr (std::is_same_v<KV, Aggr_KV>) {
+      // Probe once and add the rest of the occurrences in place.
+      KV *entry = count > 0 ? __insert_noprefetch_branched(data, collector)
+                            : nullptr;
+      if (entry) {
+        entry->count += count - 1;
+      }
+    } else {
+      BaseHashTable::insert_count(data, count, collector);
+    }
+  }
+
   // insert a batch
   void insert_batch(const InsertFindArguments &kp, collector_type* collector) override {
     this->flush_if_needed(collector);
@@ -656,8 +673,8 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   exit:
     // return empty_element if nothing is found
     if (!found) {
-      printf("key %" PRIu64 " not found at idx %" PRIu32 " | hash %" PRIu64 "\n", item->key, idx,
-             hash);
+      printf("key %" PRIu64 " not found at idx %" PRIu32 " | hash %" PRIu64 "\n",
+             static_cast<uint64_t>(item->key), idx, hash);
       curr = nullptr;
     }
     return curr;
@@ -672,6 +689,12 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     }
   }
 
+  void clear() override {
+    memset(this->hashtable[this->id], 0, this->capacity * sizeof(KV));
+    empty_slot_ = 0;
+    empty_slot_exists_ = false;
+  }
+
   size_t get_fill() const override {
     size_t count = 0;
     KV *ht = this->hashtable[this->id];
@@ -696,6 +719,18 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     return count;
   }
 
+  void collect_spectrum(uint64_t part_id, uint64_t num_parts,
+                        KmerSpectrum<key_type> &spectrum) const override {
+    KV *ht = this->hashtable[this->id];
+    const size_t begin = this->capacity * part_id / num_parts;
+    const size_t end = this->capacity * (part_id + 1) / num_parts;
+    for (size_t i = begin; i < end; i++) {
+      if (!ht[i].is_empty()) {
+        spectrum.add(ht[i].get_key(), ht[i].get_value());
+      }
+    }
+  }
+
   void print_to_file(std::string &outfile) const override {
     std::ofstream f(outfile);
     if (!f) {
@@ -1275,10 +1310,22 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
     }
   }
 
+  void prefetch_slot(const void *data, bool write) override {
+    const KVQ *key_data = reinterpret_cast<const KVQ *>(data);
+#if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
+    const uint32_t hash = key_data->key >> 32;
+    size_t idx = fastrange32(_mm_crc32_u32(0xffffffff, hash), this->capacity);
+#else
+    size_t idx =
+        fastrange32(this->hash((const char *)&key_data->key), this->capacity);
+#endif
+    this->prefetch_partition(idx, this->id, write);
+  }
+
   void add_to_insert_queue(void *data, collector_type* collector) {
     InsertFindArgument *key_data = reinterpret_cast<InsertFindArgument *>(data);
     uint64_t hash = 0;
-    uint64_t key = 0;
+    key_type key = 0;
 
     if (bq_load == BQUEUE_LOAD::HtInsert) [[likely]] {
 #if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
@@ -1326,7 +1373,7 @@ class alignas(64) PartitionedHashStore : public BaseHashTable {
   void add_to_find_queue(void *data, collector_type* collector) {
     InsertFindArgument *key_data = reinterpret_cast<InsertFindArgument *>(data);
     uint64_t hash = 0;
-    uint64_t key = 0;
+    key_type key = 0;
 
 #ifdef LATENCY_COLLECTION
     const auto time = collector->start();
@@ -0,0 +1,395 @@
+#ifndef INPUT_READER_ASYNC_FILE_HPP
+#define INPUT_READER_ASYNC_FILE_HPP
+
+#include <fcntl.h>
+#include <plog/Log.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "file.hpp"
+#include "input_reader.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+/// Read a file one whole line at a time within the partition while I/O
+/// threads read ahead.
+/// The partition is read in large aligned chunks into a ring of
+/// `num_buffers` buffers. Each buffer has an I/O thread of its own, which
+/// reads the next chunk into it as soon as the parser is done with it, so
+/// up to `num_buffers` reads are in flight and parsing overlaps with them.
+/// With `direct_io` the file is opened with O_DIRECT to bypass the page
+/// cache.
+///
+/// The partitioning is identical to `FileReader`, and `find_bound` has the
+/// same type, so the bound finders of `FileReader` work as is.
+///
+/// The line produced by `next(&line)` stays valid until the next call to
+/// `next` with a non-null output, as long as the lines skipped in between
+/// span fewer than `num_buffers - 1` chunks.
+class AsyncFileReader : public InputReader<std::string_view> {
+ public:
+  using find_bound_t = FileReader::find_bound_t;
+
+  /// Alignment of the buffers, offsets and read sizes required by O_DIRECT.
+  static constexpr uint64_t IO_ALIGNMENT = 4096;
+  static constexpr uint64_t DEFAULT_CHUNK_SIZE = 4 << 20;
+  static constexpr uint32_t DEFAULT_NUM_BUFFERS = 4;
+
+  AsyncFileReader(std::string_view filename, uint64_t part_id,
+                  uint64_t num_parts,
+                  find_bound_t find_bound = FileReader::find_next_line,
+                  bool direct_io = false,
+                  uint64_t chunk_size = DEFAULT_CHUNK_SIZE,
+                  uint32_t num_buffers = DEFAULT_NUM_BUFFERS)
+      : part_id_(part_id),
+        num_parts_(num_parts),
+        chunk_size_(chunk_size),
+        num_buffers_(std::max(num_buffers, 2u)) {
+    PLOG_FATAL_IF(part_id >= num_parts)
+        << "part_id(" << part_id << " ) >= num_parts(" << num_parts << ")";
+    this->find_partition(filename, find_bound);
+    this->open_file(filename, direct_io);
+
+    // Read from the aligned offset below the partition start and skip the
+    // head of the first chunk.
+    read_begin_ = direct_io_ ? offset_ & ~(IO_ALIGNMENT - 1) : offset_;
+    num_chunks_ = part_end_ > offset_
+                      ? (part_end_ - read_begin_ + chunk_size_ - 1) / chunk_size_
+                      : 0;
+    for (uint32_t i = 0; i < num_buffers_; i++) {
+      buffers_.push_back(static_cast<char *>(
+          aligned_alloc(IO_ALIGNMENT, round_up(chunk_size_, IO_ALIGNMENT))));
+    }
+    lens_.resize(num_buffers_);
+    filled_.resize(num_buffers_);
+
+    for (uint32_t i = 0; i < std::min<uint64_t>(num_buffers_, num_chunks_);
+         i++) {
+      io_threads_.emplace_back(&AsyncFileReader::io_loop, this, i);
+    }
+  }
+
+  /// Single partition variant.
+  AsyncFileReader(std::string_view filename)
+      : AsyncFileReader(filename, 0, 1) {}
+
+  AsyncFileReader(const AsyncFileReader &) = delete;
+  AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+  ~AsyncFileReader() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    released_cv_.notify_all();
+    for (auto &thread : io_threads_) {
+      thread.join();
+    }
+    for (auto buffer : buffers_) {
+      free(buffer);
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  /// Point `output` to the next line and advance the offset.
+  bool next(std::string_view *output) override {
+    if (this->eof()) {
+      return false;
+    }
+
+    // The previous line is no longer needed.
+    if (output != nullptr) {
+      this->release_until(current_chunk_);
+      pinned_chunk_ = current_chunk_;
+      line_.clear();
+    }
+
+    bool spilled = false, any = false, ended = false;
+    while (pos_ < len_ || this->next_chunk()) {
+      any = true;
+      const char *begin = data_ + pos_;
+      const auto newline =
+          static_cast<const char *>(memchr(begin, '\n', len_ - pos_));
+      const uint64_t len = newline ? newline - begin : len_ - pos_;
+      const uint64_t consumed = newline ? len + 1 : len;
+      pos_ += consumed;
+      offset_ += consumed;
+
+      if (output != nullptr) {
+        // Lines within a chunk are returned in place; only those
+        // straddling two chunks are copied.
+        if (newline && !spilled) {
+          *output = std::string_view(begin, len);
+          pinned_chunk_ = current_chunk_;
+          return true;
+        }
+        line_.append(begin, len);
+        spilled = true;
+      }
+      if (newline) {
+        ended = true;
+        break;
+      }
+    }
+
+    // Nothing left, or only the head of a line a failed read cut off.
+    if (!any || (cut_short_ && !ended)) {
+      offset_ = part_end_;
+      return false;
+    }
+
+    if (output != nullptr) {
+      *output = line_;
+    }
+    return true;
+  }
+
+  /// Skip to next line.
+  bool skip_to_next_line() { return this->next(nullptr); }
+
+  int peek() {
+    if (pos_ >= len_ && !this->next_chunk()) {
+      return EOF;
+    }
+    return data_[pos_];
+  }
+
+  int get() {
+    const int rtn = this->peek();
+    if (rtn != EOF) {
+      pos_++;
+      offset_++;
+    }
+    return rtn;
+  }
+
+  bool good() { return offset_ < part_end_; }
+
+  bool eof() { return offset_ >= part_end_; }
+
+  /// A read failed or came back short, and the partition ended there.
+  bool failed() { return cut_short_; }
+
+  uint64_t num_parts() { return num_parts_; }
+
+  uint64_t part_id() { return part_id_; }
+
+ private:
+  static uint64_t round_up(uint64_t n, uint64_t align) {
+    return (n + align - 1) / align * align;
+  }
+
+  /// Find the partition with the same logic as `FileReader`.
+  void find_partition(std::string_view filename, find_bound_t &find_bound) {
+    std::ifstream file(filename.data());
+    PLOG_FATAL_IF(file.fail())
+        << "Failed to open file " << filename << ": " << file.rdstate();
+    file.seekg(0, std::ios::end);
+    const uint64_t file_size = file.tellg();
+    file.seekg(0);
+    const uint64_t part_start = (double)file_size / num_parts_ * part_id_;
+    part_end_ = (double)file_size / num_parts_ * (part_id_ + 1);
+    PLOG_DEBUG << part_id_ << "/" << num_parts_ << ": start " << part_start
+               << ", end " << part_end_;
+
+    // The bounds will be -1 if EOF.
+    part_end_ = std::min(uint64_t(find_bound(file, part_end_)), file_size);
+    offset_ = std::min(uint64_t(find_bound(file, part_start)), file_size);
+    PLOG_DEBUG << part_id_ << "/" << num_parts_ << ": adj_start " << offset_
+               << ", adj_end " << part_end_;
+  }
+
+  void open_file(std::string_view filename, bool direct_io) {
+    const std::string path(filename);
+    if (direct_io && chunk_size_ % IO_ALIGNMENT == 0) {
+      fd_ = open(path.c_str(), O_RDONLY | O_DIRECT);
+      PLOG_WARNING_IF(fd_ < 0)
+          << "O_DIRECT is not supported for " << filename << ": "
+          << strerror(errno) << ". Falling back to buffered I/O.";
+    } else {
+      PLOG_WARNING_IF(direct_io)
+          << "Chunk size " << chunk_size_ << " is not a multiple of "
+          << IO_ALIGNMENT << ". Falling back to buffered I/O.";
+    }
+    direct_io_ = fd_ >= 0;
+
+    if (fd_ < 0) {
+      fd_ = open(path.c_str(), O_RDONLY);
+      PLOG_FATAL_IF(fd_ < 0)
+          << "Failed to open file " << filename << ": " << strerror(errno);
+      // Let the kernel read ahead on top of our own prefetching.
+      posix_fadvise(fd_, offset_, part_end_ - offset_,
+                    POSIX_FADV_SEQUENTIAL);
+    }
+  }
+
+  /// Fill the chunks that go to buffer `slot`, each once the parser is done
+  /// with the one before it in the buffer.
+  void io_loop(uint32_t slot) {
+    char *buffer = buffers_[slot];
+    for (uint64_t chunk = slot; chunk < num_chunks_; chunk += num_buffers_) {
+      {
+        std::unique_lock lock(mutex_);
+        released_cv_.wait(lock, [&] {
+          return stop_ || chunk - released_ < num_buffers_;
+        });
+        // The parser stops at a failed chunk; nothing after it is read.
+        if (stop_ || chunk > failed_chunk_) {
+          return;
+        }
+      }
+
+      const uint64_t chunk_offset = read_begin_ + chunk * chunk_size_;
+      const uint64_t wanted = std::min(chunk_size_, part_end_ - chunk_offset);
+      // O_DIRECT wants aligned read sizes; the tail is read past
+      // `part_end_` and ignored.
+      const uint64_t to_read =
+          direct_io_ ? round_up(wanted, IO_ALIGNMENT) : wanted;
+      uint64_t bytes_read = 0;
+      bool failed = false;
+      while (bytes_read < wanted) {
+        const ssize_t ret = pread(fd_, buffer + bytes_read,
+                                  to_read - bytes_read,
+                                  chunk_offset + bytes_read);
+        if (ret < 0 && errno == EINTR) {
+          continue;
+        }
+        if (ret <= 0) {
+          PLOG_ERROR << "Failed to read " << wanted << " bytes at "
+                     << chunk_offset << ": "
+                     << (ret == 0 ? "unexpected end of file" : strerror(errno))
+                     << ". Ending partition " << part_id_ << " there.";
+          failed = true;
+          break;
+        }
+        bytes_read += ret;
+      }
+
+      {
+        std::lock_guard lock(mutex_);
+        lens_[slot] = std::min(bytes_read, wanted);
+        filled_[slot] = chunk + 1;
+        if (failed) {
+          failed_chunk_ = std::min(failed_chunk_, chunk);
+        }
+      }
+      filled_cv_.notify_one();
+      if (failed) {
+        return;
+      }
+    }
+  }
+
+  /// Move the parser to the next chunk, waiting for it if necessary.
+  /// Returns false if the partition is exhausted.
+  bool next_chunk() {
+    const uint64_t chunk = started_ ? current_chunk_ + 1 : 0;
+    if (chunk >= num_chunks_) {
+      return false;
+    }
+
+    // Chunks skipped over since the last returned line can go.
+    this->release_until(pinned_chunk_);
+    // Lines longer than the ring; give up on keeping the last one.
+    if (chunk - released_ >= num_buffers_) {
+      PLOG_DEBUG << "Line spans more than " << num_buffers_ << " chunks";
+      this->release_until(chunk + 1 - num_buffers_);
+    }
+
+    std::unique_lock lock(mutex_);
+    filled_cv_.wait(lock,
+                    [&] { return filled_[chunk % num_buffers_] == chunk + 1; });
+    data_ = buffers_[chunk % num_buffers_];
+    len_ = lens_[chunk % num_buffers_];
+    if (chunk == failed_chunk_) {
+      // End the partition with the data read so far; the chunks before
+      // this one were read whole.
+      cut_short_ = true;
+      num_chunks_ = chunk + 1;
+      part_end_ = std::min(part_end_, read_begin_ + chunk * chunk_size_ + len_);
+    }
+    lock.unlock();
+
+    // Skip the alignment head of the first chunk.
+    pos_ = chunk == 0 ? offset_ - read_begin_ : 0;
+    current_chunk_ = chunk;
+    started_ = true;
+    return pos_ < len_ || this->next_chunk();
+  }
+
+  /// Hand the chunks before `chunk` back to the I/O threads.
+  void release_until(uint64_t chunk) {
+    // `released_` is only written by this thread.
+    if (chunk <= released_) {
+      return;
+    }
+    {
+      std::lock_guard lock(mutex_);
+      released_ = chunk;
+    }
+    released_cv_.notify_all();
+  }
+
+  int fd_ = -1;
+  bool direct_io_ = false;
+  uint64_t offset_;
+  uint64_t part_end_;
+  uint64_t part_id_;
+  uint64_t num_parts_;
+
+  uint64_t chunk_size_;
+  uint32_t num_buffers_;
+  /// File offset of the first chunk.
+  uint64_t read_begin_;
+  uint64_t num_chunks_;
+  std::vector<char *> buffers_;
+  /// Number of valid bytes of each buffer.
+  std::vector<uint64_t> lens_;
+
+  /// Parser state: the current chunk and the position within it.
+  bool started_ = false;
+  uint64_t current_chunk_ = 0;
+  /// The chunk of the last returned line.
+  uint64_t pinned_chunk_ = 0;
+  const char *data_ = nullptr;
+  uint64_t len_ = 0;
+  uint64_t pos_ = 0;
+  /// Buffer for lines straddling two chunks.
+  std::string line_;
+  /// The I/O thread failed on the current chunk, the last one.
+  bool cut_short_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable filled_cv_;
+  std::condition_variable released_cv_;
+  /// One past the chunk last filled into each buffer; 0 if none yet.
+  std::vector<uint64_t> filled_;
+  /// Chunks before this one may be overwritten.
+  uint64_t released_ = 0;
+  bool stop_ = false;
+  /// The first chunk a read failed on, short by the bytes it did not get.
+  /// Its buffer is not filled again, so its length stays until the parser
+  /// gets there.
+  uint64_t failed_chunk_ = UINT64_MAX;
+  std::vector<std::thread> io_threads_;
+};
+
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_ASYNC_FILE_HPP
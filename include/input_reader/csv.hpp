@@ -9,18 +9,22 @@
 #include <variant>
 #include <vector>
 
-#include "file.hpp"
+#include "async_file.hpp"
 #include "input_reader.hpp"
 #include "input_reader/reservoir.hpp"
+#include "mmap_file.hpp"
 
 namespace kmercounter {
 namespace input_reader {
 
 /// Read a CSV file with two integer columns: key and value.
-class KeyValueCsvReader : public InputReader<KeyValuePair> {
+/// `File` is the line reader backend; by default lines are parsed straight
+/// out of the memory mapped file.
+template <class File = MmapFileReader>
+class BasicKeyValueCsvReader : public InputReader<KeyValuePair> {
  public:
-  KeyValueCsvReader(std::string_view filename, uint64_t part_id,
-                    uint64_t num_parts, std::string_view delimiter = ",")
+  BasicKeyValueCsvReader(std::string_view filename, uint64_t part_id,
+                         uint64_t num_parts, std::string_view delimiter = ",")
       : file_(filename, part_id, num_parts), delimiter_(delimiter) {}
 
   bool next(KeyValuePair *data) override {
@@ -46,10 +50,12 @@ class KeyValueCsvReader : public InputReader<KeyValuePair> {
   }
 
  private:
-  FileReader file_;
+  File file_;
   std::string delimiter_;
 };
 
+using KeyValueCsvReader = BasicKeyValueCsvReader<>;
+
 class KeyValueCsvPreloadReader : public Reservoir<KeyValuePair> {
  public:
   template <typename... Args>
@@ -62,15 +68,16 @@ class KeyValueCsvPreloadReader : public Reservoir<KeyValuePair> {
 using Row = std::pair<uint64_t, std::string_view>;
 
 /// Read a CSV file.
-/// All data are cached in memory to save I/O.
+/// The file is memory mapped and the rows point into the mapping,
+/// which is kept alive by the reader.
 /// WIP; only reads the first integer column at this moment.
 class PartitionedCsvReader : public InputReader<Row *> {
  public:
   PartitionedCsvReader(std::string_view filename, uint64_t part_id,
-                       uint64_t num_parts, std::string_view delimiter = ",") {
-    // Read CSV line by line into memory.
-    FileReader file(filename, part_id, num_parts);
-    for (std::string_view line; file.next(&line); /*noop*/) {
+                       uint64_t num_parts, std::string_view delimiter = ",")
+      : file_(filename, part_id, num_parts) {
+    // Index the CSV line by line.
+    for (std::string_view line; file_.next(&line); /*noop*/) {
       const std::string_view key_str = line.substr(0, line.find(delimiter));
       uint64_t key{};
       std::from_chars(key_str.begin(), key_str.end(), key);
@@ -94,6 +101,7 @@ class PartitionedCsvReader : public InputReader<Row *> {
   const std::vector<Row> &rows() const { return data_; }
 
  private:
+  MmapFileReader file_;
   std::vector<Row> data_;
   std::vector<Row>::iterator iter_;
 };
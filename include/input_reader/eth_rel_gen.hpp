@@ -5,6 +5,7 @@
 #define INPUT_READER_ETH_REL_GEN_HPP
 
 #include <mutex>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -20,6 +21,7 @@
 namespace kmercounter {
 namespace input_reader {
 
+#if (KEY_LEN <= 8)
 class EthRelationReader : public SpanReader<KeyValuePair> {
  public:
   EthRelationReader(eth_hashjoin::relation_t relation)
@@ -37,6 +39,29 @@ static_assert(offsetof(eth_hashjoin::tuple_t, payload) ==
 static_assert(sizeof(eth_hashjoin::tuple_t::key) == sizeof(KeyValuePair::key));
 static_assert(sizeof(eth_hashjoin::tuple_t::payload) ==
               sizeof(KeyValuePair::value));
+#else
+/// The generated tuples are 64-bit; with wide keys they cannot be cast in
+/// place, so each one is widened as it is read.
+class EthRelationReader : public SizedInputReader<KeyValuePair> {
+ public:
+  EthRelationReader(eth_hashjoin::relation_t relation)
+      : tuples_(relation.tuples, relation.num_tuples) {}
+
+  bool next(KeyValuePair* data) override {
+    if (pos_ == tuples_.size()) {
+      return false;
+    }
+    *data = KeyValuePair(tuples_[pos_++]);
+    return true;
+  }
+
+  size_t size() override { return tuples_.size(); }
+
+ private:
+  std::span<eth_hashjoin::tuple_t> tuples_;
+  size_t pos_ = 0;
+};
+#endif
 
 class PartitionedEthRelationReader
     : public PartitionedSpanReader<eth_hashjoin::tuple_t>,
@@ -4,36 +4,48 @@
 #ifndef INPUT_READER_FASTX_HPP
 #define INPUT_READER_FASTX_HPP
 
+#include <algorithm>
 #include <array>
 #include <istream>
 #include <memory>
+#include <string>
 #include <utility>
 
+#include "async_file.hpp"
 #include "file.hpp"
+#include "gzip_file.hpp"
 #include "input_reader.hpp"
 #include "input_reader/adaptor.hpp"
 #include "input_reader/reservoir.hpp"
 #include "kmer.hpp"
+#include "mmap_file.hpp"
+#include "simd_kmer.hpp"
 #include "plog/Log.h"
 
 namespace kmercounter {
 namespace input_reader {
 /// Parse a fastq file and produce sequencies from it.
-class FastqReader : public FileReader {
+/// `File` is the line reader backend, e.g., `FileReader`, `MmapFileReader`,
+/// `AsyncFileReader` or `GzipFileReader`.
+template <class File>
+class BasicFastqReader : public File {
  public:
-  FastqReader(std::string_view filename, uint64_t part_id, uint64_t num_parts)
-      : FileReader(filename, part_id, num_parts, find_next_sequence) {}
+  /// `args` are passed on to the backend after the bound finder.
+  template <typename... Args>
+  BasicFastqReader(std::string_view filename, uint64_t part_id,
+                   uint64_t num_parts, Args&&... args)
+      : File(filename, part_id, num_parts, sequence_bound(),
+             std::forward<Args>(args)...) {}
 
-  FastqReader(std::unique_ptr<std::istream> input_file, uint64_t part_id,
-              uint64_t num_parts)
-      : FileReader(std::move(input_file), part_id, num_parts,
-                   find_next_sequence) {}
+  BasicFastqReader(std::unique_ptr<std::istream> input_file, uint64_t part_id,
+                   uint64_t num_parts)
+      : File(std::move(input_file), part_id, num_parts, sequence_bound()) {}
 
-  FastqReader(std::string_view filename)
-      : FastqReader(std::make_unique<std::ifstream>(filename.data())) {}
+  BasicFastqReader(std::string_view filename)
+      : BasicFastqReader(filename, 0, 1) {}
 
-  FastqReader(std::unique_ptr<std::istream> input_file)
-      : FastqReader(std::move(input_file), 0, 1) {}
+  BasicFastqReader(std::unique_ptr<std::istream> input_file)
+      : BasicFastqReader(std::move(input_file), 0, 1) {}
 
   // Return the next sequence.
   bool next(std::string_view* data) override {
@@ -48,12 +60,12 @@ class FastqReader : public FileReader {
                       "line which begins with '@'.";
       return false;
     }
-    if (!FileReader::next(nullptr)) {
+    if (!File::next(nullptr)) {
       return false;
     }
 
     // Copy the second line(sequence) to `data`
-    if (!FileReader::next(data)) {
+    if (!File::next(data)) {
       PLOG_WARNING << "Unexpected EOF. Expecting sequence.";
       return false;
     }
@@ -65,13 +77,13 @@ class FastqReader : public FileReader {
     }
 
     // Skip over the third line(quality header).
-    if (!FileReader::next(nullptr)) {
+    if (!File::next(nullptr)) {
       PLOG_WARNING << "Unexpected EOF. Expecting quality header.";
       return false;
     }
 
     // Copy the second line(sequence) to `data`
-    if (!FileReader::next(nullptr)) {
+    if (!File::next(nullptr)) {
       PLOG_WARNING << "Unexpected EOF. Expecting quality.";
       return false;
     }
@@ -80,6 +92,13 @@ class FastqReader : public FileReader {
   }
 
  private:
+  /// Wrap `find_next_sequence` into the bound finder type of the backend.
+  static typename File::find_bound_t sequence_bound() {
+    return [](auto&& input, auto offset) {
+      return find_next_sequence(input, offset);
+    };
+  }
+
   /// Find offset of the next find_next_sequence.
   /// Return current offset if `st` is at the beginning of a line.
   static std::streampos find_next_sequence(std::istream& st,
@@ -109,42 +128,218 @@ class FastqReader : public FileReader {
     st.clear(old_state);
     return next_seq;
   }
+
+  /// In-memory version of the above for memory mapped files, and for the
+  /// chunks of a gzip stream, which are cut many times per partition.
+  /// '+' is a quality value too, so a line starting with it need not be a
+  /// quality header. A record starts at a line beginning with '@' whose
+  /// second next line is the quality header, or the header of the next
+  /// record if there is no quality; neither a sequence nor a quality line
+  /// is followed that way. Returns the size of `data` if there is no such
+  /// line with both of the next lines in `data`.
+  static uint64_t find_next_sequence(std::string_view data, uint64_t offset) {
+    // Beginning of a file is the beginning of a line.
+    if (offset == 0) {
+      return offset;
+    }
+    if (offset >= data.size()) {
+      return data.size();
+    }
+
+    const auto next_line = [&data](uint64_t from) {
+      return std::min(data.find('\n', from), data.size()) + 1;
+    };
+    // Only cut at the beginning of a line.
+    if (data[offset - 1] != '\n') {
+      offset = next_line(offset);
+    }
+    for (; offset < data.size(); offset = next_line(offset)) {
+      if (data[offset] != '@') {
+        continue;
+      }
+      const uint64_t third = next_line(next_line(offset));
+      if (third >= data.size()) {
+        break;
+      }
+      if (data[third] == '+' || data[third] == '@') {
+        return offset;
+      }
+    }
+    return data.size();
+  }
 };
 
-/// Reads KMers from a Fastq file.  
-template <size_t K>
+using FastqReader = BasicFastqReader<FileReader>;
+using MmapFastqReader = BasicFastqReader<MmapFileReader>;
+using AsyncFastqReader = BasicFastqReader<AsyncFileReader>;
+using GzipFastqReader = BasicFastqReader<GzipFileReader>;
+
+/// Parse the sequence and the quality line of a record together and mask the
+/// bases of a quality below `min_quality` (Phred) as 'N', so that none of the
+/// KMer readers and extractors produce a KMer with a low quality base.
+/// The sequence is copied to mask it; with `min_quality` 0 there is nothing
+/// to mask and this is the same as `BasicFastqReader`.
+template <class File>
+class QualityFastqReader : public BasicFastqReader<File> {
+ public:
+  /// `args` are passed on to `BasicFastqReader`.
+  template <typename... Args>
+  QualityFastqReader(uint8_t min_quality, Args&&... args)
+      : BasicFastqReader<File>(std::forward<Args>(args)...),
+        min_quality_(min_quality) {}
+
+  bool next(std::string_view* data) override {
+    if (min_quality_ == 0) {
+      return BasicFastqReader<File>::next(data);
+    }
+    if (this->eof()) {
+      return false;
+    }
+    if (this->peek() != '@') {
+      PLOG_WARNING << "Unexpected character " << this->peek()
+                   << ". Expecting sequence identifier "
+                      "line which begins with '@'.";
+      return false;
+    }
+    if (!File::next(nullptr)) {
+      return false;
+    }
+
+    // The line is gone once the backend moves on to the quality line.
+    std::string_view seq;
+    if (!File::next(&seq)) {
+      PLOG_WARNING << "Unexpected EOF. Expecting sequence.";
+      return false;
+    }
+    seq_.assign(seq);
+    *data = seq_;
+
+    // Nothing to mask without a quality line.
+    if (this->peek() != '+') {
+      return true;
+    }
+    std::string_view quals;
+    if (!File::next(nullptr) || !File::next(&quals)) {
+      PLOG_WARNING << "Unexpected EOF. Expecting quality.";
+      return false;
+    }
+    simd::mask_low_quality(seq_.data(), quals.data(),
+                           std::min(seq_.size(), quals.size()), min_quality_);
+    return true;
+  }
+
+ private:
+  uint8_t min_quality_;
+  std::string seq_;
+};
+
+/// Reads KMers from a Fastq file.
+/// With `Canonical`, both strands of a KMer are read as the same KMer.
+template <size_t K, class Fastq = FastqReader, bool Canonical = false>
 class FastqKMerReader : public InputReaderU64 {
  public:
   template <typename... Args>
   FastqKMerReader(Args&&... args)
-      : reader_(std::make_unique<FastqReader>(std::forward<Args>(args)...)) {}
+      : reader_(std::make_unique<Fastq>(std::forward<Args>(args)...)) {}
 
   bool next(uint64_t* data) override { return reader_.next(data); }
 
  private:
-  KMerReader<K, std::string_view> reader_;
+  KMerReader<K, std::string_view, Canonical> reader_;
 };
 
+/// Reads KMers straight out of a memory mapped Fastq file.
+/// Nothing is copied, so there is no need for preloading.
+template <size_t K>
+using MmapFastqKMerReader = FastqKMerReader<K, MmapFastqReader>;
+
+/// Reads KMers from a Fastq file while the next chunks are read in the
+/// background.
+template <size_t K>
+using AsyncFastqKMerReader = FastqKMerReader<K, AsyncFastqReader>;
+
+/// Reads KMers from a gzip compressed Fastq file.
+template <size_t K>
+using GzipFastqKMerReader = FastqKMerReader<K, GzipFastqReader>;
+
 /// Produce the same output as `FastqKMerReader` but the sequencies are parsed
 /// and stored in the memory before producing.
-template <size_t K>
+template <size_t K, bool Canonical = false, class Fastq = FastqReader>
 class FastqKMerPreloadReader : public InputReaderU64 {
  public:
   template <typename... Args>
   FastqKMerPreloadReader(Args&&... args)
       : reader_(std::make_unique<Reservoir<std::string>>(
-            std::make_unique<MemcpyAdaptor<FastqReader, std::string>>(
-                FastqReader(std::forward<Args>(args)...)))) {}
+            std::make_unique<MemcpyAdaptor<Fastq, std::string>>(
+                Fastq(std::forward<Args>(args)...)))) {}
 
   bool next(uint64_t* data) override { return reader_.next(data); }
 
  private:
-  KMerReader<K> reader_;
+  KMerReader<K, std::string, Canonical> reader_;
 };
 
-/// Helper for instantiating a `FastqKMerReader` from a runtime `K`.
-template <uint32_t CurrentK=DNAKMer<1>::MAX_K, typename... Args>
-std::unique_ptr<InputReaderU64> MakeFastqKMerReader(uint32_t K, Args&&... args) {
+/// Extract the KMers of a Fastq file with `SimdKMerReader`.
+template <size_t K, class Fastq = MmapFastqReader, bool Canonical = false>
+class SimdFastqKMerReader
+    : public SimdKMerReader<K, std::string_view, Canonical> {
+ public:
+  template <typename... Args>
+  SimdFastqKMerReader(Args&&... args)
+      : SimdKMerReader<K, std::string_view, Canonical>(
+            std::make_unique<Fastq>(std::forward<Args>(args)...)) {}
+};
+
+/// `SimdFastqKMerReader` over sequences preloaded into the memory.
+template <size_t K, bool Canonical = false, class Fastq = FastqReader>
+class SimdFastqKMerPreloadReader
+    : public SimdKMerReader<K, std::string, Canonical> {
+ public:
+  template <typename... Args>
+  SimdFastqKMerPreloadReader(Args&&... args)
+      : SimdKMerReader<K, std::string, Canonical>(
+            std::make_unique<Reservoir<std::string>>(
+                std::make_unique<MemcpyAdaptor<Fastq, std::string>>(
+                    Fastq(std::forward<Args>(args)...)))) {}
+};
+
+/// Reads KMers with K > 32 from a Fastq file; see `WideKMerReader`.
+template <size_t N, class Fastq = FastqReader, bool Canonical = false>
+class WideFastqKMerReader : public InputReader<WideKey<N>> {
+ public:
+  template <typename... Args>
+  WideFastqKMerReader(uint32_t K, Args&&... args)
+      : reader_(std::make_unique<Fastq>(std::forward<Args>(args)...),
+                WideDNAKMer<N>(K)) {}
+
+  bool next(WideKey<N>* data) override { return reader_.next(data); }
+
+ private:
+  WideKMerReader<N, std::string_view, Canonical> reader_;
+};
+
+/// Same as above over sequences preloaded into the memory.
+template <size_t N, bool Canonical = false, class Fastq = FastqReader>
+class WideFastqKMerPreloadReader : public InputReader<WideKey<N>> {
+ public:
+  template <typename... Args>
+  WideFastqKMerPreloadReader(uint32_t K, Args&&... args)
+      : reader_(std::make_unique<Reservoir<std::string>>(
+                    std::make_unique<MemcpyAdaptor<Fastq, std::string>>(
+                        Fastq(std::forward<Args>(args)...))),
+                WideDNAKMer<N>(K)) {}
+
+  bool next(WideKey<N>* data) override { return reader_.next(data); }
+
+ private:
+  WideKMerReader<N, std::string, Canonical> reader_;
+};
+
+/// Helper for instantiating a KMer `Reader` from a runtime `K`.
+/// `Base` is the interface of `Reader` to return.
+template <template <size_t> class Reader, class Base = InputReaderU64,
+          uint32_t CurrentK = DNAKMer<1>::MAX_K, typename... Args>
+std::unique_ptr<Base> MakeKMerReader(uint32_t K, Args&&... args) {
   // Safety check.
   if (K > DNAKMer<1>::MAX_K || K < 1) {
     PLOG_FATAL << "K=" << K << " is not a valid value";
@@ -153,37 +348,75 @@ std::unique_ptr<InputReaderU64> MakeFastqKMerReader(uint32_t K, Args&&... args)
 
   // Found the right K.
   if (K == CurrentK) {
-    return std::make_unique<FastqKMerReader<CurrentK>>(std::forward<Args>(args)...);
+    return std::make_unique<Reader<CurrentK>>(std::forward<Args>(args)...);
   }
 
   // Recurse until we found the right K.
   // Constexpr is necessary here; the compiler will go into an infinite loop otherwise.
   if constexpr (CurrentK > 1) {
-    return MakeFastqKMerReader<CurrentK-1, Args...>(K, std::forward<Args>(args)...);
+    return MakeKMerReader<Reader, Base, CurrentK - 1, Args...>(
+        K, std::forward<Args>(args)...);
   }
   return nullptr;
 }
 
+/// Helper for instantiating a `FastqKMerReader` from a runtime `K`.
+template <typename... Args>
+std::unique_ptr<InputReaderU64> MakeFastqKMerReader(uint32_t K, Args&&... args) {
+  return MakeKMerReader<FastqKMerReader>(K, std::forward<Args>(args)...);
+}
+
 /// Helper for instantiating a `FastqKMerPreloadReader` from a runtime `K`.
-template <uint32_t CurrentK=DNAKMer<1>::MAX_K, typename... Args>
+template <typename... Args>
 std::unique_ptr<InputReaderU64> MakeFastqKMerPreloadReader(uint32_t K, Args&&... args) {
-  // Safety check.
-  if (K > DNAKMer<1>::MAX_K || K < 1) {
-    PLOG_FATAL << "K=" << K << " is not a valid value";
-    return nullptr;
-  }
+  return MakeKMerReader<FastqKMerPreloadReader>(K, std::forward<Args>(args)...);
+}
 
-  // Found the right K.
-  if (K == CurrentK) {
-    return std::make_unique<FastqKMerPreloadReader<CurrentK>>(std::forward<Args>(args)...);
-  }
+/// Helper for instantiating a `MmapFastqKMerReader` from a runtime `K`.
+template <typename... Args>
+std::unique_ptr<InputReaderU64> MakeMmapFastqKMerReader(uint32_t K, Args&&... args) {
+  return MakeKMerReader<MmapFastqKMerReader>(K, std::forward<Args>(args)...);
+}
 
-  // Recurse until we found the right K.
-  // Constexpr is necessary here; the compiler will go into an infinite loop otherwise.
-  if constexpr (CurrentK > 1) {
-    return MakeFastqKMerPreloadReader<CurrentK-1, Args...>(K, std::forward<Args>(args)...);
-  }
-  return nullptr;
+/// Helper for instantiating a `AsyncFastqKMerReader` from a runtime `K`.
+template <typename... Args>
+std::unique_ptr<InputReaderU64> MakeAsyncFastqKMerReader(uint32_t K, Args&&... args) {
+  return MakeKMerReader<AsyncFastqKMerReader>(K, std::forward<Args>(args)...);
+}
+
+/// Helper for instantiating a `GzipFastqKMerReader` from a runtime `K`.
+template <typename... Args>
+std::unique_ptr<InputReaderU64> MakeGzipFastqKMerReader(uint32_t K, Args&&... args) {
+  return MakeKMerReader<GzipFastqKMerReader>(K, std::forward<Args>(args)...);
+}
+
+/// Bind the template arguments other than `K` of the Fastq KMer readers, so
+/// that they can be passed to `MakeKMerReader`.
+template <class Fastq, bool Canonical = false>
+struct FastqKMerReaders {
+  template <size_t K>
+  using Reader = FastqKMerReader<K, Fastq, Canonical>;
+  template <size_t K>
+  using SimdReader = SimdFastqKMerReader<K, Fastq, Canonical>;
+};
+
+/// Same as above for the preloading readers, which parse with `Fastq`.
+template <bool Canonical = false, class Fastq = FastqReader>
+struct FastqKMerPreloadReaders {
+  template <size_t K>
+  using Reader = FastqKMerPreloadReader<K, Canonical, Fastq>;
+  template <size_t K>
+  using SimdReader = SimdFastqKMerPreloadReader<K, Canonical, Fastq>;
+};
+
+/// Helper for instantiating a `SimdFastqKMerReader` over `Fastq` from a
+/// runtime `K`.
+template <class Fastq, bool Canonical = false, typename... Args>
+std::unique_ptr<KMerBatchReader> MakeSimdFastqKMerReader(uint32_t K,
+                                                         Args&&... args) {
+  return MakeKMerReader<
+      FastqKMerReaders<Fastq, Canonical>::template SimdReader,
+      KMerBatchReader>(K, std::forward<Args>(args)...);
 }
 }  // namespace input_reader
 }  // namespace kmercounter
@@ -164,6 +164,7 @@ class FileReader : public InputReader<std::string_view> {
     return file;
   }
 
+ public:
   /// Find offset of next line.
   static std::streampos find_next_line(std::istream& st,
                                        std::streampos offset) {
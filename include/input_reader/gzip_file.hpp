@@ -0,0 +1,507 @@
+#ifndef INPUT_READER_GZIP_FILE_HPP
+#define INPUT_READER_GZIP_FILE_HPP
+
+#include <plog/Log.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "input_reader.hpp"
+#include "mmap_file.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+/// Check the gzip magic bytes of a file.
+inline bool is_gzip_file(std::string_view filename) {
+  std::ifstream file(filename.data(), std::ios::binary);
+  unsigned char magic[2] = {};
+  file.read(reinterpret_cast<char *>(magic), sizeof(magic));
+  return file.gcount() == sizeof(magic) && magic[0] == 0x1f &&
+         magic[1] == 0x8b;
+}
+
+/// A BGZF block: a gzip member of at most 64KiB which records its own
+/// compressed size in the header and the uncompressed size in the footer.
+struct BgzfBlock {
+  uint64_t offset;
+  uint32_t isize;
+};
+
+/// Walk the BGZF block chain of `data`.
+/// Returns an empty vector if `data` is not BGZF.
+inline std::vector<BgzfBlock> find_bgzf_blocks(std::string_view data) {
+  constexpr uint64_t HEADER_SIZE = 12;
+  constexpr uint64_t FOOTER_SIZE = 8;
+  const auto byte = [&data](uint64_t i) { return uint8_t(data[i]); };
+  const auto le16 = [&byte](uint64_t i) { return byte(i) | byte(i + 1) << 8; };
+
+  std::vector<BgzfBlock> blocks;
+  uint64_t offset = 0;
+  while (offset < data.size()) {
+    // ID1, ID2, CM=deflate, FLG=FEXTRA.
+    if (offset + HEADER_SIZE > data.size() || byte(offset) != 0x1f ||
+        byte(offset + 1) != 0x8b || byte(offset + 2) != 8 ||
+        !(byte(offset + 3) & 4)) {
+      return {};
+    }
+    // Look for the "BC" subfield, which holds the block size minus one.
+    const uint64_t xlen = le16(offset + 10);
+    uint64_t block_size = 0;
+    for (uint64_t sub = offset + HEADER_SIZE;
+         sub + 4 <= offset + HEADER_SIZE + xlen && sub + 4 <= data.size();
+         sub += 4 + le16(sub + 2)) {
+      if (byte(sub) == 'B' && byte(sub + 1) == 'C' && le16(sub + 2) == 2 &&
+          sub + 6 <= data.size()) {
+        block_size = le16(sub + 4) + 1;
+        break;
+      }
+    }
+    if (block_size < HEADER_SIZE + xlen + FOOTER_SIZE ||
+        offset + block_size > data.size()) {
+      return {};
+    }
+    const uint64_t footer = offset + block_size - 4;
+    const uint32_t isize = le16(footer) | uint32_t(le16(footer + 2)) << 16;
+    blocks.push_back({offset, isize});
+    offset += block_size;
+  }
+  return blocks;
+}
+
+/// Estimate the uncompressed size of the gzip stream `data`. BGZF records
+/// the size of every block, so it is exact there. Other streams only record
+/// the size of their last member, modulo 4 GiB, which is at best a lower
+/// bound; FASTQ compresses at least about `FASTQ_GZIP_RATIO` times, so the
+/// estimate is not less than that.
+inline uint64_t gzip_uncompressed_size(std::string_view data) {
+  constexpr uint64_t FASTQ_GZIP_RATIO = 4;
+  const auto blocks = find_bgzf_blocks(data);
+  if (!blocks.empty()) {
+    uint64_t size = 0;
+    for (const auto &block : blocks) {
+      size += block.isize;
+    }
+    return size;
+  }
+  uint64_t isize = 0;
+  if (data.size() >= 4) {
+    for (uint64_t i = 0; i < 4; i++) {
+      isize |= uint64_t(uint8_t(data[data.size() - 4 + i])) << (8 * i);
+    }
+  }
+  return std::max(isize, FASTQ_GZIP_RATIO * data.size());
+}
+
+/// Inflate a gzip stream (possibly of multiple members) and cut the output
+/// into chunks that end at a boundary given by `find_bound`.
+/// Only the uncompressed bytes in [skip, limit) are produced.
+class GzipChunker {
+ public:
+  /// Same as `MmapFileReader::find_bound_t`.
+  using find_bound_t =
+      std::function<uint64_t(std::string_view data, uint64_t offset)>;
+
+  GzipChunker(std::string_view input, uint64_t chunk_size,
+              find_bound_t find_bound, uint64_t skip = 0,
+              uint64_t limit = std::numeric_limits<uint64_t>::max())
+      : input_(input),
+        chunk_size_(std::max(chunk_size, uint64_t(2))),
+        find_bound_(std::move(find_bound)),
+        skip_(skip),
+        limit_(limit) {
+    memset(&strm_, 0, sizeof(strm_));
+    // 32 enables gzip/zlib header detection.
+    if (inflateInit2(&strm_, 15 + 32) != Z_OK) {
+      PLOG_FATAL << "inflateInit2 failed: " << strm_.msg;
+      done_ = true;
+    }
+    done_ |= input_.empty() || limit_ <= skip_;
+  }
+
+  GzipChunker(const GzipChunker &) = delete;
+  GzipChunker &operator=(const GzipChunker &) = delete;
+
+  ~GzipChunker() { inflateEnd(&strm_); }
+
+  /// Replace `chunk` with the next chunk; reuses its capacity.
+  /// Returns false if the stream is exhausted.
+  bool next_chunk(std::string *chunk) {
+    chunk->assign(carry_);
+    carry_.clear();
+    while (!done_ && chunk->size() < chunk_size_) {
+      this->inflate_some(chunk, chunk_size_ - chunk->size());
+    }
+    if (chunk->empty()) {
+      return false;
+    }
+
+    // Cut at the first boundary within the last quarter, and keep the rest
+    // for the next chunk. Inflate more if there is none.
+    const uint64_t from = std::max(chunk->size() - chunk->size() / 4, 1ul);
+    while (!done_) {
+      const uint64_t cut = find_bound_(*chunk, from);
+      if (cut < chunk->size()) {
+        carry_.assign(chunk->data() + cut, chunk->size() - cut);
+        chunk->resize(cut);
+        break;
+      }
+      this->inflate_some(chunk, chunk_size_ / 4 + 1);
+    }
+    return true;
+  }
+
+  /// Inflate up to `len` more bytes and append them to `out`.
+  void inflate_some(std::string *out, uint64_t len) {
+    const uint64_t old_size = out->size();
+    out->resize(old_size + len);
+    strm_.next_out = reinterpret_cast<Bytef *>(out->data() + old_size);
+    strm_.avail_out = len;
+
+    while (strm_.avail_out > 0 && !done_) {
+      // `avail_in` is 32-bit; feed large inputs piece by piece.
+      if (strm_.avail_in == 0) {
+        const uint64_t piece =
+            std::min(input_.size() - in_pos_, uint64_t(1) << 30);
+        strm_.next_in = (Bytef *)input_.data() + in_pos_;
+        strm_.avail_in = piece;
+        in_pos_ += piece;
+      }
+      const int ret = inflate(&strm_, Z_NO_FLUSH);
+      if (ret == Z_STREAM_END) {
+        // Concatenated members, e.g., BGZF blocks, form one stream.
+        if (strm_.avail_in == 0 && in_pos_ == input_.size()) {
+          done_ = true;
+        } else {
+          inflateReset(&strm_);
+        }
+      } else if (ret != Z_OK) {
+        PLOG_ERROR_IF(!(ret == Z_BUF_ERROR && in_pos_ == input_.size()))
+            << "inflate failed(" << ret << "): "
+            << (strm_.msg ? strm_.msg : "");
+        PLOG_WARNING_IF(ret == Z_BUF_ERROR) << "Truncated gzip stream";
+        done_ = true;
+      }
+    }
+    const uint64_t produced = len - strm_.avail_out;
+
+    // Clip to [skip_, limit_) in the uncompressed stream.
+    const uint64_t begin = total_out_;
+    const uint64_t end = total_out_ + produced;
+    total_out_ = end;
+    const uint64_t keep_begin = std::max(begin, skip_);
+    const uint64_t keep_end = std::min(end, limit_);
+    if (keep_end <= keep_begin) {
+      out->resize(old_size);
+    } else {
+      memmove(out->data() + old_size, out->data() + old_size + (keep_begin - begin),
+              keep_end - keep_begin);
+      out->resize(old_size + keep_end - keep_begin);
+    }
+    done_ |= total_out_ >= limit_;
+  }
+
+  bool done() { return done_; }
+
+ private:
+  std::string_view input_;
+  uint64_t in_pos_ = 0;
+  z_stream strm_;
+  bool done_ = false;
+  uint64_t chunk_size_;
+  find_bound_t find_bound_;
+  uint64_t skip_;
+  uint64_t limit_;
+  /// Number of bytes inflated so far.
+  uint64_t total_out_ = 0;
+  /// The bytes after the cut of the previous chunk.
+  std::string carry_;
+};
+
+/// One decompressor thread per file feeding all partitions through a ring of
+/// chunks, for gzip files which can't be decompressed in parallel.
+/// Chunks end at a record boundary, so the partitions can parse them
+/// independently; which partition gets which chunk is first come first
+/// served.
+class SharedGzipStream {
+ public:
+  using find_bound_t = GzipChunker::find_bound_t;
+
+  SharedGzipStream(std::shared_ptr<const MmapFile> file, uint64_t chunk_size,
+                   uint32_t num_buffers, find_bound_t find_bound)
+      : file_(std::move(file)),
+        chunker_(file_->view(), chunk_size, std::move(find_bound)) {
+    free_.resize(num_buffers);
+    thread_ = std::thread(&SharedGzipStream::decompress_loop, this);
+  }
+
+  ~SharedGzipStream() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    free_cv_.notify_all();
+    thread_.join();
+  }
+
+  /// Join the stream of `filename`; the first of the `num_parts` partitions
+  /// creates it. The stream is forgotten once all partitions have joined,
+  /// so the next run starts from scratch.
+  static std::shared_ptr<SharedGzipStream> join(std::string_view filename,
+                                                uint64_t num_parts,
+                                                uint64_t chunk_size,
+                                                find_bound_t find_bound) {
+    std::lock_guard guard(registry_mutex_);
+    const std::string id(filename);
+    auto &[stream, joined] = registry_[id];
+    if (!stream) {
+      stream = std::make_shared<SharedGzipStream>(
+          std::make_shared<const MmapFile>(filename), chunk_size,
+          2 * num_parts + 2, std::move(find_bound));
+    }
+    auto rtn = stream;
+    if (++joined >= num_parts) {
+      registry_.erase(id);
+    }
+    return rtn;
+  }
+
+  /// Swap the next chunk into `chunk` and recycle the buffer it held.
+  /// Returns false if all chunks were handed out.
+  bool pop(std::string *chunk) {
+    std::unique_lock lock(mutex_);
+    full_cv_.wait(lock, [&] { return !full_.empty() || done_; });
+    if (full_.empty()) {
+      return false;
+    }
+    std::swap(*chunk, full_.front());
+    free_.push_back(std::move(full_.front()));
+    full_.pop_front();
+    lock.unlock();
+    free_cv_.notify_one();
+    return true;
+  }
+
+ private:
+  void decompress_loop() {
+    while (true) {
+      std::string buffer;
+      {
+        std::unique_lock lock(mutex_);
+        free_cv_.wait(lock, [&] { return !free_.empty() || stop_; });
+        if (stop_) {
+          return;
+        }
+        buffer = std::move(free_.back());
+        free_.pop_back();
+      }
+      const bool has_chunk = chunker_.next_chunk(&buffer);
+      {
+        std::lock_guard lock(mutex_);
+        if (has_chunk) {
+          full_.push_back(std::move(buffer));
+        } else {
+          done_ = true;
+        }
+      }
+      full_cv_.notify_all();
+      if (!has_chunk) {
+        return;
+      }
+    }
+  }
+
+  std::shared_ptr<const MmapFile> file_;
+  GzipChunker chunker_;
+  std::mutex mutex_;
+  std::condition_variable free_cv_;
+  std::condition_variable full_cv_;
+  std::vector<std::string> free_;
+  std::deque<std::string> full_;
+  bool done_ = false;
+  bool stop_ = false;
+  std::thread thread_;
+
+  inline static std::mutex registry_mutex_;
+  inline static std::map<std::string,
+                         std::pair<std::shared_ptr<SharedGzipStream>, uint64_t>>
+      registry_;
+};
+
+/// Read a gzip compressed file one whole line at a time within the
+/// partition.
+/// BGZF files (e.g., from bgzip) are split at block boundaries and each
+/// partition inflates its own blocks, so decompression scales with the
+/// number of partitions. The partition bounds are then found the same way
+/// as `MmapFileReader`, on the uncompressed data.
+/// Other gzip files are inflated by a single `SharedGzipStream` thread and
+/// the partitions take record aligned chunks from it as they go.
+///
+/// The line produced by `next(&line)` stays valid until the next call to
+/// `next` with a non-null output.
+class GzipFileReader : public InputReader<std::string_view> {
+ public:
+  using find_bound_t = GzipChunker::find_bound_t;
+
+  static constexpr uint64_t DEFAULT_CHUNK_SIZE = 4 << 20;
+
+  GzipFileReader(std::string_view filename, uint64_t part_id,
+                 uint64_t num_parts,
+                 find_bound_t find_bound = MmapFileReader::find_next_line,
+                 uint64_t chunk_size = DEFAULT_CHUNK_SIZE)
+      : part_id_(part_id), num_parts_(num_parts) {
+    PLOG_FATAL_IF(part_id >= num_parts)
+        << "part_id(" << part_id << " ) >= num_parts(" << num_parts << ")";
+    file_ = std::make_shared<const MmapFile>(filename);
+    const auto blocks = find_bgzf_blocks(file_->view());
+    if (blocks.empty()) {
+      PLOG_DEBUG << filename << " is not BGZF; decompressing serially";
+      shared_ = SharedGzipStream::join(filename, num_parts, chunk_size,
+                                       find_bound);
+      return;
+    }
+    this->init_bgzf_partition(blocks, chunk_size, find_bound);
+  }
+
+  /// Single partition variant.
+  GzipFileReader(std::string_view filename) : GzipFileReader(filename, 0, 1) {}
+
+  /// Point `output` to the next line and advance the offset.
+  bool next(std::string_view *output) override {
+    if (this->eof()) {
+      return false;
+    }
+    const auto newline = chunk_.find('\n', pos_);
+    const uint64_t line_end =
+        newline == std::string::npos ? chunk_.size() : newline;
+    if (output != nullptr) {
+      *output = std::string_view(chunk_.data() + pos_, line_end - pos_);
+    }
+    pos_ = std::min(line_end + 1, uint64_t(chunk_.size()));
+    return true;
+  }
+
+  /// Skip to next line.
+  bool skip_to_next_line() { return this->next(nullptr); }
+
+  int peek() { return this->eof() ? EOF : chunk_[pos_]; }
+
+  int get() { return this->eof() ? EOF : chunk_[pos_++]; }
+
+  bool good() { return !this->eof(); }
+
+  /// Chunks end at a boundary, so moving on to the next chunk here never
+  /// splits a line or record.
+  bool eof() {
+    while (pos_ >= chunk_.size()) {
+      if (!this->next_chunk()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint64_t num_parts() { return num_parts_; }
+
+  uint64_t part_id() { return part_id_; }
+
+ private:
+  /// Split the blocks evenly by compressed size and find the uncompressed
+  /// range of this partition.
+  void init_bgzf_partition(const std::vector<BgzfBlock> &blocks,
+                           uint64_t chunk_size, find_bound_t &find_bound) {
+    const auto view = file_->view();
+    const auto first_block_at = [&](uint64_t part) {
+      const uint64_t offset = (double)view.size() / num_parts_ * part;
+      return std::lower_bound(blocks.begin(), blocks.end(), offset,
+                              [](const BgzfBlock &block, uint64_t offset) {
+                                return block.offset < offset;
+                              }) -
+             blocks.begin();
+    };
+    const uint64_t begin = first_block_at(part_id_);
+    const uint64_t end = first_block_at(part_id_ + 1);
+    uint64_t own_size = 0;
+    for (uint64_t i = begin; i < end; i++) {
+      own_size += blocks[i].isize;
+    }
+
+    // Skip the partial record in front, and finish the last record in the
+    // blocks of the next partition, which skips exactly that much.
+    const auto head = [&](uint64_t block) -> uint64_t {
+      if (block == 0 || block >= blocks.size()) {
+        return 0;
+      }
+      return head_size(view.substr(blocks[block].offset), find_bound);
+    };
+    const uint64_t skip = head(begin);
+    const uint64_t limit = own_size + head(end);
+    PLOG_DEBUG << part_id_ << "/" << num_parts_ << ": blocks [" << begin
+               << ", " << end << "), skip " << skip << ", limit " << limit;
+
+    if (begin < blocks.size()) {
+      chunker_ = std::make_unique<GzipChunker>(
+          view.substr(blocks[begin].offset), chunk_size, find_bound, skip,
+          limit);
+    }
+  }
+
+  /// The number of bytes before the first boundary of a stream that starts
+  /// in the middle of the file.
+  static uint64_t head_size(std::string_view input, find_bound_t &find_bound) {
+    constexpr uint64_t STEP = 64 << 10;
+    GzipChunker chunker(input, STEP, nullptr);
+    // A leading byte so `find_bound` doesn't treat it as the file start.
+    std::string window("\n");
+    while (true) {
+      chunker.inflate_some(&window, STEP);
+      const uint64_t bound = find_bound(window, 1);
+      if (bound < window.size() || chunker.done()) {
+        return std::min(bound, uint64_t(window.size())) - 1;
+      }
+    }
+  }
+
+  bool next_chunk() {
+    pos_ = 0;
+    // Keep the previous chunk alive for the last returned line.
+    std::swap(prev_chunk_, chunk_);
+    if (shared_) {
+      return shared_->pop(&chunk_);
+    }
+    if (chunker_) {
+      return chunker_->next_chunk(&chunk_);
+    }
+    chunk_.clear();
+    return false;
+  }
+
+  std::shared_ptr<const MmapFile> file_;
+  std::unique_ptr<GzipChunker> chunker_;
+  std::shared_ptr<SharedGzipStream> shared_;
+  std::string chunk_;
+  std::string prev_chunk_;
+  uint64_t pos_ = 0;
+  uint64_t part_id_;
+  uint64_t num_parts_;
+};
+
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_GZIP_FILE_HPP
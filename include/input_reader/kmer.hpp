@@ -10,21 +10,27 @@
 
 namespace kmercounter {
 namespace input_reader {
-/// Generate KMer from a sequence.
-template <size_t K, class Input = std::string>
-class KMerReader : public InputReaderU64 {
+/// Generate KMer from a sequence with the rolling `KMer` encoder, e.g.,
+/// `DNAKMer` or `WideDNAKMer`.
+/// With `Canonical`, produce the smaller of each KMer and its reverse
+/// complement so that both strands are counted as one.
+template <class KMer, class Input = std::string, bool Canonical = false>
+class BasicKMerReader : public InputReader<typename KMer::data_type> {
  public:
-  KMerReader(std::unique_ptr<InputReader<Input>> lines)
-      : lines_(std::move(lines)), eof_(false) {
+  using data_type = typename KMer::data_type;
+
+  BasicKMerReader(std::unique_ptr<InputReader<Input>> lines,
+                  KMer kmer = KMer())
+      : lines_(std::move(lines)), kmer_(std::move(kmer)), eof_(false) {
     PLOG_WARNING_IF(!this->fetch_and_prep_new_line()) << "Empty input.";
   }
 
   // Return the next kmer.
-  bool next(uint64_t* data) override {
+  bool next(data_type* data) override {
     if (eof_) {
       return false;
     }
-    *data = kmer_.data();
+    *data = Canonical ? kmer_.canonical_data() : kmer_.data();
 
     if (current_line_iter_ == current_line_end_) {
       // This sequence is exhausted. Fetch the next sequence.
@@ -78,7 +84,7 @@ class KMerReader : public InputReaderU64 {
 
   // Refill the buffer because of a new sequence or a 'N'.
   bool refill_buffer() {
-    for (size_t i = 0; i < K; i++) {
+    for (size_t i = 0; i < kmer_.k(); i++) {
       if (current_line_iter_ == current_line_end_) {
         return false;
       }
@@ -96,9 +102,17 @@ class KMerReader : public InputReaderU64 {
   Input current_line_;
   typename Input::iterator current_line_iter_;
   typename Input::iterator current_line_end_;
-  DNAKMer<K> kmer_;
+  KMer kmer_;
   bool eof_;
 };
+
+template <size_t K, class Input = std::string, bool Canonical = false>
+using KMerReader = BasicKMerReader<DNAKMer<K>, Input, Canonical>;
+
+/// KMers with K > 32, packed into `N` words. K is given at runtime with
+/// `WideDNAKMer<N>(K)`.
+template <size_t N, class Input = std::string, bool Canonical = false>
+using WideKMerReader = BasicKMerReader<WideDNAKMer<N>, Input, Canonical>;
 }  // namespace input_reader
 }  // namespace kmercounter
 
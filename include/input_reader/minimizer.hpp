@@ -0,0 +1,190 @@
+#ifndef INPUT_READER_MINIMIZER_HPP
+#define INPUT_READER_MINIMIZER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "plog/Log.h"
+#include "utils/circular_buffer.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+/// A run of consecutive KMers of a sequence which share the same minimizer.
+struct SuperKMer {
+  /// The bases of the KMers, i.e., K - 1 + the number of KMers.
+  std::string_view bases;
+  /// Order of the minimizer; see `MinimizerSplitter::order`.
+  uint64_t minimizer;
+};
+
+/// Split sequences into super KMers.
+/// The minimizer of a KMer is its m-mer of the smallest `order`. Consecutive
+/// KMers mostly share their minimizer, so routing a KMer by its minimizer
+/// sends whole super KMers to the same place.
+/// With `Canonical`, the m-mers are canonical as well so that both strands of
+/// a KMer have the same minimizer.
+template <bool Canonical = false>
+class MinimizerSplitter {
+ public:
+  static constexpr uint32_t MAX_M = DNAKMer<1>::MAX_K;
+  /// Long runs of the same minimizer, e.g., in low complexity regions, are cut
+  /// so that a super KMer stays small.
+  static constexpr uint32_t DEFAULT_MAX_KMERS = 64;
+
+  MinimizerSplitter(uint32_t k, uint32_t m,
+                    uint32_t max_kmers = DEFAULT_MAX_KMERS)
+      : k_(k),
+        m_(m),
+        max_kmers_(max_kmers),
+        mmer_mask_(m == MAX_M ? ~0ull : (1ull << (2 * m)) - 1) {
+    PLOG_FATAL_IF(m < 1 || m > std::min(k, MAX_M))
+        << "Minimizer length " << m << " is not in [1, min(K=" << k << ", "
+        << MAX_M << ")]";
+    window_.resize(std::bit_ceil(k - m + 1));
+  }
+
+  /// Call `emit(const SuperKMer &)` for each super KMer of `seq`, in order.
+  /// Bases other than ACGT (case insensitive) end a super KMer, the same as
+  /// for `KMerReader`.
+  template <typename Fn>
+  void split(std::string_view seq, Fn &&emit) {
+    const uint64_t window_mask = window_.size() - 1;
+    uint64_t fwd = 0;
+    uint64_t rc = 0;
+    // Number of valid bases up to the current one.
+    uint32_t valid = 0;
+    // Monotonic queue of (order, end) of the m-mers in the current window.
+    uint64_t head = 0, tail = 0;
+
+    bool open = false;
+    uint64_t start = 0;
+    uint64_t current = 0;
+    uint32_t num_kmers = 0;
+    auto close = [&](uint64_t end) {
+      if (open) {
+        emit(SuperKMer{seq.substr(start, end - start), current});
+        open = false;
+      }
+    };
+
+    for (uint64_t i = 0; i < seq.size(); i++) {
+      const int code = DNAKMer<1>::encode(seq[i]);
+      if (code < 0) {
+        close(i);
+        valid = 0;
+        head = tail = 0;
+        continue;
+      }
+      fwd = ((fwd << 2) | code) & mmer_mask_;
+      rc = (rc >> 2) | (uint64_t(code ^ DNAKMer<1>::MER_MASK) << (2 * (m_ - 1)));
+      if (++valid < m_) {
+        continue;
+      }
+
+      // Slide the window of the KMer ending at i over the m-mer ending at i.
+      while (head < tail && window_[head & window_mask].second + k_ - m_ < i) {
+        head++;
+      }
+      const uint64_t mmer_order = order(Canonical ? std::min(fwd, rc) : fwd);
+      while (head < tail && window_[(tail - 1) & window_mask].first > mmer_order) {
+        tail--;
+      }
+      window_[tail++ & window_mask] = {mmer_order, i};
+      if (valid < k_) {
+        continue;
+      }
+
+      const uint64_t minimizer = window_[head & window_mask].first;
+      if (open && (minimizer != current || num_kmers == max_kmers_)) {
+        close(i);
+      }
+      if (!open) {
+        open = true;
+        start = i + 1 - k_;
+        current = minimizer;
+        num_kmers = 0;
+      }
+      num_kmers++;
+    }
+    close(seq.size());
+  }
+
+  /// A random order of the m-mers; the lexicographic one makes poly-A and
+  /// friends the minimizers of way too many KMers.
+  static uint64_t order(uint64_t mmer) {
+    // fmix64 of MurmurHash3.
+    mmer ^= mmer >> 33;
+    mmer *= 0xff51afd7ed558ccdull;
+    mmer ^= mmer >> 33;
+    mmer *= 0xc4ceb9fe1a85ec53ull;
+    mmer ^= mmer >> 33;
+    return mmer;
+  }
+
+ private:
+  uint32_t k_;
+  uint32_t m_;
+  uint32_t max_kmers_;
+  uint64_t mmer_mask_;
+  std::vector<std::pair<uint64_t, uint64_t>> window_;
+};
+
+namespace superkmer {
+/// Number of bases packed in a word.
+constexpr size_t BASES_PER_WORD = DNAKMer<1>::MAX_K;
+
+/// Number of words holding `len` packed bases.
+constexpr size_t num_words(size_t len) {
+  return (len + BASES_PER_WORD - 1) / BASES_PER_WORD;
+}
+
+/// Words of the longest super KMer with K <= 32 and the default cut.
+constexpr size_t MAX_WORDS = num_words(
+    BASES_PER_WORD - 1 + MinimizerSplitter<>::DEFAULT_MAX_KMERS);
+
+/// Pack the valid bases of a super KMer into `num_words(bases.size())` words
+/// with the encoding of `DNAKMer`, the first base in the top bits of word 0.
+inline size_t pack(std::string_view bases, uint64_t *words) {
+  const size_t n = num_words(bases.size());
+  for (size_t w = 0; w < n; w++) {
+    uint64_t word = 0;
+    const size_t begin = w * BASES_PER_WORD;
+    const size_t end = std::min(begin + BASES_PER_WORD, bases.size());
+    for (size_t i = begin; i < end; i++) {
+      word = (word << 2) | DNAKMer<1>::encode(bases[i]);
+    }
+    // Align the last partial word to the top as well.
+    words[w] = word << (2 * (begin + BASES_PER_WORD - end));
+  }
+  return n;
+}
+
+/// Call `fn(kmer)` for each of the KMers of `len` bases packed by `pack`.
+/// The KMers are the same as those of `KMerReader<K, Input, Canonical>`.
+template <bool Canonical = false, typename Fn>
+void for_each_kmer(const uint64_t *words, size_t len, uint32_t k, Fn &&fn) {
+  const uint64_t mask = k == BASES_PER_WORD ? ~0ull : (1ull << (2 * k)) - 1;
+  uint64_t fwd = 0;
+  uint64_t rc = 0;
+  for (size_t i = 0; i < len; i++) {
+    const uint64_t code =
+        (words[i / BASES_PER_WORD] >> (62 - 2 * (i % BASES_PER_WORD))) &
+        DNAKMer<1>::MER_MASK;
+    fwd = ((fwd << 2) | code) & mask;
+    if constexpr (Canonical) {
+      rc = (rc >> 2) | ((code ^ DNAKMer<1>::MER_MASK) << (2 * (k - 1)));
+    }
+    if (i + 1 >= k) {
+      fn(Canonical ? std::min(fwd, rc) : fwd);
+    }
+  }
+}
+}  // namespace superkmer
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_MINIMIZER_HPP
@@ -0,0 +1,200 @@
+#ifndef INPUT_READER_MMAP_FILE_HPP
+#define INPUT_READER_MMAP_FILE_HPP
+
+#include <fcntl.h>
+#include <plog/Log.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "input_reader.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+/// A read-only mapping of a whole file.
+/// The mapping is shared among the partition readers so that the
+/// `string_view`s they produce stay valid as long as one of them is alive.
+class MmapFile {
+ public:
+  MmapFile(std::string_view filename) {
+    const std::string path(filename);
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      PLOG_FATAL << "Failed to open file " << filename << ": "
+                 << strerror(errno);
+      return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      PLOG_FATAL << "Failed to stat file " << filename << ": "
+                 << strerror(errno);
+      close(fd);
+      return;
+    }
+
+    // mmap fails on zero-length mappings; an empty file is an empty view.
+    if (st.st_size > 0) {
+      void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        PLOG_FATAL << "Failed to mmap file " << filename << ": "
+                   << strerror(errno);
+      } else {
+        data_ = static_cast<const char *>(addr);
+        size_ = st.st_size;
+      }
+    }
+    // The mapping holds its own reference to the file.
+    close(fd);
+  }
+
+  MmapFile(const MmapFile &) = delete;
+  MmapFile &operator=(const MmapFile &) = delete;
+
+  ~MmapFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+  }
+
+  /// Give the kernel an access pattern hint for [offset, offset + len).
+  /// Failures are not fatal; e.g., MADV_HUGEPAGE is rejected on file
+  /// mappings unless the kernel supports read-only THP for files.
+  void advise(uint64_t offset, uint64_t len, int advice) const {
+    if (data_ == nullptr || len == 0) {
+      return;
+    }
+    // madvise requires a page aligned start address.
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    const uint64_t start = offset & ~(page_size - 1);
+    if (madvise(const_cast<char *>(data_) + start, offset + len - start,
+                advice) != 0) {
+      PLOG_DEBUG << "madvise(" << advice << ") failed: " << strerror(errno);
+    }
+  }
+
+  std::string_view view() const { return std::string_view(data_, size_); }
+
+  uint64_t size() const { return size_; }
+
+ private:
+  const char *data_ = nullptr;
+  uint64_t size_ = 0;
+};
+
+/// Read a memory mapped file one whole line at a time within the partition.
+/// Same partitioning scheme as `FileReader`, but the lines produced point
+/// directly into the mapping, so nothing is copied.
+class MmapFileReader : public InputReader<std::string_view> {
+ public:
+  /// Takes the content of the whole file and returns the offset of the
+  /// first boundary after `offset`.
+  using find_bound_t =
+      std::function<uint64_t(std::string_view data, uint64_t offset)>;
+
+  MmapFileReader(std::string_view filename, uint64_t part_id,
+                 uint64_t num_parts, find_bound_t find_bound = find_next_line)
+      : MmapFileReader(std::make_shared<const MmapFile>(filename), part_id,
+                       num_parts, find_bound) {}
+
+  MmapFileReader(std::shared_ptr<const MmapFile> file, uint64_t part_id,
+                 uint64_t num_parts, find_bound_t find_bound = find_next_line)
+      : file_(std::move(file)),
+        data_(file_->view()),
+        part_id_(part_id),
+        num_parts_(num_parts) {
+    PLOG_FATAL_IF(part_id >= num_parts)
+        << "part_id(" << part_id << " ) >= num_parts(" << num_parts << ")";
+    const uint64_t file_size = data_.size();
+    const uint64_t part_start = (double)file_size / num_parts * part_id;
+    part_end_ = (double)file_size / num_parts * (part_id + 1);
+    PLOG_DEBUG << part_id << "/" << num_parts << ": start " << part_start
+               << ", end " << part_end_;
+
+    // Adjust both ends of the partition to the boundaries.
+    part_end_ = std::min(find_bound(data_, part_end_), file_size);
+    offset_ = std::min(find_bound(data_, part_start), file_size);
+    PLOG_DEBUG << part_id << "/" << num_parts << ": adj_start " << offset_
+               << ", adj_end " << part_end_;
+
+    if (offset_ < part_end_) {
+      file_->advise(offset_, part_end_ - offset_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+      file_->advise(offset_, part_end_ - offset_, MADV_HUGEPAGE);
+#endif
+    }
+  }
+
+  /// Single partition variant.
+  MmapFileReader(std::string_view filename) : MmapFileReader(filename, 0, 1) {}
+
+  /// Point `output` to the next line and advance the offset.
+  bool next(std::string_view *output) override {
+    if (this->eof()) {
+      return false;
+    }
+
+    const char *line = data_.data() + offset_;
+    const void *newline = memchr(line, '\n', data_.size() - offset_);
+    const uint64_t line_end =
+        newline ? static_cast<const char *>(newline) - data_.data()
+                : data_.size();
+
+    // Skip the line if `output` is nullptr.
+    if (output != nullptr) {
+      *output = std::string_view(line, line_end - offset_);
+    }
+    offset_ = std::min(line_end + 1, uint64_t(data_.size()));
+    return true;
+  }
+
+  /// Skip to next line.
+  bool skip_to_next_line() { return this->next(nullptr); }
+
+  int peek() { return good() ? data_[offset_] : EOF; }
+
+  int get() { return good() ? data_[offset_++] : EOF; }
+
+  bool good() { return offset_ < data_.size(); }
+
+  bool eof() { return offset_ >= part_end_; }
+
+  uint64_t num_parts() { return num_parts_; }
+
+  uint64_t part_id() { return part_id_; }
+
+  /// The underlying mapping; can be shared with other readers.
+  std::shared_ptr<const MmapFile> file() { return file_; }
+
+  /// Find offset of next line.
+  static uint64_t find_next_line(std::string_view data, uint64_t offset) {
+    // Beginning of a file is the beginning of a line.
+    if (offset == 0) {
+      return offset;
+    }
+    const auto newline = data.find('\n', offset);
+    return newline == std::string_view::npos ? data.size() : newline + 1;
+  }
+
+ private:
+  std::shared_ptr<const MmapFile> file_;
+  std::string_view data_;
+  uint64_t offset_;
+  uint64_t part_end_;
+  uint64_t part_id_;
+  uint64_t num_parts_;
+};
+
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_MMAP_FILE_HPP
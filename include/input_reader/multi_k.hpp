@@ -0,0 +1,110 @@
+#ifndef INPUT_READER_MULTI_K_HPP
+#define INPUT_READER_MULTI_K_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "plog/Log.h"
+#include "utils/circular_buffer.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+/// Extract the KMers of several K from a sequence in a single pass over its
+/// bases: each base is decoded once, into a window of the largest K, and the
+/// KMers of the smaller K are its low bits.
+/// The KMers of all K can share a table as `tag(kmer, k)`, a key which is
+/// unique across K.
+/// With `Canonical`, produce the smaller of each KMer and its reverse
+/// complement, the same as `KMerReader`.
+template <bool Canonical = false>
+class MultiKExtractor {
+ public:
+  /// One bit above the KMer is left for the tag.
+  static constexpr uint32_t MAX_K = DNAKMer<1>::MAX_K - 1;
+
+  /// `ks` in any order; duplicates are dropped.
+  explicit MultiKExtractor(std::vector<uint32_t> ks) : ks_(std::move(ks)) {
+    std::sort(ks_.begin(), ks_.end());
+    ks_.erase(std::unique(ks_.begin(), ks_.end()), ks_.end());
+    PLOG_FATAL_IF(ks_.empty()) << "No K to extract";
+    PLOG_FATAL_IF(ks_.front() < 1 || ks_.back() > MAX_K)
+        << "K of a multi-K extraction is not in [1, " << MAX_K << "]";
+    for (const auto k : ks_) {
+      masks_.push_back((1ull << (2 * k)) - 1);
+    }
+  }
+
+  /// The K values, in increasing order.
+  const std::vector<uint32_t> &ks() const { return ks_; }
+
+  /// Call `emit(i, kmer)` for each KMer of `seq`, with `i` the index of its K
+  /// in `ks()`. The KMers of a K come in the same order as from
+  /// `KMerReader`; bases other than ACGT (case insensitive) end them.
+  template <typename Fn>
+  void extract(std::string_view seq, Fn &&emit) const {
+    const uint32_t max_k = ks_.back();
+    uint64_t fwd = 0;
+    // The reverse complement of the last `max_k` bases.
+    uint64_t rc = 0;
+    // Number of valid bases up to the current one.
+    uint32_t valid = 0;
+    for (const char c : seq) {
+      const int code = DNAKMer<1>::encode(c);
+      if (code < 0) {
+        valid = 0;
+        continue;
+      }
+      fwd = (fwd << 2) | code;
+      rc = (rc >> 2) |
+           uint64_t(code ^ DNAKMer<1>::MER_MASK) << (2 * (max_k - 1));
+      valid++;
+
+      for (size_t i = 0; i < ks_.size() && ks_[i] <= valid; i++) {
+        uint64_t kmer = fwd & masks_[i];
+        if constexpr (Canonical) {
+          kmer = std::min(kmer, rc >> (2 * (max_k - ks_[i])));
+        }
+        emit(i, kmer);
+      }
+    }
+  }
+
+  /// A key of `kmer` of length `k` that no KMer of another K has: a marker
+  /// bit right above the KMer. Never zero.
+  static uint64_t tag(uint64_t kmer, uint32_t k) {
+    return kmer | (1ull << (2 * k));
+  }
+
+  /// The K of a `tag`ged key.
+  static uint32_t k_of(uint64_t key) { return (std::bit_width(key) - 1) / 2; }
+
+  /// The KMer of a `tag`ged key.
+  static uint64_t untag(uint64_t key) {
+    return key & ((1ull << (2 * k_of(key))) - 1);
+  }
+
+ private:
+  std::vector<uint32_t> ks_;
+  std::vector<uint64_t> masks_;
+};
+
+/// Parse a comma separated list of K, e.g., "21,25,31".
+inline std::vector<uint32_t> parse_k_list(const std::string &list) {
+  std::vector<uint32_t> ks;
+  std::istringstream in(list);
+  for (std::string k; std::getline(in, k, ',');) {
+    if (!k.empty()) {
+      ks.push_back(std::stoul(k));
+    }
+  }
+  return ks;
+}
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_MULTI_K_HPP
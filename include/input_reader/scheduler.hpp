@@ -0,0 +1,293 @@
+#ifndef INPUT_READER_SCHEDULER_HPP
+#define INPUT_READER_SCHEDULER_HPP
+
+#include <glob.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gzip_file.hpp"
+#include "input_reader.hpp"
+#include "plog/Log.h"
+
+namespace kmercounter {
+namespace input_reader {
+/// A FASTQ file of a multi-file input, or the pair of the mates of
+/// paired-end reads.
+struct InputFile {
+  std::string path;
+  /// The file of the mates of `path`; empty for single-end reads.
+  std::string mate;
+  /// Bytes of both files.
+  uint64_t size;
+  /// Whether the file can be read in parts. A gzip stream has to be read
+  /// whole by one thread.
+  bool splittable;
+};
+
+/// A part of an input file: partition `part_id` of `num_parts`, in the sense
+/// of the `part_id` and `num_parts` of the readers, and the same partition of
+/// the mates.
+struct InputRange {
+  const InputFile *file;
+  uint32_t part_id;
+  uint32_t num_parts;
+};
+
+/// Whether `path` is a glob pattern rather than a file.
+inline bool is_glob(std::string_view path) {
+  return path.find_first_of("*?[") != std::string_view::npos;
+}
+
+/// The files of `pattern`, a file or a glob pattern, or of `manifest` if
+/// given: a file of one FASTQ path per line, or of two, separated by white
+/// space, for the mates of paired-end reads.
+/// Throws `std::runtime_error` if the manifest cannot be read, a file of it
+/// does not exist, or there are no files at all.
+inline std::vector<InputFile> list_input_files(const std::string &pattern,
+                                               const std::string &manifest) {
+  std::vector<std::pair<std::string, std::string>> paths;
+  if (!manifest.empty()) {
+    std::ifstream in(manifest);
+    if (!in) {
+      throw std::runtime_error("failed to open input manifest " + manifest);
+    }
+    for (std::string line; std::getline(in, line);) {
+      std::istringstream fields(line);
+      std::string path, mate;
+      if (fields >> path) {
+        fields >> mate;
+        paths.emplace_back(path, mate);
+      }
+    }
+  } else {
+    glob_t matches;
+    if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+      for (size_t i = 0; i < matches.gl_pathc; i++) {
+        paths.emplace_back(matches.gl_pathv[i], "");
+      }
+    }
+    globfree(&matches);
+  }
+
+  std::vector<InputFile> files;
+  for (auto &[path, mate] : paths) {
+    for (const auto &p : {path, mate}) {
+      if (!p.empty() && !std::filesystem::is_regular_file(p)) {
+        throw std::runtime_error("input file " + p + " does not exist");
+      }
+    }
+    uint64_t size = std::filesystem::file_size(path);
+    if (!mate.empty()) {
+      size += std::filesystem::file_size(mate);
+    }
+    const bool splittable =
+        !is_gzip_file(path) && (mate.empty() || !is_gzip_file(mate));
+    files.push_back({std::move(path), std::move(mate), size, splittable});
+  }
+  if (files.empty()) {
+    throw std::runtime_error("no input files in " +
+                             (manifest.empty() ? pattern : manifest));
+  }
+  return files;
+}
+
+/// Hand out the ranges of a set of input files to a fixed number of workers
+/// so that they all finish at about the same time.
+/// The files are cut into ranges of about `range_bytes` and every worker
+/// starts with a run of consecutive ranges of the same number of bytes.
+/// A worker that runs out of ranges steals the last one of the worker with
+/// the most left, so a slow range or a slow worker holds up no one else.
+class InputScheduler {
+ public:
+  static constexpr uint64_t DEFAULT_RANGE_BYTES = 64ull << 20;
+  /// Ranges per worker to start with at least, so that there is something
+  /// to steal even if the input is small.
+  static constexpr uint64_t MIN_RANGES_PER_WORKER = 4;
+
+  InputScheduler(std::vector<InputFile> files, uint32_t num_workers,
+                 uint64_t range_bytes = DEFAULT_RANGE_BYTES)
+      : files_(std::move(files)), queues_(num_workers), num_stolen_(0) {
+    uint64_t total = 0;
+    for (const auto &file : files_) {
+      total += file.size;
+    }
+    range_bytes = std::clamp<uint64_t>(
+        total / (num_workers * MIN_RANGES_PER_WORKER), 1, range_bytes);
+
+    std::vector<uint64_t> weights;
+    for (const auto &file : files_) {
+      const uint32_t num_parts =
+          file.splittable ? std::max<uint64_t>(file.size / range_bytes, 1)
+                          : 1;
+      for (uint32_t p = 0; p < num_parts; p++) {
+        ranges_.push_back({&file, p, num_parts});
+        weights.push_back(file.size / num_parts);
+      }
+    }
+
+    // Worker w starts with the ranges whose midpoint falls in its share of
+    // the bytes.
+    uint64_t at = 0;
+    size_t r = 0;
+    for (uint32_t w = 0; w < num_workers; w++) {
+      const uint64_t begin = r;
+      const uint64_t share_end = total * (w + 1) / num_workers;
+      while (r < ranges_.size() &&
+             (w + 1 == num_workers || at + weights[r] / 2 < share_end)) {
+        at += weights[r++];
+      }
+      queues_[w].span.store(pack(begin, r), std::memory_order_relaxed);
+    }
+  }
+
+  InputScheduler(const InputScheduler &) = delete;
+  InputScheduler &operator=(const InputScheduler &) = delete;
+
+  const std::vector<InputFile> &files() const { return files_; }
+
+  size_t num_ranges() const { return ranges_.size(); }
+
+  /// Ranges taken from another worker so far.
+  uint64_t num_stolen() const {
+    return num_stolen_.load(std::memory_order_relaxed);
+  }
+
+  /// Take the next range of `worker`, or steal one; false once there is
+  /// nothing left anywhere.
+  bool next(uint32_t worker, InputRange *range) {
+    if (this->take_front(worker, range)) {
+      return true;
+    }
+    for (;;) {
+      // The worker with the most ranges left.
+      uint32_t victim = 0;
+      uint64_t most = 0;
+      for (uint32_t w = 0; w < queues_.size(); w++) {
+        const uint64_t span = queues_[w].span.load(std::memory_order_relaxed);
+        if (end_of(span) - begin_of(span) > most) {
+          most = end_of(span) - begin_of(span);
+          victim = w;
+        }
+      }
+      if (most == 0) {
+        return false;
+      }
+      if (this->take_back(victim, range)) {
+        num_stolen_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+
+ private:
+  /// The ranges [begin, end) left to a worker, packed into a word so that
+  /// the owner and the thieves agree with a single CAS.
+  struct alignas(64) Queue {
+    std::atomic_uint64_t span;
+  };
+
+  static uint64_t pack(uint64_t begin, uint64_t end) {
+    return begin << 32 | end;
+  }
+  static uint64_t begin_of(uint64_t span) { return span >> 32; }
+  static uint64_t end_of(uint64_t span) { return span & 0xffff'ffff; }
+
+  bool take_front(uint32_t worker, InputRange *range) {
+    auto &span = queues_[worker].span;
+    for (uint64_t old = span.load(std::memory_order_relaxed);
+         begin_of(old) < end_of(old);) {
+      if (span.compare_exchange_weak(old, pack(begin_of(old) + 1, end_of(old)),
+                                     std::memory_order_relaxed)) {
+        *range = ranges_[begin_of(old)];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool take_back(uint32_t worker, InputRange *range) {
+    auto &span = queues_[worker].span;
+    for (uint64_t old = span.load(std::memory_order_relaxed);
+         begin_of(old) < end_of(old);) {
+      if (span.compare_exchange_weak(old, pack(begin_of(old), end_of(old) - 1),
+                                     std::memory_order_relaxed)) {
+        *range = ranges_[end_of(old) - 1];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<InputFile> files_;
+  std::vector<InputRange> ranges_;
+  std::vector<Queue> queues_;
+  std::atomic_uint64_t num_stolen_;
+};
+
+/// Read the sequences of the ranges that `worker` gets from an
+/// `InputScheduler`, one range after the other.
+/// The mates of paired-end reads are read in lockstep, a record of each in
+/// turn, from the same partition of both files.
+class ScheduledSequenceReader : public InputReader<std::string_view> {
+ public:
+  /// Open the reader of partition `part_id` of `num_parts` of a file.
+  using Opener = std::function<std::unique_ptr<InputReader<std::string_view>>(
+      const std::string &path, uint64_t part_id, uint64_t num_parts)>;
+
+  ScheduledSequenceReader(InputScheduler *scheduler, uint32_t worker,
+                          Opener open)
+      : scheduler_(scheduler), worker_(worker), open_(std::move(open)) {}
+
+  bool next(std::string_view *data) override {
+    for (;;) {
+      // Alternate between the mates while both have records left.
+      for (int i = 0; i < 2; i++) {
+        auto &reader = readers_[turn_];
+        turn_ ^= 1;
+        if (reader && reader->next(data)) {
+          return true;
+        }
+        reader.reset();
+      }
+      if (!this->open_next()) {
+        return false;
+      }
+    }
+  }
+
+ private:
+  bool open_next() {
+    InputRange range;
+    if (!scheduler_->next(worker_, &range)) {
+      return false;
+    }
+    const auto &file = *range.file;
+    readers_[0] = open_(file.path, range.part_id, range.num_parts);
+    if (!file.mate.empty()) {
+      readers_[1] = open_(file.mate, range.part_id, range.num_parts);
+    }
+    turn_ = 0;
+    return true;
+  }
+
+  InputScheduler *scheduler_;
+  uint32_t worker_;
+  Opener open_;
+  std::unique_ptr<InputReader<std::string_view>> readers_[2];
+  int turn_ = 0;
+};
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_SCHEDULER_HPP
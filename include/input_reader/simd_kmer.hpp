@@ -0,0 +1,257 @@
+#ifndef INPUT_READER_SIMD_KMER_HPP
+#define INPUT_READER_SIMD_KMER_HPP
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "input_reader.hpp"
+#include "utils/circular_buffer.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+/// A KMer reader which can also hand out the KMers a batch at a time.
+class KMerBatchReader : public InputReaderU64 {
+ public:
+  /// Point `kmers` to the next non-empty batch of KMers.
+  /// The batch stays valid until the next call to `next_batch` or `next`.
+  virtual bool next_batch(std::span<const uint64_t> *kmers) = 0;
+};
+
+namespace simd {
+/// Number of bases encoded at a time.
+constexpr size_t BLOCK_SIZE = 32;
+
+/// Encode up to `BLOCK_SIZE` bases of `bases` into 2-bit mers with the same
+/// encoding as `DNAKMer`, the first base in the two most significant bits of
+/// `*codes`.
+/// Bit i of `*invalid` is set if base i is not one of ACGT (case
+/// insensitive) or if i >= len.
+inline void encode_block(const char *bases, size_t len, uint64_t *codes,
+                         uint32_t *invalid) {
+#if defined(__AVX2__)
+  alignas(32) char tail[BLOCK_SIZE];
+  if (len < BLOCK_SIZE) {
+    // Never read past the end of the sequence; the zero padding is invalid.
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, bases, len);
+    bases = tail;
+  }
+  const __m256i chars =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bases));
+
+  // The low nibbles of A, C, G and T are unique and the same for both cases:
+  // 1, 3, 7 and 4.
+  const __m256i lut = _mm256_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0,
+                                       0, 0, 0, 0, 0, 0, 1, 3, 0, 0, 2, 0, 0,
+                                       0, 0, 0, 0, 0, 0);
+  const __m256i mers =
+      _mm256_shuffle_epi8(lut, _mm256_and_si256(chars, _mm256_set1_epi8(0x0f)));
+
+  const __m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+  const __m256i valid = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('a')),
+                      _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('c'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('g')),
+                      _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('t'))));
+  *invalid = ~static_cast<uint32_t>(_mm256_movemask_epi8(valid));
+
+  // Pack 4 mers into one byte per 32-bit word, the first mer on top...
+  const __m256i pairs = _mm256_maddubs_epi16(mers, _mm256_set1_epi16(0x0104));
+  const __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00010010));
+  // ...and gather the bytes of the 8 words.
+  const __m256i gather = _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 4, 8, 12,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m256i packed = _mm256_shuffle_epi8(quads, gather);
+  const uint64_t little =
+      static_cast<uint32_t>(_mm256_extract_epi32(packed, 0)) |
+      static_cast<uint64_t>(_mm256_extract_epi32(packed, 4)) << 32;
+  // The first byte holds the first 4 mers.
+  *codes = __builtin_bswap64(little);
+#else
+  uint64_t packed = 0;
+  uint32_t bad = len < BLOCK_SIZE ? ~0u << len : 0;
+  for (size_t i = 0; i < std::min(len, BLOCK_SIZE); i++) {
+    uint64_t code;
+    switch (bases[i]) {
+      case 'A': case 'a': code = 0; break;
+      case 'C': case 'c': code = 1; break;
+      case 'G': case 'g': code = 2; break;
+      case 'T': case 't': code = 3; break;
+      default: code = 0; bad |= 1u << i; break;
+    }
+    packed |= code << (62 - 2 * i);
+  }
+  *codes = packed;
+  *invalid = bad;
+#endif
+}
+
+/// Overwrite with 'N' the bases of `bases` whose quality in `quals`, Phred+33
+/// encoded, is below `min_quality`, so that the extractors treat them as
+/// invalid along with the non-ACGT bases.
+inline void mask_low_quality(char *bases, const char *quals, size_t len,
+                             uint8_t min_quality) {
+  const char threshold = static_cast<char>('!' + min_quality);
+  size_t i = 0;
+#if defined(__AVX2__)
+  // Quality characters are printable, so a signed compare is enough.
+  const __m256i thresholds = _mm256_set1_epi8(threshold);
+  const __m256i ns = _mm256_set1_epi8('N');
+  for (; i + BLOCK_SIZE <= len; i += BLOCK_SIZE) {
+    const __m256i q =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(quals + i));
+    const __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bases + i));
+    const __m256i low = _mm256_cmpgt_epi8(thresholds, q);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(bases + i),
+                        _mm256_blendv_epi8(b, ns, low));
+  }
+#endif
+  for (; i < len; i++) {
+    if (quals[i] < threshold) {
+      bases[i] = 'N';
+    }
+  }
+}
+
+/// Extract all KMers of a sequence a block of bases at a time.
+/// The output is the same as `KMerReader`: all KMers without invalid bases,
+/// in order.
+/// With `Canonical`, the reverse complement of each block is computed along
+/// with it and the smaller of the two strands is produced.
+template <size_t K, bool Canonical = false>
+class KMerExtractor {
+ public:
+  static_assert(K <= BLOCK_SIZE, "A KMer must fit in two blocks");
+  static constexpr uint64_t KMER_MASK = DNAKMer<K>::KMER_MASK;
+
+  /// Write the KMers of `seq` to `out`, which must have room for
+  /// `seq.size()` KMers. Returns the number of KMers written.
+  static size_t extract(std::string_view seq, uint64_t *out) {
+    uint64_t *begin = out;
+    // The previous block; anything before the sequence is invalid.
+    uint64_t prev_codes = 0;
+    uint64_t prev_rc_codes = 0;
+    uint32_t prev_invalid = ~0u;
+    for (size_t pos = 0; pos < seq.size(); pos += BLOCK_SIZE) {
+      uint64_t codes;
+      uint32_t invalid;
+      encode_block(seq.data() + pos, seq.size() - pos, &codes, &invalid);
+
+      // A KMer ends at i if none of the K bases up to i is invalid.
+      const uint32_t ends =
+          ~static_cast<uint32_t>(smear(uint64_t(invalid) << 32 | prev_invalid) >>
+                                 32);
+      const unsigned __int128 window =
+          static_cast<unsigned __int128>(prev_codes) << 64 | codes;
+      if constexpr (Canonical) {
+        // The reverse complement of `window`; the KMer ending at i starts
+        // at mer 31 - i of it.
+        const uint64_t rc_codes = DNAKMer<K>::reverse_mers(~codes);
+        const unsigned __int128 rc_window =
+            static_cast<unsigned __int128>(rc_codes) << 64 | prev_rc_codes;
+        for (uint32_t mask = ends; mask != 0; mask &= mask - 1) {
+          const unsigned i = __builtin_ctz(mask);
+          const uint64_t fwd =
+              static_cast<uint64_t>(window >> (62 - 2 * i)) & KMER_MASK;
+          const uint64_t rc =
+              static_cast<uint64_t>(rc_window >> (66 + 2 * i - 2 * K)) &
+              KMER_MASK;
+          *out++ = std::min(fwd, rc);
+        }
+        prev_rc_codes = rc_codes;
+      } else {
+        for (uint32_t mask = ends; mask != 0; mask &= mask - 1) {
+          const unsigned i = __builtin_ctz(mask);
+          *out++ = static_cast<uint64_t>(window >> (62 - 2 * i)) & KMER_MASK;
+        }
+      }
+
+      prev_codes = codes;
+      prev_invalid = invalid;
+    }
+    return out - begin;
+  }
+
+ private:
+  /// Propagate every invalid bit to the next K - 1 positions.
+  static uint64_t smear(uint64_t invalid) {
+    size_t width = 1;
+    while (width < K) {
+      const size_t shift = std::min(width, K - width);
+      invalid |= invalid << shift;
+      width += shift;
+    }
+    return invalid;
+  }
+};
+}  // namespace simd
+
+/// Generate KMers from sequences with `simd::KMerExtractor`.
+/// The KMers of whole sequences are extracted into a batch buffer of at least
+/// `batch_size` KMers, which can be consumed directly with `next_batch`.
+template <size_t K, class Input = std::string_view, bool Canonical = false>
+class SimdKMerReader : public KMerBatchReader {
+ public:
+  static constexpr size_t DEFAULT_BATCH_SIZE = 4096;
+
+  SimdKMerReader(std::unique_ptr<InputReader<Input>> lines,
+                 size_t batch_size = DEFAULT_BATCH_SIZE)
+      : lines_(std::move(lines)), batch_size_(batch_size) {
+    batch_.resize(batch_size_);
+  }
+
+  bool next(uint64_t *data) override {
+    if (pos_ == size_ && !this->fill_batch()) {
+      return false;
+    }
+    *data = batch_[pos_++];
+    return true;
+  }
+
+  bool next_batch(std::span<const uint64_t> *kmers) override {
+    if (pos_ == size_ && !this->fill_batch()) {
+      return false;
+    }
+    *kmers = std::span<const uint64_t>(batch_.data() + pos_, size_ - pos_);
+    pos_ = size_;
+    return true;
+  }
+
+ private:
+  /// Extract whole sequences until the batch is full.
+  bool fill_batch() {
+    pos_ = 0;
+    size_ = 0;
+    while (size_ < batch_size_ && lines_->next(&line_)) {
+      const std::string_view seq(line_);
+      if (size_ + seq.size() > batch_.size()) {
+        // Sequences longer than the batch.
+        batch_.resize(size_ + seq.size());
+      }
+      size_ += simd::KMerExtractor<K, Canonical>::extract(seq, batch_.data() + size_);
+    }
+    return size_ > 0;
+  }
+
+  std::unique_ptr<InputReader<Input>> lines_;
+  Input line_;
+  size_t batch_size_;
+  std::vector<uint64_t> batch_;
+  size_t pos_ = 0;
+  size_t size_ = 0;
+};
+}  // namespace input_reader
+}  // namespace kmercounter
+
+#endif  // INPUT_READER_SIMD_KMER_HPP
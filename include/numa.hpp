@@ -10,8 +10,10 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 #include "plog/Log.h"
+#include "utils/topology.hpp"
 
 using namespace std;
 
@@ -103,19 +105,14 @@ class Numa {
       bitmask_sz = cm->size;
       _node.cpu_bitmask = *(cm->maskp);
       _node.id = n;
+      _node.num_cpus = 0;
 
-      // extract all the cpus from the bitmask
+      // extract all the cpus from the bitmask, however many words it has
       for (int i = 0; i < bitmask_sz; i++) {
-        int c = (_node.cpu_bitmask & 1) ? i : -1;
-        if (c != -1) {
-          _node.cpu_list.push_back(c);
+        if (numa_bitmask_isbitset(cm, i)) {
+          _node.cpu_list.push_back(i);
           _node.num_cpus += 1;
         }
-        if (!((i + 1) % 64)) {
-          _node.cpu_bitmask = *(cm->maskp + 1);
-        } else {
-          _node.cpu_bitmask >>= 1;
-        }
       }
       append_node(_node);
     }
@@ -135,11 +132,19 @@ course, this is bounded by the number of cpus available on a numa node. prod +
 cons <= node_x_cpus
 - PROD_CONS_MIXED_MODE: the affinity does not matter. Just run it as long as you
 can tie this thread to a cpu.
+- PROD_CONS_SMT_SIBLINGS: producer i and consumer i run on the two hardware
+threads of one physical core, and share its L1 and L2. Those left unpaired fill
+the remaining physical cores first.
+- PROD_CONS_CONSUMER_PER_L3: one consumer per L3 domain, in turn, so that every
+consumer has a last-level cache to itself; producer 0 keeps CPU 0 and the
+other producers fill the remaining physical cores first.
  */
 enum numa_policy_queues {
   PROD_CONS_SEQUENTIAL = 1,
   PROD_CONS_SEPARATE_NODES = 2,
   PROD_CONS_EQUAL_PARTITION = 3,
+  PROD_CONS_SMT_SIBLINGS = 5,
+  PROD_CONS_CONSUMER_PER_L3 = 6,
 };
 
 class NumaPolicyQueues : public Numa {
@@ -154,6 +159,20 @@ class NumaPolicyQueues : public Numa {
     std::cout << *this << std::endl;
   }
 
+  // Place on the given nodes, reading the cache topology under
+  // `topology_root` instead of the running machine.
+  NumaPolicyQueues(int num_prod, int num_cons, numa_policy_queues npq,
+                   const std::vector<numa_node_t> &nodes,
+                   const std::string &topology_root)
+      : topology_root(topology_root) {
+    this->config_num_prod = num_prod;
+    this->config_num_cons = num_cons;
+    this->nodes = nodes;
+    this->npq = npq;
+    this->init_unassigned_cpus_list();
+    this->generate_cpu_lists();
+  }
+
   friend std::ostream &operator<<(std::ostream &os, const NumaPolicyQueues &n) {
     std::ostringstream os_str;
     os_str << "assigned_cpu_list_producers: ";
@@ -209,6 +228,7 @@ class NumaPolicyQueues : public Numa {
   uint32_t config_num_prod;
   uint32_t config_num_cons;
   numa_policy_queues npq;
+  std::string topology_root = "/sys/devices/system/cpu";
   std::vector<numa_node_t> nodes;
   std::vector<uint32_t> assigned_cpu_list_producers;
   std::vector<uint32_t> assigned_cpu_list_consumers;
@@ -216,7 +236,7 @@ class NumaPolicyQueues : public Numa {
 
   void generate_cpu_lists() {
     [[maybe_unused]] uint32_t total_threads = this->config_num_cons + this->config_num_prod;
-    assert(total_threads <= static_cast<uint32_t>(Numa::get_num_total_cpus()));
+    assert(total_threads <= this->unassigned_cpu_list.size());
 
     if (this->npq == PROD_CONS_EQUAL_PARTITION) {
       uint32_t node_idx_ctr = 0, cpu_idx_ctr = 0;
@@ -315,6 +335,61 @@ class NumaPolicyQueues : public Numa {
       }
       return;
     }
+
+    if (this->npq == PROD_CONS_SMT_SIBLINGS) {
+      CpuTopology topo(this->topology_root);
+      for (auto [prod, cons] : topo.smt_pairs(
+               std::min(this->config_num_prod, this->config_num_cons))) {
+        if (!this->unassigned_cpu_list.count(prod) ||
+            !this->unassigned_cpu_list.count(cons))
+          continue;
+        this->assign(this->assigned_cpu_list_producers, prod);
+        this->assign(this->assigned_cpu_list_consumers, cons);
+      }
+      this->fill_physical_cores(topo);
+      return;
+    }
+
+    if (this->npq == PROD_CONS_CONSUMER_PER_L3) {
+      CpuTopology topo(this->topology_root);
+      // The main thread runs the last producer on CPU 0, so that CPU must
+      // not go to a consumer.
+      if (this->config_num_prod > 0 && this->unassigned_cpu_list.count(0))
+        this->assign(this->assigned_cpu_list_producers, 0);
+      for (uint32_t cpu : topo.spread_l3(UINT32_MAX)) {
+        if (this->assigned_cpu_list_consumers.size() == this->config_num_cons)
+          break;
+        if (this->unassigned_cpu_list.count(cpu))
+          this->assign(this->assigned_cpu_list_consumers, cpu);
+      }
+      this->fill_physical_cores(topo);
+      return;
+    }
+  }
+
+  void assign(std::vector<uint32_t> &list, uint32_t cpu) {
+    list.push_back(cpu);
+    this->unassigned_cpu_list.erase(cpu);
+  }
+
+  // Producers, then consumers, still short of a cpu take one thread of every
+  // free physical core before any SMT sibling.
+  void fill_physical_cores(const CpuTopology &topo) {
+    for (uint32_t cpu : topo.fill_cores(UINT32_MAX)) {
+      if (!this->unassigned_cpu_list.count(cpu)) continue;
+      if (this->assigned_cpu_list_producers.size() < this->config_num_prod)
+        this->assign(this->assigned_cpu_list_producers, cpu);
+      else if (this->assigned_cpu_list_consumers.size() < this->config_num_cons)
+        this->assign(this->assigned_cpu_list_consumers, cpu);
+      else
+        break;
+    }
+    if (this->assigned_cpu_list_producers.size() < this->config_num_prod ||
+        this->assigned_cpu_list_consumers.size() < this->config_num_cons) {
+      PLOGE.printf("Topology has too few cpus for %u producers, %u consumers",
+                   this->config_num_prod, this->config_num_cons);
+      exit(-1);
+    }
   }
 
   void init_unassigned_cpus_list() {
@@ -323,10 +398,14 @@ class NumaPolicyQueues : public Numa {
   }
 };
 
-/* Numa policy when using just a "number of threads" assignment */
+/* Numa policy when using just a "number of threads" assignment
+- THREADS_FILL_PHYSICAL_CORES: one hardware thread of every physical core, node
+by node and L3 domain by L3 domain, before any SMT sibling.
+ */
 enum numa_policy_threads {
   THREADS_SPLIT_SEPARATE_NODES = 1,
-  THREADS_ASSIGN_SEQUENTIAL = 2
+  THREADS_ASSIGN_SEQUENTIAL = 2,
+  THREADS_FILL_PHYSICAL_CORES = 4,
 };
 
 class NumaPolicyThreads : public Numa {
@@ -418,6 +497,22 @@ class NumaPolicyThreads : public Numa {
       }
       return;
     }
+
+    if (this->np == THREADS_FILL_PHYSICAL_CORES) {
+      CpuTopology topo;
+      for (uint32_t cpu : topo.fill_cores(UINT32_MAX)) {
+        if (this->assigned_cpu_list.size() == this->config_num_threads) break;
+        if (!this->unassigned_cpu_list.count(cpu)) continue;
+        this->assigned_cpu_list.push_back(cpu);
+        this->unassigned_cpu_list.erase(cpu);
+      }
+      if (this->assigned_cpu_list.size() < this->config_num_threads) {
+        PLOGE.printf("Topology has too few cpus for %u threads",
+                     this->config_num_threads);
+        exit(-1);
+      }
+      return;
+    }
   }
 
   void init_unassigned_cpus_list() {
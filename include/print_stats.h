@@ -51,6 +51,7 @@ inline void print_stats(Shard *all_sh, Configuration &config) {
     printf(
         "Thread %2d: "
         "%" PRIu64 " cycles (%f ms) for %" PRIu64 " insertions (%" PRIu64 " cycles/insert) | (%" PRIu64 " cycles/enqueue) "
+        "| %" PRIu64 " cycles at barriers "
         "{ fill: %" PRIu64 " of %" PRIu64 " (%f %%) }"
 #ifdef CALC_STATS
         "["
@@ -78,6 +79,7 @@ inline void print_stats(Shard *all_sh, Configuration &config) {
             ? 0
             : all_sh[k].stats->enqueues.duration /
                   all_sh[k].stats->enqueues.op_count,
+        all_sh[k].stats->barrier_wait,
         all_sh[k].stats->ht_fill, all_sh[k].stats->ht_capacity,
         all_sh[k].stats->ht_capacity == 0
             ? 0
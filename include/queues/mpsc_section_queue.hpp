@@ -0,0 +1,297 @@
+#pragma once
+
+#include <numaif.h>
+
+#include <atomic>
+#include <bit>
+#include <numa.hpp>
+#include <vector>
+
+#include "helper.hpp"
+#include "queue.hpp"
+#include "section_queues.hpp"
+
+namespace kmercounter {
+
+/// A section queue shared by all the producers of a consumer.
+/// `SectionQueue` has a ring per producer/consumer pair, so the queue memory
+/// grows with n_prod * n_cons. Here every consumer owns a single ring of
+/// sections, which the producers claim a whole section at a time with one
+/// fetch_add on the ring tail and fill without further synchronization. The
+/// consumer drains the sections in the order they were claimed, each once it
+/// is published. The queue memory is n_cons rings.
+///
+/// A section is published when it is full, on `push_done`, or when its
+/// producer has to wait for a free section of any ring, so that a section
+/// left open by a waiting producer never blocks the consumer of its ring.
+///
+/// The messages of a producer to a consumer stay in order, but those of
+/// different producers are interleaved, a section at a time. The consumer
+/// handles of all producers share the ring of their consumer: `dequeue`
+/// returns the next message of any producer, and each producer still ends
+/// its stream with a `BQ_MAGIC_KV`.
+class MpscSectionQueue {
+  /// The state of a section of a ring. A section at `index` is free for
+  /// the producer of ticket `t` when `seq == t`, and published when
+  /// `seq == t + 1`, holding `count` messages.
+  struct section_header {
+    CACHE_ALIGNED std::atomic_uint64_t seq;
+    uint32_t count;
+  };
+
+  struct ring {
+    CACHE_ALIGNED std::atomic_uint64_t tail;
+    // Consumer side
+    CACHE_ALIGNED uint64_t head;
+    data_t *deqPtr;
+    data_t *deqEnd;
+#ifdef CALC_STATS
+    CACHE_ALIGNED size_t numEnqueueSpins;
+    CACHE_ALIGNED size_t numDequeueSpins;
+#endif
+    data_t *data;
+    section_header *sections;
+  };
+
+ public:
+  /// The section of a ring that a producer is filling, if any.
+  struct prod_queue {
+    data_t *enqPtr;
+    data_t *section_end;
+    uint64_t ticket;
+    ring *r;
+  };
+
+  struct cons_queue {
+    ring *r;
+  };
+
+  typedef struct prod_queue prod_queue_t;
+  typedef struct cons_queue cons_queue_t;
+
+  prod_queue_t **all_pqueues;
+  cons_queue_t **all_cqueues;
+  static const uint64_t BQ_MAGIC_64BIT = 0xD221A6BE96E04673UL;
+  static const data_t BQ_MAGIC_KV;
+  static constexpr size_t MSGS_PER_SECTION = SECTION_SIZE / sizeof(data_t);
+
+  /// Bytes of a ring.
+  size_t queue_size;
+
+  /// Without `npq`, the rings stay where they are first touched.
+  explicit MpscSectionQueue(uint32_t nprod, uint32_t ncons,
+                            size_t num_sections, NumaPolicyQueues *npq)
+      : nprod(nprod), ncons(ncons), num_sections(num_sections) {
+    PLOGI.printf("%s, numsections %zu per consumer", __func__, num_sections);
+    assert(std::has_single_bit(num_sections));
+    this->section_mask = num_sections - 1;
+    this->queue_size = SECTION_SIZE * num_sections;
+
+    this->rings = (ring *)utils::zero_aligned_alloc(FIPC_CACHE_LINE_SIZE,
+                                                    ncons * sizeof(ring));
+    const auto cons_cpus =
+        npq ? npq->get_assigned_cpu_list_consumers() : std::vector<uint32_t>();
+    for (auto c = 0u; c < ncons; c++) {
+      ring *r = &this->rings[c];
+      r->data = (data_t *)utils::zero_aligned_alloc(PAGESIZE, queue_size);
+      r->sections = (section_header *)utils::zero_aligned_alloc(
+          FIPC_CACHE_LINE_SIZE, num_sections * sizeof(section_header));
+      for (auto s = 0u; s < num_sections; s++) {
+        r->sections[s].seq.store(s, std::memory_order_relaxed);
+      }
+      // The consumer reads every message once, the producers write them
+      // from all over; keep the ring with the consumer.
+      if (c < cons_cpus.size()) {
+        mbind_local(r->data, queue_size, numa_node_of_cpu(cons_cpus[c]));
+      }
+    }
+
+    this->all_pqueues = (prod_queue_t **)calloc(nprod, sizeof(prod_queue_t *));
+    for (auto p = 0u; p < nprod; p++) {
+      all_pqueues[p] = (prod_queue_t *)utils::zero_aligned_alloc(
+          FIPC_CACHE_LINE_SIZE, cache_lines(ncons * sizeof(prod_queue_t)));
+      for (auto c = 0u; c < ncons; c++) {
+        all_pqueues[p][c].r = &this->rings[c];
+      }
+    }
+
+    this->all_cqueues = (cons_queue_t **)calloc(ncons, sizeof(cons_queue_t *));
+    for (auto c = 0u; c < ncons; c++) {
+      all_cqueues[c] = (cons_queue_t *)utils::zero_aligned_alloc(
+          FIPC_CACHE_LINE_SIZE, cache_lines(nprod * sizeof(cons_queue_t)));
+      for (auto p = 0u; p < nprod; p++) {
+        all_cqueues[c][p].r = &this->rings[c];
+      }
+    }
+  }
+
+  inline int enqueue(prod_queue_t *pq, uint32_t p, uint32_t c, data_t value) {
+    if (pq->enqPtr == nullptr) {
+      this->claim(pq, p);
+    }
+    *pq->enqPtr = value;
+    pq->enqPtr += 1;
+    if (pq->enqPtr == pq->section_end) {
+      this->publish(pq);
+    }
+    return SUCCESS;
+  }
+
+  inline int dequeue(cons_queue_t *cq, uint32_t p, uint32_t c, data_t *value) {
+    ring *r = cq->r;
+    if (r->deqPtr == r->deqEnd) {
+      section_header *s = &r->sections[r->head & section_mask];
+      if (s->seq.load(std::memory_order_acquire) != r->head + 1) {
+#ifdef CALC_STATS
+        r->numDequeueSpins++;
+#endif
+        return RETRY;
+      }
+      r->deqPtr = this->section_data(r, r->head);
+      r->deqEnd = r->deqPtr + s->count;
+    }
+    *value = *r->deqPtr;
+    r->deqPtr += 1;
+
+    if (r->deqPtr == r->deqEnd) {
+      // Hand the section back to the producer that wraps around to it.
+      r->sections[r->head & section_mask].seq.store(
+          r->head + num_sections, std::memory_order_release);
+      __atomic_store_n(&r->head, r->head + 1, __ATOMIC_RELAXED);
+    }
+    return SUCCESS;
+  }
+
+  void dump_stats(uint32_t p, uint32_t c) {
+#ifdef CALC_STATS
+    // The ring is shared by all producers; report it once.
+    if (p == 0) {
+      ring *r = &rings[c];
+      printf("[%u] enq spins %" PRIu64 " | numdequeue spins %" PRIu64
+             " | sections %" PRIu64 "\n",
+             c, r->numEnqueueSpins, r->numDequeueSpins, r->head);
+    }
+#endif
+  }
+
+  inline void prefetch(uint32_t p, uint32_t c, bool is_prod) {
+    if (is_prod) {
+      auto nc = ((c + 1) >= ncons) ? 0 : (c + 1);
+      auto pq = &all_pqueues[p][nc];
+      if (pq->enqPtr && ((uint64_t)pq->enqPtr & CACHELINE_MASK) == 0) {
+        __builtin_prefetch(pq->enqPtr + 8, 1, 3);
+      }
+    } else {
+      ring *r = &rings[c];
+      if (r->deqPtr) {
+        __builtin_prefetch(r->deqPtr + 0, 1, 3);
+        __builtin_prefetch(r->deqPtr + 8, 1, 3);
+      }
+    }
+  }
+
+  /// Messages that consumer `c` has yet to take, counting whole sections.
+  inline size_t occupancy(uint32_t p, uint32_t c) const {
+    const ring *r = &rings[c];
+    // The head first, as it never passes the tail.
+    const uint64_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    return (r->tail.load(std::memory_order_relaxed) - head) * MSGS_PER_SECTION;
+  }
+
+  inline void push_done(uint32_t p, uint32_t c) {
+    auto pq = &this->all_pqueues[p][c];
+    enqueue(pq, p, c, BQ_MAGIC_KV);
+    this->flush(p, c);
+  }
+
+  /// Publish what producer `p` has written to consumer `c` so far, for a
+  /// consumer that waits on it, e.g., for a response.
+  inline void flush(uint32_t p, uint32_t c) {
+    auto pq = &this->all_pqueues[p][c];
+    if (pq->enqPtr != nullptr) {
+      this->publish(pq);
+    }
+  }
+
+  /// Sections are published part full, so there is no need for a filler.
+  inline void flush(uint32_t p, uint32_t c, data_t filler) {
+    this->flush(p, c);
+  }
+
+  void pop_done(uint32_t p, uint32_t c) {}
+
+  ~MpscSectionQueue() {
+    for (auto p = 0u; p < nprod; p++) {
+      free(all_pqueues[p]);
+    }
+    for (auto c = 0u; c < ncons; c++) {
+      free(all_cqueues[c]);
+      free(rings[c].data);
+      free(rings[c].sections);
+    }
+    free(all_pqueues);
+    free(all_cqueues);
+    free(rings);
+  }
+
+ private:
+  static size_t cache_lines(size_t bytes) {
+    return (bytes + FIPC_CACHE_LINE_SIZE - 1) & ~(FIPC_CACHE_LINE_SIZE - 1);
+  }
+
+  data_t *section_data(ring *r, uint64_t ticket) const {
+    return r->data + (ticket & section_mask) * MSGS_PER_SECTION;
+  }
+
+  /// Take the next section of the ring of `pq`, waiting for the consumer to
+  /// free it if need be.
+  void claim(prod_queue_t *pq, uint32_t p) {
+    ring *r = pq->r;
+    const uint64_t ticket = r->tail.fetch_add(1, std::memory_order_relaxed);
+    section_header *s = &r->sections[ticket & section_mask];
+    if (s->seq.load(std::memory_order_acquire) != ticket) {
+      // The consumer of this ring may be waiting for a section that this
+      // producer holds in it, or the consumer of another ring may wait for
+      // one of ours while its producers wait for us; let them all go.
+      for (auto c = 0u; c < ncons; c++) {
+        if (all_pqueues[p][c].enqPtr != nullptr) {
+          this->publish(&all_pqueues[p][c]);
+        }
+      }
+      while (s->seq.load(std::memory_order_acquire) != ticket) {
+#ifdef CALC_STATS
+        r->numEnqueueSpins++;
+#endif
+        asm volatile("pause");
+      }
+    }
+    pq->ticket = ticket;
+    pq->enqPtr = this->section_data(r, ticket);
+    pq->section_end = pq->enqPtr + MSGS_PER_SECTION;
+  }
+
+  void publish(prod_queue_t *pq) {
+    section_header *s = &pq->r->sections[pq->ticket & section_mask];
+    s->count = pq->enqPtr - (pq->section_end - MSGS_PER_SECTION);
+    s->seq.store(pq->ticket + 1, std::memory_order_release);
+    pq->enqPtr = nullptr;
+    pq->section_end = nullptr;
+  }
+
+  static void mbind_local(void *buf, size_t sz, int node) {
+    unsigned long nodemask[4096] = {0};
+    nodemask[0] = 1ul << node;
+    long ret = mbind(buf, std::max<size_t>(sz, PAGESIZE), MPOL_BIND, nodemask,
+                     4096, MPOL_MF_MOVE | MPOL_MF_STRICT);
+    if (ret < 0) {
+      PLOGE.printf("mbind failed! ret %d (errno %d)", ret, errno);
+    }
+  }
+
+  uint32_t nprod;
+  uint32_t ncons;
+  size_t num_sections;
+  size_t section_mask;
+  ring *rings;
+};
+}  // namespace kmercounter
@@ -414,6 +414,26 @@ class SectionQueue {
     }
   }
 
+  /// Messages from producer `p` that consumer `c` has yet to take, as far
+  /// as the producer can tell: the consumer publishes its position a
+  /// section at a time.
+  inline size_t occupancy(uint32_t p, uint32_t c) const {
+    auto pq = &all_pqueues[p][c];
+    const ptrdiff_t len = pq->queue_end - pq->data;
+    const ptrdiff_t used = pq->enqPtr - all_pc_queues[p][c].deqSharedPtr;
+    return used < 0 ? used + len : used;
+  }
+
+  /// Publish what producer `p` has written to consumer `c` so far, filling
+  /// the rest of the section with `filler`: the consumer only sees whole
+  /// sections.
+  inline void flush(uint32_t p, uint32_t c, data_t filler) {
+    auto pq = &this->all_pqueues[p][c];
+    while (((uint64_t)pq->enqPtr & SECTION_MASK) != 0) {
+      enqueue(pq, p, c, filler);
+    }
+  }
+
   inline void push_done(uint32_t p, uint32_t c) {
     // PLOGD.printf("PUSH DONE");
     auto pcq = &this->all_pc_queues[p][c];
@@ -1,25 +1,39 @@
 #ifndef __HASHJOIN_TEST_HPP__
 #define __HASHJOIN_TEST_HPP__
 
-#include <barrier>
 #include <functional>
+#include <memory>
 
 #include "hashtables/base_kht.hpp"
 #include "types.hpp"
+#include "utils/grace_join.hpp"
+#include "utils/spin_barrier.hpp"
 
 namespace kmercounter {
 
 class HashjoinTest {
  public:
+  /// Create the state shared by the threads of a run of `config`, before
+  /// they start.
+  void prepare(const Configuration &config);
   /// Generate and join two relations.
   void join_relations_generated(Shard *sh, const Configuration &config,
                                 BaseHashTable *ht,
                                 bool materialize,
-                                std::barrier<VoidFn> *barrier);
+                                SpinBarrier *barrier);
+  /// Generate and join two relations with a grace hash join: partitions that
+  /// do not fit `config.mem_budget` are spilled to `config.spill_dir` and
+  /// joined pairwise afterwards, in tables from `make_ht(capacity)`.
+  void join_relations_grace(
+      Shard *sh, const Configuration &config,
+      const std::function<BaseHashTable *(uint64_t)> &make_ht,
+      SpinBarrier *barrier);
   /// Load and join two tables from filesystem.
   void join_relations_from_files(Shard *sh, const Configuration &config,
                                  BaseHashTable *ht,
-                                 std::barrier<VoidFn> *barrier);
+                                 SpinBarrier *barrier);
+
+  std::unique_ptr<GraceJoin> grace;
 };
 
 }  // namespace kmercounter
@@ -1,24 +1,168 @@
 #ifndef TESTS_KMERTEST_HPP
 #define TESTS_KMERTEST_HPP
 
+#include <atomic>
 #include <barrier>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "hashtables/base_kht.hpp"
 #include "types.hpp"
 #include "input_reader/fastq.hpp"
+#include "input_reader/scheduler.hpp"
+#include "utils/kmer_spectrum.hpp"
+#include "utils/singleton_filter.hpp"
+#include "utils/spill_buckets.hpp"
+#include "utils/spin_barrier.hpp"
 
 namespace kmercounter {
 
+#if (KEY_LEN > 8)
+/// Wide keys hold KMers with K > 32.
+using KMerInputReader = input_reader::InputReader<key_type>;
+#else
+using KMerInputReader = input_reader::InputReaderU64;
+#endif
+
+/// The schedule of the ranges of a multi-file input, i.e., a glob pattern in
+/// `config.in_file` or a `config.in_manifest`, for `num_parts` readers; null
+/// for a single file. The driver creates one per run and hands it to every
+/// reader of the run.
+std::unique_ptr<input_reader::InputScheduler> make_input_scheduler(
+    const Configuration &config, uint64_t num_parts);
+
+/// Instantiate the k-mer reader of `config.input_backend` over the
+/// partition `part_id` of `config.in_file`.
+/// With a `scheduler`, it reads the ranges of the files that worker
+/// `part_id` of `num_parts` gets from it instead.
+/// The reader is a `KMerBatchReader` with `config.simd_kmer`.
+std::unique_ptr<KMerInputReader> make_kmer_reader(
+    const Configuration &config, input_reader::InputScheduler *scheduler,
+    uint64_t part_id, uint64_t num_parts);
+
+/// Instantiate the reader of the sequences of `config.in_file`, or of the
+/// ranges from `scheduler`, with `config.input_backend`. There is nothing to
+/// preload; the preloading backend streams the sequences from the file
+/// instead.
+std::unique_ptr<input_reader::InputReader<std::string_view>>
+make_sequence_reader(const Configuration &config,
+                     input_reader::InputScheduler *scheduler,
+                     uint64_t part_id, uint64_t num_parts);
+
+/// The k-mer spectrum of a run, merged from the share of each of its
+/// `num_threads` threads.
+struct SpectrumShared {
+  SpectrumShared(const Configuration &config, uint32_t num_threads)
+      : merged(config.top_k), num_threads(num_threads) {}
+
+  std::mutex mutex;
+  KmerSpectrum<key_type> merged;
+  uint64_t max_scan_cycles = 0;
+  uint32_t num_reported = 0;
+  const uint32_t num_threads;
+};
+
+/// Merge one thread's share of the k-mer spectrum of the run into `shared`,
+/// i.e., the count histogram and the `config.top_k` most frequent k-mers.
+/// The last thread to report prints it, with the histogram to
+/// `<config.ht_file>.hist` if given.
+void report_kmer_spectrum(const Configuration &config, SpectrumShared *shared,
+                          const KmerSpectrum<key_type> &spectrum,
+                          uint64_t scan_cycles);
+
+/// The singleton filter in front of the table of a count, and how many
+/// k-mers it held back and let through.
+struct FilterShared {
+  FilterShared(uint64_t bytes) : filter(bytes) {}
+
+  SingletonFilter filter;
+  std::atomic_uint64_t num_dropped = 0;
+  std::atomic_uint64_t num_promoted = 0;
+};
+
+/// The K of a multi-K count and how many k-mers of each the threads
+/// inserted.
+struct MultiKShared {
+  /// The K of `config.k_list`, in increasing order.
+  MultiKShared(const Configuration &config);
+
+  std::vector<uint32_t> ks;
+  std::vector<std::atomic_uint64_t> num_kmers;
+};
+
+/// State shared by the threads of a radix count.
+struct RadixShared {
+  RadixShared(uint32_t num_threads)
+      : phase(num_threads),
+        num_kmers(num_threads),
+        histograms(num_threads) {}
+
+  /// Synchronizes the passes without going through the application barrier,
+  /// which also drives the PAPI counters.
+  std::barrier<> phase;
+  std::vector<uint64_t> num_kmers;
+  std::vector<std::vector<uint64_t>> histograms;
+  /// Start of each partition in `partitioned`, plus the end.
+  std::vector<uint64_t> partition_begin;
+  std::vector<uint64_t> partitioned;
+};
+
+/// State shared by the threads of an out-of-core count.
+struct ExternalShared {
+  /// Plan the spill buckets of the input of `config`.
+  ExternalShared(const Configuration &config);
+
+  /// The internal phases do not go through `sync_complete`; a phase barrier
+  /// of its own keeps the PAPI counters on for the whole count.
+  std::barrier<> phase;
+  std::unique_ptr<SpillBuckets<>> buckets;
+  uint32_t bits;
+  uint64_t keys_per_buffer;
+  /// Buckets [range_begin[r], range_begin[r + 1]) are counted in round r.
+  std::vector<uint32_t> range_begin;
+  std::vector<uint64_t> range_slots;
+  uint64_t fill;
+  uint64_t max_count;
+  uint64_t max_capacity;
+};
+
 class KmerTest {
  public:
+  /// Set up the state shared by the threads of a run of `config`. The driver
+  /// calls it before it starts them, so that nothing is left over from the
+  /// previous run of a sweep.
+  void prepare(const Configuration &config);
+
   void count_kmer(Shard *sh, const Configuration &config,
                   BaseHashTable *ht,
-                  std::barrier<VoidFn> *barrier);
+                  SpinBarrier *barrier);
 
   void count_kmer_radix(Shard *sh, const Configuration &config,
                   BaseHashTable *ht,
-                  std::barrier<VoidFn> *barrier);
+                  SpinBarrier *barrier);
+
+  /// Count k-mers that do not fit in memory: spill them to buckets under
+  /// `config.spill_dir`, then count as many buckets at a time as fit
+  /// `config.mem_budget` in a table from `make_ht(capacity)`.
+  void count_kmer_external(
+      Shard *sh, const Configuration &config,
+      const std::function<BaseHashTable *(uint64_t)> &make_ht,
+      SpinBarrier *barrier);
+
+  /// Count the k-mers of every K of `config.k_list` in a single pass over
+  /// the input, into `ht` as `MultiKExtractor::tag(kmer, K)`.
+  void count_kmer_multi_k(Shard *sh, const Configuration &config,
+                          BaseHashTable *ht, SpinBarrier *barrier);
+
+  std::unique_ptr<RadixShared> radix;
+  std::unique_ptr<ExternalShared> external;
+  std::unique_ptr<SpectrumShared> spectrum;
+  std::unique_ptr<input_reader::InputScheduler> scheduler;
+  std::unique_ptr<FilterShared> filter;
+  std::unique_ptr<MultiKShared> multi_k;
 };
 
 }  // namespace kmercounter
@@ -1,14 +1,20 @@
 #pragma once
 
-#include <barrier>
+#include <memory>
 #include <thread>
 
 #include "hashtables/base_kht.hpp"
+#include "hashtables/partition_map.hpp"
+#include "input_reader/scheduler.hpp"
 #include "numa.hpp"
 #include "types.hpp"
+#include "utils/spin_barrier.hpp"
 
 namespace kmercounter {
 
+class MpscSectionQueue;
+struct SpectrumShared;
+
 template <typename T>
 class QueueTest {
   std::vector<std::thread> prod_threads;
@@ -20,6 +26,19 @@ class QueueTest {
   NumaPolicyQueues *npq;
 
   T *queues;
+  // Delegated finds: requests to the consumer owning a key, and the results
+  // back to the producer.
+  MpscSectionQueue *find_requests;
+  MpscSectionQueue *find_responses;
+  // With `num_partitions`: the owner of each partition, the partitions, and
+  // the barrier of producers and consumers between rounds of inserts.
+  PartitionMap *part_map = nullptr;
+  std::vector<BaseHashTable *> partitions;
+  SpinBarrier *phase_barrier = nullptr;
+  // With `kmer_spectrum`: the spectrum merged from the consumers.
+  SpectrumShared *spectrum = nullptr;
+  // The ranges of a multi-file input, shared by the producers.
+  std::unique_ptr<input_reader::InputScheduler> scheduler;
 
   std::vector<numa_node> nodes;
 
@@ -29,6 +48,8 @@ class QueueTest {
   const unsigned LYNX_QUEUE_SIZE = (1 << 12) * 8;
   const unsigned BQ_QUEUE_SIZE = 4096;
   static const uint64_t BQ_MAGIC_64BIT = 0xD221A6BE96E04673UL;
+  // Outstanding delegated finds per producer
+  const unsigned FIND_WINDOW = 128;
 
   void run_find_test(Configuration *cfg, Numa *n, bool is_join, NumaPolicyQueues *npq);
 
@@ -40,18 +61,53 @@ class QueueTest {
                        const uint32_t n_cons, const bool main_thread,
                        const double skew,
                        bool is_join,
-                       std::barrier<std::function<void()>>* barrier
+                       SpinBarrier *barrier
                        );
 
   void consumer_thread(const uint32_t tid, const uint32_t n_prod,
                        const uint32_t n_cons, const uint32_t num_nops,
-                       std::barrier<std::function<void()>>* barrier
+                       SpinBarrier *barrier
                        );
+  /// Insert into the partitions the consumer owns, a batch per partition,
+  /// and hand them over at the end of each round as the map says.
+  void partitioned_consumer_thread(const uint32_t tid, const uint32_t n_prod,
+                                   const uint32_t n_cons,
+                                   const uint32_t num_nops,
+                                   SpinBarrier *barrier);
+
+  /// Split the reads into super k-mers and send each one to the partition of
+  /// its minimizer.
+  void superkmer_producer_thread(const uint32_t tid, const uint32_t n_prod,
+                                 const uint32_t n_cons, const bool main_thread,
+                                 const double skew, bool is_join,
+                                 SpinBarrier *barrier);
+
+  /// Expand the received super k-mers and count their k-mers.
+  void superkmer_consumer_thread(const uint32_t tid, const uint32_t n_prod,
+                                 const uint32_t n_cons, const uint32_t num_nops,
+                                 SpinBarrier *barrier);
+
   void find_thread(int tid, int n_prod, int n_cons,
                        bool is_join,
-                       std::barrier<std::function<void()>>* barrier);
+                       SpinBarrier *barrier);
+
+  /// Send finds, or a mix of finds and inserts with `rw_queues`, to the
+  /// owners of the keys and collect the results, keeping up to
+  /// `FIND_WINDOW` finds in flight.
+  void find_requester_thread(int tid, int n_prod, int n_cons, bool is_join,
+                             SpinBarrier *barrier);
+
+  /// Serve the requests to the partition of a consumer in rounds: a round
+  /// of finds is probed as a batch and answered at once.
+  void find_owner_thread(int tid, int n_prod, int n_cons, bool is_join,
+                         SpinBarrier *barrier);
 
   void init_queues(uint32_t nprod, uint32_t ncons);
+
+ private:
+  /// The node of each thread of a run, producers then consumers, in the
+  /// order of their ids, to group them at the barriers.
+  std::vector<uint32_t> barrier_nodes();
 };
 
 }  // namespace kmercounter
@@ -3,12 +3,14 @@
 
 #include "hashtables/base_kht.hpp"
 #include "types.hpp"
+#include "utils/spin_barrier.hpp"
 
 namespace kmercounter {
 
 class SynthTest {
  public:
-  void synth_run_exec(Shard *sh, BaseHashTable *kmer_ht);
+  void synth_run_exec(Shard *sh, BaseHashTable *kmer_ht,
+                      SpinBarrier *barrier);
   OpTimings synth_run(BaseHashTable *ktable, uint8_t start);
   OpTimings synth_run_get(BaseHashTable *ktable, uint8_t start);
 };
@@ -1,15 +1,15 @@
 #ifndef __ZIPFIAN_TEST_HPP__
 #define __ZIPFIAN_TEST_HPP__
 
-#include <barrier>
 #include "hashtables/base_kht.hpp"
 #include "types.hpp"
+#include "utils/spin_barrier.hpp"
 
 namespace kmercounter {
 
 class ZipfianTest {
  public:
-  void run(Shard *sh, BaseHashTable *kmer_ht, double skew, int64_t seed, unsigned int count, std::barrier<std::function<void ()>>*);
+  void run(Shard *sh, BaseHashTable *kmer_ht, double skew, int64_t seed, unsigned int count, SpinBarrier *);
 };
 
 }  // namespace kmercounter
@@ -15,6 +15,7 @@ namespace kmercounter {
 class LynxQueue;
 class BQueueAligned;
 class SectionQueue;
+class MpscSectionQueue;
 
 class Tests {
  public:
@@ -22,7 +23,11 @@ class Tests {
   PrefetchTest pt;
   //QueueTest<kmercounter::BQueueAligned> qt;
   // QueueTest<kmercounter::LynxQueue> qt;
+#ifdef MPSC_SECTION_QUEUE
+  QueueTest<kmercounter::MpscSectionQueue> qt;
+#else
   QueueTest<kmercounter::SectionQueue> qt;
+#endif
   CacheMissTest cmt;
   ZipfianTest zipf;
   KmerTest kmer;
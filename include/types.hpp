@@ -12,6 +12,8 @@
 #include <string>
 #include <utility>
 
+#include "utils/wide_key.hpp"
+
 #define CACHE_LINE_SIZE 64
 #define PAGE_SIZE 4096
 #define ALPHA 0.15
@@ -31,9 +33,26 @@ namespace kmercounter {
 using key_type = std::uint32_t;
 #elif (KEY_LEN == 8)
 using key_type = std::uint64_t;
+#elif (KEY_LEN == 16)
+using key_type = WideKey<2>;
+#elif (KEY_LEN == 32)
+using key_type = WideKey<4>;
 #endif
 
+#if (KEY_LEN <= 8)
 using value_type = key_type;
+#else
+// Wide keys are long KMers; the values are still counts.
+using value_type = std::uint64_t;
+#endif
+
+// Structs holding a key are packed, except with wide keys: those are 16-byte
+// aligned vectors, and entries already come out at their packed sizes.
+#if (KEY_LEN <= 8)
+#define KEY_PACKED PACKED
+#else
+#define KEY_PACKED
+#endif
 
 enum class BRANCHKIND { WithBranch, NoBranch_Cmove, NoBranch_Simd };
 
@@ -80,8 +99,17 @@ typedef enum {
   ARRAY_HT = 4,
 } ht_type_t;
 
+// XXX: If you add/modify a backend, update the `input_backend_strings` in
+// src/types.cpp
+typedef enum {
+  PRELOAD_INPUT = 1,
+  MMAP_INPUT = 2,
+  ASYNC_INPUT = 3,
+} input_backend_t;
+
 extern const char* run_mode_strings[];
 extern const char* ht_type_strings[];
+extern const char* input_backend_strings[];
 
 struct alignas(64) cacheline {
   char dummy;
@@ -99,7 +127,35 @@ struct Configuration {
   std::string ht_file;
   std::string in_file;
   uint64_t in_file_sz;
+  // File of input FASTQ paths, one per line or a pair of mates per line
+  std::string in_manifest;
   uint32_t K;
+  // how the input file is read (see input_backend_t)
+  uint32_t input_backend;
+  // bypass the page cache when reading the input asynchronously
+  bool direct_io;
+  // extract k-mers with the vectorized encoder
+  bool simd_kmer;
+  // count a k-mer and its reverse complement as one
+  bool canonical_kmer;
+  // route super k-mers by minimizers of this length to the partitions (0: off)
+  uint32_t minimizer_len;
+  // count k-mers by radix partitioning them in two passes (FASTQ_WITH_INSERT)
+  bool radix_kmer;
+  // count k-mers out of core / grace hashjoin, spilling to this directory
+  std::string spill_dir;
+  // memory budget of out-of-core counting and grace hashjoin in MiB
+  uint64_t mem_budget;
+  // scan the k-mer table for the count histogram and the top k-mers
+  bool kmer_spectrum;
+  // number of most frequent k-mers reported with kmer_spectrum
+  uint32_t top_k;
+  // MiB of the filter that keeps k-mers seen once out of the table (0: off)
+  uint64_t singleton_filter;
+  // Comma separated K values to count in one pass, e.g., "21,25,31"
+  std::string k_list;
+  // Phred quality below which bases are kept out of the k-mers (0: off)
+  uint32_t min_quality;
 
   // number of threads
   uint32_t num_threads;
@@ -162,6 +218,33 @@ struct Configuration {
 
   bool rw_queues;
   unsigned pollute_ratio;
+  // queue tests: the producers send finds to the consumer owning the
+  // partition of the key and get the results back on a queue
+  bool delegate_finds;
+  // queue tests: count the hot keys in the producers, see HotKeyTracker
+  bool skew_routing;
+  // queue tests: keys each producer merges before they are enqueued, see
+  // AggregationBuffer; 0 disables
+  uint32_t aggr_buffer;
+  // queue tests: partitions of the table, spread over the consumers; 0 for
+  // one per consumer
+  uint32_t num_partitions;
+  // queue tests: move partitions between consumers by load after each round
+  // of inserts, see PartitionMap
+  bool rebalance;
+  // rw ratio: requests per second, in millions, arriving at a pool of workers
+  // that grows and shrinks with the load, see ElasticWorkers; 0 disables
+  double elastic_rate;
+  // rw ratio: how many times the elastic rate arrives during a burst
+  double elastic_burst;
+  // comma separated thread counts to run one after another in this process,
+  // reusing the threads, tables and inputs; empty runs num_threads once
+  std::string sweep_threads;
+  // runs of every point of the sweep
+  uint32_t sweep_reps;
+  // zipfian: keys a helper thread on the SMT sibling of every worker
+  // prefetches ahead of it, see PrefetchHelper; 0 disables
+  uint32_t helper_prefetch;
 
   void dump_configuration() {
     printf("Run configuration {\n");
@@ -172,8 +255,35 @@ struct Configuration {
     printf("  ht_size %" PRIu64 " (%" PRIu64 " GiB)\n", ht_size,
            ht_size / (1ul << 30));
     printf("  K %" PRIu64 "\n", K);
+    printf("  input_backend %u - %s\n", input_backend,
+           input_backend_strings[input_backend]);
+    printf("  Direct I/O %s\n", direct_io ? "enabled" : "disabled");
+    printf("  SIMD k-mer extraction %s\n", simd_kmer ? "enabled" : "disabled");
+    printf("  Canonical k-mers %s\n", canonical_kmer ? "enabled" : "disabled");
+    printf("  Minimizer length %u\n", minimizer_len);
+    printf("  Radix k-mer counting %s\n", radix_kmer ? "enabled" : "disabled");
+    printf("  Spill directory %s, memory budget %" PRIu64 " MiB\n",
+           spill_dir.empty() ? "(none)" : spill_dir.c_str(), mem_budget);
+    printf("  K-mer spectrum %s, top %u\n",
+           kmer_spectrum ? "enabled" : "disabled", top_k);
+    printf("  Singleton filter %" PRIu64 " MiB\n", singleton_filter);
+    printf("  K list %s\n", k_list.empty() ? "(none)" : k_list.c_str());
+    printf("  Min base quality %u\n", min_quality);
+    printf("  Input manifest %s\n",
+           in_manifest.empty() ? "(none)" : in_manifest.c_str());
     printf("  P(read) %f\n", pread);
     printf("  Pollution Ratio %u\n", pollute_ratio);
+    printf("  Delegated finds %s\n", delegate_finds ? "enabled" : "disabled");
+    printf("  Skew-aware routing %s\n", skew_routing ? "enabled" : "disabled");
+    printf("  Pre-aggregation buffer %u keys\n", aggr_buffer);
+    printf("  Table partitions %u, rebalancing %s\n", num_partitions,
+           rebalance ? "enabled" : "disabled");
+    printf("  Elastic rate %f Mops/s, bursts x%f\n", elastic_rate,
+           elastic_burst);
+    printf("  Sweep threads %s, %u runs each\n",
+           sweep_threads.empty() ? "(none)" : sweep_threads.c_str(),
+           sweep_reps);
+    printf("  SMT helper prefetch distance %u\n", helper_prefetch);
     printf("BQUEUES:\n  n_prod %u | n_cons %u\n", n_prod, n_cons);
     printf("  ht_fill %u\n", ht_fill);
     printf("ZIPFIAN:\n  skew: %f\n  seed: %ld\n", skew, seed);
@@ -214,6 +324,8 @@ struct thread_stats {
   uint64_t ht_fill;
   uint64_t ht_capacity;
   uint32_t max_count;
+  // cycles waited at the phase barrier
+  uint64_t barrier_wait;
   // uint64_t total_threads; // TODO add this back
 #ifdef CALC_STATS
   uint64_t num_reprobes;
@@ -0,0 +1,102 @@
+#ifndef UTILS_AGGREGATION_BUFFER_HPP
+#define UTILS_AGGREGATION_BUFFER_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace kmercounter {
+/// Merge the repeats of a key before they leave a thread, so that a key seen
+/// n times costs one (key, n) instead of n messages.
+/// A small set-associative table of (key, count), a cache line of `WAYS`
+/// entries per set, meant to stay in L1/L2. A new key that finds its set
+/// full evicts the entry with the smallest count, which has gained the least
+/// from waiting.
+/// Keys must not be zero.
+class AggregationBuffer {
+ public:
+  static constexpr uint32_t WAYS = 4;
+
+  /// Room for about `capacity` keys, rounded up to a power of two sets.
+  explicit AggregationBuffer(uint32_t capacity) {
+    num_sets_ = 1;
+    set_bits_ = 0;
+    while (num_sets_ * WAYS < capacity) {
+      num_sets_ *= 2;
+      set_bits_++;
+    }
+    sets_ = static_cast<Set *>(
+        std::aligned_alloc(alignof(Set), num_sets_ * sizeof(Set)));
+    std::memset(sets_, 0, num_sets_ * sizeof(Set));
+  }
+
+  AggregationBuffer(const AggregationBuffer &) = delete;
+  AggregationBuffer &operator=(const AggregationBuffer &) = delete;
+
+  ~AggregationBuffer() { std::free(sets_); }
+
+  /// Add an occurrence of `key`; `evict(key, count)` gets the entry it
+  /// replaces, if any.
+  template <typename Fn>
+  void add(uint64_t key, Fn &&evict) {
+    Set &set = sets_[set_of(key)];
+    Entry *victim = &set.entries[0];
+    for (auto &e : set.entries) {
+      if (e.key == key) {
+        e.count++;
+        return;
+      }
+      if (e.key == 0) {
+        e = {key, 1};
+        return;
+      }
+      if (e.count < victim->count) {
+        victim = &e;
+      }
+    }
+    num_evictions_++;
+    evict(victim->key, victim->count);
+    *victim = {key, 1};
+  }
+
+  /// Call `fn(key, count)` for every entry and empty the buffer.
+  template <typename Fn>
+  void drain(Fn &&fn) {
+    for (uint32_t s = 0; s < num_sets_; s++) {
+      for (auto &e : sets_[s].entries) {
+        if (e.key != 0) {
+          fn(e.key, e.count);
+          e = {0, 0};
+        }
+      }
+    }
+  }
+
+  uint32_t capacity() const { return num_sets_ * WAYS; }
+
+  /// Entries evicted to make room so far.
+  uint64_t num_evictions() const { return num_evictions_; }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    uint64_t count;
+  };
+
+  struct alignas(64) Set {
+    Entry entries[WAYS];
+  };
+
+  uint32_t set_of(uint64_t key) const {
+    // The top bits of a Fibonacci hash; none for a single set.
+    return set_bits_ ? (key * 0x9E3779B97F4A7C15ull) >> (64 - set_bits_) : 0;
+  }
+
+  Set *sets_;
+  uint32_t num_sets_;
+  uint32_t set_bits_;
+  uint64_t num_evictions_ = 0;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_AGGREGATION_BUFFER_HPP
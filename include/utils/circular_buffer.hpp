@@ -1,12 +1,15 @@
 #ifndef UTILS_CIRCULAR_BUFFER_HPP
 #define UTILS_CIRCULAR_BUFFER_HPP
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <cstdint>
 #include <iterator>
+#include <string>
 
 #include "plog/Log.h"
+#include "utils/wide_key.hpp"
 
 namespace kmercounter {
 // A DNA KMer.
@@ -14,9 +17,11 @@ template <size_t K>
 class DNAKMer {
 public:
   static_assert(K > 0);
+  using data_type = uint64_t;
 
   DNAKMer() : DNAKMer(uint64_t{}) {}
-  DNAKMer(uint64_t kmer) : buffer_{kmer} {}
+  DNAKMer(uint64_t kmer)
+      : buffer_{kmer}, rc_buffer_{reverse_complement(kmer)} {}
 
   // Push a character mer into the buffer.
   // Does nothing and returns false if it's not a valid mer.
@@ -30,6 +35,9 @@ public:
     // Shift left and insert the mer in the right-most entry.
     this->shift_left();
     buffer_ |= code;
+    // The complement goes in the left-most entry of the reverse complement.
+    rc_buffer_ >>= MER_SIZE;
+    rc_buffer_ |= uint64_t(code ^ MER_MASK) << (KMER_SIZE - MER_SIZE);
     return true;
   }
 
@@ -37,6 +45,19 @@ public:
     return buffer_;
   }
 
+  static constexpr size_t k() { return K; }
+
+  // The reverse complement of `data()`.
+  uint64_t rc_data() const {
+    return rc_buffer_;
+  }
+
+  // The smaller of the kmer and its reverse complement, i.e., the
+  // representative of both strands.
+  uint64_t canonical_data() const {
+    return std::min(buffer_, rc_buffer_);
+  }
+
   std::string to_string() const {
     std::string str;
     uint64_t mask = (uint64_t)MER_MASK << ((K - 1) * MER_SIZE); 
@@ -53,6 +74,29 @@ public:
     return DNAKMer(kmer).to_string();
   }
 
+  // Reverse the order of the 32 mers of a word.
+  static uint64_t reverse_mers(uint64_t word) {
+    word = __builtin_bswap64(word);
+    word = ((word >> 4) & 0x0F0F'0F0F'0F0F'0F0F) |
+           ((word & 0x0F0F'0F0F'0F0F'0F0F) << 4);
+    return ((word >> 2) & 0x3333'3333'3333'3333) |
+           ((word & 0x3333'3333'3333'3333) << 2);
+  }
+
+  // Complement of a mer is `MER_MASK - mer` (A <-> T, C <-> G).
+  static uint64_t reverse_complement(uint64_t kmer) {
+    return reverse_mers(~kmer) >> (sizeof(uint64_t) * 8 - KMER_SIZE);
+  }
+
+  static uint64_t canonical(uint64_t kmer) {
+    return std::min(kmer, reverse_complement(kmer));
+  }
+
+  // The code of a character mer, or a negative value if it's not a valid mer.
+  static int encode(const uint8_t mer) { return ENCODE_MAP[mer]; }
+
+  static uint8_t decode_mer(const uint8_t code) { return DECODE_MAP[code]; }
+
   // Size of a mer in bits
   constexpr static size_t MER_SIZE = 2; 
   // Maximun K, aka the number of mers, that we can hold.
@@ -81,6 +125,8 @@ private:
 
   // Currently assumes only uint64_t for simplicity.
   uint64_t buffer_; 
+  // Reverse complement of `buffer_`, maintained along with it.
+  uint64_t rc_buffer_;
   static_assert(K <= 32, "K > 32 is not yet implemented");
 
   // Borrowed from https://github.com/gmarcais/Jellyfish/blob/master/include/jellyfish/mer_dna.hpp
@@ -125,6 +171,93 @@ static_assert(DNAKMer<4>::KMER_MASK == 0b1111'1111);
 static_assert(DNAKMer<31>::KMER_MASK == 0x3FFF'FFFF'FFFF'FFFF);
 static_assert(DNAKMer<32>::KMER_MASK == 0xFFFF'FFFF'FFFF'FFFF);
 
+/// A DNA KMer with K up to 32 * N, packed into a `WideKey<N>`.
+/// The layout is the one of `DNAKMer` spread over the words: the last mer is
+/// in the least significant bits of word 0.
+/// K is a runtime value; instantiating every K up to 128 is not worth it.
+template <size_t N>
+class WideDNAKMer {
+ public:
+  using data_type = WideKey<N>;
+  constexpr static size_t MER_SIZE = DNAKMer<1>::MER_SIZE;
+  constexpr static size_t MAX_K = N * DNAKMer<1>::MAX_K;
+  constexpr static size_t WORD_BITS = sizeof(uint64_t) * 8;
+
+  explicit WideDNAKMer(uint32_t k) : k_(k) {
+    PLOG_FATAL_IF(k < 1 || k > MAX_K)
+        << "K=" << k << " is not a valid value for " << N * WORD_BITS
+        << "-bit KMers";
+    const size_t kmer_bits = k * MER_SIZE;
+    for (size_t i = 0; i < N; i++) {
+      const size_t low = i * WORD_BITS;
+      mask_.words[i] = kmer_bits >= low + WORD_BITS ? ~0ull
+                       : kmer_bits > low ? (1ull << (kmer_bits - low)) - 1
+                                         : 0;
+    }
+    // All A's, like `DNAKMer()`.
+    rc_buffer_ = mask_;
+  }
+
+  // Same as `DNAKMer::push`.
+  bool push(const uint8_t mer) {
+    const int code = DNAKMer<1>::encode(mer);
+    if (code < 0) {
+      return false;
+    }
+
+    // Shift left across the words and drop the first mer.
+    for (size_t i = N - 1; i > 0; i--) {
+      buffer_.words[i] = (buffer_.words[i] << MER_SIZE) |
+                         (buffer_.words[i - 1] >> (WORD_BITS - MER_SIZE));
+    }
+    buffer_.words[0] = (buffer_.words[0] << MER_SIZE) | code;
+    for (size_t i = 0; i < N; i++) {
+      buffer_.words[i] &= mask_.words[i];
+    }
+
+    // Shift the reverse complement right and put the complement on top.
+    for (size_t i = 0; i < N - 1; i++) {
+      rc_buffer_.words[i] = (rc_buffer_.words[i] >> MER_SIZE) |
+                            (rc_buffer_.words[i + 1] << (WORD_BITS - MER_SIZE));
+    }
+    rc_buffer_.words[N - 1] >>= MER_SIZE;
+    const size_t top = (k_ - 1) * MER_SIZE;
+    rc_buffer_.words[top / WORD_BITS] |=
+        uint64_t(code ^ DNAKMer<1>::MER_MASK) << (top % WORD_BITS);
+    return true;
+  }
+
+  const WideKey<N> &data() const { return buffer_; }
+
+  const WideKey<N> &rc_data() const { return rc_buffer_; }
+
+  const WideKey<N> &canonical_data() const {
+    return rc_buffer_ < buffer_ ? rc_buffer_ : buffer_;
+  }
+
+  uint32_t k() const { return k_; }
+
+  static std::string decode(const WideKey<N> &kmer, uint32_t k) {
+    std::string str;
+    for (size_t i = k; i-- > 0;) {
+      const size_t bit = i * MER_SIZE;
+      const uint8_t code = (kmer.words[bit / WORD_BITS] >> (bit % WORD_BITS)) &
+                           DNAKMer<1>::MER_MASK;
+      str.push_back(DNAKMer<1>::decode_mer(code));
+    }
+    return str;
+  }
+
+  std::string to_string() const { return decode(buffer_, k_); }
+
+ private:
+  uint32_t k_;
+  WideKey<N> buffer_{};
+  WideKey<N> rc_buffer_{};
+  // Mask to remove unused bits of each word.
+  WideKey<N> mask_{};
+};
+
 /// An always-full circular buffer.
 /// Use memmove to keep the head at the beginning of the buffer.
 /// Maybe faster than the offset variant.
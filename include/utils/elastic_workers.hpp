@@ -0,0 +1,176 @@
+#ifndef UTILS_ELASTIC_WORKERS_HPP
+#define UTILS_ELASTIC_WORKERS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace kmercounter {
+enum class WorkerRole : uint32_t { Parked, Insert, Find, Exit };
+
+/// The roles of a fixed set of worker threads, handed out by a controller
+/// as the load changes.
+/// A worker checks its role between batches. A parked worker sleeps on its
+/// role until it gets another one, so it costs no CPU; the threads stay
+/// alive and pinned, and come back without being spawned again.
+class ElasticWorkers {
+ public:
+  explicit ElasticWorkers(uint32_t num_workers) : slots_(num_workers) {}
+
+  uint32_t num_workers() const { return slots_.size(); }
+
+  /// The role of worker `w`, sleeping while it is parked.
+  WorkerRole await_role(uint32_t w) {
+    auto &role = slots_[w].role;
+    role.wait(WorkerRole::Parked, std::memory_order_acquire);
+    return role.load(std::memory_order_acquire);
+  }
+
+  WorkerRole role(uint32_t w) const {
+    return slots_[w].role.load(std::memory_order_relaxed);
+  }
+
+  /// Count `n` operations done by worker `w`; only `w` may call this.
+  void add_ops(uint32_t w, uint64_t n) {
+    auto &ops = slots_[w].ops;
+    ops.store(ops.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+  }
+
+  /// Operations worker `w` has done so far.
+  uint64_t ops(uint32_t w) const {
+    return slots_[w].ops.load(std::memory_order_relaxed);
+  }
+
+  void assign(uint32_t w, WorkerRole role) {
+    auto &slot = slots_[w].role;
+    if (slot.exchange(role, std::memory_order_release) == WorkerRole::Parked) {
+      slot.notify_one();
+    }
+  }
+
+  /// Run `inserters` workers in the insert role and `finders` in the find
+  /// role, and park the others. Workers keep their role where they can and
+  /// the lowest-numbered ones run, so that the same cores stay busy.
+  /// Returns the number of workers whose role changed.
+  uint32_t resize(uint32_t inserters, uint32_t finders) {
+    const uint32_t active = std::min<uint32_t>(inserters + finders,
+                                               slots_.size());
+    std::vector<WorkerRole> roles(slots_.size(), WorkerRole::Parked);
+    uint32_t left[] = {inserters, finders};
+    auto index = [](WorkerRole r) { return r == WorkerRole::Insert ? 0 : 1; };
+    // Keep what can be kept, then fill in.
+    for (uint32_t w = 0; w < active; w++) {
+      const WorkerRole r = this->role(w);
+      if ((r == WorkerRole::Insert || r == WorkerRole::Find) &&
+          left[index(r)] > 0) {
+        roles[w] = r;
+        left[index(r)]--;
+      }
+    }
+    for (uint32_t w = 0; w < active; w++) {
+      if (roles[w] == WorkerRole::Parked) {
+        roles[w] = left[0] > 0 ? WorkerRole::Insert : WorkerRole::Find;
+        left[index(roles[w])]--;
+      }
+    }
+    uint32_t changes = 0;
+    for (uint32_t w = 0; w < slots_.size(); w++) {
+      if (this->role(w) != roles[w]) {
+        this->assign(w, roles[w]);
+        changes++;
+      }
+    }
+    return changes;
+  }
+
+  /// Let every worker go, parked or not.
+  void stop() {
+    for (uint32_t w = 0; w < slots_.size(); w++) {
+      this->assign(w, WorkerRole::Exit);
+    }
+  }
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<WorkerRole> role{WorkerRole::Parked};
+    std::atomic_uint64_t ops{0};
+  };
+
+  std::vector<Slot> slots_;
+};
+
+/// How many workers to run, and in which role, from one tick of the
+/// controller to the next.
+/// The capacity of a worker is learnt from the ticks that ended with a
+/// backlog, when the workers had no reason to wait. Enough workers run to
+/// serve what arrived in the last tick and half of the backlog; the pool
+/// grows at once and shrinks a worker a tick, so that a lull in a burst does
+/// not park the workers it is about to need.
+class ElasticPolicy {
+ public:
+  struct Plan {
+    uint32_t inserters;
+    uint32_t finders;
+  };
+
+  /// What happened in a tick, and what is left of each kind of request.
+  struct Tick {
+    uint64_t done;
+    uint32_t active;
+    uint64_t insert_arrivals;
+    uint64_t find_arrivals;
+    uint64_t insert_backlog;
+    uint64_t find_backlog;
+  };
+
+  explicit ElasticPolicy(uint32_t max_workers, uint32_t min_workers = 1)
+      : max_workers_(max_workers),
+        min_workers_(std::min(min_workers, max_workers)),
+        active_(max_workers) {}
+
+  /// Operations per worker per tick, as far as it is known.
+  double worker_rate() const { return rate_; }
+
+  Plan next(const Tick &t) {
+    const uint64_t backlog = t.insert_backlog + t.find_backlog;
+    if (backlog > 0 && t.active > 0 && t.done > 0) {
+      const double sample = static_cast<double>(t.done) / t.active;
+      rate_ = rate_ > 0 ? 0.75 * rate_ + 0.25 * sample : sample;
+    }
+
+    uint32_t wanted = max_workers_;
+    if (rate_ > 0) {
+      const double demand =
+          t.insert_arrivals + t.find_arrivals + backlog / 2.0;
+      wanted = std::clamp<uint32_t>(std::ceil(demand / rate_), min_workers_,
+                                    max_workers_);
+    }
+    active_ = wanted >= active_ ? wanted : std::max(wanted, active_ - 1);
+
+    // Split the workers by the demand of each kind, keeping one for a kind
+    // that has any.
+    const double inserts = t.insert_arrivals + t.insert_backlog;
+    const double finds = t.find_arrivals + t.find_backlog;
+    if (inserts + finds == 0) {
+      return {active_, 0};
+    }
+    uint32_t inserters = std::lround(active_ * inserts / (inserts + finds));
+    if (active_ >= 2) {
+      inserters = std::clamp<uint32_t>(inserters, inserts > 0 ? 1 : 0,
+                                       finds > 0 ? active_ - 1 : active_);
+    }
+    return {inserters, active_ - inserters};
+  }
+
+ private:
+  uint32_t max_workers_;
+  uint32_t min_workers_;
+  uint32_t active_;
+  double rate_ = 0;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_ELASTIC_WORKERS_HPP
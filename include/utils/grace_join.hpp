@@ -0,0 +1,322 @@
+#ifndef UTILS_GRACE_JOIN_HPP
+#define UTILS_GRACE_JOIN_HPP
+
+#include <x86intrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "hashtables/base_kht.hpp"
+#include "hashtables/batch_runner/batch_runner.hpp"
+#include "hashtables/kvtypes.hpp"
+#include "input_reader/input_reader.hpp"
+#include "plog/Log.h"
+#include "types.hpp"
+#include "utils/radix_partition.hpp"
+#include "utils/spill_buckets.hpp"
+
+namespace kmercounter {
+/// A grace hash join of a build relation R with a probe relation S by the
+/// `config.num_threads` threads of a run, within `config.mem_budget` MiB.
+/// Both relations are partitioned by key. The first partitions are joined in
+/// memory on the way; the others are spilled to `config.spill_dir` and
+/// joined pairwise afterwards, as many at a time as fit the budget.
+/// The threads of a run share one `GraceJoin`, created before they start.
+class GraceJoin {
+ public:
+  using MakeTable = std::function<BaseHashTable *(uint64_t)>;
+
+  static constexpr uint64_t MiB = 1ull << 20;
+  /// Tuples read from a spilled partition at a time by a thread.
+  static constexpr uint64_t READ_CHUNK_TUPLES = MiB / sizeof(KeyValuePair);
+  /// Bounds on the staging buffer of a partition per thread.
+  static constexpr uint64_t MIN_SPILL_BUFFER_TUPLES = 256;
+  static constexpr uint64_t MAX_SPILL_BUFFER_TUPLES = 64 << 10;
+  static constexpr uint32_t MAX_PARTITION_BITS = 10;
+
+  /// Plan the partitions of a build relation of `config.relation_r_size`
+  /// tuples.
+  explicit GraceJoin(const Configuration &config)
+      : num_threads_(config.num_threads),
+        ht_fill_(config.ht_fill),
+        phase_(config.num_threads) {
+    const uint64_t budget = config.mem_budget * MiB;
+    if (budget <= 2 * this->read_buffers()) {
+      PLOG_ERROR << "Memory budget of " << config.mem_budget
+                 << " MiB is too small for " << num_threads_ << " threads";
+      exit(-1);
+    }
+    budget_ = budget - this->read_buffers();
+    this->plan_partitions(config.relation_r_size, config.spill_dir);
+  }
+
+  GraceJoin(const GraceJoin &) = delete;
+  GraceJoin &operator=(const GraceJoin &) = delete;
+
+  /// Partitions are picked by a hash independent of the one of the tables.
+  static uint32_t partition_of(const KeyValuePair &kv, uint32_t bits) {
+    return radix::partition_of(radix::mix(static_cast<uint64_t>(kv.key)),
+                               bits);
+  }
+
+  /// Join the tuples of R from `r` with the tuples of S from `s` on thread
+  /// `tid`, in tables from `make_ht(capacity)`, which the threads share.
+  /// Every thread of the run calls it. Returns the rows output by this
+  /// thread.
+  uint64_t run(uint32_t tid, input_reader::InputReader<KeyValuePair> *r,
+               input_reader::InputReader<KeyValuePair> *s,
+               const MakeTable &make_ht) {
+    uint64_t num_output = 0;
+    auto join_row = [&num_output](const FindResult &) { num_output++; };
+    auto probe = [&num_output](HTBatchRunner<> &batch_runner,
+                               const KeyValuePair &kv) {
+      // Only the non-prefetching find answers right away.
+      if (batch_runner.find(kv)) {
+        num_output++;
+      }
+    };
+
+    // Partition both relations, joining the resident partitions on the way:
+    // build from R, then probe with S.
+    BaseHashTable *ht = make_ht(resident_slots_);
+    {
+      HTBatchRunner batch_runner(ht);
+      {
+        SpillWriter<KeyValuePair> writer(*r_spill_, tuples_per_buffer_);
+        for (KeyValuePair kv; r->next(&kv);) {
+          const uint32_t p = partition_of(kv, bits_);
+          if (p < num_resident_) {
+            batch_runner.insert(kv);
+          } else {
+            writer.push(p - num_resident_, kv);
+          }
+        }
+      }
+      batch_runner.flush_insert();
+      phase_.arrive_and_wait();
+
+      // Read ahead the build side of the first spilled round while probing.
+      if (r_spill_->num_buckets() > 0) {
+        prefetch_spilled(*r_spill_, 0, 1, tid);
+      }
+      batch_runner.set_callback(join_row);
+      {
+        SpillWriter<KeyValuePair> writer(*s_spill_, tuples_per_buffer_);
+        for (KeyValuePair kv; s->next(&kv);) {
+          const uint32_t p = partition_of(kv, bits_);
+          if (p < num_resident_) {
+            probe(batch_runner, kv);
+          } else {
+            writer.push(p - num_resident_, kv);
+          }
+        }
+      }
+      batch_runner.flush_find();
+    }
+    phase_.arrive_and_wait();
+
+    if (tid == 0) {
+      partition_end_ = _rdtsc();
+      this->plan_rounds();
+      PLOG_INFO.printf(
+          "Grace hashjoin: %u partitions, %u resident, %zu rounds over the "
+          "spilled ones",
+          1u << bits_, num_resident_, round_slots_.size());
+    }
+    // Every thread drops its reference before a round allocates a table
+    // anew.
+    delete ht;
+    phase_.arrive_and_wait();
+
+    // Join the spilled partition pairs, a round of them at a time, while the
+    // kernel reads ahead the next round.
+    std::vector<KeyValuePair> chunk(READ_CHUNK_TUPLES);
+    const size_t num_rounds = round_slots_.size();
+    for (size_t round = 0; round < num_rounds; round++) {
+      const auto begin = round_begin_[round];
+      const auto end = round_begin_[round + 1];
+      prefetch_spilled(*s_spill_, begin, end, tid);
+      if (round + 1 < num_rounds) {
+        prefetch_spilled(*r_spill_, end, round_begin_[round + 2], tid);
+      }
+
+      ht = make_ht(round_slots_[round]);
+      {
+        HTBatchRunner batch_runner(ht);
+        for_each_spilled(*r_spill_, begin, end, tid, chunk,
+                         [&](const KeyValuePair &kv) {
+                           batch_runner.insert(kv);
+                         });
+        batch_runner.flush_insert();
+        phase_.arrive_and_wait();
+
+        batch_runner.set_callback(join_row);
+        for_each_spilled(
+            *s_spill_, begin, end, tid, chunk,
+            [&](const KeyValuePair &kv) { probe(batch_runner, kv); });
+        batch_runner.flush_find();
+      }
+      phase_.arrive_and_wait();
+      delete ht;
+      phase_.arrive_and_wait();
+    }
+    // No thread reads the spilled partitions any more.
+    if (tid == 0) {
+      r_spill_.reset();
+      s_spill_.reset();
+    }
+    num_output_ += num_output;
+    return num_output;
+  }
+
+  /// Rows output by all threads, once they are done.
+  uint64_t num_output() const { return num_output_.load(); }
+
+  /// When the threads were done partitioning, in cycles.
+  uint64_t partition_end() const { return partition_end_; }
+
+ private:
+  uint64_t read_buffers() const {
+    return num_threads_ * READ_CHUNK_TUPLES * sizeof(KeyValuePair);
+  }
+
+  /// Slots of a table holding `num_tuples` build tuples at the configured
+  /// fill.
+  uint64_t table_slots(uint64_t num_tuples) const {
+    return std::bit_ceil(std::max<uint64_t>(num_tuples * 100 / ht_fill_, 1));
+  }
+
+  uint64_t table_bytes(uint64_t num_tuples) const {
+    return this->table_slots(num_tuples) * sizeof(KVType);
+  }
+
+  /// Partition so that the table of a partition takes a quarter of the
+  /// budget at most, and keep as many partitions resident as fit half of it.
+  /// The other half holds the staging buffers of the spilled ones.
+  void plan_partitions(uint64_t r_size, const std::string &spill_dir) {
+    uint64_t num_partitions = std::bit_ceil(
+        (4 * this->table_bytes(r_size) + budget_ - 1) / budget_);
+    num_partitions =
+        std::min<uint64_t>(num_partitions, 1 << MAX_PARTITION_BITS);
+    bits_ = std::bit_width(num_partitions) - 1;
+    PLOG_WARNING_IF(this->table_bytes(r_size / num_partitions) > budget_ / 2)
+        << "Build relation needs more than " << num_partitions
+        << " partitions; the memory budget will be exceeded";
+
+    const uint64_t per_partition =
+        (r_size + num_partitions - 1) / num_partitions;
+    uint32_t resident = 1;
+    while (resident < num_partitions &&
+           this->table_bytes((resident + 1) * per_partition) <=
+               (resident + 1 == num_partitions ? budget_ : budget_ / 2)) {
+      resident++;
+    }
+    num_resident_ = resident;
+    resident_slots_ = this->table_slots(resident * per_partition);
+
+    const uint32_t num_spilled = num_partitions - resident;
+    tuples_per_buffer_ = MIN_SPILL_BUFFER_TUPLES;
+    if (num_spilled > 0) {
+      const uint64_t staging = budget_ / 2 / sizeof(KeyValuePair) /
+                               (2 * num_threads_ * num_spilled);
+      tuples_per_buffer_ = std::clamp(staging, MIN_SPILL_BUFFER_TUPLES,
+                                      MAX_SPILL_BUFFER_TUPLES);
+    }
+    r_spill_ = std::make_unique<SpillBuckets<KeyValuePair>>(spill_dir,
+                                                            num_spilled, "r-");
+    s_spill_ = std::make_unique<SpillBuckets<KeyValuePair>>(spill_dir,
+                                                            num_spilled, "s-");
+  }
+
+  /// Merge consecutive spilled partitions into rounds whose tables fit the
+  /// budget.
+  void plan_rounds() {
+    const auto &r_spill = *r_spill_;
+    round_begin_ = {0};
+    round_slots_.clear();
+    uint64_t tuples = 0;
+    for (uint32_t b = 0; b < r_spill.num_buckets(); b++) {
+      const uint64_t merged = tuples + r_spill.size(b);
+      if (tuples > 0 && this->table_bytes(merged) > budget_) {
+        round_begin_.push_back(b);
+        round_slots_.push_back(this->table_slots(tuples));
+        tuples = r_spill.size(b);
+      } else {
+        tuples = merged;
+      }
+    }
+    if (r_spill.num_buckets() > 0) {
+      round_begin_.push_back(r_spill.num_buckets());
+      round_slots_.push_back(this->table_slots(tuples));
+    }
+  }
+
+  /// The slice of `bucket` read by thread `tid`.
+  std::pair<uint64_t, uint64_t> slice(const SpillBuckets<KeyValuePair> &spill,
+                                      uint32_t bucket, uint32_t tid) const {
+    const uint64_t n = spill.size(bucket);
+    return {n * tid / num_threads_, n * (tid + 1) / num_threads_};
+  }
+
+  /// Call `fn(kv)` on the slice of thread `tid` of each of the buckets
+  /// [`begin`, `end`), a chunk at a time.
+  template <typename Fn>
+  void for_each_spilled(const SpillBuckets<KeyValuePair> &spill,
+                        uint32_t begin, uint32_t end, uint32_t tid,
+                        std::vector<KeyValuePair> &chunk, Fn &&fn) const {
+    for (auto b = begin; b < end; b++) {
+      const auto [first, last] = this->slice(spill, b, tid);
+      for (uint64_t at = first; at < last; at += chunk.size()) {
+        const std::span<KeyValuePair> tuples(
+            chunk.data(), std::min<uint64_t>(chunk.size(), last - at));
+        spill.read(b, at, tuples);
+        for (const auto &kv : tuples) {
+          fn(kv);
+        }
+      }
+      spill.release(b, first, last);
+    }
+  }
+
+  void prefetch_spilled(const SpillBuckets<KeyValuePair> &spill,
+                        uint32_t begin, uint32_t end, uint32_t tid) const {
+    for (auto b = begin; b < end; b++) {
+      const auto [first, last] = this->slice(spill, b, tid);
+      spill.prefetch(b, first, last);
+    }
+  }
+
+  const uint32_t num_threads_;
+  const uint32_t ht_fill_;
+  /// Budget of the tables, i.e., all but the read buffers of the spilled
+  /// partitions.
+  uint64_t budget_;
+  /// The internal phases do not go through `sync_complete` so that the PAPI
+  /// counters stay on for the whole join.
+  std::barrier<> phase_;
+  uint32_t bits_;
+  /// Partitions [0, num_resident_) are joined in memory while partitioning;
+  /// partition p >= num_resident_ is spilled to bucket p - num_resident_.
+  uint32_t num_resident_;
+  uint64_t resident_slots_;
+  uint64_t tuples_per_buffer_;
+  std::unique_ptr<SpillBuckets<KeyValuePair>> r_spill_;
+  std::unique_ptr<SpillBuckets<KeyValuePair>> s_spill_;
+  /// Buckets [round_begin_[i], round_begin_[i + 1]) are joined in round i.
+  std::vector<uint32_t> round_begin_;
+  std::vector<uint64_t> round_slots_;
+  std::atomic_uint64_t num_output_ = 0;
+  uint64_t partition_end_ = 0;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_GRACE_JOIN_HPP
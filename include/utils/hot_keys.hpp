@@ -0,0 +1,128 @@
+#ifndef UTILS_HOT_KEYS_HPP
+#define UTILS_HOT_KEYS_HPP
+
+#include <array>
+#include <cstdint>
+
+namespace kmercounter {
+/// Find the few keys that make up a large share of a stream of keys, and
+/// count them apart from the rest from then on.
+/// Every `SAMPLE_PERIOD`-th key goes into a Misra-Gries summary of
+/// `CANDIDATES` counters, whose estimates never exceed the true number of
+/// samples of a key. A key whose estimated share of the samples reaches
+/// `min_share` is a candidate; once `promote`d, every occurrence of it is
+/// counted exactly in a small table of up to `MAX_HOT` keys.
+/// Keys must not be zero.
+class HotKeyTracker {
+ public:
+  static constexpr uint32_t SAMPLE_PERIOD = 16;
+  static constexpr uint32_t CANDIDATES = 32;
+  static constexpr uint32_t MAX_HOT = 64;
+  /// Samples to take before any key can be a candidate.
+  static constexpr uint64_t MIN_SAMPLES = 256;
+
+  explicit HotKeyTracker(double min_share) : min_share_(min_share) {}
+
+  /// Count `key` and return true if it is hot.
+  bool count(uint64_t key) {
+    for (uint32_t i = slot_of(key);; i = (i + 1) % HOT_SLOTS) {
+      if (hot_[i].key == key) {
+        hot_[i].count++;
+        return true;
+      }
+      if (hot_[i].key == 0) {
+        return false;
+      }
+    }
+  }
+
+  /// Sample `key`, a key that is not hot; true if it was sampled and is a
+  /// candidate for promotion.
+  bool sample(uint64_t key) {
+    if (++since_sample_ < SAMPLE_PERIOD) {
+      return false;
+    }
+    since_sample_ = 0;
+    num_samples_++;
+
+    Candidate *free = nullptr;
+    for (auto &c : candidates_) {
+      if (c.key == key && c.count > 0) {
+        c.count++;
+        return num_samples_ >= MIN_SAMPLES &&
+               c.count >= min_share_ * num_samples_;
+      }
+      if (c.count == 0) {
+        free = &c;
+      }
+    }
+    if (free) {
+      *free = {key, 1};
+    } else {
+      // Take one sample off every key, the new one included.
+      for (auto &c : candidates_) {
+        c.count--;
+      }
+    }
+    return false;
+  }
+
+  /// Count `key` exactly from now on; false if the hot set is full.
+  bool promote(uint64_t key) {
+    uint32_t i = slot_of(key);
+    while (hot_[i].key != 0 && hot_[i].key != key) {
+      i = (i + 1) % HOT_SLOTS;
+    }
+    if (hot_[i].key == 0) {
+      if (num_hot_ == MAX_HOT) {
+        return false;
+      }
+      hot_[i] = {key, 0};
+      num_hot_++;
+    }
+    return true;
+  }
+
+  uint32_t num_hot() const { return num_hot_; }
+
+  /// Call `fn(key, count)` for each hot key with its count since it was
+  /// promoted, and reset the counts.
+  template <typename Fn>
+  void drain(Fn &&fn) {
+    for (auto &h : hot_) {
+      if (h.key != 0 && h.count > 0) {
+        fn(h.key, h.count);
+        h.count = 0;
+      }
+    }
+  }
+
+ private:
+  /// Twice as many slots as hot keys keep the probes short.
+  static constexpr uint32_t HOT_SLOTS = 2 * MAX_HOT;
+
+  struct Candidate {
+    uint64_t key;
+    uint64_t count;
+  };
+
+  struct Hot {
+    uint64_t key;
+    uint64_t count;
+  };
+
+  static uint32_t slot_of(uint64_t key) {
+    return (key * 0x9E3779B97F4A7C15ull) >> 57;
+  }
+  static_assert(HOT_SLOTS == 1u << 7, "slot_of hashes to 7 bits");
+
+  double min_share_;
+  uint32_t since_sample_ = 0;
+  uint64_t num_samples_ = 0;
+  uint32_t num_hot_ = 0;
+  std::array<Candidate, CANDIDATES> candidates_{};
+  std::array<Hot, HOT_SLOTS> hot_{};
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_HOT_KEYS_HPP
@@ -0,0 +1,116 @@
+#ifndef UTILS_KMER_SPECTRUM_HPP
+#define UTILS_KMER_SPECTRUM_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace kmercounter {
+/// The count histogram (count-of-counts) and the `top_k` most frequent keys
+/// of a set of (key, count) entries, e.g., the KMers of a table.
+/// Each thread fills a spectrum of its own share of the entries; the
+/// spectra are merged at the end.
+template <typename Key = uint64_t>
+class KmerSpectrum {
+ public:
+  /// Counts below this go to a flat array; the rare larger ones to a map.
+  static constexpr uint64_t DENSE_COUNTS = 1 << 14;
+
+  using Entry = std::pair<uint64_t, Key>;
+
+  explicit KmerSpectrum(uint32_t top_k) : top_k_(top_k), dense_(DENSE_COUNTS) {}
+
+  void add(const Key &key, uint64_t count) {
+    if (count < DENSE_COUNTS) {
+      dense_[count]++;
+    } else {
+      sparse_[count]++;
+    }
+    this->add_top(key, count);
+  }
+
+  void merge(const KmerSpectrum &other) {
+    for (uint64_t c = 0; c < DENSE_COUNTS; c++) {
+      dense_[c] += other.dense_[c];
+    }
+    for (const auto &[count, num] : other.sparse_) {
+      sparse_[count] += num;
+    }
+    for (const auto &[count, key] : other.top_) {
+      this->add_top(key, count);
+    }
+  }
+
+  /// (count, number of keys with that count), for the counts that occur, in
+  /// increasing order of count.
+  std::vector<std::pair<uint64_t, uint64_t>> histogram() const {
+    std::vector<std::pair<uint64_t, uint64_t>> hist;
+    for (uint64_t c = 0; c < DENSE_COUNTS; c++) {
+      if (dense_[c] != 0) {
+        hist.emplace_back(c, dense_[c]);
+      }
+    }
+    hist.insert(hist.end(), sparse_.begin(), sparse_.end());
+    return hist;
+  }
+
+  /// The most frequent keys as (count, key), most frequent first.
+  std::vector<Entry> top() const {
+    auto top = top_;
+    std::sort(top.begin(), top.end(), greater);
+    return top;
+  }
+
+  /// Number of distinct keys.
+  uint64_t distinct() const {
+    uint64_t n = 0;
+    for (const auto &[count, num] : this->histogram()) {
+      n += num;
+    }
+    return n;
+  }
+
+  /// Sum of the counts.
+  uint64_t total() const {
+    uint64_t n = 0;
+    for (const auto &[count, num] : this->histogram()) {
+      n += count * num;
+    }
+    return n;
+  }
+
+ private:
+  // Ties go to the smaller key so that the result does not depend on the
+  // order of the scan.
+  static bool greater(const Entry &a, const Entry &b) {
+    if (a.first != b.first) {
+      return a.first > b.first;
+    }
+    return a.second < b.second;
+  }
+
+  /// `top_` is a min-heap of the most frequent keys so far.
+  void add_top(const Key &key, uint64_t count) {
+    if (top_k_ == 0) {
+      return;
+    }
+    if (top_.size() < top_k_) {
+      top_.emplace_back(count, key);
+      std::push_heap(top_.begin(), top_.end(), greater);
+    } else if (greater({count, key}, top_.front())) {
+      std::pop_heap(top_.begin(), top_.end(), greater);
+      top_.back() = {count, key};
+      std::push_heap(top_.begin(), top_.end(), greater);
+    }
+  }
+
+  uint32_t top_k_;
+  std::vector<uint64_t> dense_;
+  std::map<uint64_t, uint64_t> sparse_;
+  std::vector<Entry> top_;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_KMER_SPECTRUM_HPP
@@ -0,0 +1,87 @@
+#ifndef UTILS_PREFETCH_HELPER_HPP
+#define UTILS_PREFETCH_HELPER_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <x86intrin.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace kmercounter {
+/// A thread, meant for the SMT sibling of a worker, that walks the worker's
+/// input ahead of it and prefetches what each position will touch, so that
+/// the worker can run plain one-at-a-time operations on warm cache lines.
+/// The worker publishes how far it has got with `advance`; the helper stays
+/// at most `distance` positions ahead, and jumps forward when it falls
+/// behind, since a prefetch the worker has already passed is wasted.
+class PrefetchHelper {
+ public:
+  using Prefetch = std::function<void(uint64_t)>;
+
+  /// Prefetch positions 0 to `end` - 1 of the worker's input, on `cpu`.
+  PrefetchHelper(uint32_t cpu, uint32_t distance, uint64_t end,
+                 Prefetch prefetch)
+      : distance_(distance),
+        end_(end),
+        prefetch_(std::move(prefetch)),
+        thread_(&PrefetchHelper::run, this, cpu) {}
+
+  PrefetchHelper(const PrefetchHelper &) = delete;
+  PrefetchHelper &operator=(const PrefetchHelper &) = delete;
+
+  ~PrefetchHelper() { this->finish(); }
+
+  /// The worker is done with positions below `pos`.
+  void advance(uint64_t pos) { pos_.store(pos, std::memory_order_relaxed); }
+
+  /// Stop the helper, wherever it is, and wait for it.
+  void finish() {
+    done_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  /// Positions prefetched, and passed over because the worker got there
+  /// first. Valid after `finish`.
+  uint64_t issued() const { return issued_; }
+  uint64_t skipped() const { return skipped_; }
+
+ private:
+  void run(uint32_t cpu) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+
+    uint64_t next = 0;
+    while (next < end_ && !done_.load(std::memory_order_relaxed)) {
+      const uint64_t pos = pos_.load(std::memory_order_relaxed);
+      if (next < pos) {
+        skipped_ += pos - next;
+        next = pos;
+      } else if (next < pos + distance_) {
+        prefetch_(next++);
+        issued_++;
+      } else {
+        // Far enough ahead; leave the core to the worker.
+        _mm_pause();
+      }
+    }
+  }
+
+  const uint64_t distance_;
+  const uint64_t end_;
+  const Prefetch prefetch_;
+  uint64_t issued_ = 0;
+  uint64_t skipped_ = 0;
+  alignas(64) std::atomic_uint64_t pos_{0};
+  std::atomic_bool done_{false};
+  std::thread thread_;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_PREFETCH_HELPER_HPP
@@ -0,0 +1,165 @@
+#ifndef UTILS_RADIX_PARTITION_HPP
+#define UTILS_RADIX_PARTITION_HPP
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace kmercounter {
+namespace radix {
+/// Maximum partitioning fanout of a single pass. The write-combining buffers
+/// of all partitions (64 B each) have to stay in L1/L2.
+constexpr uint32_t MAX_BITS = 12;
+
+inline uint32_t hash(uint64_t key) {
+  return _mm_crc32_u64(0xffffffff, key);
+}
+
+/// A hash independent of `hash`, which is also the CRC32 that the hashtables
+/// pick slots with. Keys that are inserted into a table after partitioning
+/// are partitioned by it, or the keys of a partition would crowd into the
+/// slots that share those bits.
+inline uint32_t mix(uint64_t key) {
+  // fmix64 of MurmurHash3.
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ull;
+  key ^= key >> 33;
+  return key >> 32;
+}
+
+/// Partitions are picked by the high bits of the hash.
+inline uint32_t partition_of(uint32_t hash, uint32_t bits) {
+  return bits == 0 ? 0 : hash >> (32 - bits);
+}
+
+/// Number of partition bits for `num_keys` keys counted by `num_threads`
+/// threads, so that the table of a partition stays within `table_bytes`
+/// while every thread gets a few partitions.
+inline uint32_t choose_bits(uint64_t num_keys, uint32_t num_threads,
+                            uint64_t table_bytes) {
+  // Tables are at most half full and hold 16 byte slots.
+  const uint64_t keys_per_partition = std::max<uint64_t>(table_bytes / 32, 1);
+  const uint64_t by_size = std::bit_width(
+      std::bit_ceil((num_keys + keys_per_partition - 1) / keys_per_partition) -
+      1);
+  const uint64_t by_threads =
+      std::bit_width(std::bit_ceil(4 * uint64_t(num_threads)) - 1);
+  return std::min<uint64_t>(std::max(by_size, by_threads), MAX_BITS);
+}
+
+/// Pass one: count the keys of each of the `1 << bits` partitions into
+/// `histogram`.
+inline void histogram(std::span<const uint64_t> keys, uint32_t bits,
+                      uint64_t *histogram) {
+  std::fill(histogram, histogram + (1ull << bits), 0);
+  for (const auto key : keys) {
+    histogram[partition_of(hash(key), bits)]++;
+  }
+}
+
+/// Pass two: scatter keys to their partitions with software write-combining.
+/// Keys are staged in a cache line per partition, which is written out with
+/// non-temporal stores once full. The output of partition p starts at
+/// `out + offsets[p]`.
+class Scatter {
+ public:
+  static constexpr size_t LINE_KEYS = 64 / sizeof(uint64_t);
+
+  Scatter(uint32_t bits, uint64_t *out, std::vector<uint64_t> offsets)
+      : bits_(bits),
+        out_(out),
+        next_(std::move(offsets)),
+        lines_(1ull << bits),
+        fill_(1ull << bits, 0) {}
+
+  ~Scatter() { this->flush(); }
+
+  void push(uint64_t key) {
+    const uint32_t p = partition_of(hash(key), bits_);
+    lines_[p].keys[fill_[p]] = key;
+    if (++fill_[p] == LINE_KEYS) {
+      uint64_t *dst = out_ + next_[p];
+      for (size_t i = 0; i < LINE_KEYS; i++) {
+        _mm_stream_si64(reinterpret_cast<long long *>(dst + i),
+                        lines_[p].keys[i]);
+      }
+      next_[p] += LINE_KEYS;
+      fill_[p] = 0;
+    }
+  }
+
+  /// Write out the partially filled lines.
+  void flush() {
+    for (size_t p = 0; p < lines_.size(); p++) {
+      std::copy_n(lines_[p].keys, fill_[p], out_ + next_[p]);
+      next_[p] += fill_[p];
+      fill_[p] = 0;
+    }
+    _mm_sfence();
+  }
+
+ private:
+  struct alignas(64) Line {
+    uint64_t keys[LINE_KEYS];
+  };
+
+  uint32_t bits_;
+  uint64_t *out_;
+  std::vector<uint64_t> next_;
+  std::vector<Line> lines_;
+  std::vector<uint8_t> fill_;
+};
+
+/// Count the keys of a partition in an open addressing table sized for the
+/// partition, i.e., a cache sized one with sensible partitioning.
+class PartitionCounter {
+ public:
+  /// Call `emit(key, count)` for each distinct key of `keys`.
+  template <typename Fn>
+  void count(std::span<const uint64_t> keys, Fn &&emit) {
+    const size_t capacity = std::bit_ceil(std::max<size_t>(2 * keys.size(), 16));
+    if (slots_.size() < capacity) {
+      slots_.resize(capacity);
+    }
+    std::fill_n(slots_.begin(), capacity, Slot{});
+    const size_t mask = capacity - 1;
+    const uint32_t shift = 64 - std::bit_width(mask);
+
+    for (const auto key : keys) {
+      // All the keys of a partition share the high bits of `hash`, so the
+      // slot comes from another hash.
+      size_t i = (key * 0x9E3779B97F4A7C15ull) >> shift;
+      while (slots_[i].count != 0 && slots_[i].key != key) {
+        i = (i + 1) & mask;
+      }
+      slots_[i].key = key;
+      slots_[i].count++;
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+      if (slots_[i].count != 0) {
+        emit(slots_[i].key, slots_[i].count);
+      }
+    }
+  }
+
+  size_t capacity() const { return slots_.size(); }
+
+ private:
+  struct Slot {
+    uint64_t key;
+    uint64_t count;
+  };
+  std::vector<Slot> slots_;
+};
+}  // namespace radix
+}  // namespace kmercounter
+
+#endif  // UTILS_RADIX_PARTITION_HPP
@@ -0,0 +1,138 @@
+#ifndef UTILS_SINGLETON_FILTER_HPP
+#define UTILS_SINGLETON_FILTER_HPP
+
+#include <immintrin.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+#include "plog/Log.h"
+
+namespace kmercounter {
+/// A concurrent blocked bloom filter that lets a key through to the table
+/// only from its second sighting on, so that the singletons, mostly
+/// sequencing errors, never take a slot.
+/// A key maps to one cache line and to two words in it: one with the bits of
+/// the first sighting and one with those of the promotion. Each word holds
+/// all `BITS_PER_KEY` bits of the key, so a stage is a single atomic OR and
+/// exactly one thread promotes a key.
+class SingletonFilter {
+ public:
+  enum class Sighting {
+    /// Not seen before; drop it.
+    First,
+    /// Seen once before; insert it for the first sighting as well.
+    Second,
+    /// Insert it as usual.
+    Repeat,
+  };
+
+  static constexpr uint32_t BITS_PER_KEY = 4;
+  static constexpr uint64_t WORDS_PER_BLOCK = 8;
+  static constexpr uint64_t BLOCK_BYTES = WORDS_PER_BLOCK * sizeof(uint64_t);
+  /// Keys hashed and prefetched ahead of testing them in `see_batch`.
+  static constexpr size_t BATCH = 16;
+
+  explicit SingletonFilter(uint64_t bytes)
+      : num_blocks_(std::max<uint64_t>(bytes / BLOCK_BYTES, 1)) {
+    const uint64_t size = num_blocks_ * BLOCK_BYTES;
+    // Anonymous memory is zeroed and page aligned, as madvise needs.
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+      PLOG_ERROR << "Failed to allocate a " << size
+                 << " byte singleton filter: " << strerror(errno);
+      exit(-1);
+    }
+    blocks_ = static_cast<uint64_t *>(mem);
+    // Transparent huge pages are only a hint; the filter works without.
+    if (madvise(blocks_, size, MADV_HUGEPAGE) != 0) {
+      PLOG_DEBUG << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno);
+    }
+  }
+
+  SingletonFilter(const SingletonFilter &) = delete;
+  SingletonFilter &operator=(const SingletonFilter &) = delete;
+
+  ~SingletonFilter() { munmap(blocks_, this->size_bytes()); }
+
+  uint64_t size_bytes() const { return num_blocks_ * BLOCK_BYTES; }
+
+  Sighting see(uint64_t key) { return this->see_hashed(hash(key)); }
+
+  /// Call `fn(key, sighting)` for each of `keys`, prefetching the blocks of
+  /// a batch of keys before testing any of them.
+  template <typename Fn>
+  void see_batch(std::span<const uint64_t> keys, Fn &&fn) {
+    uint64_t hashes[BATCH];
+    for (size_t i = 0; i < keys.size(); i += BATCH) {
+      const size_t n = std::min(BATCH, keys.size() - i);
+      for (size_t j = 0; j < n; j++) {
+        hashes[j] = hash(keys[i + j]);
+        _mm_prefetch(reinterpret_cast<const char *>(this->block(hashes[j])),
+                     _MM_HINT_T0);
+      }
+      for (size_t j = 0; j < n; j++) {
+        fn(keys[i + j], this->see_hashed(hashes[j]));
+      }
+    }
+  }
+
+  static uint64_t hash(uint64_t key) {
+    // fmix64 of MurmurHash3.
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+  }
+
+ private:
+  uint64_t *block(uint64_t hash) const {
+    // The high half picks the block; the low half the words and bits.
+    const uint64_t idx = ((hash >> 32) * num_blocks_) >> 32;
+    return blocks_ + idx * WORDS_PER_BLOCK;
+  }
+
+  Sighting see_hashed(uint64_t hash) {
+    uint64_t *block = this->block(hash);
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < BITS_PER_KEY; i++) {
+      mask |= 1ull << ((hash >> (6 * i)) & 63);
+    }
+    // Words of the two stages, always different ones.
+    const uint64_t first = (hash >> 24) & (WORDS_PER_BLOCK - 1);
+    const uint64_t second =
+        (first + 1 + (hash >> 27) % (WORDS_PER_BLOCK - 1)) &
+        (WORDS_PER_BLOCK - 1);
+
+    // Test before setting so that repeats do not write the line.
+    if (!set(&block[first], mask)) {
+      return Sighting::First;
+    }
+    if (!set(&block[second], mask)) {
+      return Sighting::Second;
+    }
+    return Sighting::Repeat;
+  }
+
+  /// Set `mask` in `*word`; return whether it was set already.
+  static bool set(uint64_t *word, uint64_t mask) {
+    if ((__atomic_load_n(word, __ATOMIC_RELAXED) & mask) == mask) {
+      return true;
+    }
+    return (__atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask) == mask;
+  }
+
+  uint64_t num_blocks_;
+  uint64_t *blocks_;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_SINGLETON_FILTER_HPP
@@ -0,0 +1,148 @@
+#ifndef UTILS_SPILL_BUCKETS_HPP
+#define UTILS_SPILL_BUCKETS_HPP
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "plog/Log.h"
+
+namespace kmercounter {
+/// A set of on-disk buckets of items, e.g., keys, one file per bucket, shared
+/// by all threads. Writers reserve a range of a bucket at a time, so appends
+/// from different threads are large sequential writes that do not serialize.
+/// Files are named `<dir>/<prefix><bucket>`.
+template <typename T = uint64_t>
+class SpillBuckets {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ public:
+  SpillBuckets(const std::string &dir, uint32_t num_buckets,
+               const std::string &prefix = "bucket-")
+      : sizes_(num_buckets) {
+    for (uint32_t b = 0; b < num_buckets; b++) {
+      const std::string path = dir + "/" + prefix + std::to_string(b);
+      const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+      PLOG_FATAL_IF(fd < 0)
+          << "Failed to open spill file " << path << ": " << strerror(errno);
+      // Nothing has to survive the run.
+      unlink(path.c_str());
+      fds_.push_back(fd);
+    }
+  }
+
+  SpillBuckets(const SpillBuckets &) = delete;
+  SpillBuckets &operator=(const SpillBuckets &) = delete;
+
+  ~SpillBuckets() {
+    for (const auto fd : fds_) {
+      close(fd);
+    }
+  }
+
+  uint32_t num_buckets() const { return fds_.size(); }
+
+  /// Number of items in `bucket`; final once all writers are flushed.
+  uint64_t size(uint32_t bucket) const {
+    return sizes_[bucket].load(std::memory_order_relaxed);
+  }
+
+  void append(uint32_t bucket, std::span<const T> items) {
+    const uint64_t at =
+        sizes_[bucket].fetch_add(items.size(), std::memory_order_relaxed);
+    this->pio(pwrite, bucket, const_cast<T *>(items.data()), items.size(), at);
+  }
+
+  /// Read the items [`begin`, `begin + items.size()`) of `bucket`.
+  void read(uint32_t bucket, uint64_t begin, std::span<T> items) const {
+    this->pio(pread, bucket, items.data(), items.size(), begin);
+  }
+
+  /// Hint the kernel to read ahead the items [`begin`, `end`) of `bucket`.
+  void prefetch(uint32_t bucket, uint64_t begin, uint64_t end) const {
+    posix_fadvise(fds_[bucket], begin * sizeof(T), (end - begin) * sizeof(T),
+                  POSIX_FADV_WILLNEED);
+  }
+
+  /// Drop the pages of `bucket` once they are consumed.
+  void release(uint32_t bucket, uint64_t begin, uint64_t end) const {
+    posix_fadvise(fds_[bucket], begin * sizeof(T), (end - begin) * sizeof(T),
+                  POSIX_FADV_DONTNEED);
+  }
+
+ private:
+  template <typename Fn>
+  void pio(Fn &&fn, uint32_t bucket, T *items, uint64_t num_items,
+           uint64_t at) const {
+    auto *buf = reinterpret_cast<char *>(items);
+    uint64_t left = num_items * sizeof(T);
+    uint64_t offset = at * sizeof(T);
+    while (left > 0) {
+      const ssize_t ret = fn(fds_[bucket], buf, left, offset);
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ret <= 0) {
+        PLOG_FATAL << "Spill I/O on bucket " << bucket << " failed: "
+                   << (ret < 0 ? strerror(errno) : "end of file");
+        std::abort();
+      }
+      buf += ret;
+      offset += ret;
+      left -= ret;
+    }
+  }
+
+  std::vector<int> fds_;
+  std::vector<std::atomic_uint64_t> sizes_;
+};
+
+/// Per-thread staging of the items of each bucket, handed to `SpillBuckets` a
+/// buffer at a time.
+template <typename T = uint64_t>
+class SpillWriter {
+ public:
+  SpillWriter(SpillBuckets<T> &buckets, uint64_t items_per_buffer)
+      : buckets_(buckets),
+        items_per_buffer_(items_per_buffer),
+        buffers_(new T[buckets.num_buckets() * items_per_buffer]),
+        fill_(buckets.num_buckets(), 0) {}
+
+  ~SpillWriter() { this->flush(); }
+
+  void push(uint32_t bucket, const T &item) {
+    T *buffer = &buffers_[bucket * items_per_buffer_];
+    buffer[fill_[bucket]] = item;
+    if (++fill_[bucket] == items_per_buffer_) {
+      buckets_.append(bucket, {buffer, items_per_buffer_});
+      fill_[bucket] = 0;
+    }
+  }
+
+  void flush() {
+    for (uint32_t b = 0; b < fill_.size(); b++) {
+      if (fill_[b] > 0) {
+        buckets_.append(b, {&buffers_[b * items_per_buffer_], fill_[b]});
+        fill_[b] = 0;
+      }
+    }
+  }
+
+ private:
+  SpillBuckets<T> &buckets_;
+  uint64_t items_per_buffer_;
+  std::unique_ptr<T[]> buffers_;
+  std::vector<uint64_t> fill_;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_SPILL_BUCKETS_HPP
@@ -0,0 +1,118 @@
+#ifndef UTILS_SPIN_BARRIER_HPP
+#define UTILS_SPIN_BARRIER_HPP
+
+#include <x86intrin.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+/// A sense-reversing spin barrier, in two levels: the threads of a NUMA node
+/// meet on a counter of their node, and the last of them, the node's leader,
+/// meets the other leaders on a global one. The last leader runs the
+/// completion, if any, and flips the global sense; each leader then flips the
+/// sense of its node. A waiting thread spins on a cache line of its own node,
+/// and only the leaders touch the global one, once per phase.
+/// Participants are numbered 0..n-1 and say who they are when they arrive;
+/// the barrier keeps the cycles each one has waited, to show the imbalance
+/// between threads.
+class SpinBarrier {
+ public:
+  /// `nodes[i]` is the node of participant i.
+  explicit SpinBarrier(const std::vector<uint32_t> &nodes,
+                       std::function<void()> on_completion = {})
+      : slots_(nodes.size()), on_completion_(std::move(on_completion)) {
+    std::vector<uint32_t> group_of_node;
+    for (uint32_t i = 0; i < nodes.size(); i++) {
+      if (nodes[i] >= group_of_node.size()) {
+        group_of_node.resize(nodes[i] + 1, UINT32_MAX);
+      }
+      if (group_of_node[nodes[i]] == UINT32_MAX) {
+        group_of_node[nodes[i]] = num_groups_++;
+      }
+      slots_[i].group = group_of_node[nodes[i]];
+    }
+    groups_ = std::vector<Group>(num_groups_);
+    for (const auto &slot : slots_) {
+      groups_[slot.group].size++;
+    }
+  }
+
+  /// A single level, for threads on one node or when it does not matter.
+  explicit SpinBarrier(uint32_t num_threads,
+                       std::function<void()> on_completion = {})
+      : SpinBarrier(std::vector<uint32_t>(num_threads, 0),
+                    std::move(on_completion)) {}
+
+  SpinBarrier(const SpinBarrier &) = delete;
+  SpinBarrier &operator=(const SpinBarrier &) = delete;
+
+  uint32_t num_threads() const { return slots_.size(); }
+
+  /// Arrive as participant `tid` and wait for the others.
+  void arrive_and_wait(uint32_t tid) {
+    const uint64_t start = __rdtsc();
+    Group &g = groups_[slots_[tid].group];
+    const bool sense = g.sense.load(std::memory_order_acquire);
+    if (g.count.fetch_add(1, std::memory_order_acq_rel) + 1 == g.size) {
+      // Reset before the flip, which lets the node in again.
+      g.count.store(0, std::memory_order_relaxed);
+      const bool top = top_sense_.load(std::memory_order_acquire);
+      if (top_count_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+          num_groups_) {
+        top_count_.store(0, std::memory_order_relaxed);
+        if (on_completion_) {
+          on_completion_();
+        }
+        top_sense_.store(!top, std::memory_order_release);
+      } else {
+        spin_while(top_sense_, top);
+      }
+      g.sense.store(!sense, std::memory_order_release);
+    } else {
+      spin_while(g.sense, sense);
+    }
+    slots_[tid].wait_cycles += __rdtsc() - start;
+  }
+
+  /// Cycles participant `tid` has waited so far.
+  uint64_t wait_cycles(uint32_t tid) const { return slots_[tid].wait_cycles; }
+
+ private:
+  /// Pause between polls; give the CPU away now and then, in case the
+  /// threads outnumber the CPUs.
+  static void spin_while(const std::atomic_bool &flag, bool value) {
+    for (uint32_t spins = 1; flag.load(std::memory_order_acquire) == value;
+         spins++) {
+      if (spins % (1u << 14) == 0) {
+        std::this_thread::yield();
+      } else {
+        _mm_pause();
+      }
+    }
+  }
+
+  struct Group {
+    alignas(64) std::atomic_uint32_t count{0};
+    uint32_t size = 0;
+    alignas(64) std::atomic_bool sense{false};
+  };
+
+  struct alignas(64) Slot {
+    uint32_t group;
+    uint64_t wait_cycles = 0;
+  };
+
+  std::vector<Slot> slots_;
+  std::vector<Group> groups_;
+  uint32_t num_groups_ = 0;
+  std::function<void()> on_completion_;
+  alignas(64) std::atomic_uint32_t top_count_{0};
+  alignas(64) std::atomic_bool top_sense_{false};
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_SPIN_BARRIER_HPP
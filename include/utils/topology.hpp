@@ -0,0 +1,224 @@
+#ifndef UTILS_TOPOLOGY_HPP
+#define UTILS_TOPOLOGY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace kmercounter {
+/// Where a CPU sits in the machine. Cores and L3 domains are named by their
+/// lowest CPU, since core ids repeat across packages.
+struct CpuPlace {
+  uint32_t cpu;
+  uint32_t node;
+  uint32_t package;
+  uint32_t core;
+  uint32_t l3;
+};
+
+/// The online CPUs, as sysfs describes them under `root`: the package, the
+/// physical core and its SMT siblings, the L3 domain and the NUMA node of
+/// each. CPU lists are read as text ("0-3,128-131"), so there is no bound on
+/// the number of CPUs.
+/// The placements walk the cores node by node, L3 domain by L3 domain, so
+/// that threads next to each other in a list share as much cache as they
+/// can.
+class CpuTopology {
+ public:
+  explicit CpuTopology(const std::string &root = "/sys/devices/system/cpu") {
+    for (uint32_t cpu : parse_cpulist(read_line(root + "/online"))) {
+      const std::string dir = root + "/cpu" + std::to_string(cpu);
+      CpuPlace p{cpu, node_of(dir), 0, cpu, cpu};
+      read_uint(dir + "/topology/physical_package_id", p.package);
+      const auto siblings =
+          parse_cpulist(read_line(dir + "/topology/thread_siblings_list"));
+      if (!siblings.empty()) p.core = siblings.front();
+      p.l3 = l3_of(dir, p.core);
+      places_.push_back(p);
+    }
+
+    // Cores in order of node, L3 domain and lowest CPU.
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, std::vector<uint32_t>>
+        cores;
+    for (const auto &p : places_) {
+      cores[{p.node, p.l3, p.core}].push_back(p.cpu);
+    }
+    for (auto &[key, threads] : cores) {
+      std::sort(threads.begin(), threads.end());
+      cores_.push_back(threads);
+      core_l3_.push_back(std::get<1>(key));
+    }
+  }
+
+  const std::vector<CpuPlace> &places() const { return places_; }
+
+  /// Hardware threads of every physical core.
+  const std::vector<std::vector<uint32_t>> &cores() const { return cores_; }
+
+  uint32_t num_l3_domains() const { return l3_domains().size(); }
+
+  /// Another hardware thread of the core of `cpu`, if it has one.
+  std::optional<uint32_t> sibling_of(uint32_t cpu) const {
+    for (const auto &threads : cores_) {
+      if (std::find(threads.begin(), threads.end(), cpu) == threads.end())
+        continue;
+      for (uint32_t t : threads) {
+        if (t != cpu) return t;
+      }
+    }
+    return std::nullopt;
+  }
+
+  /// The first `n` CPUs to use: one thread of every physical core, and only
+  /// then their SMT siblings. Fewer if the machine has fewer.
+  std::vector<uint32_t> fill_cores(uint32_t n) const {
+    return take(fill_order(all_cores()), n);
+  }
+
+  /// Up to `n` pairs of SMT siblings, one pair per physical core, for a
+  /// producer and a consumer to share the L1 and L2 of the core.
+  std::vector<std::pair<uint32_t, uint32_t>> smt_pairs(uint32_t n) const {
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (const auto &threads : cores_) {
+      if (pairs.size() == n) break;
+      if (threads.size() >= 2) pairs.emplace_back(threads[0], threads[1]);
+    }
+    return pairs;
+  }
+
+  /// Up to `n` CPUs, one per L3 domain in turn, physical cores first within
+  /// a domain.
+  std::vector<uint32_t> spread_l3(uint32_t n) const {
+    std::vector<std::vector<uint32_t>> domains;
+    for (uint32_t l3 : l3_domains()) {
+      std::vector<uint32_t> in_domain;
+      for (uint32_t c = 0; c < cores_.size(); c++) {
+        if (core_l3_[c] == l3) in_domain.push_back(c);
+      }
+      domains.push_back(fill_order(in_domain));
+    }
+    std::vector<uint32_t> cpus;
+    for (uint32_t round = 0; cpus.size() < n; round++) {
+      bool any = false;
+      for (const auto &d : domains) {
+        if (round < d.size() && cpus.size() < n) {
+          cpus.push_back(d[round]);
+          any = true;
+        }
+      }
+      if (!any) break;
+    }
+    return cpus;
+  }
+
+  /// Parse a sysfs CPU list such as "0-3,8,10-11".
+  static std::vector<uint32_t> parse_cpulist(const std::string &list) {
+    std::vector<uint32_t> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+      if (range.empty() || range == "\n") continue;
+      const auto dash = range.find('-');
+      try {
+        const uint32_t lo = std::stoul(range.substr(0, dash));
+        const uint32_t hi =
+            dash == std::string::npos ? lo : std::stoul(range.substr(dash + 1));
+        for (uint32_t c = lo; c <= hi; c++) cpus.push_back(c);
+      } catch (const std::exception &) {
+        // Not a range; skip it.
+      }
+    }
+    return cpus;
+  }
+
+ private:
+  static std::string read_line(const std::string &path) {
+    std::ifstream f(path);
+    std::string line;
+    std::getline(f, line);
+    return line;
+  }
+
+  static bool read_uint(const std::string &path, uint32_t &value) {
+    std::ifstream f(path);
+    return static_cast<bool>(f >> value);
+  }
+
+  /// sysfs links each CPU to its node as cpuN/nodeM.
+  static uint32_t node_of(const std::string &dir) {
+    std::error_code ec;
+    for (const auto &e : std::filesystem::directory_iterator(dir, ec)) {
+      const std::string name = e.path().filename().string();
+      if (name.size() > 4 && name.compare(0, 4, "node") == 0) {
+        try {
+          return std::stoul(name.substr(4));
+        } catch (const std::exception &) {
+        }
+      }
+    }
+    return 0;
+  }
+
+  /// The lowest CPU sharing the level 3 cache, or `core` if there is none.
+  static uint32_t l3_of(const std::string &dir, uint32_t core) {
+    std::error_code ec;
+    for (const auto &e :
+         std::filesystem::directory_iterator(dir + "/cache", ec)) {
+      const std::string index = e.path().string();
+      uint32_t level;
+      if (!read_uint(index + "/level", level) || level != 3) continue;
+      const auto shared = parse_cpulist(read_line(index + "/shared_cpu_list"));
+      if (!shared.empty()) return shared.front();
+    }
+    return core;
+  }
+
+  std::vector<uint32_t> all_cores() const {
+    std::vector<uint32_t> all(cores_.size());
+    for (uint32_t c = 0; c < all.size(); c++) all[c] = c;
+    return all;
+  }
+
+  std::vector<uint32_t> l3_domains() const {
+    std::vector<uint32_t> domains;
+    for (uint32_t l3 : core_l3_) {
+      if (std::find(domains.begin(), domains.end(), l3) == domains.end()) {
+        domains.push_back(l3);
+      }
+    }
+    return domains;
+  }
+
+  /// The first thread of each of `cores`, then the second, and so on.
+  std::vector<uint32_t> fill_order(const std::vector<uint32_t> &cores) const {
+    std::vector<uint32_t> cpus;
+    for (uint32_t t = 0;; t++) {
+      const size_t before = cpus.size();
+      for (uint32_t c : cores) {
+        if (t < cores_[c].size()) cpus.push_back(cores_[c][t]);
+      }
+      if (cpus.size() == before) return cpus;
+    }
+  }
+
+  static std::vector<uint32_t> take(std::vector<uint32_t> cpus, uint32_t n) {
+    if (cpus.size() > n) cpus.resize(n);
+    return cpus;
+  }
+
+  std::vector<CpuPlace> places_;
+  std::vector<std::vector<uint32_t>> cores_;
+  /// The L3 domain of every core in `cores_`.
+  std::vector<uint32_t> core_l3_;
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_TOPOLOGY_HPP
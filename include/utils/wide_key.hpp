@@ -0,0 +1,86 @@
+#ifndef UTILS_WIDE_KEY_HPP
+#define UTILS_WIDE_KEY_HPP
+
+#include <immintrin.h>
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+namespace kmercounter {
+/// A key of `N` 64-bit words, for keys that do not fit in a `uint64_t`, e.g.,
+/// KMers with K > 32.
+/// Word 0 holds the least significant bits, so a key constructed from a
+/// `uint64_t` compares equal to the same narrow key zero extended.
+template <size_t N>
+struct alignas(16) WideKey {
+  static_assert(N == 2 || N == 4, "Only 128-bit and 256-bit keys");
+
+  uint64_t words[N];
+
+  // Trivial, like the narrow key, so that tables of keys can be cleared
+  // with memset and packed in the KV structs.
+  WideKey() = default;
+  // Implicit so that the narrow key generators and the empty key (0) work
+  // unchanged.
+  constexpr WideKey(uint64_t low) : words{low} {}
+
+  /// The least significant word; enough for hashing into partitions and
+  /// for printing narrow keys.
+  explicit constexpr operator uint64_t() const { return words[0]; }
+
+  uint64_t low() const { return words[0]; }
+
+  /// Compare all words at once.
+  /// Keys embedded in packed structs may be unaligned, hence the unaligned
+  /// loads.
+  bool operator==(const WideKey &other) const {
+    if constexpr (N == 2) {
+      const __m128i a =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(words));
+      const __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(other.words));
+      return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+    } else {
+#if defined(__AVX2__)
+      const __m256i a =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words));
+      const __m256i b =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(other.words));
+      return _mm256_testc_si256(_mm256_cmpeq_epi64(a, b),
+                                _mm256_set1_epi64x(-1));
+#else
+      return memcmp(words, other.words, sizeof(words)) == 0;
+#endif
+    }
+  }
+
+  bool operator!=(const WideKey &other) const { return !(*this == other); }
+
+  /// Order as one unsigned integer.
+  bool operator<(const WideKey &other) const {
+    for (size_t i = N; i-- > 0;) {
+      if (words[i] != other.words[i]) {
+        return words[i] < other.words[i];
+      }
+    }
+    return false;
+  }
+
+  /// Print the words, most significant first.
+  friend std::ostream &operator<<(std::ostream &os, const WideKey &key) {
+    const auto flags = os.flags();
+    os << std::hex;
+    for (size_t i = N; i-- > 0;) {
+      os << key.words[i] << (i ? ":" : "");
+    }
+    os.flags(flags);
+    return os;
+  }
+};
+
+static_assert(sizeof(WideKey<2>) == 16);
+static_assert(sizeof(WideKey<4>) == 32);
+}  // namespace kmercounter
+
+#endif  // UTILS_WIDE_KEY_HPP
@@ -0,0 +1,109 @@
+#ifndef UTILS_WORKER_POOL_HPP
+#define UTILS_WORKER_POOL_HPP
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+/// Threads pinned to a list of CPUs, created once and handed one job after
+/// another, so that the phases and repetitions of a run pay for thread
+/// creation and pinning once.
+/// A worker pins itself before it runs anything, so what it first touches
+/// is allocated on the node of its CPU, as with a freshly spawned thread.
+/// Between jobs the workers sleep in an atomic wait.
+/// The calling thread takes part in every job, as its last index.
+class WorkerPool {
+ public:
+  using Job = std::function<void(uint32_t)>;
+
+  explicit WorkerPool(const std::vector<uint32_t> &cpus) : cpus_(cpus) {
+    for (uint32_t i = 0; i < cpus_.size(); i++) {
+      threads_.emplace_back(&WorkerPool::worker, this, i);
+    }
+  }
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  ~WorkerPool() {
+    this->post(EXIT);
+    for (auto &t : threads_) {
+      t.join();
+    }
+  }
+
+  /// Workers, not counting the calling thread.
+  uint32_t size() const { return cpus_.size(); }
+
+  uint32_t cpu_of(uint32_t i) const { return cpus_[i]; }
+
+  /// Run `job(i)` on workers 0 to n - 2 and `job(n - 1)` on the calling
+  /// thread, and return once they are all done; the other workers sleep
+  /// through it. Needs 1 <= n <= size() + 1.
+  void run(uint32_t n, const Job &job) {
+    job_ = &job;
+    pending_.store(n - 1, std::memory_order_relaxed);
+    this->post(n - 1);
+
+    job(n - 1);
+
+    for (uint32_t left; (left = pending_.load(std::memory_order_acquire));) {
+      pending_.wait(left, std::memory_order_acquire);
+    }
+    job_ = nullptr;
+  }
+
+ private:
+  void worker(uint32_t i) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpus_[i], &cpuset);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+
+    uint64_t seen = 0;
+    for (;;) {
+      // A worker that wakes late may skip a job, but only one it has no
+      // part in: a job is not over until its workers are done.
+      generation_.wait(seen, std::memory_order_acquire);
+      seen = generation_.load(std::memory_order_acquire);
+      const uint32_t active = seen;
+      if (active == EXIT) {
+        return;
+      }
+      if (i < active) {
+        (*job_)(i);
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          pending_.notify_one();
+        }
+      }
+    }
+  }
+
+  static constexpr uint32_t EXIT = UINT32_MAX;
+
+  /// Start the next generation, with `active` workers in it.
+  void post(uint32_t active) {
+    const uint64_t next =
+        (generation_.load(std::memory_order_relaxed) >> 32) + 1;
+    generation_.store(next << 32 | active, std::memory_order_release);
+    generation_.notify_all();
+  }
+
+  std::vector<uint32_t> cpus_;
+  std::vector<std::thread> threads_;
+  // Written before a generation starts, read by its workers.
+  const Job *job_ = nullptr;
+  /// The generation count in the upper half, the workers it runs on in the
+  /// lower one.
+  alignas(64) std::atomic_uint64_t generation_{0};
+  alignas(64) std::atomic_uint32_t pending_{0};
+};
+}  // namespace kmercounter
+
+#endif  // UTILS_WORKER_POOL_HPP
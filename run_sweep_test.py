@@ -85,6 +85,21 @@ def dumplog(log_dir: str):
             csv.write(format_str + '\n')
 
 
+def run_in_process(build_dir: str, run_args: typing.List[str], args: argparse.Namespace):
+    # One process runs every thread count and leaves a log per count, as the
+    # runs of a process each would.
+    sweep_args = run_args + [f'--num-threads={NPROC}', f'--sweep-threads={",".join(str(n) for n in range(1, NPROC + 1))}']
+    sweep_args += get_additional_args(NPROC, args)
+    logfile = build_dir.parent.joinpath('sweep.log')
+    print(f'Running the sweep in one process with {sweep_args}', flush=True)
+    run_synchronous(build_dir, './dramhit', sweep_args, os.open(logfile, os.O_RDWR | os.O_CREAT | os.O_TRUNC))
+    with open(logfile) as log:
+        points = re.split(r'^Sweep point: (\d+) threads, run \d+$', log.read(), flags=re.MULTILINE)
+    for n, text in zip(points[1::2], points[2::2]):
+        with open(build_dir.parent.joinpath(f'{n}.log'), 'w') as out:
+            out.write(text)
+    dumplog(build_dir)
+
 def run_partitioned_with_queues(build_dir: str, args: argparse.Namespace):
     print('Running partitioned', flush=True)
     for n in range(1, 33):
@@ -97,6 +112,9 @@ def run_partitioned_with_queues(build_dir: str, args: argparse.Namespace):
 
 def run_partitioned_no_queues(build_dir: str, args: argparse.Namespace):
     print('Running partitioned without queues', flush=True)
+    if args.in_process:
+        run_in_process(build_dir, ['--ht-type=1', '--numa-split=1'] + ([] if args.skew else ['--mode=6']), args)
+        return
     for n in range(1, NPROC + 1):
         partitioned_args = [f'--num-threads={n}', '--ht-type=1', '--numa-split=1']
         if not args.skew:
@@ -109,6 +127,9 @@ def run_partitioned_no_queues(build_dir: str, args: argparse.Namespace):
 
 def run_cashtpp(build_dir: str, args: argparse.Namespace):
     print(f'Running cashtpp', flush=True)
+    if args.in_process:
+        run_in_process(build_dir, ['--ht-type=3', '--numa-split=1'] + ([] if args.skew else ['--mode=6']), args)
+        return
     for n in range(1, NPROC + 1):
         cashtpp_args = [f'--num-threads={n}', '--ht-type=3', '--numa-split=1']
         if not args.skew:
@@ -142,6 +163,7 @@ if __name__ == '__main__':
     parser.add_argument('--skew', nargs='?', type=float, help='Skew for zipfian')
     parser.add_argument('--bq', action='store_true', help='Enable prodcuer/consumer with partitioned HT')
     parser.add_argument('--no_prefetch', action='store_true', default=False, help='Disable prefetch engine')
+    parser.add_argument('--in_process', action='store_true', default=False, help='Run all thread counts in one process')
 
     args = parser.parse_args()
 
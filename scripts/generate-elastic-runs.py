@@ -0,0 +1,16 @@
+#!/bin/env python3
+
+# Run the RW ratio mix at a fixed arrival rate with bursts, served by a pool
+# of workers that grows and shrinks with the load, for a few rates and read
+# shares; compare the cycles per op with the closed-loop run of all threads.
+# usage: generate-elastic-runs.py <num-threads> <skew> | sh -x
+
+import sys
+
+threads = int(sys.argv[1])
+skew = float(sys.argv[2])
+for n in range(3):
+    for pread in [0.5, 0.9]:
+        print(f'./dramhit --ht-type=3 --mode=12 --num-threads={threads} --skew={skew} --p-read={pread} > closed-{pread}-{n}')
+        for rate in [10, 50, 200]:
+            print(f'./dramhit --ht-type=3 --mode=12 --num-threads={threads} --skew={skew} --p-read={pread} --elastic-rate={rate} > elastic-{pread}-{rate}-{n}')
@@ -0,0 +1,18 @@
+#!/bin/env python3
+
+# Run the zipfian test on the same physical cores three ways: one worker per
+# core with a prefetching helper on its SMT sibling, for a few distances; two
+# workers per core with the in-thread prefetch queue; and two workers per core
+# without prefetching. Physical cores are filled before siblings
+# (--numa-split=4), so <num-cores> workers leave the siblings to the helpers.
+# usage: generate-helper-runs.py <num-cores> <skew> | sh -x
+
+import sys
+
+cores = int(sys.argv[1])
+skew = float(sys.argv[2])
+for n in range(3):
+    for distance in [8, 32, 128]:
+        print(f'./dramhit --ht-type=3 --mode=11 --numa-split=4 --num-threads={cores} --skew={skew} --helper-prefetch={distance} > helper-{distance}-{n}')
+    print(f'./dramhit --ht-type=3 --mode=11 --numa-split=4 --num-threads={2 * cores} --skew={skew} > queue-{n}')
+    print(f'./dramhit --ht-type=3 --mode=11 --numa-split=4 --num-threads={2 * cores} --skew={skew} --no-prefetch=1 > plain-{n}')
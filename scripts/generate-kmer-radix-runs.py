@@ -0,0 +1,16 @@
+#!/bin/env python3
+
+# Compare radix partitioned k-mer counting against inserting directly into
+# the hashtable, across K and datasets of different sizes.
+# usage: generate-kmer-radix-runs.py <num-threads> <fastq>... | sh -x
+
+import os
+import sys
+
+threads = int(sys.argv[1])
+for f in sys.argv[2:]:
+    name = os.path.splitext(os.path.basename(f))[0]
+    for k in [15, 21, 27, 31]:
+        for n in range(3):
+            print(f'./dramhit --ht-type=3 --mode=4 --num-threads={threads} --k={k} --in-file={f} > direct-{name}-{k}-{n}')
+            print(f'./dramhit --ht-type=3 --mode=4 --num-threads={threads} --k={k} --in-file={f} --radix=1 > radix-{name}-{k}-{n}')
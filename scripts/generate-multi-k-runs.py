@@ -0,0 +1,20 @@
+#!/bin/env python3
+
+# Compare a K sweep of one run per K against counting all K in a single pass
+# with --k-list. The single table holds the k-mers of all K, so it gets the
+# sum of the sizes of the separate runs.
+# usage: generate-multi-k-runs.py <num-threads> <ht-size per K> <fastq>... | sh -x
+
+import os
+import sys
+
+threads = int(sys.argv[1])
+ht_size = int(sys.argv[2])
+ks = [15, 19, 21, 25, 27, 31]
+for f in sys.argv[3:]:
+    name = os.path.splitext(os.path.basename(f))[0]
+    for n in range(3):
+        for k in ks:
+            print(f'./dramhit --ht-type=3 --mode=4 --num-threads={threads} --ht-size={ht_size} --k={k} --in-file={f} > sweep-{name}-{k}-{n}')
+        k_list = ','.join(str(k) for k in ks)
+        print(f'./dramhit --ht-type=3 --mode=4 --num-threads={threads} --ht-size={ht_size * len(ks)} --k-list={k_list} --in-file={f} > multi-k-{name}-{n}')
@@ -0,0 +1,18 @@
+#!/bin/env python3
+
+# Compare one partition per consumer with more partitions than consumers,
+# with and without moving them by load between the rounds of inserts.
+# usage: generate-partition-runs.py <num-threads> <skew> | sh -x
+
+import sys
+
+threads = int(sys.argv[1])
+skew = float(sys.argv[2])
+c = threads // 2
+for n in range(3):
+    print(f'./dramhit --ht-type=1 --mode=8 --ht-fill=75 --ncons={c} --nprod={threads - c} --skew={skew} --numa-split=3 --insert-factor=4 > parts-{c}-{n}')
+    for m in [2 * c, 4 * c]:
+        if threads - c + m > 256:
+            continue
+        print(f'./dramhit --ht-type=1 --mode=8 --ht-fill=75 --ncons={c} --nprod={threads - c} --skew={skew} --numa-split=3 --insert-factor=4 --num-partitions={m} > parts-{m}-{n}')
+        print(f'./dramhit --ht-type=1 --mode=8 --ht-fill=75 --ncons={c} --nprod={threads - c} --skew={skew} --numa-split=3 --insert-factor=4 --num-partitions={m} --rebalance=1 > rebalanced-{m}-{n}')
@@ -0,0 +1,17 @@
+#!/bin/env python3
+
+# Compare k-mer counting with and without the singleton filter in front of
+# the table. Both memory (filter + table) and throughput are in the logs.
+# usage: generate-singleton-filter-runs.py <num-threads> <fastq>... | sh -x
+
+import os
+import sys
+
+threads = int(sys.argv[1])
+for f in sys.argv[2:]:
+    name = os.path.splitext(os.path.basename(f))[0]
+    for k in [21, 31]:
+        for n in range(3):
+            print(f'./dramhit --ht-type=3 --mode=4 --num-threads={threads} --k={k} --in-file={f} > nofilter-{name}-{k}-{n}')
+            for mb in [256, 1024]:
+                print(f'./dramhit --ht-type=3 --mode=4 --num-threads={threads} --k={k} --in-file={f} --singleton-filter={mb} > filter{mb}-{name}-{k}-{n}')
@@ -0,0 +1,15 @@
+#!/bin/env python3
+
+# Compare the queue inserts with and without skew-aware routing or
+# producer-side pre-aggregation as the skew grows. Needs a build with -DBQUEUE=ON -DAGGR=ON and zipfian inserts.
+# usage: generate-skew-routing-runs.py <num-threads> | sh -x
+
+import sys
+
+threads = int(sys.argv[1])
+for skew in [0.01, 0.5, 0.9, 0.99, 1.2, 1.5]:
+    for c in [threads // 4, threads // 2]:
+        for n in range(3):
+            print(f'./dramhit --ht-type=1 --mode=8 --ht-fill=75 --ncons={c} --nprod={threads - c} --skew={skew} --numa-split=3 > strict-{skew}-{c}-{n}')
+            print(f'./dramhit --ht-type=1 --mode=8 --ht-fill=75 --ncons={c} --nprod={threads - c} --skew={skew} --numa-split=3 --skew-routing=1 > routed-{skew}-{c}-{n}')
+            print(f'./dramhit --ht-type=1 --mode=8 --ht-fill=75 --ncons={c} --nprod={threads - c} --skew={skew} --numa-split=3 --aggr-buffer=1024 > merged-{skew}-{c}-{n}')
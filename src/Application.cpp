@@ -15,6 +15,8 @@
 #include "./hashtables/cas_kht.hpp"
 #include "./hashtables/simple_kht.hpp"
 #include "./hashtables/array_kht.hpp"
+#include "input_reader/multi_k.hpp"
+#include "input_reader/scheduler.hpp"
 #include "misc_lib.h"
 #include "print_stats.h"
 #include "tests/PrefetchTest.hpp"
@@ -55,7 +57,21 @@ const Configuration def = {
     .ht_file = std::string(""),
     .in_file = std::string("/local/devel/devel/datasets/turkey/myseq0.fa"),
     .in_file_sz = 0,
+    .in_manifest = std::string(""),
     .K = 20,
+    .input_backend = PRELOAD_INPUT,
+    .direct_io = false,
+    .simd_kmer = false,
+    .canonical_kmer = false,
+    .minimizer_len = 0,
+    .radix_kmer = false,
+    .spill_dir = std::string(""),
+    .mem_budget = 4096,
+    .kmer_spectrum = false,
+    .top_k = 10,
+    .singleton_filter = 0,
+    .k_list = std::string(""),
+    .min_quality = 0,
     .num_threads = 1,
     .mode = BQ_TESTS_YES_BQ,  // TODO enum
     .numa_split = 3,
@@ -81,7 +97,17 @@ const Configuration def = {
     .relation_s_size = 128000000,
     .delimitor = "|",
     .rw_queues = false,
-    .pollute_ratio = 0
+    .pollute_ratio = 0,
+    .delegate_finds = false,
+    .skew_routing = false,
+    .aggr_buffer = 0,
+    .num_partitions = 0,
+    .rebalance = false,
+    .elastic_rate = 0,
+    .elastic_burst = 4,
+    .sweep_threads = std::string(""),
+    .sweep_reps = 1,
+    .helper_prefetch = 0
 };  // TODO enum
 
 // for synchronization of threads
@@ -165,7 +191,7 @@ void free_ht(BaseHashTable *kmer_ht) {
   delete kmer_ht;
 }
 
-void Application::shard_thread(int tid, std::barrier<std::function<void()>>* barrier) {
+void Application::shard_thread(int tid, SpinBarrier *barrier) {
   Shard *sh = &this->shards[tid];
   BaseHashTable *kmer_ht = NULL;
 
@@ -174,7 +200,11 @@ void Application::shard_thread(int tid, std::barrier<std::function<void()>>* bar
 
   switch (config.mode) {
     case FASTQ_WITH_INSERT:
-      kmer_ht = init_ht(config.ht_size, sh->shard_idx);
+      // Out-of-core counting allocates a table per round instead, and radix
+      // counting one per partition.
+      if (config.spill_dir.empty() && !config.radix_kmer) {
+        kmer_ht = init_ht(config.ht_size, sh->shard_idx);
+      }
       break;
     case PREFETCH:
       // kmer_ht = new PartitionedHashStore<Prefetch_KV, PrefetchKV_Queue>(
@@ -183,9 +213,15 @@ void Application::shard_thread(int tid, std::barrier<std::function<void()>>* bar
     case SYNTH:
     case RW_RATIO:
     case ZIPFIAN:
-    case HASHJOIN:
     case BQ_TESTS_NO_BQ:
-      kmer_ht = init_ht(config.ht_size, sh->shard_idx);
+      // Allocated by `setup_tables` and kept for the next run of a sweep.
+      kmer_ht = this->tables[tid];
+      break;
+    case HASHJOIN:
+      // The grace join allocates a table per round instead.
+      if (config.spill_dir.empty()) {
+        kmer_ht = init_ht(config.ht_size, sh->shard_idx);
+      }
       break;
     case FASTQ_NO_INSERT:
       break;
@@ -210,7 +246,7 @@ void Application::shard_thread(int tid, std::barrier<std::function<void()>>* bar
 
   switch (config.mode) {
     case SYNTH:
-      this->test.st.synth_run_exec(sh, kmer_ht);
+      this->test.st.synth_run_exec(sh, kmer_ht, barrier);
       break;
     case PREFETCH:
       this->test.pt.prefetch_test_run_exec(sh, config, kmer_ht);
@@ -223,16 +259,51 @@ void Application::shard_thread(int tid, std::barrier<std::function<void()>>* bar
       break;
     case RW_RATIO:
       PLOG_INFO << "Inserting " << HT_TESTS_NUM_INSERTS << " pairs per thread";
-      this->test.rw.run(*sh, *kmer_ht, HT_TESTS_NUM_INSERTS, barrier);
+      if (config.elastic_rate > 0) {
+        this->test.rw.run_elastic(*sh, *kmer_ht, HT_TESTS_NUM_INSERTS,
+                                  barrier);
+      } else {
+        this->test.rw.run(*sh, *kmer_ht, HT_TESTS_NUM_INSERTS, barrier);
+      }
       break;
     case HASHJOIN:
+      if (!config.spill_dir.empty()) {
+        this->test.hj.join_relations_grace(
+            sh, config,
+            [sh](uint64_t sz) { return init_ht(sz, sh->shard_idx); },
+            barrier);
+        goto done;
+      }
       this->test.hj.join_relations_generated(sh, config, kmer_ht, config.materialize, barrier);
       break;
-    // case FASTQ_WITH_INSERT:
-    //   this->test.kmer.count_kmer_radix(sh, config, kmer_ht, barrier);
-    //   break;
     case FASTQ_WITH_INSERT:
+      if (!config.spill_dir.empty()) {
+        // Writes out a file per round
+        this->test.kmer.count_kmer_external(
+            sh, config,
+            [sh](uint64_t sz) { return init_ht(sz, sh->shard_idx); },
+            barrier);
+        goto done;
+      }
+      if (!config.k_list.empty()) {
+        // Keys of the table carry their K; see `MultiKExtractor::tag`.
+        this->test.kmer.count_kmer_multi_k(sh, config, kmer_ht, barrier);
+        break;
+      }
+      if (config.radix_kmer) {
+        // Writes out its own counts
+        this->test.kmer.count_kmer_radix(sh, config, kmer_ht, barrier);
+        goto done;
+      }
       this->test.kmer.count_kmer(sh, config, kmer_ht, barrier);
+      if (config.kmer_spectrum) {
+        // The table is shared; every thread scans a slice of it.
+        KmerSpectrum<key_type> spectrum(config.top_k);
+        const auto start = _rdtsc();
+        kmer_ht->collect_spectrum(sh->shard_idx, config.num_threads, spectrum);
+        report_kmer_spectrum(config, this->test.kmer.spectrum.get(), spectrum,
+                             _rdtsc() - start);
+      }
       break;
     default:
       break;
@@ -253,6 +324,7 @@ void Application::shard_thread(int tid, std::barrier<std::function<void()>>* bar
   // free_ht(kmer_ht);
 
 done:
+  sh->stats->barrier_wait = barrier->wait_cycles(tid);
   --num_entered;
   return;
 }
@@ -270,7 +342,17 @@ int Application::spawn_shard_threads() {
   if ((config.mode != SYNTH) && (config.mode != ZIPFIAN) &&
       (config.mode != PREFETCH) && (config.mode != CACHE_MISS) &&
       (config.mode != RW_RATIO) && (config.mode != HASHJOIN)) {
-    config.in_file_sz = get_file_size(config.in_file.c_str());
+    if (!config.in_manifest.empty() ||
+        input_reader::is_glob(config.in_file)) {
+      // Multi-file input; the readers balance the files among threads.
+      config.in_file_sz = 0;
+      for (const auto &file : input_reader::list_input_files(
+               config.in_file, config.in_manifest)) {
+        config.in_file_sz += file.size;
+      }
+    } else {
+      config.in_file_sz = get_file_size(config.in_file.c_str());
+    }
     PLOG_INFO.printf("File size: %" PRIu64 " bytes", config.in_file_sz);
     seg_sz = config.in_file_sz / config.num_threads;
     if (seg_sz < 4096) {
@@ -308,6 +390,22 @@ int Application::spawn_shard_threads() {
     exit(-1);
   }
 
+  // The threads are created and pinned once, for the largest run.
+  if (!this->pool) {
+    std::vector<uint32_t> cpus;
+    for (uint32_t assigned_cpu : this->np->get_assigned_cpu_list()) {
+      if (assigned_cpu == 0) continue;
+      cpus.push_back(assigned_cpu);
+    }
+    this->pool = new WorkerPool(cpus);
+    this->tables.resize(this->pool->size() + 1);
+  }
+  if (config.num_threads > this->pool->size() + 1) {
+    PLOGE.printf("%u threads configured, the pool has %u", config.num_threads,
+                 this->pool->size() + 1);
+    exit(-1);
+  }
+
   std::function<void()> on_completion = []() noexcept {
     // For debugging
     // PLOG_INFO << "Phase completed.";
@@ -315,22 +413,19 @@ int Application::spawn_shard_threads() {
 
   std::function<void()> on_sync_complete = sync_complete;
 
-  std::barrier barrier(config.num_threads, on_sync_complete);
-  uint32_t i = 0;
-  for (uint32_t assigned_cpu : this->np->get_assigned_cpu_list()) {
-    if (assigned_cpu == 0) continue;
+  // The threads of a node meet on a counter of the node before they meet
+  // the other nodes.
+  std::vector<uint32_t> nodes;
+  for (uint32_t i = 0; i < config.num_threads; i++) {
     Shard *sh = &this->shards[i];
     sh->shard_idx = i;
     sh->f_start = round_up(seg_sz * sh->shard_idx, PAGE_SIZE);
     sh->f_end = round_up(seg_sz * (sh->shard_idx + 1), PAGE_SIZE);
-    auto _thread = std::thread(&Application::shard_thread, this, i, &barrier);
-    CPU_ZERO(&cpuset);
-    CPU_SET(assigned_cpu, &cpuset);
-    pthread_setaffinity_np(_thread.native_handle(), sizeof(cpu_set_t), &cpuset);
-    PLOGV.printf("Thread %u: affinity: %u", sh->shard_idx, assigned_cpu);
-    this->threads.push_back(std::move(_thread));
-    i += 1;
+    const uint32_t cpu = i + 1 < config.num_threads ? this->pool->cpu_of(i) : 0;
+    nodes.push_back(std::max(numa_node_of_cpu(cpu), 0));
+    PLOGV.printf("Thread %u: affinity: %u, node %u", i, cpu, nodes.back());
   }
+  SpinBarrier barrier(nodes, on_sync_complete);
 
   // Pin main application thread to cpu 0 and run our thread routine
   CPU_ZERO(&cpuset);
@@ -338,20 +433,27 @@ int Application::spawn_shard_threads() {
   sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
   PLOGV.printf("Thread 'main': affinity: %u", 0);
 
-  PLOGV.printf("Running master thread with id %d", i);
-  {
-    Shard *sh = &this->shards[i];
-    sh->shard_idx = i;
-    sh->f_start = round_up(seg_sz * sh->shard_idx, PAGE_SIZE);
-    sh->f_end = round_up(seg_sz * (sh->shard_idx + 1), PAGE_SIZE);
-    this->shard_thread(i, &barrier);
+  switch (config.mode) {
+    case SYNTH:
+    case RW_RATIO:
+    case ZIPFIAN:
+    case BQ_TESTS_NO_BQ:
+      this->setup_tables(false);
+      break;
+    default:
+      break;
   }
 
-  for (auto &th : this->threads) {
-    if (th.joinable()) {
-      th.join();
-    }
+  if (config.mode == FASTQ_WITH_INSERT) {
+    this->test.kmer.prepare(config);
+  } else if (config.mode == HASHJOIN) {
+    this->test.hj.prepare(config);
   }
+
+  PLOGV.printf("Running master thread with id %u", config.num_threads - 1);
+  this->pool->run(config.num_threads,
+                  [&](uint32_t i) { this->shard_thread(i, &barrier); });
+
   if ((config.mode != CACHE_MISS) && (config.mode != HASHJOIN)) {
     print_stats(this->shards, config);
   }
@@ -361,6 +463,74 @@ int Application::spawn_shard_threads() {
   return 0;
 }
 
+void Application::setup_tables(bool clear) {
+  if (config.ht_size != this->tables_size) {
+    for (auto &ht : this->tables) {
+      delete ht;
+      ht = nullptr;
+    }
+    this->tables_size = config.ht_size;
+  }
+  this->pool->run(config.num_threads, [&](uint32_t i) {
+    if (!this->tables[i]) {
+      this->tables[i] = init_ht(config.ht_size, i);
+    } else if (clear && (i == 0 || config.ht_type == PARTITIONED_HT)) {
+      this->tables[i]->clear();
+    }
+  });
+}
+
+/// Parse a comma separated list of thread counts, e.g., "1,2,4,8".
+static std::vector<uint32_t> parse_thread_counts(const std::string &list) {
+  std::vector<uint32_t> counts;
+  std::istringstream in(list);
+  for (std::string n; std::getline(in, n, ',');) {
+    if (!n.empty()) {
+      counts.push_back(std::stoul(n));
+    }
+  }
+  return counts;
+}
+
+int Application::run_sweep() {
+  const auto counts = config.sweep_threads.empty()
+                          ? std::vector<uint32_t>{config.num_threads}
+                          : parse_thread_counts(config.sweep_threads);
+  const auto num_inserts = HT_TESTS_NUM_INSERTS;
+  // `process` split a partitioned table for the largest thread count; every
+  // point splits the same total among its own threads instead.
+  const uint64_t ht_size = config.ht_type == PARTITIONED_HT
+                               ? config.ht_size * config.num_threads
+                               : config.ht_size;
+
+  for (const auto n : counts) {
+    for (uint32_t rep = 0; rep < config.sweep_reps; rep++) {
+      config.num_threads = n;
+      if (config.ht_type == PARTITIONED_HT) {
+        config.ht_size = ht_size / n;
+        HT_TESTS_NUM_INSERTS =
+            static_cast<double>(config.ht_size) * config.ht_fill * 0.01;
+      } else {
+        HT_TESTS_NUM_INSERTS = num_inserts;
+      }
+      zipfian_inserts = false;
+      zipfian_finds = false;
+      collectors.clear();
+
+      // Every run starts from an empty table, the same inputs and the state
+      // of a fresh process.
+      if (this->pool) {
+        this->setup_tables(true);
+      }
+
+      printf("Sweep point: %u threads, run %u, table size %" PRIu64 "\n", n,
+             rep, ht_size);
+      this->spawn_shard_threads();
+    }
+  }
+  return 0;
+}
+
 // TODO: Move me @David
 void papi_init() {
 #if defined(WITH_PAPI_LIB) || defined(ENABLE_HIGH_LEVEL_PAPI)
@@ -422,7 +592,10 @@ int Application::process(int argc, char *argv[]) {
         "Use alphanum_kmers (for debugging)")(
         "numa-split",
         po::value<uint32_t>(&config.numa_split)->default_value(def.numa_split),
-        "Split spawning threads between numa nodes")(
+        "Split spawning threads between numa nodes (threads: 1 split nodes, "
+        "2 sequential, 4 physical cores first; queues: 1 sequential, 2 "
+        "separate nodes, 3 equal partition, 5 producer/consumer on SMT "
+        "siblings, 6 one consumer per L3)")(
         "stats",
         po::value<std::string>(&config.stats_file)
             ->default_value(def.stats_file),
@@ -437,7 +610,67 @@ int Application::process(int argc, char *argv[]) {
         "Hashtable output file name.")(
         "in-file",
         po::value<std::string>(&config.in_file)->default_value(def.in_file),
-        "Input fasta file")(
+        "Input fasta file, or a glob pattern of files")(
+        "in-manifest",
+        po::value<std::string>(&config.in_manifest)
+            ->default_value(def.in_manifest),
+        "File of input FASTQ paths, one per line, or two per line for the "
+        "mates of paired-end reads; replaces --in-file")(
+        "input-backend",
+        po::value<uint32_t>(&config.input_backend)
+            ->default_value(def.input_backend),
+        "1: ifstream, preloaded into memory\n"
+        "2: mmap (zero-copy)\n"
+        "3: asynchronous read-ahead\n")(
+        "direct-io",
+        po::value<bool>(&config.direct_io)->default_value(def.direct_io),
+        "Use O_DIRECT for the asynchronous input backend")(
+        "simd-kmer",
+        po::value<bool>(&config.simd_kmer)->default_value(def.simd_kmer),
+        "Extract k-mers a block of bases at a time with SIMD")(
+        "canonical",
+        po::value<bool>(&config.canonical_kmer)
+            ->default_value(def.canonical_kmer),
+        "Count a k-mer and its reverse complement as the same k-mer")(
+        "minimizer",
+        po::value<uint32_t>(&config.minimizer_len)
+            ->default_value(def.minimizer_len),
+        "Send super k-mers of this minimizer length to the partitions "
+        "instead of single k-mers (partitioned HT only, 0 to disable)")(
+        "radix",
+        po::value<bool>(&config.radix_kmer)->default_value(def.radix_kmer),
+        "Count k-mers by radix partitioning them instead of inserting into "
+        "the hashtable")(
+        "spill-dir",
+        po::value<std::string>(&config.spill_dir)
+            ->default_value(def.spill_dir),
+        "Spill to this directory: count k-mers out of core, or run a grace "
+        "hashjoin (CAS HT only)")(
+        "mem-budget",
+        po::value<uint64_t>(&config.mem_budget)->default_value(def.mem_budget),
+        "Memory budget of out-of-core counting and grace hashjoin in MiB")(
+        "spectrum",
+        po::value<bool>(&config.kmer_spectrum)
+            ->default_value(def.kmer_spectrum),
+        "After counting, report the k-mer count histogram and the top "
+        "k-mers")(
+        "top-k",
+        po::value<uint32_t>(&config.top_k)->default_value(def.top_k),
+        "Number of most frequent k-mers to report with --spectrum")(
+        "singleton-filter",
+        po::value<uint64_t>(&config.singleton_filter)
+            ->default_value(def.singleton_filter),
+        "MiB of a bloom filter in front of the table that keeps k-mers seen "
+        "only once out of it (0 to disable)")(
+        "k-list",
+        po::value<std::string>(&config.k_list)->default_value(def.k_list),
+        "Count the k-mers of these comma separated K values (<= 31) in one "
+        "pass instead of --k, in one table keyed by (K, k-mer) (CAS HT only)")(
+        "min-quality",
+        po::value<uint32_t>(&config.min_quality)
+            ->default_value(def.min_quality),
+        "Drop the k-mers with a base below this Phred quality, masked while "
+        "parsing the FASTQ (0 to disable)")(
         "drop-caches",
         po::value<bool>(&config.drop_caches)->default_value(def.drop_caches),
         "drop page cache before run")(
@@ -486,7 +719,56 @@ int Application::process(int argc, char *argv[]) {
           "rw-queues",
           po::value<bool>(&config.rw_queues)->default_value(def.rw_queues),
           "Enable R/W tests for queues tests"
-        )("pollute-ratio", po::value(&config.pollute_ratio)->default_value(def.pollute_ratio), "Ratio of pollution events to ops (>1)");
+        )("pollute-ratio", po::value(&config.pollute_ratio)->default_value(def.pollute_ratio), "Ratio of pollution events to ops (>1)")(
+          "delegate-finds",
+          po::value<bool>(&config.delegate_finds)
+              ->default_value(def.delegate_finds),
+          "Send the finds of the queue tests to the owner of each partition "
+          "and wait for its response")(
+          "skew-routing",
+          po::value<bool>(&config.skew_routing)
+              ->default_value(def.skew_routing),
+          "Count the hottest keys in the producers of the queue tests instead "
+          "of sending every occurrence to their owner")(
+          "aggr-buffer",
+          po::value<uint32_t>(&config.aggr_buffer)
+              ->default_value(def.aggr_buffer),
+          "Keys each producer of the queue tests merges before sending them, "
+          "as a count per key (0 to disable)")(
+          "num-partitions",
+          po::value<uint32_t>(&config.num_partitions)
+              ->default_value(def.num_partitions),
+          "Partitions of the table in the queue tests, at least one per "
+          "consumer (0 for one per consumer)")(
+          "rebalance",
+          po::value<bool>(&config.rebalance)->default_value(def.rebalance),
+          "Move partitions between the consumers by load after each round of "
+          "inserts (see --insert-factor)")(
+          "elastic-rate",
+          po::value<double>(&config.elastic_rate)
+              ->default_value(def.elastic_rate),
+          "Requests per second, in millions, arriving at the RW ratio workers, "
+          "which are parked and woken as the load changes (0 to disable)")(
+          "elastic-burst",
+          po::value<double>(&config.elastic_burst)
+              ->default_value(def.elastic_burst),
+          "How many times the elastic rate arrives during a burst")(
+          "sweep-threads",
+          po::value<std::string>(&config.sweep_threads)
+              ->default_value(def.sweep_threads),
+          "Run these comma separated thread counts one after another in one "
+          "process, on the same threads, tables and inputs (synth, zipfian and "
+          "RW ratio tests)")(
+          "sweep-reps",
+          po::value<uint32_t>(&config.sweep_reps)
+              ->default_value(def.sweep_reps),
+          "Runs of every thread count of the sweep")(
+          "helper-prefetch",
+          po::value<uint32_t>(&config.helper_prefetch)
+              ->default_value(def.helper_prefetch),
+          "Keys a helper thread on the SMT sibling of every zipfian worker "
+          "prefetches ahead of it, while the worker inserts and finds without "
+          "batching (0 to disable)");
 
     papi_init();
 
@@ -537,6 +819,65 @@ int Application::process(int argc, char *argv[]) {
         PLOG_ERROR.printf("Please provide input fasta file.");
         exit(-1);
       }
+      if (!config.spill_dir.empty() && config.ht_type != CASHTPP) {
+        PLOG_ERROR.printf("Out-of-core counting needs the CAS hashtable.");
+        exit(-1);
+      }
+      if (config.min_quality > 93) {
+        PLOG_ERROR.printf("Phred quality %u is out of range [0, 93].",
+                          config.min_quality);
+        exit(-1);
+      }
+      // Given in MiB; keep the size in bytes from overflowing.
+      if (config.singleton_filter > (UINT64_MAX >> 21)) {
+        PLOG_ERROR.printf("Singleton filter of %" PRIu64 " MiB is too large.",
+                          config.singleton_filter);
+        exit(-1);
+      }
+      if (!config.k_list.empty() && config.ht_type != CASHTPP) {
+        PLOG_ERROR.printf("Multi-K counting needs the CAS hashtable.");
+        exit(-1);
+      }
+      if (config.radix_kmer && !config.k_list.empty()) {
+        PLOG_ERROR.printf("Radix counting counts a single K.");
+        exit(-1);
+      }
+      if (!config.k_list.empty()) {
+#if (KEY_LEN > 8)
+        PLOG_ERROR.printf("Multi-K counting supports K <= %u only.",
+                          input_reader::MultiKExtractor<>::MAX_K);
+        exit(-1);
+#endif
+        std::vector<uint32_t> ks;
+        try {
+          ks = input_reader::parse_k_list(config.k_list);
+        } catch (const std::exception &) {
+          PLOG_ERROR.printf("Invalid K list '%s'.", config.k_list.c_str());
+          exit(-1);
+        }
+        if (ks.empty()) {
+          PLOG_ERROR.printf("The K list '%s' has no K.", config.k_list.c_str());
+          exit(-1);
+        }
+        for (const auto k : ks) {
+          if (k < 1 || k > input_reader::MultiKExtractor<>::MAX_K) {
+            PLOG_ERROR.printf("K=%u of the K list is out of range [1, %u].", k,
+                              input_reader::MultiKExtractor<>::MAX_K);
+            exit(-1);
+          }
+        }
+      }
+#if (KEY_LEN > 8)
+      if (!config.spill_dir.empty()) {
+        PLOG_ERROR.printf("Out-of-core counting supports K <= 32 only.");
+        exit(-1);
+      }
+      if (config.radix_kmer) {
+        PLOG_WARNING.printf(
+            "Radix counting supports K <= 32 only; inserting directly.");
+        config.radix_kmer = false;
+      }
+#endif
     } else if (config.mode == FASTQ_NO_INSERT) {
       PLOG_INFO.printf("Mode : FASTQ_NO_INSERT");
       if (config.in_file.empty()) {
@@ -555,6 +896,55 @@ int Application::process(int argc, char *argv[]) {
         //config.ht_size = static_cast<double>(max_join_size) * 100 / config.ht_fill;
       }
       PLOGI.printf("Setting ht size to %llu for hashjoin test", config.ht_size);
+      if (!config.spill_dir.empty() && config.ht_type != CASHTPP) {
+        PLOG_ERROR.printf("Grace hashjoin needs the CAS hashtable.");
+        exit(-1);
+      }
+    } else if (config.mode == RW_RATIO && config.elastic_rate > 0) {
+      if (config.ht_type != CASHTPP || config.num_threads < 2) {
+        PLOG_ERROR.printf(
+            "Elastic RW runs need the CAS hashtable and at least 2 threads.");
+        exit(-1);
+      }
+    }
+
+    // Every run lists a multi-file input again; a bad list fails here rather
+    // than in the middle of one.
+    if (!config.in_manifest.empty() || input_reader::is_glob(config.in_file)) {
+      try {
+        input_reader::list_input_files(config.in_file, config.in_manifest);
+      } catch (const std::exception &e) {
+        PLOG_ERROR.printf("Invalid input: %s.", e.what());
+        exit(-1);
+      }
+    }
+
+    if (config.helper_prefetch > 0) {
+      if (config.mode != ZIPFIAN) {
+        PLOG_ERROR.printf("SMT helper prefetching runs the zipfian test only.");
+        exit(-1);
+      }
+      // The helper does the prefetching; the workers take the plain paths.
+      config.no_prefetch = true;
+    }
+
+    if (!config.sweep_threads.empty() || config.sweep_reps > 1) {
+      if (config.mode != SYNTH && config.mode != ZIPFIAN &&
+          config.mode != RW_RATIO) {
+        PLOG_ERROR.printf(
+            "Sweeps run the synth, zipfian and RW ratio tests only.");
+        exit(-1);
+      }
+      // The threads are placed for the largest count of the sweep, and the
+      // smaller ones run on the first of them.
+      const auto counts = parse_thread_counts(config.sweep_threads);
+      if (!counts.empty()) {
+        config.num_threads = *std::max_element(counts.begin(), counts.end());
+        if (*std::min_element(counts.begin(), counts.end()) == 0) {
+          PLOG_ERROR.printf("Sweep thread counts must be positive.");
+          exit(-1);
+        }
+      }
     }
 
     switch (config.ht_type) {
@@ -575,6 +965,18 @@ int Application::process(int argc, char *argv[]) {
         exit(0);
     }
 
+    switch (config.input_backend) {
+      case PRELOAD_INPUT:
+      case MMAP_INPUT:
+      case ASYNC_INPUT:
+        break;
+      default:
+        PLOG_ERROR.printf("Unknown input backend %u! Specify using "
+                          "--input-backend",
+                          config.input_backend);
+        exit(-1);
+    }
+
     if (config.ht_fill > 0 && config.ht_fill < 200) {
       HT_TESTS_NUM_INSERTS =
           static_cast<double>(config.ht_size) * config.ht_fill * 0.01;
@@ -623,6 +1025,14 @@ int Application::process(int argc, char *argv[]) {
         this->npq = new NumaPolicyQueues(config.n_prod, config.n_cons,
                                          PROD_CONS_EQUAL_PARTITION);
         break;
+      case PROD_CONS_SMT_SIBLINGS:
+        this->npq = new NumaPolicyQueues(config.n_prod, config.n_cons,
+                                         PROD_CONS_SMT_SIBLINGS);
+        break;
+      case PROD_CONS_CONSUMER_PER_L3:
+        this->npq = new NumaPolicyQueues(config.n_prod, config.n_cons,
+                                         PROD_CONS_CONSUMER_PER_L3);
+        break;
       default:
         break;
     }
@@ -636,6 +1046,10 @@ int Application::process(int argc, char *argv[]) {
         this->np = new NumaPolicyThreads(config.num_threads,
                                          THREADS_ASSIGN_SEQUENTIAL);
         break;
+      case THREADS_FILL_PHYSICAL_CORES:
+        this->np = new NumaPolicyThreads(config.num_threads,
+                                         THREADS_FILL_PHYSICAL_CORES);
+        break;
       default:
         PLOGE.printf("Unknown numa policy. Exiting");
         exit(-1);
@@ -655,6 +1069,8 @@ int Application::process(int argc, char *argv[]) {
     }
   } else if (config.mode == BQ_TESTS_YES_BQ) {
     this->test.qt.run_test(&config, this->n, false, this->npq);
+  } else if (!config.sweep_threads.empty() || config.sweep_reps > 1) {
+    this->run_sweep();
   } else {
     this->spawn_shard_threads();
   }
@@ -668,6 +1084,7 @@ int Application::process(int argc, char *argv[]) {
       HT_TESTS_NUM_INSERTS = config.ht_size * config.ht_fill * 0.01;
 
       config.no_prefetch = 0;
+      config.helper_prefetch = 0;
 
       this->spawn_shard_threads();
     }
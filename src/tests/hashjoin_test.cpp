@@ -11,9 +11,11 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <syncstream>
 #include <unordered_set>
+#include <vector>
 
 #include "constants.hpp"
 #include "hashtables/base_kht.hpp"
@@ -25,6 +27,7 @@
 #include "sync.h"
 #include "tests/HashjoinTest.hpp"
 #include "types.hpp"
+#include "utils/grace_join.hpp"
 #include <chrono>
 
 namespace kmercounter {
@@ -43,7 +46,7 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
               std::tuple<KeyValuePair*, uint32_t> relation_s,
               BaseHashTable* ht,
               MaterializeVector* mvec,
-              bool materialize, std::barrier<std::function<void()>>* barrier) {
+              bool materialize, SpinBarrier *barrier) {
   // Build hashtable from t1.
   HTBatchRunner batch_runner(ht);
   const auto t1_start = RDTSC_START();
@@ -77,7 +80,7 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
   }
 
   // Make sure insertions is finished before probing.
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(sh->shard_idx);
 
   if (sh->shard_idx == 0) {
     end_build_ts = std::chrono::steady_clock::now();
@@ -112,7 +115,7 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
   batch_runner.flush_find();
 
   // Make sure insertions is finished before probing.
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(sh->shard_idx);
 
 
   if (sh->shard_idx == 0) {
@@ -142,13 +145,14 @@ void hashjoin(Shard* sh, input_reader::SizedInputReader<KeyValuePair>* t1,
         << " cycles per output." << std::endl;
   }
 }
+
 }  // namespace
 
 void HashjoinTest::join_relations_generated(Shard* sh,
                                             const Configuration& config,
                                             BaseHashTable* ht,
                                             bool materialize,
-                                            std::barrier<VoidFn>* barrier) {
+                                            SpinBarrier *barrier) {
   input_reader::PartitionedEthRelationGenerator t1(
       "r.tbl", DEFAULT_R_SEED, config.relation_r_size, sh->shard_idx,
       config.num_threads, config.relation_r_size);
@@ -206,7 +210,7 @@ void HashjoinTest::join_relations_generated(Shard* sh,
     mt = new MaterializeVector(t1.size());
 
   // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(sh->shard_idx);
 
   if (sh->shard_idx == 0) {
     start = _rdtsc();
@@ -216,7 +220,7 @@ void HashjoinTest::join_relations_generated(Shard* sh,
   // Run hashjoin
   hashjoin(sh, &t1, &t2, relation_r, relation_s, ht, mt, materialize, barrier);
 
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(sh->shard_idx);
 
   if (sh->shard_idx == 0) {
     end = _rdtsc();
@@ -232,10 +236,55 @@ void HashjoinTest::join_relations_generated(Shard* sh,
   }
 }
 
+void HashjoinTest::prepare(const Configuration &config) {
+  this->grace.reset();
+  if (!config.spill_dir.empty()) {
+    this->grace = std::make_unique<GraceJoin>(config);
+  }
+}
+
+void HashjoinTest::join_relations_grace(
+    Shard* sh, const Configuration& config,
+    const std::function<BaseHashTable*(uint64_t)>& make_ht,
+    SpinBarrier *barrier) {
+  const uint32_t tid = sh->shard_idx;
+
+  input_reader::PartitionedEthRelationGenerator t1(
+      "r.tbl", DEFAULT_R_SEED, config.relation_r_size, sh->shard_idx,
+      config.num_threads, config.relation_r_size);
+  input_reader::PartitionedEthRelationGenerator t2(
+      "s.tbl", DEFAULT_S_SEED, config.relation_s_size, sh->shard_idx,
+      config.num_threads, config.relation_r_size);
+
+  // Wait for all readers finish initializing.
+  barrier->arrive_and_wait(sh->shard_idx);
+
+  std::uint64_t start{};
+  std::chrono::time_point<std::chrono::steady_clock> start_ts, end_ts;
+  if (tid == 0) {
+    start = _rdtsc();
+    start_ts = std::chrono::steady_clock::now();
+  }
+
+  this->grace->run(tid, &t1, &t2, make_ht);
+
+  barrier->arrive_and_wait(sh->shard_idx);
+
+  if (tid == 0) {
+    end_ts = std::chrono::steady_clock::now();
+    PLOG_INFO.printf(
+        "Grace hashjoin took %llu us (%llu cycles, partitioning %llu), "
+        "output %llu rows",
+        chrono::duration_cast<chrono::microseconds>(end_ts - start_ts).count(),
+        _rdtsc() - start, this->grace->partition_end() - start,
+        this->grace->num_output());
+  }
+}
+
 void HashjoinTest::join_relations_from_files(Shard* sh,
                                              const Configuration& config,
                                              BaseHashTable* ht,
-                                             std::barrier<VoidFn>* barrier) {
+                                             SpinBarrier *barrier) {
   input_reader::KeyValueCsvPreloadReader t1(config.relation_r, sh->shard_idx,
                                             config.num_threads, "|");
   input_reader::KeyValueCsvPreloadReader t2(config.relation_s, sh->shard_idx,
@@ -244,7 +293,7 @@ void HashjoinTest::join_relations_from_files(Shard* sh,
             << " t1 " << t1.size() << " t2 " << t2.size();
 
   // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(sh->shard_idx);
 
   // Run hashjoin
   hashjoin(sh, &t1, &t2,
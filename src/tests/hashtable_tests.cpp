@@ -2,8 +2,10 @@
 #include <ittnotify.h>
 #endif
 
+#include <sched.h>
+
 #include <atomic>
-#include <barrier>
+#include <memory>
 #include <sstream>
 
 #include "misc_lib.h"
@@ -11,6 +13,8 @@
 #include "sync.h"
 #include "tests/tests.hpp"
 #include "utils/hugepage_allocator.hpp"
+#include "utils/prefetch_helper.hpp"
+#include "utils/topology.hpp"
 #include "utils/vtune.hpp"
 #include "zipf.h"
 #include "zipf_distribution.hpp"
@@ -38,9 +42,54 @@ extern ExecPhase cur_phase;
 extern std::vector<key_type, huge_page_allocator<key_type>> *zipf_values;
 extern std::vector<cacheline> toxic_waste_dump;
 
+// A helper on the SMT sibling of the calling worker `id`, which prefetches the
+// slots of the keys the worker will insert (`write`) or find, or none if the
+// mode is off or the CPU has no sibling.
+std::unique_ptr<PrefetchHelper> start_prefetch_helper(BaseHashTable *hashtable,
+                                                      unsigned int id,
+                                                      bool write) {
+  if (config.helper_prefetch == 0) {
+    return nullptr;
+  }
+  static const CpuTopology topo;
+  const int cpu = sched_getcpu();
+  const auto sibling = topo.sibling_of(cpu);
+  if (!sibling) {
+    PLOGW.printf("thread %u: cpu %d has no SMT sibling, running without a "
+                 "helper", id, cpu);
+    return nullptr;
+  }
+
+  // The keys of the worker, in the order of its loops below.
+  const uint64_t num_keys = HT_TESTS_NUM_INSERTS;
+  const uint64_t key_start =
+      std::max(static_cast<uint64_t>(HT_TESTS_NUM_INSERTS) * id, (uint64_t)1);
+  [[maybe_unused]] const uint64_t zipf_start = key_start == 1 ? 0 : key_start;
+  return std::make_unique<PrefetchHelper>(
+      *sibling, config.helper_prefetch, num_keys * config.insert_factor,
+      [=](uint64_t pos) {
+#ifdef XORWOW
+        key_type key = key_start + pos % num_keys;
+#else
+        key_type key = zipf_values->at(zipf_start + pos % num_keys);
+#endif
+        hashtable->prefetch_slot(&key, write);
+      });
+}
+
+void stop_prefetch_helper(std::unique_ptr<PrefetchHelper> &helper,
+                          unsigned int id) {
+  if (helper) {
+    helper->finish();
+    PLOGI.printf("thread %u | helper prefetched %" PRIu64
+                 " keys, %" PRIu64 " came too late",
+                 id, helper->issued(), helper->skipped());
+  }
+}
+
 OpTimings do_zipfian_inserts(
     BaseHashTable *hashtable, double skew, int64_t seed, unsigned int count,
-    unsigned int id, std::barrier<std::function<void()>> *sync_barrier) {
+    unsigned int id, SpinBarrier *sync_barrier) {
 #ifdef LATENCY_COLLECTION
   const auto collector = &collectors.at(id);
   collector->claim();
@@ -50,7 +99,7 @@ OpTimings do_zipfian_inserts(
 
   std::uint64_t duration{};
 
-  sync_barrier->arrive_and_wait();
+  sync_barrier->arrive_and_wait(id);
   stop_sync = true;
 
 #ifdef WITH_VTUNE_LIB
@@ -68,8 +117,11 @@ OpTimings do_zipfian_inserts(
 
   PLOGV.printf("id: %u | key_start %" PRIu64 "", id, key_start);
 
+  auto helper = start_prefetch_helper(hashtable, id, true);
+  std::uint64_t done{};
+
   const auto start = RDTSC_START();
-  key_type key{};
+  std::uint64_t key{};
   std::size_t next_pollution{};
 
   for (auto j = 0u; j < config.insert_factor; j++) {
@@ -85,7 +137,7 @@ OpTimings do_zipfian_inserts(
         prefetch_object<false>(&zipf_values->at(zipf_idx + 16), 64);
       }
 
-      auto value = zipf_values->at(zipf_idx);
+      auto value = static_cast<uint64_t>(zipf_values->at(zipf_idx));
 #endif
       items[key].key = items[key].value = value;
       items[key].id = n;
@@ -94,6 +146,7 @@ OpTimings do_zipfian_inserts(
       zipf_idx++;
       if (config.no_prefetch) {
         hashtable->insert_noprefetch(&items[key], collector);
+        if (helper) helper->advance(++done);
 
         for (auto p = 0u; p < config.pollute_ratio; ++p)
           prefetch_object<true>(
@@ -119,6 +172,8 @@ OpTimings do_zipfian_inserts(
   const auto end = RDTSCP();
   duration += end - start;
 
+  stop_prefetch_helper(helper, id);
+
   PLOG_DEBUG << "Inserts done; Reprobes: " << hashtable->num_reprobes
              << ", Soft Reprobes: " << hashtable->num_soft_reprobes;
 
@@ -126,7 +181,7 @@ OpTimings do_zipfian_inserts(
   __itt_event_end(event);
 #endif
 
-  sync_barrier->arrive_and_wait();
+  sync_barrier->arrive_and_wait(id);
 
 #ifdef LATENCY_COLLECTION
   collector->dump("async_insert", id);
@@ -151,9 +206,13 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
   FindResult *results = new FindResult[config.batch_len];
   ValuePairs vp = std::make_pair(0, results);
 
-  sync_barrier->arrive_and_wait();
+  sync_barrier->arrive_and_wait(id);
   stop_sync = true;
 
+  // Only now, as thread 0 shuffles the keys before the barrier.
+  auto helper = start_prefetch_helper(hashtable, id, false);
+  std::uint64_t done{};
+
   static const auto event = vtune::event_start("find_casht");
 
   const auto start = RDTSC_START();
@@ -175,6 +234,7 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
 
       if (config.no_prefetch) {
         auto ret = hashtable->find_noprefetch(&value, collector);
+        if (helper) helper->advance(++done);
         for (auto p = 0u; p < config.pollute_ratio; ++p)
           prefetch_object<true>(
               &toxic_waste_dump[next_pollution++ & (1024 * 1024 - 1)], 64);
@@ -213,7 +273,9 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
   const auto end = RDTSCP();
   duration += end - start;
 
-  sync_barrier->arrive_and_wait();
+  stop_prefetch_helper(helper, id);
+
+  sync_barrier->arrive_and_wait(id);
 
   vtune::event_end(event);
 
@@ -232,7 +294,7 @@ OpTimings do_zipfian_gets(BaseHashTable *hashtable, unsigned int num_threads,
 
 void ZipfianTest::run(Shard *shard, BaseHashTable *hashtable, double skew,
                       int64_t zipf_seed, unsigned int count,
-                      std::barrier<std::function<void()>> *sync_barrier) {
+                      SpinBarrier *sync_barrier) {
   OpTimings insert_timings{};
   static_assert(HT_TESTS_MAX_STRIDE - 1 ==
                 1);  // Otherwise timing logic is wrong
@@ -241,7 +303,8 @@ void ZipfianTest::run(Shard *shard, BaseHashTable *hashtable, double skew,
   static auto step = 0;
   {
     std::lock_guard lock{collector_lock};
-    if (step == 0) {
+    // Back at 3 on the next run of a sweep.
+    if (step == 0 || step == 3) {
       collectors.resize(config.num_threads);
       step = 1;
     }
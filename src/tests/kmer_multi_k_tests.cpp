@@ -0,0 +1,103 @@
+#include "tests/KmerTest.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <plog/Log.h>
+#include <string_view>
+#include <vector>
+
+#include "constants.hpp"
+#include "hashtables/base_kht.hpp"
+#include "hashtables/batch_runner/batch_runner.hpp"
+#include "input_reader/multi_k.hpp"
+#include "print_stats.h"
+#include "sync.h"
+#include "types.hpp"
+
+namespace kmercounter {
+namespace {
+#if (KEY_LEN <= 8)
+/// Insert the tagged KMers of every K of every sequence of `reader`; return
+/// the number of KMers of each K.
+template <bool Canonical>
+std::vector<uint64_t> insert_multi_k(
+    input_reader::InputReader<std::string_view> *reader,
+    const std::vector<uint32_t> &ks, HTBatchRunner<> *batch_runner) {
+  using Extractor = input_reader::MultiKExtractor<Canonical>;
+  const Extractor extractor(ks);
+  std::vector<uint64_t> num_kmers(extractor.ks().size());
+  for (std::string_view seq; reader->next(&seq);) {
+    extractor.extract(seq, [&](size_t i, uint64_t kmer) {
+      batch_runner->insert(Extractor::tag(kmer, extractor.ks()[i]), 0);
+      num_kmers[i]++;
+    });
+  }
+  return num_kmers;
+}
+#endif  // KEY_LEN <= 8
+}  // namespace
+
+MultiKShared::MultiKShared(const Configuration &config)
+    // Sorted the same as by the extractor.
+    : ks(input_reader::MultiKExtractor<>(
+             input_reader::parse_k_list(config.k_list))
+             .ks()),
+      num_kmers(ks.size()) {}
+
+void KmerTest::count_kmer_multi_k(Shard *sh, const Configuration &config,
+                                  BaseHashTable *ht,
+                                  SpinBarrier *barrier) {
+#if (KEY_LEN > 8)
+  // `Application::process` refuses multi-K counts with wide keys.
+  PLOG_FATAL << "Multi-K counting supports K <= 31 only";
+#else
+  MultiKShared *const shared = this->multi_k.get();
+  const auto &ks = shared->ks;
+
+  auto reader = make_sequence_reader(config, this->scheduler.get(),
+                                     sh->shard_idx, config.num_threads);
+  HTBatchRunner batch_runner(ht);
+
+  // Wait for all readers finish initializing.
+  barrier->arrive_and_wait(sh->shard_idx);
+
+  std::chrono::time_point<std::chrono::steady_clock> start_ts;
+  const auto start = _rdtsc();
+  if (sh->shard_idx == 0) {
+    start_ts = std::chrono::steady_clock::now();
+  }
+
+  // Each sequence is parsed and decoded once for all K.
+  const auto num_kmers =
+      config.canonical_kmer
+          ? insert_multi_k<true>(reader.get(), ks, &batch_runner)
+          : insert_multi_k<false>(reader.get(), ks, &batch_runner);
+  batch_runner.flush_insert();
+  uint64_t total = 0;
+  for (size_t i = 0; i < ks.size(); i++) {
+    shared->num_kmers[i] += num_kmers[i];
+    total += num_kmers[i];
+  }
+  barrier->arrive_and_wait(sh->shard_idx);
+
+  sh->stats->insertions.duration = _rdtsc() - start;
+  sh->stats->insertions.op_count = total;
+
+  if (sh->shard_idx == 0) {
+    const auto end_ts = std::chrono::steady_clock::now();
+    PLOG_INFO.printf(
+        "Multi-K kmer insertion took %llu us (%llu cycles) for %zu values of K",
+        chrono::duration_cast<chrono::microseconds>(end_ts - start_ts).count(),
+        _rdtsc() - start, ks.size());
+    for (size_t i = 0; i < ks.size(); i++) {
+      PLOG_INFO.printf("  K=%u: %lu kmers", ks[i],
+                       shared->num_kmers[i].load());
+    }
+  }
+  PLOGV.printf("[%d] Num kmers %llu", sh->shard_idx, total);
+
+  get_ht_stats(sh, ht);
+#endif  // KEY_LEN > 8
+}
+
+}  // namespace kmercounter
@@ -2,66 +2,146 @@
 
 #include <algorithm>
 #include <atomic>
-#include <barrier>
 #include <cstdint>
+#include <fstream>
 #include <plog/Log.h>
+#include <span>
+#include <vector>
 
 #include "constants.hpp"
 #include "hashtables/base_kht.hpp"
-#include "hashtables/batch_runner/batch_runner.hpp"
-#include "hashtables/kvtypes.hpp"
 #include "sync.h"
 #include "input_reader/fastq.hpp"
 #include "input_reader/counter.hpp"
 #include "types.hpp"
 #include "print_stats.h"
+#include "utils/radix_partition.hpp"
 
 namespace kmercounter {
+namespace {
+/// Size of the table of one partition to aim for, about an L2.
+constexpr uint64_t RADIX_TABLE_BYTES = 1 << 20;
+}  // namespace
+
 void KmerTest::count_kmer_radix(Shard* sh,
                               const Configuration& config,
                               BaseHashTable* ht,
-                              std::barrier<VoidFn>* barrier){
-  // Be care of the `K` here; it's a compile time constant.
-  auto reader = input_reader::MakeFastqKMerPreloadReader(config.K, config.in_file, sh->shard_idx, config.num_threads);
-  HTBatchRunner batch_runner(ht);
+                              SpinBarrier *barrier){
+#if (KEY_LEN > 8)
+  PLOG_FATAL << "Radix counting supports K <= 32 only";
+#else
+  RadixShared& shared = *this->radix;
+  const uint32_t tid = sh->shard_idx;
+  const uint32_t num_threads = config.num_threads;
+
+  // The input is partitioned in memory, so read it all first.
+  auto reader = make_kmer_reader(config, this->scheduler.get(), sh->shard_idx,
+                                 config.num_threads);
+  std::vector<uint64_t> kmers;
+  for (KMerInputReader::value_type kmer; reader->next(&kmer);) {
+    kmers.push_back(kmer);
+  }
+  shared.num_kmers[tid] = kmers.size();
 
-  // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  // Wait for all readers finish reading.
+  barrier->arrive_and_wait(sh->shard_idx);
 
-  // start timers
-  std::uint64_t start {}, end {};
-  std::uint64_t start_cycles {}, end_cycles {};
-  std::uint64_t num_kmers{};
+  std::uint64_t start_cycles{}, pass1_cycles{}, pass2_cycles{};
   std::chrono::time_point<std::chrono::steady_clock> start_ts, end_ts;
-  start = _rdtsc();
-
-  if (sh->shard_idx == 0) {
+  const auto start = _rdtsc();
+  if (tid == 0) {
     start_ts = std::chrono::steady_clock::now();
-    start_cycles = _rdtsc();
+    start_cycles = start;
+  }
+
+  uint64_t total_kmers = 0;
+  for (const auto n : shared.num_kmers) {
+    total_kmers += n;
+  }
+  const uint32_t bits =
+      radix::choose_bits(total_kmers, num_threads, RADIX_TABLE_BYTES);
+  const uint64_t num_partitions = 1ull << bits;
+
+  // Pass one: histogram by the high hash bits.
+  auto& histogram = shared.histograms[tid];
+  histogram.resize(num_partitions);
+  radix::histogram(kmers, bits, histogram.data());
+  shared.phase.arrive_and_wait();
+
+  if (tid == 0) {
+    pass1_cycles = _rdtsc();
+    shared.partition_begin.assign(num_partitions + 1, 0);
+    for (uint64_t p = 0; p < num_partitions; p++) {
+      uint64_t size = 0;
+      for (const auto& h : shared.histograms) {
+        size += h[p];
+      }
+      shared.partition_begin[p + 1] = shared.partition_begin[p] + size;
+    }
+    shared.partitioned.resize(total_kmers);
   }
+  shared.phase.arrive_and_wait();
 
-  // Inser Kmers into hashtable
-  for (uint64_t kmer; reader->next(&kmer);) {
-    batch_runner.insert(kmer, 0 /* we use the aggr tables so no value */);
-    num_kmers++;
+  // Pass two: scatter into this thread's slice of every partition.
+  {
+    std::vector<uint64_t> offsets(shared.partition_begin.begin(),
+                                  shared.partition_begin.end() - 1);
+    for (uint32_t t = 0; t < tid; t++) {
+      for (uint64_t p = 0; p < num_partitions; p++) {
+        offsets[p] += shared.histograms[t][p];
+      }
+    }
+    radix::Scatter scatter(bits, shared.partitioned.data(), std::move(offsets));
+    for (const auto kmer : kmers) {
+      scatter.push(kmer);
+    }
+  }
+  kmers = {};
+  shared.phase.arrive_and_wait();
+  if (tid == 0) {
+    pass2_cycles = _rdtsc();
   }
-  batch_runner.flush_insert();
-  barrier->arrive_and_wait();
+
+  // Count the partitions of this thread, each in a table of its own.
+  std::ofstream outfile;
+  if (!config.ht_file.empty()) {
+    outfile.open(config.ht_file + std::to_string(sh->shard_idx));
+  }
+  radix::PartitionCounter counter;
+  uint64_t num_distinct{}, max_count{};
+  for (uint64_t p = tid; p < num_partitions; p += num_threads) {
+    const std::span<const uint64_t> partition(
+        shared.partitioned.data() + shared.partition_begin[p],
+        shared.partition_begin[p + 1] - shared.partition_begin[p]);
+    counter.count(partition, [&](uint64_t kmer, uint64_t count) {
+      num_distinct++;
+      max_count = std::max(max_count, count);
+      if (outfile.is_open()) {
+        outfile << kmer << " : " << count << std::endl;
+      }
+    });
+  }
+  barrier->arrive_and_wait(sh->shard_idx);
 
   sh->stats->insertions.duration = _rdtsc() - start;
-  sh->stats->insertions.op_count = num_kmers;
+  sh->stats->insertions.op_count = shared.num_kmers[tid];
+  sh->stats->ht_fill = num_distinct;
+  sh->stats->ht_capacity = counter.capacity();
+  sh->stats->max_count = max_count;
 
-  // done; calc stats
-  if (sh->shard_idx == 0) {
+  if (tid == 0) {
     end_ts = std::chrono::steady_clock::now();
-    end_cycles = _rdtsc();
-    PLOG_INFO.printf("Kmer insertion took %llu us (%llu cycles)",
+    PLOG_INFO.printf(
+        "Radix kmer counting took %llu us (%llu cycles): %lu partitions, "
+        "histogram %llu, scatter %llu, count %llu cycles",
         chrono::duration_cast<chrono::microseconds>(end_ts - start_ts).count(),
-        end_cycles - start_cycles);
+        _rdtsc() - start_cycles, num_partitions, pass1_cycles - start_cycles,
+        pass2_cycles - pass1_cycles, _rdtsc() - pass2_cycles);
+    shared.partitioned = {};
   }
-  PLOGV.printf("[%d] Num kmers %llu", sh->shard_idx, num_kmers);
-
-  get_ht_stats(sh, ht);
+  PLOGV.printf("[%d] Num kmers %llu, distinct %llu", sh->shard_idx,
+               shared.num_kmers[tid], num_distinct);
+#endif  // KEY_LEN > 8
 }
 
 } // namespace kmercounter
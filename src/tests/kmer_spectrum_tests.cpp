@@ -0,0 +1,75 @@
+#include "tests/KmerTest.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <plog/Log.h>
+#include <string>
+
+#include "constants.hpp"
+#include "input_reader/fastq.hpp"
+#include "sync.h"
+#include "types.hpp"
+#include "utils/circular_buffer.hpp"
+#include "utils/kmer_spectrum.hpp"
+
+namespace kmercounter {
+namespace {
+/// Rows of the histogram to log when it is not written to a file.
+constexpr size_t LOGGED_HIST_ROWS = 16;
+
+std::string decode_kmer(const key_type &kmer, uint32_t k) {
+#if (KEY_LEN > 8)
+  return WideDNAKMer<KEY_LEN / 8>::decode(kmer, k);
+#else
+  return WideDNAKMer<2>::decode(WideKey<2>(kmer), k);
+#endif
+}
+
+void print_kmer_spectrum(const Configuration &config,
+                         const KmerSpectrum<key_type> &spectrum,
+                         uint64_t scan_cycles) {
+  const auto hist = spectrum.histogram();
+  const uint64_t singletons =
+      !hist.empty() && hist.front().first == 1 ? hist.front().second : 0;
+  PLOG_INFO.printf(
+      "K-mer spectrum: %lu distinct, %lu total, %lu singletons (scan took "
+      "%lu cycles)",
+      spectrum.distinct(), spectrum.total(), singletons, scan_cycles);
+
+  if (!config.ht_file.empty()) {
+    const std::string outfile = config.ht_file + ".hist";
+    PLOG_INFO.printf("Printing count histogram to file: %s", outfile.c_str());
+    std::ofstream f(outfile);
+    for (const auto &[count, num] : hist) {
+      f << count << " " << num << std::endl;
+    }
+  } else {
+    for (size_t i = 0; i < std::min(hist.size(), LOGGED_HIST_ROWS); i++) {
+      PLOG_INFO.printf("  count %lu: %lu k-mers", hist[i].first,
+                       hist[i].second);
+    }
+  }
+
+  const auto top = spectrum.top();
+  for (size_t i = 0; i < top.size(); i++) {
+    PLOG_INFO << "  top " << i + 1 << ": "
+              << decode_kmer(top[i].second, config.K) << " "
+              << top[i].first;
+  }
+}
+}  // namespace
+
+void report_kmer_spectrum(const Configuration &config, SpectrumShared *shared,
+                          const KmerSpectrum<key_type> &spectrum,
+                          uint64_t scan_cycles) {
+  const std::lock_guard<std::mutex> lock(shared->mutex);
+  shared->merged.merge(spectrum);
+  shared->max_scan_cycles = std::max(shared->max_scan_cycles, scan_cycles);
+  if (++shared->num_reported == shared->num_threads) {
+    print_kmer_spectrum(config, shared->merged, shared->max_scan_cycles);
+  }
+}
+
+}  // namespace kmercounter
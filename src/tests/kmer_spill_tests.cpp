@@ -0,0 +1,300 @@
+#include "tests/KmerTest.hpp"
+
+#include <algorithm>
+#include <barrier>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <plog/Log.h>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "hashtables/base_kht.hpp"
+#include "hashtables/batch_runner/batch_runner.hpp"
+#include "hashtables/kvtypes.hpp"
+#include "input_reader/gzip_file.hpp"
+#include "input_reader/mmap_file.hpp"
+#include "input_reader/scheduler.hpp"
+#include "misc_lib.h"
+#include "sync.h"
+#include "types.hpp"
+#include "utils/radix_partition.hpp"
+#include "utils/spill_buckets.hpp"
+
+namespace kmercounter {
+namespace {
+constexpr uint64_t MiB = 1ull << 20;
+/// Keys read from a bucket at a time by a thread.
+constexpr uint64_t READ_CHUNK_KEYS = MiB / sizeof(uint64_t);
+/// Bounds on the staging buffer of a bucket per thread; smaller buffers
+/// would no longer make large writes.
+constexpr uint64_t MIN_SPILL_BUFFER_KEYS = 512;
+constexpr uint64_t MAX_SPILL_BUFFER_KEYS = 128 << 10;
+/// Spill files are open all at once.
+constexpr uint32_t MAX_BUCKET_BITS = 10;
+
+/// Slots of a table that holds `num_keys` keys, were they all distinct, at
+/// the configured fill.
+uint64_t table_slots(const Configuration &config, uint64_t num_keys) {
+  return std::bit_ceil(
+      std::max<uint64_t>(num_keys * 100 / config.ht_fill, 1));
+}
+
+uint64_t read_buffers(const Configuration &config) {
+  return config.num_threads * READ_CHUNK_KEYS * sizeof(uint64_t);
+}
+
+uint64_t table_budget(const Configuration &config) {
+  return config.mem_budget * MiB - read_buffers(config);
+}
+
+/// Bytes of FASTQ in the input, uncompressed.
+uint64_t input_bytes(const Configuration &config) {
+  using namespace input_reader;
+  std::vector<std::string> paths;
+  if (!config.in_manifest.empty() || is_glob(config.in_file)) {
+    for (const auto &file :
+         list_input_files(config.in_file, config.in_manifest)) {
+      paths.push_back(file.path);
+      if (!file.mate.empty()) {
+        paths.push_back(file.mate);
+      }
+    }
+  } else {
+    paths.push_back(config.in_file);
+  }
+  uint64_t bytes = 0;
+  for (const auto &path : paths) {
+    bytes += is_gzip_file(path)
+                 ? gzip_uncompressed_size(MmapFile(path).view())
+                 : get_file_size(path.c_str());
+  }
+  return bytes;
+}
+
+/// Pick the number of buckets from the input size so that a bucket is about
+/// half of the table budget, leaving room to merge buckets after the fact.
+void plan_buckets(const Configuration &config, ExternalShared *shared) {
+  // A FASTQ file is about half bases, and there are at most as many KMers.
+  const uint64_t est_kmers = input_bytes(config) / 2;
+  const uint64_t est_bytes =
+      table_slots(config, est_kmers) * sizeof(KVType);
+  const uint64_t num_buckets =
+      std::bit_ceil(2 * est_bytes / table_budget(config) + 1);
+  shared->bits = std::min<uint32_t>(std::bit_width(num_buckets) - 1,
+                                    MAX_BUCKET_BITS);
+  PLOG_WARNING_IF(std::bit_width(num_buckets) - 1 > MAX_BUCKET_BITS)
+      << "Input needs more than " << (1 << MAX_BUCKET_BITS)
+      << " buckets; the memory budget will be exceeded";
+
+  // Half of the budget goes to the staging buffers while ingesting. Rather
+  // than buffers too small to make large writes, or beyond the budget, there
+  // are fewer and larger buckets.
+  const uint64_t staging_keys =
+      config.mem_budget * MiB / 2 / sizeof(uint64_t) / config.num_threads;
+  const uint32_t bits = shared->bits;
+  while (shared->bits > 0 &&
+         (staging_keys >> shared->bits) < MIN_SPILL_BUFFER_KEYS) {
+    shared->bits--;
+  }
+  if ((staging_keys >> shared->bits) < MIN_SPILL_BUFFER_KEYS) {
+    PLOG_ERROR << "Memory budget of " << config.mem_budget
+               << " MiB leaves no room for spill buffers with "
+               << config.num_threads << " threads";
+    exit(-1);
+  }
+  PLOG_WARNING_IF(shared->bits < bits)
+      << "Spilling to " << (1 << shared->bits) << " buckets instead of "
+      << (1 << bits) << " to stay within the memory budget";
+  shared->keys_per_buffer =
+      std::min(staging_keys >> shared->bits, MAX_SPILL_BUFFER_KEYS);
+  shared->buckets =
+      std::make_unique<SpillBuckets<>>(config.spill_dir, 1u << shared->bits);
+}
+
+#if (KEY_LEN <= 8)
+/// Merge consecutive buckets into rounds whose tables fit the budget.
+void plan_rounds(const Configuration &config, ExternalShared *shared) {
+  const uint64_t budget = table_budget(config);
+  const auto &buckets = *shared->buckets;
+  shared->range_begin = {0};
+  shared->range_slots.clear();
+  uint64_t keys = 0;
+  for (uint32_t b = 0; b < buckets.num_buckets(); b++) {
+    const uint64_t merged = keys + buckets.size(b);
+    if (keys > 0 && table_slots(config, merged) * sizeof(KVType) > budget) {
+      shared->range_begin.push_back(b);
+      shared->range_slots.push_back(table_slots(config, keys));
+      keys = buckets.size(b);
+    } else {
+      keys = merged;
+    }
+    PLOG_WARNING_IF(table_slots(config, buckets.size(b)) * sizeof(KVType) >
+                    budget)
+        << "Bucket " << b << " (" << buckets.size(b)
+        << " kmers) does not fit the memory budget on its own";
+  }
+  shared->range_begin.push_back(buckets.num_buckets());
+  shared->range_slots.push_back(table_slots(config, keys));
+}
+
+/// The slice of `bucket` read by thread `tid`.
+std::pair<uint64_t, uint64_t> slice(const SpillBuckets<> &buckets,
+                                    uint32_t bucket, uint32_t tid,
+                                    uint32_t num_threads) {
+  const uint64_t n = buckets.size(bucket);
+  return {n * tid / num_threads, n * (tid + 1) / num_threads};
+}
+#endif  // KEY_LEN <= 8
+}  // namespace
+
+ExternalShared::ExternalShared(const Configuration &config)
+    : phase(config.num_threads) {
+  if (config.mem_budget * MiB <= read_buffers(config)) {
+    PLOG_ERROR << "Memory budget of " << config.mem_budget
+               << " MiB leaves no room for a hashtable with "
+               << config.num_threads << " threads";
+    exit(-1);
+  }
+  plan_buckets(config, this);
+}
+
+void KmerTest::count_kmer_external(
+    Shard *sh, const Configuration &config,
+    const std::function<BaseHashTable *(uint64_t)> &make_ht,
+    SpinBarrier *barrier) {
+#if (KEY_LEN > 8)
+  PLOG_FATAL << "Out-of-core counting supports K <= 32 only";
+#else
+  ExternalShared &shared = *this->external;
+  auto &phase = shared.phase;
+  const uint32_t tid = sh->shard_idx;
+  const uint32_t num_threads = config.num_threads;
+
+  auto reader = make_kmer_reader(config, this->scheduler.get(), sh->shard_idx,
+                                 config.num_threads);
+
+  // Wait for all readers finish initializing.
+  barrier->arrive_and_wait(sh->shard_idx);
+
+  std::uint64_t start_cycles{}, spill_cycles{};
+  std::uint64_t num_kmers{};
+  std::chrono::time_point<std::chrono::steady_clock> start_ts, end_ts;
+  const auto start = _rdtsc();
+  if (tid == 0) {
+    start_ts = std::chrono::steady_clock::now();
+    start_cycles = start;
+  }
+
+  // Ingest: spill the KMers to their buckets.
+  {
+    SpillWriter<> writer(*shared.buckets, shared.keys_per_buffer);
+    for (KMerInputReader::value_type kmer; reader->next(&kmer);) {
+      writer.push(radix::partition_of(radix::mix(kmer), shared.bits), kmer);
+      num_kmers++;
+    }
+  }
+  reader.reset();
+  phase.arrive_and_wait();
+
+  if (tid == 0) {
+    spill_cycles = _rdtsc();
+    plan_rounds(config, &shared);
+    shared.fill = shared.max_count = shared.max_capacity = 0;
+    PLOG_INFO.printf("Spilled kmers to %u buckets in %llu cycles; counting "
+                     "in %zu rounds",
+                     shared.buckets->num_buckets(), spill_cycles - start_cycles,
+                     shared.range_slots.size());
+  }
+  phase.arrive_and_wait();
+
+  // Count one range of buckets at a time, while the kernel reads ahead the
+  // next one.
+  const auto &buckets = *shared.buckets;
+  const size_t num_rounds = shared.range_slots.size();
+  std::vector<uint64_t> chunk(READ_CHUNK_KEYS);
+  KmerSpectrum<key_type> spectrum(config.top_k);
+  uint64_t spectrum_cycles = 0;
+  for (size_t r = 0; r < num_rounds; r++) {
+    if (r + 1 < num_rounds) {
+      for (auto b = shared.range_begin[r + 1]; b < shared.range_begin[r + 2];
+           b++) {
+        const auto [begin, end] = slice(buckets, b, tid, num_threads);
+        buckets.prefetch(b, begin, end);
+      }
+    }
+
+    BaseHashTable *ht = make_ht(shared.range_slots[r]);
+    {
+      HTBatchRunner batch_runner(ht);
+      for (auto b = shared.range_begin[r]; b < shared.range_begin[r + 1];
+           b++) {
+        const auto [begin, end] = slice(buckets, b, tid, num_threads);
+        for (uint64_t at = begin; at < end; at += READ_CHUNK_KEYS) {
+          const std::span<uint64_t> keys(
+              chunk.data(), std::min(READ_CHUNK_KEYS, end - at));
+          buckets.read(b, at, keys);
+          batch_runner.insert_batch(keys, 0);
+        }
+        buckets.release(b, begin, end);
+      }
+      batch_runner.flush_insert();
+    }
+    phase.arrive_and_wait();
+
+    if (config.kmer_spectrum) {
+      const auto spectrum_start = _rdtsc();
+      ht->collect_spectrum(tid, num_threads, spectrum);
+      spectrum_cycles += _rdtsc() - spectrum_start;
+    }
+
+    // The table is shared; one thread is enough for the stats.
+    if (tid == 0) {
+      shared.fill += ht->get_fill();
+      shared.max_count = std::max(shared.max_count, ht->get_max_count());
+      shared.max_capacity = std::max(shared.max_capacity, ht->get_capacity());
+      if (!config.ht_file.empty()) {
+        std::string outfile = config.ht_file + std::to_string(r);
+        PLOG_INFO.printf("Round %zu: Printing to file: %s", r,
+                         outfile.c_str());
+        ht->print_to_file(outfile);
+      }
+    }
+    phase.arrive_and_wait();
+    // Every thread drops its reference before the next round allocates the
+    // table anew.
+    delete ht;
+    phase.arrive_and_wait();
+  }
+  barrier->arrive_and_wait(sh->shard_idx);
+  if (config.kmer_spectrum) {
+    report_kmer_spectrum(config, this->spectrum.get(), spectrum,
+                         spectrum_cycles);
+  }
+
+  sh->stats->insertions.duration = _rdtsc() - start;
+  sh->stats->insertions.op_count = num_kmers;
+  sh->stats->ht_fill = shared.fill;
+  sh->stats->ht_capacity = shared.max_capacity;
+  sh->stats->max_count = shared.max_count;
+
+  if (tid == 0) {
+    end_ts = std::chrono::steady_clock::now();
+    PLOG_INFO.printf(
+        "Out-of-core kmer counting took %llu us (%llu cycles), counting %llu "
+        "cycles",
+        chrono::duration_cast<chrono::microseconds>(end_ts - start_ts).count(),
+        _rdtsc() - start_cycles, _rdtsc() - spill_cycles);
+  }
+  PLOGV.printf("[%d] Num kmers %llu", sh->shard_idx, num_kmers);
+  phase.arrive_and_wait();
+  if (tid == 0) {
+    shared.buckets.reset();
+  }
+#endif  // KEY_LEN > 8
+}
+
+}  // namespace kmercounter
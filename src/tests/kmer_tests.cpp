@@ -2,9 +2,10 @@
 
 #include <algorithm>
 #include <atomic>
-#include <barrier>
+#include <bit>
 #include <cstdint>
 #include <plog/Log.h>
+#include <span>
 
 #include "constants.hpp"
 #include "hashtables/base_kht.hpp"
@@ -13,20 +14,213 @@
 #include "sync.h"
 #include "input_reader/fastq.hpp"
 #include "input_reader/counter.hpp"
+#include "input_reader/scheduler.hpp"
 #include "types.hpp"
 #include "print_stats.h"
+#include "utils/singleton_filter.hpp"
 
 namespace kmercounter {
+namespace {
+/// Instantiate the scalar or vectorized reader of `Readers` (see
+/// `input_reader::FastqKMerReaders`).
+template <class Readers, typename... Args>
+std::unique_ptr<input_reader::InputReaderU64> make_reader(
+    const Configuration& config, Args&&... args) {
+  // Be care of the `K` here; it's a compile time constant.
+  if (config.simd_kmer) {
+    return input_reader::MakeKMerReader<Readers::template SimdReader,
+                                        input_reader::KMerBatchReader>(
+        config.K, std::forward<Args>(args)...);
+  }
+  return input_reader::MakeKMerReader<Readers::template Reader>(
+      config.K, std::forward<Args>(args)...);
+}
+
+/// The reader of the sequences of partition `part_id` of `num_parts` of the
+/// FASTQ file `path`, with the backend of `config`.
+std::unique_ptr<input_reader::InputReader<std::string_view>> open_sequences(
+    const Configuration& config, const std::string& path, uint64_t part_id,
+    uint64_t num_parts) {
+  using namespace input_reader;
+  const uint8_t q = config.min_quality;
+  if (is_gzip_file(path)) {
+    return std::make_unique<QualityFastqReader<GzipFileReader>>(
+        q, path, part_id, num_parts);
+  }
+  switch (config.input_backend) {
+    case MMAP_INPUT:
+      return std::make_unique<QualityFastqReader<MmapFileReader>>(
+          q, path, part_id, num_parts);
+    case ASYNC_INPUT:
+      return std::make_unique<QualityFastqReader<AsyncFileReader>>(
+          q, path, part_id, num_parts, config.direct_io);
+    case PRELOAD_INPUT:
+    default:
+      return std::make_unique<QualityFastqReader<FileReader>>(
+          q, path, part_id, num_parts);
+  }
+}
+
+/// Open the ranges of a `ScheduledSequenceReader` with the backend of
+/// `config`.
+input_reader::ScheduledSequenceReader::Opener range_opener(
+    const Configuration& config) {
+  return [&config](const std::string& path, uint64_t part_id,
+                   uint64_t num_parts) {
+    return open_sequences(config, path, part_id, num_parts);
+  };
+}
+
+#if (KEY_LEN > 8)
+template <bool Canonical>
+std::unique_ptr<KMerInputReader> make_kmer_reader(
+    const Configuration& config, input_reader::InputScheduler* scheduler,
+    uint64_t part_id, uint64_t num_parts) {
+  using namespace input_reader;
+  // K is a runtime value for the wide readers.
+  constexpr size_t N = sizeof(key_type) / sizeof(uint64_t);
+  const uint8_t q = config.min_quality;
+  PLOG_WARNING_IF(config.simd_kmer)
+      << "SIMD KMer extraction supports K <= 32 only; ignoring --simd-kmer";
+  if (scheduler) {
+    return std::make_unique<
+        WideFastqKMerReader<N, ScheduledSequenceReader, Canonical>>(
+        config.K, scheduler, part_id, range_opener(config));
+  }
+  if (is_gzip_file(config.in_file)) {
+    return std::make_unique<
+        WideFastqKMerReader<N, QualityFastqReader<GzipFileReader>, Canonical>>(
+        config.K, q, config.in_file, part_id, num_parts);
+  }
+  switch (config.input_backend) {
+    case MMAP_INPUT:
+      return std::make_unique<
+          WideFastqKMerReader<N, QualityFastqReader<MmapFileReader>, Canonical>>(
+          config.K, q, config.in_file, part_id, num_parts);
+    case ASYNC_INPUT:
+      return std::make_unique<WideFastqKMerReader<
+          N, QualityFastqReader<AsyncFileReader>, Canonical>>(
+          config.K, q, config.in_file, part_id, num_parts, config.direct_io);
+    case PRELOAD_INPUT:
+    default:
+      return std::make_unique<WideFastqKMerPreloadReader<
+          N, Canonical, QualityFastqReader<FileReader>>>(
+          config.K, q, config.in_file, part_id, num_parts);
+  }
+}
+#else
+template <bool Canonical>
+std::unique_ptr<KMerInputReader> make_kmer_reader(
+    const Configuration& config, input_reader::InputScheduler* scheduler,
+    uint64_t part_id, uint64_t num_parts) {
+  using namespace input_reader;
+  // Low quality bases are masked while parsing; see `QualityFastqReader`.
+  const uint8_t q = config.min_quality;
+  if (scheduler) {
+    return make_reader<FastqKMerReaders<ScheduledSequenceReader, Canonical>>(
+        config, scheduler, part_id, range_opener(config));
+  }
+  // Compressed input is always streamed through the decompressor.
+  if (is_gzip_file(config.in_file)) {
+    return make_reader<
+        FastqKMerReaders<QualityFastqReader<GzipFileReader>, Canonical>>(
+        config, q, config.in_file, part_id, num_parts);
+  }
+  switch (config.input_backend) {
+    case MMAP_INPUT:
+      return make_reader<
+          FastqKMerReaders<QualityFastqReader<MmapFileReader>, Canonical>>(
+          config, q, config.in_file, part_id, num_parts);
+    case ASYNC_INPUT:
+      return make_reader<
+          FastqKMerReaders<QualityFastqReader<AsyncFileReader>, Canonical>>(
+          config, q, config.in_file, part_id, num_parts, config.direct_io);
+    case PRELOAD_INPUT:
+    default:
+      return make_reader<
+          FastqKMerPreloadReaders<Canonical, QualityFastqReader<FileReader>>>(
+          config, q, config.in_file, part_id, num_parts);
+  }
+}
+#endif  // KEY_LEN > 8
+}  // namespace
+
+std::unique_ptr<input_reader::InputScheduler> make_input_scheduler(
+    const Configuration& config, uint64_t num_parts) {
+  using namespace input_reader;
+  if (config.in_manifest.empty() && !is_glob(config.in_file)) {
+    return nullptr;
+  }
+  auto scheduler = std::make_unique<InputScheduler>(
+      list_input_files(config.in_file, config.in_manifest), num_parts);
+  PLOG_INFO.printf("Reading %zu input files in %zu ranges with %lu threads",
+                   scheduler->files().size(), scheduler->num_ranges(),
+                   num_parts);
+  return scheduler;
+}
+
+std::unique_ptr<KMerInputReader> make_kmer_reader(
+    const Configuration& config, input_reader::InputScheduler* scheduler,
+    uint64_t part_id, uint64_t num_parts) {
+  if (config.canonical_kmer) {
+    return make_kmer_reader<true>(config, scheduler, part_id, num_parts);
+  }
+  return make_kmer_reader<false>(config, scheduler, part_id, num_parts);
+}
+
+std::unique_ptr<input_reader::InputReader<std::string_view>>
+make_sequence_reader(const Configuration& config,
+                     input_reader::InputScheduler* scheduler,
+                     uint64_t part_id, uint64_t num_parts) {
+  if (scheduler) {
+    return std::make_unique<input_reader::ScheduledSequenceReader>(
+        scheduler, part_id, range_opener(config));
+  }
+  return open_sequences(config, config.in_file, part_id, num_parts);
+}
+
+void KmerTest::prepare(const Configuration& config) {
+  this->radix.reset();
+  this->external.reset();
+  this->spectrum.reset();
+  this->filter.reset();
+  this->multi_k.reset();
+  this->scheduler = make_input_scheduler(config, config.num_threads);
+  if (config.kmer_spectrum) {
+    this->spectrum =
+        std::make_unique<SpectrumShared>(config, config.num_threads);
+  }
+  if (!config.spill_dir.empty()) {
+    this->external = std::make_unique<ExternalShared>(config);
+  } else if (!config.k_list.empty()) {
+    this->multi_k = std::make_unique<MultiKShared>(config);
+  } else if (config.radix_kmer) {
+    this->radix = std::make_unique<RadixShared>(config.num_threads);
+#if (KEY_LEN <= 8)
+  } else if (config.singleton_filter > 0) {
+    this->filter =
+        std::make_unique<FilterShared>(config.singleton_filter << 20);
+#endif
+  }
+}
+
 void KmerTest::count_kmer(Shard* sh,
                               const Configuration& config,
                               BaseHashTable* ht,
-                              std::barrier<VoidFn>* barrier){
-  // Be care of the `K` here; it's a compile time constant.
-  auto reader = input_reader::MakeFastqKMerPreloadReader(config.K, config.in_file, sh->shard_idx, config.num_threads);
+                              SpinBarrier *barrier){
+  auto reader = make_kmer_reader(config, this->scheduler.get(), sh->shard_idx,
+                                 config.num_threads);
   HTBatchRunner batch_runner(ht);
 
+  // The filter in front of the table is shared by all threads.
+  FilterShared *const filter = this->filter.get();
+#if (KEY_LEN > 8)
+  PLOG_WARNING_IF(sh->shard_idx == 0 && config.singleton_filter > 0)
+      << "The singleton filter supports K <= 32 only; counting without it";
+#endif
+
   // Wait for all readers finish initializing.
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(sh->shard_idx);
 
   // start timers
   std::uint64_t start {}, end {};
@@ -40,13 +234,61 @@ void KmerTest::count_kmer(Shard* sh,
     start_cycles = _rdtsc();
   }
 
+  // Insert a k-mer from its second sighting on, the second one counting for
+  // the first as well.
+  uint64_t dropped{}, promoted{};
+#if (KEY_LEN <= 8)
+  auto insert_seen = [&](uint64_t kmer, SingletonFilter::Sighting sighting) {
+    switch (sighting) {
+      case SingletonFilter::Sighting::First:
+        dropped++;
+        return;
+      case SingletonFilter::Sighting::Second:
+        promoted++;
+        batch_runner.insert(kmer, 0);
+        [[fallthrough]];
+      case SingletonFilter::Sighting::Repeat:
+        batch_runner.insert(kmer, 0);
+    }
+  };
+#endif
+
   // Inser Kmers into hashtable
-  for (uint64_t kmer; reader->next(&kmer);) {
-    batch_runner.insert(kmer, 0 /* we use the aggr tables so no value */);
-    num_kmers++;
+  if (filter) {
+#if (KEY_LEN <= 8)
+    if (auto batch_reader =
+            dynamic_cast<input_reader::KMerBatchReader*>(reader.get())) {
+      for (std::span<const uint64_t> kmers;
+           batch_reader->next_batch(&kmers);) {
+        filter->filter.see_batch(kmers, insert_seen);
+        num_kmers += kmers.size();
+      }
+    } else {
+      for (KMerInputReader::value_type kmer; reader->next(&kmer);) {
+        insert_seen(kmer, filter->filter.see(kmer));
+        num_kmers++;
+      }
+    }
+#endif
+  } else if (auto batch_reader =
+          dynamic_cast<input_reader::KMerBatchReader*>(reader.get())) {
+    // Whole batches of extracted kmers go straight to the batch runner.
+    for (std::span<const uint64_t> kmers; batch_reader->next_batch(&kmers);) {
+      batch_runner.insert_batch(kmers, 0);
+      num_kmers += kmers.size();
+    }
+  } else {
+    for (KMerInputReader::value_type kmer; reader->next(&kmer);) {
+      batch_runner.insert(kmer, 0 /* we use the aggr tables so no value */);
+      num_kmers++;
+    }
   }
   batch_runner.flush_insert();
-  barrier->arrive_and_wait();
+  if (filter) {
+    filter->num_dropped += dropped;
+    filter->num_promoted += promoted;
+  }
+  barrier->arrive_and_wait(sh->shard_idx);
 
   sh->stats->insertions.duration = _rdtsc() - start;
   sh->stats->insertions.op_count = num_kmers;
@@ -62,6 +304,24 @@ void KmerTest::count_kmer(Shard* sh,
   PLOGV.printf("[%d] Num kmers %llu", sh->shard_idx, num_kmers);
 
   get_ht_stats(sh, ht);
+
+  if (filter && sh->shard_idx == 0) {
+    // All threads have added their counts before the last barrier. Every
+    // k-mer in the table was promoted once, so the promotions tell the
+    // capacity the table needs at the configured fill.
+    const uint64_t num_promoted = filter->num_promoted.load();
+    const uint64_t needed = std::bit_ceil(
+        std::max<uint64_t>(num_promoted * 100 / config.ht_fill, 1));
+    PLOG_INFO.printf(
+        "Singleton filter (%lu MiB): dropped %lu first sightings, promoted "
+        "%lu k-mers; table holds %lu k-mers in %lu of its %lu MiB, and "
+        "%lu MiB (--ht-size %lu) would do",
+        filter->filter.size_bytes() >> 20, filter->num_dropped.load(),
+        num_promoted, sh->stats->ht_fill,
+        (sh->stats->ht_fill * sizeof(KVType)) >> 20,
+        (ht->get_capacity() * sizeof(KVType)) >> 20,
+        (needed * sizeof(KVType)) >> 20, needed);
+  }
 }
 
 } // namespace kmercounter
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cinttypes>
+#include <optional>
 #include <tuple>
 
 #include "fastrange.h"
@@ -11,13 +13,18 @@
 #include "input_reader/csv.hpp"
 #include "input_reader/eth_rel_gen.hpp"
 #include "input_reader/fastq.hpp"
+#include "input_reader/minimizer.hpp"
 #include "misc_lib.h"
 #include "print_stats.h"
 #include "queues/bqueue_aligned.hpp"
 #include "queues/lynxq.hpp"
+#include "queues/mpsc_section_queue.hpp"
 #include "queues/section_queues.hpp"
 #include "sync.h"
+#include "tests/KmerTest.hpp"
 #include "tests/QueueTest.hpp"
+#include "utils/aggregation_buffer.hpp"
+#include "utils/hot_keys.hpp"
 #include "utils/hugepage_allocator.hpp"
 #include "utils/vtune.hpp"
 #include "xorwow.hpp"
@@ -63,6 +70,11 @@ auto get_ht_size = [](int ncons) {
   return ht_size;
 };
 
+// The partitions of the table: one per consumer unless asked for more.
+static uint32_t num_table_partitions(uint32_t n_cons) {
+  return config.num_partitions ? config.num_partitions : n_cons;
+}
+
 std::vector<key_type, huge_page_allocator<key_type>> *zipf_values;
 
 void init_zipfian_dist(double skew, int64_t seed) {
@@ -126,6 +138,17 @@ static auto hash_to_cpu(std::uint32_t hash, unsigned int count) {
   return fastrange32(_mm_crc32_u32(0xffffffff, hash), count);
 };
 
+// With skew-aware routing, a producer counts a key itself once it makes up
+// this share of the messages of a consumer.
+static constexpr double HOT_KEY_SHARE = 0.25;
+// A key counted by a producer, hot or pre-aggregated, reaches its owner as
+// a single {key, MERGED_COUNT | count}. The other values lose their top bit.
+static constexpr uint64_t MERGED_COUNT = 1ull << 63;
+// The end of a round of inserts from a producer, when the partitions may
+// change owners: {BQ_MAGIC_64BIT, PHASE_END}, and fillers to publish it.
+static constexpr uint64_t PHASE_END = 1;
+static constexpr uint64_t PHASE_FILLER = 0;
+
 static auto get_current_node() { return numa_node_of_cpu(sched_getcpu()); };
 
 static auto mbind_buffer_local(void *buf, ssize_t sz) {
@@ -142,7 +165,7 @@ static auto mbind_buffer_local(void *buf, ssize_t sz) {
 }
 
 
-std::barrier<std::function<void()>> *prod_barrier;
+SpinBarrier *prod_barrier = nullptr;
 uint64_t g_rw_start, g_rw_end;
 std::vector<cacheline> toxic_waste_dump(1024 * 1024 * 1024 / sizeof(cacheline));
 
@@ -150,7 +173,7 @@ template <typename T>
 void QueueTest<T>::producer_thread(
     const uint32_t tid, const uint32_t n_prod, const uint32_t n_cons,
     const bool main_thread, const double skew, bool is_join,
-    std::barrier<std::function<void()>> *barrier) {
+    SpinBarrier *barrier) {
   // Get shard pointer from the shards array
   Shard *sh = &this->shards[tid];
 
@@ -168,6 +191,11 @@ void QueueTest<T>::producer_thread(
 
   auto [ratio, num_messages, key_start] = get_params(n_prod, n_cons, tid);
   Hasher hasher;
+  // Keys go to the owner of their partition.
+  const uint32_t num_parts = num_table_partitions(n_cons);
+  auto owner_of = [&](uint32_t part) {
+    return this->part_map ? this->part_map->owner_of(part) : part;
+  };
 #define CONFIG_NUMA_AFFINITY
 
   for (auto i = 0u; i < n_cons; i++) {
@@ -213,8 +241,8 @@ void QueueTest<T>::producer_thread(
 
 #if defined(BQUEUE_KMER_TEST)
 #warning "BQ KMER TEST"
-  auto reader = input_reader::MakeFastqKMerPreloadReader(
-      config.K, config.in_file, sh->shard_idx, n_prod);
+  auto reader =
+      make_kmer_reader(config, this->scheduler.get(), sh->shard_idx, n_prod);
 #endif
 
   // PLOGD.printf("sh->shard_idx %d, n_prod %d config.relation_r_size %llu
@@ -233,11 +261,52 @@ void QueueTest<T>::producer_thread(
   };
 
   if (tid == 0) {
-    prod_barrier = new std::barrier(config.n_prod, on_completion);
+    // The producers of the previous run are done with theirs.
+    delete prod_barrier;
+    prod_barrier = new SpinBarrier(config.n_prod, on_completion);
   }
   std::size_t next_pollution{};
 
-  barrier->arrive_and_wait();
+  // Skew-aware routing: the keys hot enough to hold up their owner are
+  // counted here, while the rest keep going to their owner one by one.
+  std::optional<HotKeyTracker> hot_keys;
+  if (cfg->skew_routing) {
+    hot_keys.emplace(HOT_KEY_SHARE / n_cons);
+  }
+  // Pre-aggregation: the repeats of a key are merged here until it is
+  // evicted or the phase ends.
+  std::optional<AggregationBuffer> aggr_buffer;
+  if (cfg->aggr_buffer > 0) {
+    aggr_buffer.emplace(cfg->aggr_buffer);
+  }
+#if !defined(BQUEUE_KMER_TEST)
+  // Send `count` occurrences of `key` to its owner at once.
+  auto send_count = [&](uint64_t key, uint64_t count) {
+    const uint32_t owner =
+        owner_of(hash_to_cpu(hasher(&key, sizeof(key)), num_parts));
+    this->queues->enqueue(pqueues[owner], this_prod_id, owner,
+                          count == 1 ? data_t(key, key & ~MERGED_COUNT)
+                                     : data_t(key, MERGED_COUNT | count));
+  };
+#endif
+  auto combine_hot_key = [&](uint64_t key, uint32_t owner) {
+    if (hot_keys->count(key)) {
+      return true;
+    }
+    if (hot_keys->sample(key)) {
+      // Split off a candidate only if its owner lags behind the others.
+      size_t total = 0;
+      for (auto c = 0u; c < n_cons; c++) {
+        total += this->queues->occupancy(this_prod_id, c);
+      }
+      if (this->queues->occupancy(this_prod_id, owner) * n_cons >= total) {
+        hot_keys->promote(key);
+      }
+    }
+    return false;
+  };
+
+  barrier->arrive_and_wait(tid);
 
   PLOGV.printf(
       "[prod:%u] started! Sending %lu messages to %d consumers | "
@@ -253,16 +322,16 @@ void QueueTest<T>::producer_thread(
   key_start = key_start_orig;
   auto zipf_idx = key_start == 1 ? 0 : key_start;
   for (transaction_id = 0u; transaction_id < num_messages * cfg->rw_queues;) {
-    k = zipf_values->at(zipf_idx);
+    k = static_cast<uint64_t>(zipf_values->at(zipf_idx));
     ++zipf_idx;
     uint64_t hash_val = hasher(&k, sizeof(k));
-    cons_id = hash_to_cpu(hash_val, n_cons);
+    cons_id = owner_of(hash_to_cpu(hash_val, num_parts));
     auto pq = pqueues[cons_id];
     this->queues->enqueue(pq, this_prod_id, cons_id, {k, k});
     transaction_id++;
   }
 
-  auto ht_size = config.ht_size / n_cons;
+  auto ht_size = config.ht_size / num_parts;
   const auto ktable = init_ht(ht_size, sh->shard_idx);
   this->ht_vec->at(tid) = ktable;
 
@@ -271,7 +340,7 @@ void QueueTest<T>::producer_thread(
   std::array<bool, 1024> flips;
   for (auto &flip : flips) flip = !coin(urbg);  // do a write if true
 
-  prod_barrier->arrive_and_wait();
+  prod_barrier->arrive_and_wait(tid);
 
 #if defined(BQUEUE_KMER_TEST)
   Key kv{};
@@ -288,7 +357,7 @@ void QueueTest<T>::producer_thread(
   for (auto j = 0u; j < config.insert_factor; j++) {
     key_start = key_start_orig;
     auto zipf_idx = key_start == 1 ? 0 : key_start;
-    std::uint64_t kmer{};
+    KMerInputReader::value_type kmer{};
 #if defined(XORWOW)
     _xw_state = init_state;
 #endif
@@ -304,7 +373,9 @@ void QueueTest<T>::producer_thread(
 #endif
       if (is_join) {
         // num_kmers++;
-        kv.key = k = kmer;
+        kv.key = kmer;
+        // Wide KMers are routed by their low word.
+        k = static_cast<uint64_t>(kmer);
 #if defined(BQUEUE_KMER_TEST)
 #else
         kv.value = 0;
@@ -321,7 +392,7 @@ void QueueTest<T>::producer_thread(
         if (!(zipf_idx & 7) && zipf_idx + 16 < zipf_values->size())
           prefetch_object<false>(&zipf_values->at(zipf_idx + 16), 64);
 
-      k = zipf_values->at(zipf_idx);
+      k = static_cast<uint64_t>(zipf_values->at(zipf_idx));
       kv = data_t(k, k);
       //PLOGV.printf("zipf_values[%" PRIu64 "] = %" PRIu64, zipf_idx, k);
       zipf_idx++;
@@ -335,7 +406,8 @@ void QueueTest<T>::producer_thread(
       // XXX: if we are testing without insertions, make sure to pick CRC as
       // the hashing mechanism to have reduced overhead
       uint64_t hash_val = hasher(&k, sizeof(k));
-      cons_id = hash_to_cpu(hash_val, n_cons);
+      const uint32_t part = hash_to_cpu(hash_val, num_parts);
+      cons_id = owner_of(part);
 
       if (!cfg->rw_queues || flips[transaction_id & 1023]) {  // TODO
 #if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
@@ -345,6 +417,23 @@ void QueueTest<T>::producer_thread(
 #endif
         // if (++cons_id >= n_cons) cons_id = 0;
 
+        if (hot_keys && k != 0) {
+          if (combine_hot_key(k, cons_id)) {
+            transaction_id++;
+            continue;
+          }
+        }
+#if !defined(BQUEUE_KMER_TEST)
+        if (aggr_buffer && k != 0) {
+          aggr_buffer->add(k, send_count);
+          transaction_id++;
+          continue;
+        }
+        if (hot_keys) {
+          kv.value &= ~MERGED_COUNT;
+        }
+#endif
+
         auto pq = pqueues[cons_id];
         // PLOGV.printf("Queuing key = %" PRIu64 ", value = %" PRIu64, kv.key,
         // kv.value);
@@ -362,7 +451,7 @@ void QueueTest<T>::producer_thread(
         auto &item = items[next_item];
         items[next_item].key = k;
         items[next_item].id = item_id++;
-        items[next_item].part_id = cons_id + n_prod;
+        items[next_item].part_id = part + n_prod;
         if (next_item == 0) ktable->prefetch_queue(QueueType::find_queue);
 
         ++next_item;
@@ -381,7 +470,34 @@ void QueueTest<T>::producer_thread(
 
       transaction_id++;
     }
+
+#if !defined(BQUEUE_KMER_TEST)
+    if (this->phase_barrier && j + 1 < config.insert_factor) {
+      // Wait for the consumers to take in the round, so that the partitions
+      // can change owners before the next one.
+      for (auto c = 0u; c < n_cons; c++) {
+        this->queues->enqueue(pqueues[c], this_prod_id, c,
+                              data_t(T::BQ_MAGIC_64BIT, PHASE_END));
+        this->queues->flush(this_prod_id, c,
+                            data_t(T::BQ_MAGIC_64BIT, PHASE_FILLER));
+      }
+      this->phase_barrier->arrive_and_wait(tid);
+    }
+#endif
+  }
+
+#if !defined(BQUEUE_KMER_TEST)
+  if (hot_keys) {
+    PLOG_DEBUG.printf("Producer %d counted %u hot keys", this_prod_id,
+                      hot_keys->num_hot());
+    hot_keys->drain(send_count);
   }
+  if (aggr_buffer) {
+    PLOG_DEBUG.printf("Producer %d evicted %" PRIu64 " merged keys",
+                      this_prod_id, aggr_buffer->num_evictions());
+    aggr_buffer->drain(send_count);
+  }
+#endif
 
   // enqueue halt messages and the consumer automatically knows
   // when to stop
@@ -395,7 +511,9 @@ void QueueTest<T>::producer_thread(
 
   auto t_end = RDTSCP();
 
-  prod_barrier->arrive_and_wait();
+  prod_barrier->arrive_and_wait(tid);
+  // The driver adds the wait at the barriers of all threads.
+  sh->stats->barrier_wait = prod_barrier->wait_cycles(tid);
 
   if (main_thread) {
     vtune::event_end(event);
@@ -420,7 +538,7 @@ void QueueTest<T>::producer_thread(
 template <typename T>
 void QueueTest<T>::consumer_thread(
     const uint32_t tid, const uint32_t n_prod, const uint32_t n_cons,
-    const uint32_t num_nops, std::barrier<std::function<void()>> *barrier) {
+    const uint32_t num_nops, SpinBarrier *barrier) {
   // Get shard pointer from the shards array
   Shard *sh = &this->shards[tid];
 
@@ -477,7 +595,7 @@ void QueueTest<T>::consumer_thread(
     (*this->ht_vec)[tid] = kmer_ht;
   }
 
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(tid);
 
   PLOG_DEBUG.printf("[cons:%u] starting", this_cons_id);
 
@@ -581,9 +699,26 @@ void QueueTest<T>::consumer_thread(
         goto pick_next_msg;
       }
 
+#if !defined(BQUEUE_KMER_TEST)
+      if ((config.skew_routing || config.aggr_buffer > 0) &&
+          (kv.value & MERGED_COUNT)) [[unlikely]] {
+        // All the occurrences of a key that a producer merged at once.
+        const uint64_t occurrences = kv.value & ~MERGED_COUNT;
+        if (bq_load == BQUEUE_LOAD::HtInsert) {
+          InsertFindArgument item{};
+          item.key = kv.key;
+          item.id = static_cast<uint64_t>(kv.key);
+          kmer_ht->insert_count(&item, occurrences, collector);
+          inserted += occurrences;
+        }
+        transaction_id += occurrences;
+        continue;
+      }
+#endif
+
       if (bq_load == BQUEUE_LOAD::HtInsert) {
         items[data_idx].key = kv.key;
-        items[data_idx].id = kv.key;
+        items[data_idx].id = static_cast<uint64_t>(kv.key);
         //PLOGV.printf("sizeof items %zu | size of kv.key %zu",
         //          sizeof(_items[data_idx].key), sizeof(kv.key));
         //_items[data_idx].value = k & 0xffffffff;
@@ -630,6 +765,13 @@ void QueueTest<T>::consumer_thread(
 
   if (bq_load == BQUEUE_LOAD::HtInsert) {
     get_ht_stats(sh, kmer_ht);
+    if (this->cfg->kmer_spectrum && this->cfg->mode == FASTQ_WITH_INSERT) {
+      KmerSpectrum<key_type> spectrum(this->cfg->top_k);
+      const auto start = _rdtsc();
+      kmer_ht->collect_spectrum(0, 1, spectrum);
+      report_kmer_spectrum(*this->cfg, this->spectrum, spectrum,
+                           _rdtsc() - start);
+    }
   }
 
   for (auto i = 0u; i < n_prod; ++i) {
@@ -663,9 +805,419 @@ void QueueTest<T>::consumer_thread(
 #endif
 }
 
+template <typename T>
+void QueueTest<T>::partitioned_consumer_thread(
+    const uint32_t tid, const uint32_t n_prod, const uint32_t n_cons,
+    const uint32_t num_nops, SpinBarrier *barrier) {
+  Shard *sh = &this->shards[tid];
+
+#ifdef LATENCY_COLLECTION
+  const auto collector = &collectors.at(tid);
+  collector->claim();
+#else
+  collector_type *const collector{};
+#endif
+
+  sh->stats = (thread_stats *)calloc(1, sizeof(thread_stats));
+
+  const uint32_t this_cons_id = sh->shard_idx - n_prod;
+  const uint32_t num_parts = this->part_map->num_partitions();
+  Hasher hasher;
+  typename T::cons_queue_t *cqueues[n_prod];
+  for (auto i = 0u; i < n_prod; i++) {
+    cqueues[i] = &this->queues->all_cqueues[this_cons_id][i];
+  }
+  vtune::set_threadname("consumer_thread" + std::to_string(tid));
+
+  // The partitions start out on the node of their first owner.
+  const auto part_size = get_ht_size(num_parts);
+  for (auto part : this->part_map->partitions_of(this_cons_id)) {
+    this->partitions[part] = init_ht(part_size, n_prod + part);
+  }
+  (*this->ht_vec)[tid] =
+      this->partitions[this->part_map->partitions_of(this_cons_id).front()];
+
+  // A batch of inserts per partition, and the inserts of the round.
+  std::vector<InsertFindArgument *> batches(num_parts);
+  std::vector<uint32_t> batch_sizes(num_parts);
+  std::vector<uint64_t> part_ops(num_parts);
+  for (auto &batch : batches) {
+    batch = (InsertFindArgument *)aligned_alloc(
+        64, sizeof(InsertFindArgument) * config.batch_len);
+  }
+
+  uint64_t inserted = 0;
+  auto submit_batch = [&](uint32_t part) {
+    InsertFindArguments kp(batches[part], batch_sizes[part]);
+    this->partitions[part]->insert_batch(kp, collector);
+    inserted += kp.size();
+    batch_sizes[part] = 0;
+  };
+  // Go over the partitions of this consumer, so that the prefetches of one
+  // batch overlap with the inserts of the next.
+  auto submit_all = [&]() {
+    for (auto part : this->part_map->partitions_of(this_cons_id)) {
+      if (batch_sizes[part] > 0) {
+        submit_batch(part);
+      }
+    }
+  };
+
+  barrier->arrive_and_wait(tid);
+
+  PLOG_DEBUG.printf("[cons:%u] starting with %zu partitions", this_cons_id,
+                    this->part_map->partitions_of(this_cons_id).size());
+
+  static auto event = -1;
+  if (tid == n_prod) event = vtune::event_start("message_deq");
+
+  auto t_start = RDTSC_START();
+
+#if defined(BQUEUE_KMER_TEST)
+  Key kv{};
+#else
+  KeyValuePair kv{};
+#endif
+  uint64_t transaction_id = 0;
+  uint32_t finished_producers = 0;
+  uint32_t phase_ends = 0;
+  uint64_t active_qmask = 0ull;
+  for (auto i = 0u; i < n_prod; i++) {
+    active_qmask |= (1ull << i);
+  }
+
+  for (uint32_t prod_id = 0; finished_producers < n_prod;
+       prod_id = prod_id + 1 < n_prod ? prod_id + 1 : 0) {
+    if (!(active_qmask & (1ull << prod_id))) {
+      continue;
+    }
+    auto cq = cqueues[prod_id];
+    for (auto i = 0u; i < config.batch_len; i++) {
+      if (this->queues->dequeue(cq, prod_id, this_cons_id, (data_t *)&kv) ==
+          RETRY) {
+        submit_all();
+        break;
+      }
+
+      if ((data_t)kv == T::BQ_MAGIC_KV) [[unlikely]] {
+        finished_producers++;
+        this->queues->pop_done(prod_id, this_cons_id);
+        active_qmask &= ~(1ull << prod_id);
+        break;
+      }
+
+#if !defined(BQUEUE_KMER_TEST)
+      if (kv.key == T::BQ_MAGIC_64BIT) [[unlikely]] {
+        if (kv.value == PHASE_END && ++phase_ends == n_prod) {
+          // Everything of the round is in; let the partitions go.
+          submit_all();
+          for (auto part : this->part_map->partitions_of(this_cons_id)) {
+            this->partitions[part]->flush_insert_queue(collector);
+            this->part_map->add_load(part, part_ops[part]);
+            part_ops[part] = 0;
+          }
+          phase_ends = 0;
+          this->phase_barrier->arrive_and_wait(tid);
+        }
+        continue;
+      }
+#endif
+
+      const uint64_t k = static_cast<uint64_t>(kv.key);
+      const uint32_t part = hash_to_cpu(hasher(&k, sizeof(k)), num_parts);
+
+#if !defined(BQUEUE_KMER_TEST)
+      if ((config.skew_routing || config.aggr_buffer > 0) &&
+          (kv.value & MERGED_COUNT)) [[unlikely]] {
+        const uint64_t occurrences = kv.value & ~MERGED_COUNT;
+        InsertFindArgument item{};
+        item.key = kv.key;
+        item.id = k;
+        this->partitions[part]->insert_count(&item, occurrences, collector);
+        inserted += occurrences;
+        part_ops[part] += occurrences;
+        transaction_id += occurrences;
+        continue;
+      }
+#endif
+
+      auto &item = batches[part][batch_sizes[part]];
+      item.key = kv.key;
+      item.id = k;
+#if !defined(BQUEUE_KMER_TEST)
+      item.value = kv.value;
+#endif
+      part_ops[part]++;
+      if (++batch_sizes[part] == config.batch_len) {
+        submit_batch(part);
+      }
+      transaction_id++;
+    }
+  }
+
+  submit_all();
+  for (auto part : this->part_map->partitions_of(this_cons_id)) {
+    this->partitions[part]->flush_insert_queue(collector);
+  }
+
+  auto t_end = RDTSCP();
+
+  if (tid == n_prod) vtune::event_end(event);
+
+  sh->stats->insertions.duration = (t_end - t_start);
+  sh->stats->insertions.op_count = transaction_id;
+
+  // The partitions this consumer ends up with.
+  for (auto part : this->part_map->partitions_of(this_cons_id)) {
+    BaseHashTable *ht = this->partitions[part];
+    sh->stats->ht_fill += ht->get_fill();
+    sh->stats->ht_capacity += ht->get_capacity();
+    sh->stats->max_count = std::max(
+        sh->stats->max_count, static_cast<uint32_t>(ht->get_max_count()));
+  }
+  (*this->ht_vec)[tid] =
+      this->partitions[this->part_map->partitions_of(this_cons_id).front()];
+
+  for (auto &batch : batches) {
+    free(batch);
+  }
+
+  PLOGV.printf("cons_id %d | inserted %lu elements into %zu partitions",
+               this_cons_id, inserted,
+               this->part_map->partitions_of(this_cons_id).size());
+}
+
+template <bool Canonical, typename Fn>
+static void split_superkmers(input_reader::InputReader<std::string_view> *reader,
+                             uint32_t k, uint32_t m, Fn &&emit) {
+  input_reader::MinimizerSplitter<Canonical> splitter(k, m);
+  for (std::string_view seq; reader->next(&seq);) {
+    splitter.split(seq, emit);
+  }
+}
+
+// A super k-mer goes out as a header with its number of bases followed by the
+// packed bases (see `input_reader::superkmer::pack`), all to the same queue.
+template <typename T>
+void QueueTest<T>::superkmer_producer_thread(
+    const uint32_t tid, const uint32_t n_prod, const uint32_t n_cons,
+    const bool main_thread, const double skew, bool is_join,
+    SpinBarrier *barrier) {
+  Shard *sh = &this->shards[tid];
+  sh->stats = (thread_stats *)calloc(1, sizeof(thread_stats));
+
+  const uint8_t this_prod_id = sh->shard_idx;
+  typename T::prod_queue_t *pqueues[n_cons];
+  for (auto i = 0u; i < n_cons; i++) {
+    pqueues[i] = &this->queues->all_pqueues[this_prod_id][i];
+  }
+  vtune::set_threadname("superkmer_producer_thread" + std::to_string(tid));
+
+  auto reader = make_sequence_reader(config, this->scheduler.get(),
+                                     sh->shard_idx, n_prod);
+
+  barrier->arrive_and_wait(tid);
+
+  static auto event = -1;
+  if (main_thread) {
+    event = vtune::event_start("superkmer_enq");
+  }
+
+  uint64_t num_messages{}, num_superkmers{}, num_kmers{};
+  uint64_t words[input_reader::superkmer::MAX_WORDS];
+  auto send = [&](const input_reader::SuperKMer &skmer) {
+    const uint32_t cons_id = hash_to_cpu(skmer.minimizer, n_cons);
+    const auto num_words = input_reader::superkmer::pack(skmer.bases, words);
+    auto pq = pqueues[cons_id];
+    this->queues->enqueue(pq, this_prod_id, cons_id,
+                          data_t(skmer.bases.size(), 0));
+    for (auto w = 0u; w < num_words; w++) {
+      this->queues->enqueue(pq, this_prod_id, cons_id, data_t(words[w], 0));
+    }
+    num_messages += num_words + 1;
+    num_superkmers++;
+    num_kmers += skmer.bases.size() - config.K + 1;
+  };
+
+  auto t_start = RDTSC_START();
+  if (config.canonical_kmer) {
+    split_superkmers<true>(reader.get(), config.K, config.minimizer_len, send);
+  } else {
+    split_superkmers<false>(reader.get(), config.K, config.minimizer_len, send);
+  }
+
+  for (uint32_t cons_id = 0; cons_id < n_cons; cons_id++) {
+    this->queues->push_done(this_prod_id, cons_id);
+  }
+  auto t_end = RDTSCP();
+
+  if (main_thread) {
+    vtune::event_end(event);
+  }
+
+  sh->stats->enqueues.duration = (t_end - t_start);
+  sh->stats->enqueues.op_count = num_messages;
+
+  PLOGV.printf(
+      "[prod:%u] sent %lu k-mers in %lu super k-mers (%lu messages)",
+      this_prod_id, num_kmers, num_superkmers, num_messages);
+}
+
+template <typename T>
+void QueueTest<T>::superkmer_consumer_thread(
+    const uint32_t tid, const uint32_t n_prod, const uint32_t n_cons,
+    const uint32_t num_nops, SpinBarrier *barrier) {
+  Shard *sh = &this->shards[tid];
+
+#ifdef LATENCY_COLLECTION
+  const auto collector = &collectors.at(tid);
+  collector->claim();
+#else
+  collector_type *const collector{};
+#endif
+
+  sh->stats = (thread_stats *)calloc(1, sizeof(thread_stats));
+
+  const uint8_t this_cons_id = sh->shard_idx - n_prod;
+  typename T::cons_queue_t *cqueues[n_prod];
+  for (auto i = 0u; i < n_prod; i++) {
+    cqueues[i] = &this->queues->all_cqueues[this_cons_id][i];
+  }
+  vtune::set_threadname("superkmer_consumer_thread" + std::to_string(tid));
+
+  auto ht_size = get_ht_size(n_cons);
+  BaseHashTable *kmer_ht = init_ht(ht_size, sh->shard_idx);
+  (*this->ht_vec)[tid] = kmer_ht;
+
+  std::vector<InsertFindArgument> items(config.batch_len);
+  uint32_t num_items = 0;
+  uint64_t inserted = 0;
+  auto submit_batch = [&]() {
+    if (num_items > 0) {
+      kmer_ht->insert_batch(InsertFindArguments(items.data(), num_items),
+                            collector);
+      num_items = 0;
+    }
+  };
+  auto insert_kmer = [&](uint64_t kmer) {
+    auto &item = items[num_items];
+    item.key = kmer;
+    item.id = kmer;
+    inserted++;
+    if (config.no_prefetch) {
+      kmer_ht->insert_noprefetch(&item, collector);
+    } else if (++num_items == config.batch_len) {
+      submit_batch();
+    }
+  };
+
+  // A super k-mer may straddle the sections of a queue, so the partial one of
+  // each producer is kept until the rest of it shows up.
+  struct PartialSuperKMer {
+    uint64_t len;
+    uint32_t num_words;
+    uint32_t received;
+    uint64_t words[input_reader::superkmer::MAX_WORDS];
+  };
+  std::vector<PartialSuperKMer> partial(n_prod);
+  uint64_t num_superkmers{};
+
+  barrier->arrive_and_wait(tid);
+
+  static auto event = -1;
+  if (tid == n_prod) event = vtune::event_start("superkmer_deq");
+
+  auto t_start = RDTSC_START();
+
+  uint32_t finished_producers = 0;
+  uint64_t active_qmask = 0ull;
+  for (auto i = 0u; i < n_prod; i++) {
+    active_qmask |= (1ull << i);
+  }
+
+  data_t kv{};
+  for (uint32_t prod_id = 0; finished_producers < n_prod;
+       prod_id = prod_id + 1 == n_prod ? 0 : prod_id + 1) {
+    if (!(active_qmask & (1ull << prod_id))) {
+      continue;
+    }
+    if (!config.no_prefetch) {
+      kmer_ht->prefetch_queue(QueueType::insert_queue);
+    }
+
+    auto cq = cqueues[prod_id];
+    auto &skmer = partial[prod_id];
+    for (auto i = 0u; i < config.batch_len; i++) {
+      if (this->queues->dequeue(cq, prod_id, this_cons_id, &kv) == RETRY) {
+        submit_batch();
+        break;
+      }
+
+      if (skmer.received == skmer.num_words) {
+        // Expecting a header, or the end of the stream.
+        if (kv == T::BQ_MAGIC_KV) [[unlikely]] {
+          finished_producers++;
+          this->queues->pop_done(prod_id, this_cons_id);
+          active_qmask &= ~(1ull << prod_id);
+          submit_batch();
+          break;
+        }
+        skmer.len = static_cast<uint64_t>(kv.key);
+        skmer.num_words = input_reader::superkmer::num_words(skmer.len);
+        skmer.received = 0;
+        continue;
+      }
+
+      skmer.words[skmer.received++] = static_cast<uint64_t>(kv.key);
+      if (skmer.received == skmer.num_words) {
+        if (config.canonical_kmer) {
+          input_reader::superkmer::for_each_kmer<true>(skmer.words, skmer.len,
+                                                       config.K, insert_kmer);
+        } else {
+          input_reader::superkmer::for_each_kmer<false>(skmer.words, skmer.len,
+                                                        config.K, insert_kmer);
+        }
+        num_superkmers++;
+      }
+    }
+  }
+  submit_batch();
+  kmer_ht->flush_insert_queue(collector);
+
+  auto t_end = RDTSCP();
+
+  if (tid == n_prod) vtune::event_end(event);
+
+  sh->stats->insertions.duration = (t_end - t_start);
+  sh->stats->insertions.op_count = inserted;
+
+  get_ht_stats(sh, kmer_ht);
+  if (this->cfg->kmer_spectrum) {
+    KmerSpectrum<key_type> spectrum(this->cfg->top_k);
+    const auto start = _rdtsc();
+    kmer_ht->collect_spectrum(0, 1, spectrum);
+    report_kmer_spectrum(*this->cfg, this->spectrum, spectrum,
+                         _rdtsc() - start);
+  }
+
+  PLOGV.printf("cons_id %d | inserted %lu k-mers from %lu super k-mers",
+               this_cons_id, inserted, num_superkmers);
+
+  if (!this->cfg->ht_file.empty()) {
+    std::string outfile = this->cfg->ht_file + std::to_string(sh->shard_idx);
+    PLOG_INFO.printf("Shard %u: Printing to file: %s", sh->shard_idx,
+                     outfile.c_str());
+    kmer_ht->print_to_file(outfile);
+  }
+
+#ifdef LATENCY_COLLECTION
+  collector->dump("insert", tid);
+#endif
+}
+
 template <typename T>
 void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
-                               std::barrier<std::function<void()>> *barrier) {
+                               SpinBarrier *barrier) {
   Shard *sh = &this->shards[tid];
   uint64_t found = 0, not_found = 0;
   uint64_t count = std::max(HT_TESTS_NUM_INSERTS * tid, (uint64_t)1);
@@ -697,7 +1249,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
     // Nevertheless, they need this ktable object to queue the find requests to
     // other partitions. So, just create a HT with 100 buckets.
 
-    auto ht_size = get_ht_size(n_cons);
+    auto ht_size = get_ht_size(num_table_partitions(n_cons));
     PLOGV.printf("[find%u] init_ht ht_size: %u | id: %d", tid, ht_size,
                  sh->shard_idx);
     ktable = init_ht(ht_size, sh->shard_idx);
@@ -736,7 +1288,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
   int partition;
   int j = 0;
 
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(tid);
 
   static const auto event = vtune::event_start("find_batch");
 
@@ -765,7 +1317,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
         if (!(zipf_idx & 7) && zipf_idx + 16 < zipf_values->size())
           prefetch_object<false>(&zipf_values->at(zipf_idx + 16), 64);
 
-        k = zipf_values->at(zipf_idx);
+        k = static_cast<uint64_t>(zipf_values->at(zipf_idx));
         // PLOGV.printf("zipf_values[%" PRIu64 "] = %" PRIu64, zipf_idx, k);
         zipf_idx++;
 #else
@@ -775,7 +1327,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
       }
       uint64_t hash_val = hasher(&k, sizeof(k));
 
-      partition = hash_to_cpu(hash_val, n_cons);
+      partition = hash_to_cpu(hash_val, num_table_partitions(n_cons));
       // PLOGI.printf("partition %d", partition);
 
 #if defined(BQ_KEY_UPPER_BITS_HAS_HASH)
@@ -839,7 +1391,7 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
   }
   auto t_end = RDTSCP();
 
-  barrier->arrive_and_wait();
+  barrier->arrive_and_wait(tid);
 
 #ifdef CALC_STATS
   PLOG_INFO.printf(
@@ -867,6 +1419,280 @@ void QueueTest<T>::find_thread(int tid, int n_prod, int n_cons, bool is_join,
 #endif
 }
 
+// A delegated find goes to the owner of the key as
+// {key, FIND_REQUEST | producer << 32 | request id}, an insert as {key, value}
+// with the top bit of the value clear. The owner answers a find with
+// {request id, value}, with FIND_NOT_FOUND set in the id if there is no such
+// key.
+static constexpr uint64_t FIND_REQUEST = 1ull << 63;
+static constexpr uint64_t FIND_NOT_FOUND = 1ull << 63;
+
+template <typename T>
+void QueueTest<T>::find_requester_thread(
+    int tid, int n_prod, int n_cons, bool is_join,
+    SpinBarrier *barrier) {
+#if defined(BQUEUE_KMER_TEST)
+  PLOG_FATAL << "Delegated finds need key/value messages";
+#else
+  Shard *sh = &this->shards[tid];
+  Hasher hasher;
+  auto requests = this->find_requests;
+  auto responses = this->find_responses;
+  auto response_q = &responses->all_cqueues[tid][0];
+
+  vtune::set_threadname("find_requester_thread" + std::to_string(tid));
+
+  // The same keys as the producer inserted.
+  auto [ratio, num_messages, key_start] = get_params(n_prod, n_cons, tid);
+  const auto key_start_orig = key_start;
+
+  struct xorwow_state _xw_state, init_state;
+  xorwow_init(&_xw_state);
+  init_state = _xw_state;
+
+  std::bernoulli_distribution coin{config.pread};
+  xorwow_urbg urbg{};
+  std::array<bool, 1024> flips;
+  for (auto &flip : flips) flip = !coin(urbg);  // do a write if true
+
+  uint64_t request_id = 0, outstanding = 0;
+  uint64_t found = 0, not_found = 0, inserts = 0;
+  auto collect_responses = [&]() {
+    data_t resp;
+    while (responses->dequeue(response_q, 0, tid, &resp) == SUCCESS) {
+      if (static_cast<uint64_t>(resp.key) & FIND_NOT_FOUND) {
+        not_found++;
+      } else {
+        found++;
+      }
+      outstanding--;
+    }
+  };
+
+  barrier->arrive_and_wait(tid);
+
+  auto t_start = RDTSC_START();
+
+  for (auto m = 0u; m < config.insert_factor; m++) {
+    key_start = key_start_orig;
+    auto zipf_idx = key_start == 1 ? 0 : key_start;
+#if defined(XORWOW)
+    _xw_state = init_state;
+#endif
+    for (uint64_t i = 0; i < num_messages; i++) {
+      uint64_t k;
+#if defined(XORWOW)
+      k = xorwow(&_xw_state);
+#elif defined(BQ_TESTS_INSERT_ZIPFIAN)
+      if (!(zipf_idx & 7) && zipf_idx + 16 < zipf_values->size())
+        prefetch_object<false>(&zipf_values->at(zipf_idx + 16), 64);
+      k = static_cast<uint64_t>(zipf_values->at(zipf_idx++));
+#else
+      k = key_start++;
+#endif
+      const uint32_t owner = hash_to_cpu(hasher(&k, sizeof(k)), n_cons);
+      auto pq = &requests->all_pqueues[tid][owner];
+
+      if (cfg->rw_queues && flips[i & 1023]) {
+        requests->enqueue(pq, tid, owner, data_t(k, k & ~FIND_REQUEST));
+        inserts++;
+        continue;
+      }
+
+      requests->enqueue(
+          pq, tid, owner,
+          data_t(k, FIND_REQUEST | uint64_t(tid) << 32 |
+                        (request_id++ & 0xffff'ffff)));
+      if (++outstanding >= FIND_WINDOW) {
+        // The owners only see the requests of published sections.
+        for (auto c = 0; c < n_cons; c++) {
+          requests->flush(tid, c);
+        }
+        while (outstanding >= FIND_WINDOW) {
+          collect_responses();
+        }
+      } else if (!(i & 63)) {
+        collect_responses();
+      }
+    }
+  }
+
+  for (auto c = 0; c < n_cons; c++) {
+    requests->push_done(tid, c);
+  }
+  while (outstanding > 0) {
+    collect_responses();
+  }
+
+  auto t_end = RDTSCP();
+
+  barrier->arrive_and_wait(tid);
+
+  sh->stats->finds.duration = (t_end - t_start);
+  sh->stats->finds.op_count = found + not_found + inserts;
+
+  PLOGV.printf(
+      "requester %d | found %lu not_found %lu inserts %lu | cycles per op %lu",
+      tid, found, not_found, inserts,
+      (t_end - t_start) / std::max<uint64_t>(found + not_found + inserts, 1));
+#endif  // BQUEUE_KMER_TEST
+}
+
+template <typename T>
+void QueueTest<T>::find_owner_thread(
+    int tid, int n_prod, int n_cons, bool is_join,
+    SpinBarrier *barrier) {
+#if defined(BQUEUE_KMER_TEST)
+  PLOG_FATAL << "Delegated finds need key/value messages";
+#else
+  Shard *sh = &this->shards[tid];
+  const uint32_t this_cons_id = tid - n_prod;
+  BaseHashTable *ktable = this->ht_vec->at(tid);
+  auto requests = this->find_requests;
+  auto responses = this->find_responses;
+  auto request_q = &requests->all_cqueues[this_cons_id][0];
+
+#ifdef LATENCY_COLLECTION
+  const auto collector = &collectors.at(tid);
+  collector->claim();
+#else
+  collector_type *const collector{};
+#endif
+
+  vtune::set_threadname("find_owner_thread" + std::to_string(tid));
+
+  // A round holds at most a window of finds of each producer.
+  const uint32_t round_len = FIND_WINDOW * n_prod;
+  std::vector<InsertFindArgument> finds(round_len);
+  std::vector<uint64_t> senders(round_len);
+  std::vector<uint8_t> hits(round_len);
+  std::vector<uint64_t> values(round_len);
+  std::vector<InsertFindArgument> inserts(config.batch_len);
+  std::vector<FindResult> results(config.batch_len);
+  ValuePairs vp{0, results.data()};
+  uint32_t num_inserts = 0;
+  uint64_t served = 0, inserted = 0;
+
+  auto submit_inserts = [&]() {
+    if (num_inserts > 0) {
+      ktable->prefetch_queue(QueueType::insert_queue);
+      ktable->insert_batch(InsertFindArguments(inserts.data(), num_inserts),
+                           collector);
+      inserted += num_inserts;
+      num_inserts = 0;
+    }
+  };
+  auto reap = [&]() {
+    for (auto r = 0u; r < vp.first; r++) {
+      hits[results[r].id] = 1;
+      values[results[r].id] = results[r].value;
+    }
+    const auto n = vp.first;
+    vp.first = 0;
+    return n;
+  };
+
+  barrier->arrive_and_wait(tid);
+
+  auto t_start = RDTSC_START();
+
+  int finished_producers = 0;
+  while (finished_producers < n_prod) {
+    uint32_t num_finds = 0;
+    data_t kv;
+    while (num_finds < round_len &&
+           requests->dequeue(request_q, 0, this_cons_id, &kv) == SUCCESS) {
+      if (kv == MpscSectionQueue::BQ_MAGIC_KV) [[unlikely]] {
+        finished_producers++;
+      } else if (kv.value & FIND_REQUEST) {
+        auto &item = finds[num_finds];
+        item.key = kv.key;
+        item.id = num_finds;
+        item.part_id = tid;
+        senders[num_finds] = kv.value;
+        hits[num_finds] = 0;
+        num_finds++;
+      } else {
+        auto &item = inserts[num_inserts];
+        item.key = kv.key;
+        item.value = kv.value;
+        item.id = static_cast<uint64_t>(kv.key);
+        if (++num_inserts == config.batch_len) {
+          submit_inserts();
+        }
+      }
+    }
+    if (num_finds == 0) {
+      continue;
+    }
+
+    // A find sees the inserts that its producer sent before it.
+    submit_inserts();
+    ktable->flush_insert_queue(collector);
+
+    for (uint32_t f = 0; f < num_finds; f += config.batch_len) {
+      const uint32_t len = std::min<uint32_t>(config.batch_len, num_finds - f);
+      if (f == 0) {
+        ktable->prefetch_queue(QueueType::find_queue);
+      }
+      ktable->find_batch(InsertFindArguments(&finds[f], len), vp, collector);
+      reap();
+    }
+    do {
+      ktable->flush_find_queue(vp, collector);
+    } while (reap() == config.batch_len);
+
+    for (uint32_t f = 0; f < num_finds; f++) {
+      const uint32_t requester = (senders[f] & ~FIND_REQUEST) >> 32;
+      const uint64_t id = senders[f] & 0xffff'ffff;
+      responses->enqueue(&responses->all_pqueues[this_cons_id][requester],
+                         this_cons_id, requester,
+                         data_t(hits[f] ? id : id | FIND_NOT_FOUND,
+                                hits[f] ? values[f] : 0));
+    }
+    for (auto p = 0; p < n_prod; p++) {
+      responses->flush(this_cons_id, p);
+    }
+    served += num_finds;
+  }
+  submit_inserts();
+  ktable->flush_insert_queue(collector);
+
+  auto t_end = RDTSCP();
+
+  barrier->arrive_and_wait(tid);
+
+  // The producers count the operations.
+  sh->stats->finds.duration = (t_end - t_start);
+  sh->stats->finds.op_count = 0;
+
+  PLOGV.printf("owner %u | served %lu finds, %lu inserts", this_cons_id,
+               served, inserted);
+
+  get_ht_stats(sh, ktable);
+
+#ifdef LATENCY_COLLECTION
+  collector->dump("delegated_find", tid);
+#endif
+#endif  // BQUEUE_KMER_TEST
+}
+
+template <typename T>
+std::vector<uint32_t> QueueTest<T>::barrier_nodes() {
+  // The same order as the threads are spawned in: the producers, the last of
+  // them on CPU 0, then the consumers.
+  std::vector<uint32_t> nodes;
+  for (uint32_t cpu : this->npq->get_assigned_cpu_list_producers()) {
+    if (cpu == 0) continue;
+    nodes.push_back(std::max(numa_node_of_cpu(cpu), 0));
+  }
+  nodes.push_back(std::max(numa_node_of_cpu(0), 0));
+  for (uint32_t cpu : this->npq->get_assigned_cpu_list_consumers()) {
+    nodes.push_back(std::max(numa_node_of_cpu(cpu), 0));
+  }
+  return nodes;
+}
+
 template <typename T>
 void QueueTest<T>::init_queues(uint32_t nprod, uint32_t ncons) {
   PLOG_DEBUG.printf("Initializing queues");
@@ -876,6 +1702,10 @@ void QueueTest<T>::init_queues(uint32_t nprod, uint32_t ncons) {
     this->QUEUE_SIZE = QueueTest::BQ_QUEUE_SIZE;
   } else if (std::is_same<T, kmercounter::SectionQueue>::value) {
     this->QUEUE_SIZE = 4;
+  } else if (std::is_same<T, kmercounter::MpscSectionQueue>::value) {
+    // Sections per consumer, shared by all producers: room for each of them
+    // to hold one open section and one waiting to be drained.
+    this->QUEUE_SIZE = std::bit_ceil(std::max(2 * nprod, 8u));
   }
   this->queues = new T(nprod, ncons, this->QUEUE_SIZE, this->npq);
 }
@@ -888,6 +1718,19 @@ void QueueTest<T>::run_test(Configuration *cfg, Numa *n, bool is_join,
 
   std::chrono::time_point<std::chrono::steady_clock> start_ts, end_ts;
 
+  // Delegated finds travel as key/value messages and look up the zipfian or
+  // sequential keys, not the relation a join inserted.
+  if (cfg->delegate_finds) {
+#if defined(BQUEUE_KMER_TEST)
+    PLOG_ERROR << "Delegated finds need key/value messages";
+    exit(-1);
+#endif
+    if (is_join && cfg->rw_queues) {
+      PLOG_ERROR << "Delegated finds apply to synthetic keys only";
+      exit(-1);
+    }
+  }
+
   start_ts = std::chrono::steady_clock::now();
 
 #ifdef LATENCY_COLLECTION
@@ -946,7 +1789,23 @@ void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
     // For debugging
   };
 
-  std::barrier barrier(cfg->n_prod + cfg->n_cons, on_completion);
+  SpinBarrier barrier(this->barrier_nodes(), on_completion);
+
+  // Either every thread probes the partitions itself, or the producers
+  // delegate their finds to the consumers owning the partitions.
+  auto prod_finder = &QueueTest<T>::find_thread;
+  auto cons_finder = &QueueTest<T>::find_thread;
+  if (cfg->delegate_finds) {
+    prod_finder = &QueueTest<T>::find_requester_thread;
+    cons_finder = &QueueTest<T>::find_owner_thread;
+    this->find_requests = new MpscSectionQueue(
+        cfg->n_prod, cfg->n_cons, std::bit_ceil(std::max(2 * cfg->n_prod, 8u)),
+        npq);
+    // Every section a producer has to read holds at least one of its
+    // outstanding finds, so the owners never wait for room.
+    this->find_responses = new MpscSectionQueue(
+        cfg->n_cons, cfg->n_prod, std::bit_ceil(FIND_WINDOW), nullptr);
+  }
 
   // Spawn threads that will perform find operation
   for (uint32_t assigned_cpu : this->npq->get_assigned_cpu_list_producers()) {
@@ -954,7 +1813,7 @@ void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
     if (assigned_cpu == 0) continue;
     Shard *sh = &this->shards[i];
     sh->shard_idx = i;
-    auto _thread = std::thread(&QueueTest::find_thread, this, i, cfg->n_prod,
+    auto _thread = std::thread(prod_finder, this, i, cfg->n_prod,
                                cfg->n_cons, is_join, &barrier);
     CPU_ZERO(&cpuset);
     CPU_SET(assigned_cpu, &cpuset);
@@ -981,7 +1840,7 @@ void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
     Shard *sh = &this->shards[i];
     sh->shard_idx = i;
 
-    auto _thread = std::thread(&QueueTest::find_thread, this, i, cfg->n_prod,
+    auto _thread = std::thread(cons_finder, this, i, cfg->n_prod,
                                cfg->n_cons, is_join, &barrier);
 
     CPU_ZERO(&cpuset);
@@ -1000,8 +1859,8 @@ void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
 
   {
     PLOG_VERBOSE.printf("Running master thread with id %d", main_sh->shard_idx);
-    this->find_thread(main_sh->shard_idx, cfg->n_prod, cfg->n_cons, is_join,
-                      &barrier);
+    (this->*prod_finder)(main_sh->shard_idx, cfg->n_prod, cfg->n_cons,
+                         is_join, &barrier);
   }
 
   for (auto &th : this->prod_threads) {
@@ -1011,6 +1870,14 @@ void QueueTest<T>::run_find_test(Configuration *cfg, Numa *n, bool is_join,
   for (auto &th : this->cons_threads) {
     th.join();
   }
+  // On top of the wait of the inserts.
+  for (uint32_t t = 0; t < cfg->n_prod + cfg->n_cons; t++) {
+    this->shards[t].stats->barrier_wait += barrier.wait_cycles(t);
+  }
+  if (cfg->delegate_finds) {
+    delete this->find_requests;
+    delete this->find_responses;
+  }
   PLOG_INFO.printf("Find done!");
   print_stats(this->shards, *cfg);
 }
@@ -1056,7 +1923,92 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
     PLOG_INFO << "Sync completed. Starting prod/cons threads!";
   };
 
-  std::barrier barrier(cfg->n_prod + cfg->n_cons, on_completion);
+  SpinBarrier barrier(this->barrier_nodes(), on_completion);
+
+  // K-mers are sent a super k-mer at a time with a minimizer length.
+  auto producer = &QueueTest<T>::producer_thread;
+  auto consumer = &QueueTest<T>::consumer_thread;
+  if (is_join && cfg->mode == FASTQ_WITH_INSERT && cfg->minimizer_len > 0) {
+    if constexpr (sizeof(data_t::key) < sizeof(uint64_t)) {
+      PLOG_FATAL << "Super k-mers need at least 64-bit queue messages";
+      exit(-1);
+    }
+    if (cfg->K > input_reader::superkmer::BASES_PER_WORD) {
+      PLOG_ERROR << "Super k-mers support K <= "
+                 << input_reader::superkmer::BASES_PER_WORD << " only";
+      exit(-1);
+    }
+    if constexpr (std::is_same_v<T, MpscSectionQueue>) {
+      // The consumers put super k-mers straddling a section back together
+      // per producer, and a shared ring interleaves the producers.
+      PLOG_FATAL << "Super k-mers need a queue per producer";
+      exit(-1);
+    }
+    producer = &QueueTest<T>::superkmer_producer_thread;
+    consumer = &QueueTest<T>::superkmer_consumer_thread;
+  }
+
+  // Merged counts travel in the value of a message, which the joins and the
+  // k-mer counts use for the key itself.
+  if (cfg->skew_routing || cfg->aggr_buffer > 0) {
+#if defined(BQUEUE_KMER_TEST)
+    PLOG_ERROR << "Skew-aware routing and pre-aggregation need key/value "
+                  "messages";
+    exit(-1);
+#endif
+    if (is_join) {
+      PLOG_ERROR << "Skew-aware routing and pre-aggregation apply to "
+                    "aggregation only";
+      exit(-1);
+    }
+  }
+
+  // More partitions than consumers, which may move between rounds.
+  if (cfg->num_partitions > 0) {
+    if (cfg->num_partitions < cfg->n_cons) {
+      PLOG_ERROR << "Need at least a partition per consumer";
+      exit(-1);
+    }
+    // The ids of the partition tables follow those of the producers.
+    if (cfg->n_prod + cfg->num_partitions > MAX_PARTITIONS) {
+      PLOG_ERROR << "Producers and partitions share " << MAX_PARTITIONS
+                 << " ids";
+      exit(-1);
+    }
+    // The super k-mer consumer and the delegated finds do not know about
+    // partitions.
+    if (consumer != &QueueTest<T>::consumer_thread ||
+        bq_load != BQUEUE_LOAD::HtInsert || cfg->delegate_finds) {
+      PLOG_ERROR << "Partitions apply to plain inserts only";
+      exit(-1);
+    }
+    // Partitions only move between rounds of inserts.
+    if (cfg->rebalance && cfg->insert_factor <= 1) {
+      PLOG_ERROR << "Rebalancing needs more than one round; pass "
+                    "--insert-factor > 1";
+      exit(-1);
+    }
+    this->part_map = new PartitionMap(cfg->num_partitions, cfg->n_cons);
+    this->partitions.assign(cfg->num_partitions, nullptr);
+    this->phase_barrier = new SpinBarrier(
+        this->barrier_nodes(), [this, cfg]() noexcept {
+          if (cfg->rebalance) {
+            const auto moves = this->part_map->rebalance();
+            PLOG_INFO.printf("Moved %u partitions between rounds", moves);
+          }
+        });
+    consumer = &QueueTest<T>::partitioned_consumer_thread;
+  } else if (cfg->rebalance) {
+    PLOG_WARNING << "Rebalancing needs --num-partitions; ignored";
+  }
+
+  // The producers share the ranges of a multi-file input.
+  this->scheduler = make_input_scheduler(*cfg, cfg->n_prod);
+
+  // Every consumer reports its share of the spectrum of its table.
+  if (cfg->kmer_spectrum) {
+    this->spectrum = new SpectrumShared(*cfg, cfg->n_cons);
+  }
 
   // Spawn producer threads
   for (uint32_t assigned_cpu : this->npq->get_assigned_cpu_list_producers()) {
@@ -1065,7 +2017,7 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
     Shard *sh = &this->shards[i];
     sh->shard_idx = i;
     auto _thread =
-        std::thread(&QueueTest<T>::producer_thread, this, i, cfg->n_prod,
+        std::thread(producer, this, i, cfg->n_prod,
                     cfg->n_cons, false, cfg->skew, is_join, &barrier);
     CPU_ZERO(&cpuset);
     CPU_SET(assigned_cpu, &cpuset);
@@ -1093,7 +2045,7 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
     PLOG_DEBUG.printf("tid %d assigned cpu %d", i, assigned_cpu);
 
     auto _thread =
-        std::thread(&QueueTest<T>::consumer_thread, this, i, cfg->n_prod,
+        std::thread(consumer, this, i, cfg->n_prod,
                     cfg->n_cons, cfg->num_nops, &barrier);
 
     CPU_ZERO(&cpuset);
@@ -1110,8 +2062,8 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
 
   {
     PLOGV.printf("Running master thread with id %d", main_sh->shard_idx);
-    this->producer_thread(main_sh->shard_idx, cfg->n_prod, cfg->n_cons, true,
-                          cfg->skew, is_join, &barrier);
+    (this->*producer)(main_sh->shard_idx, cfg->n_prod, cfg->n_cons, true,
+                      cfg->skew, is_join, &barrier);
   }
 
   for (auto &th : this->prod_threads) {
@@ -1125,15 +2077,29 @@ void QueueTest<T>::insert_with_queues(Configuration *cfg, Numa *n, bool is_join,
   this->prod_threads.clear();
   this->cons_threads.clear();
 
+  for (uint32_t t = 0; t < cfg->n_prod + cfg->n_cons; t++) {
+    this->shards[t].stats->barrier_wait +=
+        barrier.wait_cycles(t) +
+        (this->phase_barrier ? this->phase_barrier->wait_cycles(t) : 0);
+  }
+  delete this->phase_barrier;
+  this->phase_barrier = nullptr;
+  delete this->spectrum;
+  this->spectrum = nullptr;
+  this->scheduler.reset();
+
   // TODO free everything
   // TODO: Move this stats to find after testing find
   // print_stats(this->shards, *cfg);
 }
 
 template class QueueTest<SectionQueue>;
+template class QueueTest<MpscSectionQueue>;
 
 const data_t SectionQueue::BQ_MAGIC_KV = data_t(
       SectionQueue::BQ_MAGIC_64BIT, SectionQueue::BQ_MAGIC_64BIT);
+const data_t MpscSectionQueue::BQ_MAGIC_KV = data_t(
+      MpscSectionQueue::BQ_MAGIC_64BIT, MpscSectionQueue::BQ_MAGIC_64BIT);
 //template class QueueTest<LynxQueue>;
 //template class QueueTest<BQueueAligned>;
 }  // namespace kmercounter
@@ -5,14 +5,16 @@
 
 #include <RWRatioTest.hpp>
 #include <array>
-#include <barrier>
+#include <chrono>
 #include <constants.hpp>
 #include <hasher.hpp>
 #include <random>
+#include <thread>
 #include <xorwow.hpp>
 
 #include "hashtables/base_kht.hpp"
 #include "hashtables/ht_helper.hpp"
+#include "utils/elastic_workers.hpp"
 #include "utils/hugepage_allocator.hpp"
 
 #ifdef WITH_VTUNE_LIB
@@ -56,7 +58,7 @@ class rw_experiment {
   }
 
   experiment_results run(unsigned int total_ops, collector_type* collector,
-                             std::barrier<std::function<void()>> *sync_barrier) {
+                         SpinBarrier *sync_barrier, uint32_t tid) {
     const auto keyrange = config.num_threads * total_ops;
     std::array<InsertFindArgument, HT_TESTS_BATCH_LENGTH> args{};
     uint64_t k{};
@@ -85,7 +87,7 @@ class rw_experiment {
     std::array<bool, 1024> flips{};
     for (auto& flip : flips) flip = !sampler(prng);
 
-    sync_barrier->arrive_and_wait();
+    sync_barrier->arrive_and_wait(tid);
 
     const auto start = start_time();
     if (!config.no_prefetch) {
@@ -117,7 +119,7 @@ class rw_experiment {
           prefetch_object<false>(&zipf_values->at(zipf_idx + 16), 64);
         }
 
-        InsertFindArgument kv{values[i], values[i]};
+        InsertFindArgument kv{values[i], static_cast<value_type>(values[i])};
         kv.id = i;
         if (flips[i & 1023]) {
           ++timings.n_writes;
@@ -136,7 +138,7 @@ class rw_experiment {
     __itt_event_end(event);
 #endif
 
-    sync_barrier->arrive_and_wait();
+    sync_barrier->arrive_and_wait(tid);
 
     return timings;
   }
@@ -198,9 +200,251 @@ class rw_experiment {
   }
 };
 
+namespace {
+/// The requests of one kind in the elastic run: the controller releases
+/// them as they arrive, and the workers claim them a batch at a time.
+struct ElasticStream {
+  alignas(64) std::atomic_uint64_t released{0};
+  alignas(64) std::atomic_uint64_t claimed{0};
+  uint64_t total{0};
+
+  /// Claim up to `n` of the released requests: [begin, end), empty if there
+  /// are none.
+  std::pair<uint64_t, uint64_t> claim(uint64_t n) {
+    uint64_t begin = claimed.load(std::memory_order_relaxed);
+    for (;;) {
+      const uint64_t end = std::min(
+          begin + n, released.load(std::memory_order_acquire));
+      if (end <= begin) {
+        return {begin, begin};
+      }
+      if (claimed.compare_exchange_weak(begin, end,
+                                        std::memory_order_relaxed)) {
+        return {begin, end};
+      }
+    }
+  }
+
+  /// Requests that arrived and wait for a worker.
+  uint64_t backlog() const {
+    // Claimed first, as it never passes released.
+    const uint64_t c = claimed.load(std::memory_order_relaxed);
+    return released.load(std::memory_order_relaxed) - c;
+  }
+
+  bool drained() const {
+    return claimed.load(std::memory_order_relaxed) == total;
+  }
+};
+
+struct ElasticRun {
+  explicit ElasticRun(uint32_t num_workers) : workers(num_workers) {}
+
+  ElasticWorkers workers;
+  ElasticStream inserts;
+  ElasticStream finds;
+  uint64_t start;
+  uint64_t stop;
+};
+
+ElasticRun* elastic_run;
+
+// The controller looks at the workers every tick. The requests arrive at
+// `elastic_rate`, and at `elastic_burst` times that for the first
+// `BURST_TICKS` of every `BURST_PERIOD`.
+constexpr auto ELASTIC_TICK = std::chrono::milliseconds(1);
+constexpr uint64_t BURST_PERIOD = 100;
+constexpr uint64_t BURST_TICKS = 20;
+constexpr uint64_t ELASTIC_BATCH = HT_TESTS_BATCH_LENGTH;
+}  // namespace
+
+void RWRatioTest::run_elastic(Shard& shard, BaseHashTable& hashtable,
+                              unsigned int total_ops,
+                              SpinBarrier *sync_barrier) {
+  PLOG_FATAL_IF(config.num_threads < 2)
+      << "The elastic run needs a controller and at least one worker";
+  const uint32_t num_workers = config.num_threads - 1;
+  const bool controller = shard.shard_idx == 0;
+  // Finds ask for the first keys, which are put in the table before the run;
+  // inserts bring the keys after them.
+  const uint64_t total = static_cast<uint64_t>(total_ops) * num_workers;
+  const uint64_t num_finds = total * config.pread;
+  if (controller) {
+    // The last run, if any, is over: everyone has left it.
+    delete elastic_run;
+    elastic_run = new ElasticRun(num_workers);
+    elastic_run->finds.total = num_finds;
+    elastic_run->inserts.total = total - num_finds;
+  }
+  const std::span<const key_type> values{zipf_values->data(),
+                                         zipf_values->size()};
+
+  uint64_t n_inserts = 0, n_finds = 0, n_found = 0;
+  if (!controller) {
+    // Every key a find can ask for is in the table.
+    const uint32_t w = shard.shard_idx - 1;
+    const uint64_t first = num_finds * w / num_workers;
+    const uint64_t last = num_finds * (w + 1) / num_workers;
+    std::array<InsertFindArgument, HT_TESTS_BATCH_LENGTH> args{};
+    for (uint64_t i = first; i < last; i += args.size()) {
+      const uint64_t n = std::min<uint64_t>(args.size(), last - i);
+      for (uint64_t j = 0; j < n; j++) {
+        args[j].key = values[i + j];
+      }
+      hashtable.insert_batch(InsertFindArguments(args.data(), n));
+    }
+    hashtable.flush_insert_queue();
+  }
+
+  sync_barrier->arrive_and_wait(shard.shard_idx);
+
+  auto& run = *elastic_run;
+  if (controller) {
+    run.start = __rdtsc();
+    ElasticPolicy policy(num_workers);
+    const auto first = policy.next({0, 0, run.inserts.total,
+                                    run.finds.total, 0, 0});
+    uint32_t active = first.inserters + first.finders;
+    uint64_t changes = run.workers.resize(first.inserters, first.finders);
+    uint64_t ticks = 0, sum_active = 0, peak = active;
+
+    const double per_tick = config.elastic_rate * 1e6 *
+                            std::chrono::duration<double>(ELASTIC_TICK).count();
+    double arrived = 0;
+    uint64_t prev_ops = 0;
+    auto next = std::chrono::steady_clock::now();
+    while (!run.inserts.drained() || !run.finds.drained()) {
+      next += ELASTIC_TICK;
+      std::this_thread::sleep_until(next);
+
+      // Release what arrived in the tick, finds and inserts in the mix of
+      // the run.
+      arrived += ticks % BURST_PERIOD < BURST_TICKS
+                     ? per_tick * config.elastic_burst
+                     : per_tick;
+      const uint64_t old_inserts = run.inserts.released;
+      const uint64_t old_finds = run.finds.released;
+      run.finds.released.store(
+          std::min<uint64_t>(run.finds.total, arrived * config.pread),
+          std::memory_order_release);
+      run.inserts.released.store(
+          std::min<uint64_t>(run.inserts.total,
+                             arrived - static_cast<uint64_t>(
+                                           arrived * config.pread)),
+          std::memory_order_release);
+
+      uint64_t ops = 0;
+      for (auto w = 0u; w < num_workers; w++) {
+        ops += run.workers.ops(w);
+      }
+      const auto plan = policy.next(
+          {ops - prev_ops, active, run.inserts.released - old_inserts,
+           run.finds.released - old_finds, run.inserts.backlog(),
+           run.finds.backlog()});
+      prev_ops = ops;
+      changes += run.workers.resize(plan.inserters, plan.finders);
+      active = plan.inserters + plan.finders;
+
+      ticks++;
+      sum_active += active;
+      peak = std::max<uint64_t>(peak, active);
+    }
+    run.workers.stop();
+    run.stop = __rdtsc();
+
+    PLOG_INFO.printf(
+        "Elastic run: %" PRIu64 " ticks, %.2f of %u workers active on "
+        "average, %" PRIu64 " at most, %" PRIu64 " role changes, %.0f ops "
+        "per worker per tick",
+        ticks, ticks ? static_cast<double>(sum_active) / ticks : 0.0,
+        num_workers, peak, changes, policy.worker_rate());
+  } else {
+    const uint32_t w = shard.shard_idx - 1;
+    std::array<InsertFindArgument, ELASTIC_BATCH> args{};
+    std::array<FindResult, HT_TESTS_FIND_BATCH_LENGTH> result_batch{};
+    ValuePairs results{0, result_batch.data()};
+    WorkerRole current = WorkerRole::Parked;
+    bool pending = false;
+    // Nothing is left in the prefetch queues of a worker that waits or
+    // changes roles.
+    auto flush = [&]() {
+      if (!pending) {
+        return;
+      }
+      if (current == WorkerRole::Insert) {
+        hashtable.flush_insert_queue();
+      } else {
+        hashtable.flush_find_queue(results);
+        n_found += results.first;
+        results.first = 0;
+      }
+      pending = false;
+    };
+
+    for (;;) {
+      WorkerRole role = run.workers.role(w);
+      if (role == WorkerRole::Parked) {
+        flush();
+        role = run.workers.await_role(w);
+      }
+      if (role == WorkerRole::Exit) {
+        break;
+      }
+      if (role != current) {
+        flush();
+        current = role;
+      }
+
+      auto& stream =
+          role == WorkerRole::Insert ? run.inserts : run.finds;
+      const auto [begin, end] = stream.claim(args.size());
+      if (begin == end) {
+        flush();
+        _mm_pause();
+        continue;
+      }
+      const uint64_t offset = role == WorkerRole::Insert ? num_finds : 0;
+      for (auto i = begin; i < end; i++) {
+        args[i - begin].key = values[offset + i];
+        args[i - begin].id = i;
+      }
+      const InsertFindArguments batch(args.data(), end - begin);
+      if (role == WorkerRole::Insert) {
+        hashtable.insert_batch(batch);
+        n_inserts += batch.size();
+      } else {
+        hashtable.find_batch(batch, results);
+        n_found += results.first;
+        results.first = 0;
+        n_finds += batch.size();
+      }
+      pending = true;
+      run.workers.add_ops(w, batch.size());
+    }
+    flush();
+  }
+
+  sync_barrier->arrive_and_wait(shard.shard_idx);
+
+  if (n_finds != n_found) {
+    PLOG_WARNING << "Not all read attempts succeeded (" << n_found << " / "
+                 << n_finds << ")";
+  }
+
+  const uint64_t cycles = run.stop - run.start;
+  shard.stats->finds.op_count = n_finds;
+  shard.stats->finds.duration = cycles;
+  shard.stats->any.op_count = n_finds + n_inserts;
+  shard.stats->any.duration = cycles;
+  shard.stats->insertions = shard.stats->any;
+
+  shard.stats->ht_capacity = hashtable.get_capacity();
+  shard.stats->ht_fill = hashtable.get_fill();
+}
+
 void RWRatioTest::run(Shard& shard, BaseHashTable& hashtable,
                       unsigned int total_ops,
-                      std::barrier<std::function<void()>> *sync_barrier) {
+                      SpinBarrier *sync_barrier) {
   PLOG_INFO << "Starting RW thread " << shard.shard_idx;
   rw_experiment experiment{hashtable, shard.shard_idx * total_ops};
 
@@ -214,7 +458,8 @@ void RWRatioTest::run(Shard& shard, BaseHashTable& hashtable,
 
   cur_phase = ExecPhase::insertions;
 
-  const auto results = experiment.run(total_ops, collector, sync_barrier);
+  const auto results = experiment.run(total_ops, collector, sync_barrier,
+                                        shard.shard_idx);
   PLOG_INFO << "Executed " << results.n_reads << " reads / " << results.n_writes
             << " writes ("
             << static_cast<double>(results.n_reads) / results.n_writes
@@ -215,9 +215,8 @@ OpTimings SynthTest::synth_run_get(BaseHashTable *ktable, uint8_t tid) {
 uint64_t seed2 = 123456789;
 inline uint64_t PREFETCH_STRIDE = 64;
 
-static uint64_t insert_done;
-
-void SynthTest::synth_run_exec(Shard *sh, BaseHashTable *kmer_ht) {
+void SynthTest::synth_run_exec(Shard *sh, BaseHashTable *kmer_ht,
+                               SpinBarrier *barrier) {
   OpTimings insert_times{};
 
   PLOG_INFO.printf("Synth test run: thread %u, ht size: %" PRIu64 ", insertions: %" PRIu64 "",
@@ -237,11 +236,8 @@ void SynthTest::synth_run_exec(Shard *sh, BaseHashTable *kmer_ht) {
   }
   sh->stats->insertions = insert_times;
 
-  fipc_test_FAI(insert_done);
-
-  while (insert_done < config.num_threads) {
-    fipc_test_pause();
-  }
+  // Every thread has inserted before anyone looks up.
+  barrier->arrive_and_wait(sh->shard_idx);
 
   const auto find_times = synth_run_get(kmer_ht, sh->shard_idx);
   sh->stats->finds = find_times;
@@ -36,6 +36,12 @@ const char* ht_type_strings[] = {
     "CASHT++",
     "ARRAY_HT",
 };
+const char* input_backend_strings[] = {
+    "",
+    "PRELOAD",
+    "MMAP",
+    "ASYNC",
+};
 const char* run_mode_strings[] = {
     "",
     "DRY_RUN",
@@ -193,6 +193,29 @@ TEST_P(AggregationTest, OFF_BY_ONE_TEST) {
   ASSERT_EQ(valuepairs.second[1].value, 1);
 }
 
+// Many occurrences of a key at once count as that many inserts of it
+TEST_P(AggregationTest, INSERT_COUNT_TEST) {
+  std::array<InsertFindArgument, 2> arguments{
+      InsertFindArgument{key : 1, id : 128},
+      InsertFindArgument{key : 0xdeadbeef, id : 256}};
+  ht_->insert_count(&arguments[0], 1000);
+  ht_->insert_count(&arguments[1], 1);
+  ht_->insert_count(&arguments[0], 24);
+  ASSERT_EQ(ht_->get_fill(), 2);
+
+  InsertFindArguments keypairs(arguments);
+  std::array<FindResult, HT_TESTS_BATCH_LENGTH> values{};
+  ValuePairs valuepairs{0, values.data()};
+  ht_->find_batch(keypairs, valuepairs);
+  ht_->flush_find_queue(valuepairs);
+
+  ASSERT_EQ(valuepairs.first, 2);
+  ASSERT_EQ(valuepairs.second[0].id, 128);
+  ASSERT_EQ(valuepairs.second[0].value, 1024);
+  ASSERT_EQ(valuepairs.second[1].id, 256);
+  ASSERT_EQ(valuepairs.second[1].value, 1);
+}
+
 INSTANTIATE_TEST_CASE_P(TestAllCombinations, AggregationTest,
                         ::testing::ValuesIn(HTS));
 
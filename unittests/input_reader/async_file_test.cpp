@@ -0,0 +1,202 @@
+#include "input_reader/async_file.hpp"
+
+#include <absl/strings/str_join.h>
+#include <absl/strings/str_split.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "input_reader/fastq.hpp"
+#include "input_reader/mmap_file.hpp"
+#include "input_reader_test_utils.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+/// Generate comma seperated a CSV file.
+std::string generate_csv(uint64_t num_rows, uint64_t num_cols = 3) {
+  std::string csv;
+  for (uint64_t row = 0; row < num_rows; row++) {
+    std::vector<uint64_t> fields;
+    for (uint64_t col = 0; col < num_cols; col++) {
+      fields.push_back(row + col * col);
+    }
+    csv += absl::StrJoin(fields, ",");
+    csv += '\n';
+  }
+  return csv;
+}
+
+const char ONE_SEQ[] = R"(@ERR024163.1 EAS51_210:1:1:1072:4554/1
+AGGAGGTAAATCTATCTTGAGCNAGTNAGNTNNNNNNNNAGGCATTATNNNANCTGACTTCAANATATATAACACAGCTATAGNAATCANNANANCNTNN
++
+EFFDEFFFFFDAEDBDFD?B@@!@C/!77!7!!!!!!!!6961=7AA;!!!<!AAB>=B?>?@!CAAAACBD5CBC?AEAA?A!#####!!#!#!#!#!!
+)";
+
+TEST(AsyncFileTest, SimplePartitionTest) {
+  TempFile file(R"(line 1
+this is line 2
+3
+
+line 4 is me)");
+
+  // Chunks smaller than a line force lines to straddle chunks.
+  for (const uint64_t chunk_size : {1, 3, 7, 4096}) {
+    AsyncFileReader reader(file.path(), 0, 1, FileReader::find_next_line,
+                           false, chunk_size, 2);
+    std::string_view str;
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("line 1", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("this is line 2", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("3", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("line 4 is me", str);
+    EXPECT_FALSE(reader.next(&str));
+  }
+}
+
+TEST(AsyncFileTest, SameAsMmapTest) {
+  constexpr auto num_liness = std::to_array({1, 2, 13, 100, 1000});
+  constexpr auto num_partss = std::to_array<uint64_t>({1, 2, 3, 9, 64});
+  constexpr auto chunk_sizes = std::to_array({5, 64, 4096});
+
+  for (const auto num_lines : num_liness) {
+    TempFile file(generate_csv(num_lines));
+    for (const auto num_parts : num_partss) {
+      for (const auto chunk_size : chunk_sizes) {
+        for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+          MmapFileReader expected(file.path(), part_id, num_parts);
+          AsyncFileReader actual(file.path(), part_id, num_parts,
+                                 FileReader::find_next_line, false,
+                                 chunk_size, 3);
+          std::string_view expected_line, actual_line;
+          while (expected.next(&expected_line)) {
+            ASSERT_TRUE(actual.next(&actual_line));
+            ASSERT_EQ(expected_line, actual_line);
+          }
+          ASSERT_FALSE(actual.next(&actual_line));
+        }
+      }
+    }
+  }
+}
+
+TEST(AsyncFileTest, DirectIOTest) {
+  TempFile file(generate_csv(10000));
+  // Falls back to buffered I/O if the filesystem doesn't support O_DIRECT.
+  for (const uint64_t num_parts : {1, 3, 7}) {
+    for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+      MmapFileReader expected(file.path(), part_id, num_parts);
+      AsyncFileReader actual(file.path(), part_id, num_parts,
+                             FileReader::find_next_line, true,
+                             AsyncFileReader::IO_ALIGNMENT, 2);
+      std::string_view expected_line, actual_line;
+      while (expected.next(&expected_line)) {
+        ASSERT_TRUE(actual.next(&actual_line));
+        ASSERT_EQ(expected_line, actual_line);
+      }
+      ASSERT_FALSE(actual.next(&actual_line));
+    }
+  }
+}
+
+TEST(AsyncFileTest, FailedReadEndsPartitionTest) {
+  const std::string csv = generate_csv(10000);
+  TempFile file(csv);
+  AsyncFileReader reader(file.path(), 0, 1, FileReader::find_next_line, false,
+                         64, 2);
+  // The I/O threads are at most two chunks ahead; the rest is gone.
+  ASSERT_EQ(0, truncate(file.path().c_str(), csv.size() / 2));
+
+  std::vector<std::string> expected = absl::StrSplit(csv, '\n');
+  uint64_t num_lines = 0;
+  for (std::string_view line; reader.next(&line); num_lines++) {
+    ASSERT_LT(num_lines, expected.size());
+    // Whole lines only, even where the read stopped.
+    ASSERT_EQ(expected[num_lines], line);
+  }
+  EXPECT_TRUE(reader.failed());
+  EXPECT_TRUE(reader.eof());
+  EXPECT_LT(num_lines, 10000u);
+  std::string_view line;
+  EXPECT_FALSE(reader.next(&line));
+
+  // A failure that the I/O threads hit while the parser is still chunks
+  // behind loses nothing before the failed read.
+  TempFile ahead(csv);
+  constexpr uint64_t chunk_size = 64;
+  const uint64_t cut = 2 * chunk_size + chunk_size / 2;
+  AsyncFileReader behind(ahead.path(), 0, 1, FileReader::find_next_line,
+                         false, chunk_size, 4);
+  ASSERT_EQ(0, truncate(ahead.path().c_str(), cut));
+  // Let the I/O threads read ahead and fail before parsing starts.
+  // Chunk 2 comes back short and chunk 3 empty, in either order.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  num_lines = 0;
+  for (; behind.next(&line); num_lines++) {
+    ASSERT_LT(num_lines, expected.size());
+    ASSERT_EQ(expected[num_lines], line);
+  }
+  EXPECT_TRUE(behind.failed());
+  EXPECT_GE(num_lines, static_cast<uint64_t>(
+                           std::count(csv.begin(), csv.begin() + cut, '\n')));
+  EXPECT_LT(num_lines, 10000u);
+}
+
+TEST(AsyncFastqReaderTest, MultiParition) {
+  constexpr auto num_seqss = std::to_array({1, 2, 3, 13, 100, 1000});
+  constexpr auto num_partss = std::to_array<uint64_t>({1, 2, 3, 5, 17, 64});
+
+  for (const auto num_seqs : num_seqss) {
+    std::string seqs;
+    for (int i = 0; i < num_seqs; i++) {
+      seqs += ONE_SEQ;
+    }
+    TempFile file(seqs);
+    for (const auto num_parts : num_partss) {
+      uint64_t total_seqs_read = 0;
+      for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+        // The sequence must survive skipping the quality lines.
+        AsyncFastqReader reader(file.path(), part_id, num_parts, false, 64, 4);
+        for (std::string_view seq; reader.next(&seq);) {
+          ASSERT_EQ(100, seq.size());
+          ASSERT_EQ('A', seq.front());
+          ASSERT_EQ('N', seq.back());
+          total_seqs_read++;
+        }
+      }
+      ASSERT_EQ(num_seqs, total_seqs_read)
+          << "Incorrect number of seqs read for " << num_parts
+          << " partitions.";
+    }
+  }
+}
+
+TEST(AsyncFastqKMerReaderTest, SameAsFastqKMerReader) {
+  constexpr size_t K = 4;
+  TempFile file(std::string(ONE_SEQ) + ONE_SEQ);
+  FastqKMerReader<K> expected(file.path());
+  AsyncFastqKMerReader<K> actual(file.path(), 0, 1);
+  uint64_t expected_kmer, actual_kmer;
+  while (expected.next(&expected_kmer)) {
+    ASSERT_TRUE(actual.next(&actual_kmer));
+    EXPECT_EQ(expected_kmer, actual_kmer);
+  }
+  EXPECT_FALSE(actual.next(&actual_kmer));
+}
+
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
@@ -312,6 +312,56 @@ TEST(FastqKMerPreloadReader, MultiseqParseNTest) {
   }
 }
 
+// Quality '#' is 2 and 'I' is 40.
+const char LOW_QUALITY_SEQS[] = R"(@seq0
+ACGTACGTAC
++
+IIII#IIIII
+@seq1
+ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTAC
++
+I#IIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIIII#II
+)";
+
+TEST(QualityFastqReaderTest, MaskTest) {
+  std::unique_ptr<std::istream> input =
+      std::make_unique<std::istringstream>(LOW_QUALITY_SEQS);
+  QualityFastqReader<FileReader> reader(20, std::move(input));
+  std::string_view seq;
+  ASSERT_TRUE(reader.next(&seq));
+  EXPECT_EQ("ACGTNCGTAC", seq);
+  ASSERT_TRUE(reader.next(&seq));
+  EXPECT_EQ("ANGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGNAC", seq);
+  EXPECT_FALSE(reader.next(&seq));
+}
+
+TEST(QualityFastqReaderTest, NoThresholdTest) {
+  std::unique_ptr<std::istream> input =
+      std::make_unique<std::istringstream>(LOW_QUALITY_SEQS);
+  QualityFastqReader<FileReader> reader(0, std::move(input));
+  std::string_view seq;
+  ASSERT_TRUE(reader.next(&seq));
+  EXPECT_EQ("ACGTACGTAC", seq);
+}
+
+TEST(QualityFastqReaderTest, KMerTest) {
+  // The KMers with a low quality base are dropped.
+  constexpr size_t K = 4;
+  std::unique_ptr<std::istream> input =
+      std::make_unique<std::istringstream>(LOW_QUALITY_SEQS);
+  FastqKMerPreloadReader<K, false, QualityFastqReader<FileReader>> reader(
+      20, std::move(input));
+  std::vector<std::string> kmers;
+  for (uint64_t kmer; reader.next(&kmer);) {
+    kmers.push_back(DNAKMer<K>::decode(kmer));
+  }
+  // 1 + 2 KMers of the first sequence, 38 of the second.
+  ASSERT_EQ(3 + 38, kmers.size());
+  EXPECT_EQ("ACGT", kmers[0]);
+  EXPECT_EQ("CGTA", kmers[1]);
+  EXPECT_EQ("GTAC", kmers[2]);
+}
+
 }  // namespace
 }  // namespace input_reader
-}  // namespace kmercounter
\ No newline at end of file
+}  // namespace kmercounter
@@ -0,0 +1,289 @@
+#include "input_reader/gzip_file.hpp"
+
+#include <absl/strings/str_join.h>
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "input_reader/fastq.hpp"
+#include "input_reader/mmap_file.hpp"
+#include "input_reader_test_utils.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+/// Generate comma seperated a CSV file.
+std::string generate_csv(uint64_t num_rows, uint64_t num_cols = 3) {
+  std::string csv;
+  for (uint64_t row = 0; row < num_rows; row++) {
+    std::vector<uint64_t> fields;
+    for (uint64_t col = 0; col < num_cols; col++) {
+      fields.push_back(row + col * col);
+    }
+    csv += absl::StrJoin(fields, ",");
+    csv += '\n';
+  }
+  return csv;
+}
+
+/// Deflate `data` with the given `window_bits` in one go.
+std::string deflate_all(std::string_view data, int window_bits) {
+  z_stream strm{};
+  EXPECT_EQ(Z_OK, deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                               window_bits, 8, Z_DEFAULT_STRATEGY));
+  std::string out(deflateBound(&strm, data.size()) + 32, '\0');
+  strm.next_in = (Bytef *)data.data();
+  strm.avail_in = data.size();
+  strm.next_out = (Bytef *)out.data();
+  strm.avail_out = out.size();
+  EXPECT_EQ(Z_STREAM_END, deflate(&strm, Z_FINISH));
+  out.resize(strm.total_out);
+  deflateEnd(&strm);
+  return out;
+}
+
+std::string gzip(std::string_view data) { return deflate_all(data, 15 + 16); }
+
+/// Compress `data` into BGZF blocks of `block_size` uncompressed bytes.
+std::string bgzip(std::string_view data, uint64_t block_size) {
+  const auto le16 = [](std::string &out, uint32_t x) {
+    out.push_back(x & 0xff);
+    out.push_back(x >> 8 & 0xff);
+  };
+  const auto le32 = [&le16](std::string &out, uint32_t x) {
+    le16(out, x & 0xffff);
+    le16(out, x >> 16);
+  };
+  const auto block = [&](std::string_view piece) {
+    const std::string deflated = deflate_all(piece, -15);
+    std::string out = {'\x1f', '\x8b', '\x08', '\x04', 0, 0, 0, 0, 0, '\xff'};
+    le16(out, 6);
+    out += "BC";
+    le16(out, 2);
+    le16(out, 18 + deflated.size() + 8 - 1);
+    out += deflated;
+    le32(out, crc32(0, (const Bytef *)piece.data(), piece.size()));
+    le32(out, piece.size());
+    return out;
+  };
+
+  std::string out;
+  for (uint64_t offset = 0; offset < data.size(); offset += block_size) {
+    out += block(data.substr(offset, block_size));
+  }
+  // EOF marker.
+  return out + block("");
+}
+
+const char ONE_SEQ[] = R"(@ERR024163.1 EAS51_210:1:1:1072:4554/1
+AGGAGGTAAATCTATCTTGAGCNAGTNAGNTNNNNNNNNAGGCATTATNNNANCTGACTTCAANATATATAACACAGCTATAGNAATCANNANANCNTNN
++
+EFFDEFFFFFDAEDBDFD?B@@!@C/!77!7!!!!!!!!6961=7AA;!!!<!AAB>=B?>?@!CAAAACBD5CBC?AEAA?A!#####!!#!#!#!#!!
+)";
+
+/// Read all lines of `num_parts` partitions, with all readers alive at once
+/// like the worker threads.
+std::vector<std::string> read_lines(const std::string &path,
+                                    uint64_t num_parts, uint64_t chunk_size) {
+  std::vector<std::unique_ptr<GzipFileReader>> readers;
+  for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+    readers.push_back(std::make_unique<GzipFileReader>(
+        path, part_id, num_parts, MmapFileReader::find_next_line, chunk_size));
+  }
+  std::vector<std::string> lines;
+  for (auto &reader : readers) {
+    for (std::string_view line; reader->next(&line);) {
+      lines.emplace_back(line);
+    }
+  }
+  return lines;
+}
+
+TEST(GzipFileTest, SimpleTest) {
+  const char *data = R"(line 1
+this is line 2
+3
+
+line 4 is me)";
+  for (const auto &compressed : {gzip(data), bgzip(data, 5)}) {
+    TempFile file(compressed);
+    EXPECT_TRUE(is_gzip_file(file.path()));
+    GzipFileReader reader(file.path());
+    std::string_view str;
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("line 1", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("this is line 2", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("3", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("", str);
+    EXPECT_TRUE(reader.next(&str));
+    EXPECT_EQ("line 4 is me", str);
+    EXPECT_FALSE(reader.next(&str));
+  }
+}
+
+TEST(GzipFileTest, BgzfBlocksTest) {
+  const std::string csv = generate_csv(1000);
+  EXPECT_TRUE(find_bgzf_blocks(gzip(csv)).empty());
+  const auto blocks = find_bgzf_blocks(bgzip(csv, 1000));
+  ASSERT_EQ((csv.size() + 999) / 1000 + 1, blocks.size());
+  EXPECT_EQ(0, blocks.front().offset);
+  EXPECT_EQ(1000, blocks.front().isize);
+  EXPECT_EQ(0, blocks.back().isize);
+}
+
+TEST(GzipFileTest, UncompressedSizeTest) {
+  const std::string csv = generate_csv(1000);
+  EXPECT_EQ(csv.size(), gzip_uncompressed_size(bgzip(csv, 1000)));
+  // Plain gzip has the size in the footer, but not less than the ratio.
+  const std::string compressed = gzip(csv);
+  EXPECT_EQ(std::max<uint64_t>(csv.size(), 4 * compressed.size()),
+            gzip_uncompressed_size(compressed));
+  EXPECT_EQ(0u, gzip_uncompressed_size(""));
+}
+
+TEST(GzipFileTest, PartitionTest) {
+  constexpr auto num_liness = std::to_array({1, 2, 13, 100, 1000, 10000});
+  constexpr auto num_partss = std::to_array({1, 2, 3, 9, 64});
+
+  for (const auto num_lines : num_liness) {
+    const std::string csv = generate_csv(num_lines);
+    std::vector<std::string> expected;
+    TempFile plain(csv);
+    MmapFileReader plain_reader(plain.path());
+    for (std::string_view line; plain_reader.next(&line);) {
+      expected.emplace_back(line);
+    }
+
+    // Serial gzip hands out chunks in order to whoever asks first.
+    TempFile gz(gzip(csv));
+    // BGZF partitions are in file order.
+    TempFile bgzf(bgzip(csv, 1000));
+    for (const auto num_parts : num_partss) {
+      for (const uint64_t chunk_size : {16, 4096}) {
+        EXPECT_EQ(expected, read_lines(gz.path(), num_parts, chunk_size));
+        EXPECT_EQ(expected, read_lines(bgzf.path(), num_parts, chunk_size))
+            << num_lines << " lines, " << num_parts << " partitions";
+      }
+    }
+  }
+}
+
+TEST(GzipFileTest, ConcurrentPartitionTest) {
+  constexpr uint64_t num_lines = 100000;
+  constexpr uint64_t num_parts = 8;
+  const std::string csv = generate_csv(num_lines);
+  for (const auto &compressed : {gzip(csv), bgzip(csv, 60000)}) {
+    TempFile file(compressed);
+    std::vector<std::unique_ptr<GzipFileReader>> readers;
+    for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+      readers.push_back(std::make_unique<GzipFileReader>(
+          file.path(), part_id, num_parts, MmapFileReader::find_next_line,
+          4096));
+    }
+    std::atomic_uint64_t total_lines_read{};
+    std::vector<std::thread> threads;
+    for (auto &reader : readers) {
+      threads.emplace_back([&reader, &total_lines_read] {
+        total_lines_read += reader_size(std::move(reader));
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    EXPECT_EQ(num_lines, total_lines_read);
+  }
+}
+
+TEST(GzipFastqReaderTest, MultiParition) {
+  constexpr auto num_seqss = std::to_array({1, 2, 3, 13, 100, 1000});
+  constexpr auto num_partss = std::to_array<uint64_t>({1, 2, 3, 5, 17, 64});
+
+  for (const auto num_seqs : num_seqss) {
+    std::string seqs;
+    for (int i = 0; i < num_seqs; i++) {
+      seqs += ONE_SEQ;
+    }
+    for (const auto &compressed : {gzip(seqs), bgzip(seqs, 1000)}) {
+      TempFile file(compressed);
+      for (const auto num_parts : num_partss) {
+        std::vector<std::unique_ptr<GzipFastqReader>> readers;
+        for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+          readers.push_back(std::make_unique<GzipFastqReader>(
+              file.path(), part_id, num_parts, 1000));
+        }
+        uint64_t total_seqs_read = 0;
+        for (auto &reader : readers) {
+          for (std::string_view seq; reader->next(&seq);) {
+            ASSERT_EQ(100, seq.size());
+            total_seqs_read++;
+          }
+        }
+        ASSERT_EQ(num_seqs, total_seqs_read)
+            << "Incorrect number of seqs read for " << num_parts
+            << " partitions.";
+      }
+    }
+  }
+}
+
+TEST(GzipFastqReaderTest, PlusInQualityTest) {
+  // Quality lines which start with and contain '+' (Q10) and '@' (Q31).
+  std::string seqs;
+  constexpr int num_seqs = 500;
+  for (int i = 0; i < num_seqs; i++) {
+    seqs += "@read." + std::to_string(i) + "\n" + std::string(40, "ACGT"[i % 4]) +
+            "\n+\n" + (i % 2 ? "+" : "++@") + std::string(i % 2 ? 39 : 37, '+') +
+            "\n";
+  }
+  for (const auto &compressed : {gzip(seqs), bgzip(seqs, 100)}) {
+    TempFile file(compressed);
+    for (const uint64_t num_parts : {1, 3, 8}) {
+      for (const uint64_t chunk_size : {16, 100, 1000}) {
+        std::vector<std::unique_ptr<GzipFastqReader>> readers;
+        for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+          readers.push_back(std::make_unique<GzipFastqReader>(
+              file.path(), part_id, num_parts, chunk_size));
+        }
+        int total_seqs_read = 0;
+        for (auto &reader : readers) {
+          for (std::string_view seq; reader->next(&seq);) {
+            ASSERT_EQ(40, seq.size());
+            ASSERT_EQ(std::string(40, seq[0]), seq);
+            total_seqs_read++;
+          }
+        }
+        EXPECT_EQ(num_seqs, total_seqs_read)
+            << num_parts << " partitions, chunks of " << chunk_size;
+      }
+    }
+  }
+}
+
+TEST(GzipFastqKMerReaderTest, SameAsFastqKMerReader) {
+  constexpr size_t K = 4;
+  const std::string seqs = std::string(ONE_SEQ) + ONE_SEQ;
+  TempFile plain(seqs);
+  TempFile compressed(bgzip(seqs, 100));
+  FastqKMerReader<K> expected(plain.path());
+  GzipFastqKMerReader<K> actual(compressed.path(), 0, 1);
+  uint64_t expected_kmer, actual_kmer;
+  while (expected.next(&expected_kmer)) {
+    ASSERT_TRUE(actual.next(&actual_kmer));
+    EXPECT_EQ(expected_kmer, actual_kmer);
+  }
+  EXPECT_FALSE(actual.next(&actual_kmer));
+}
+
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
@@ -1,7 +1,14 @@
 #ifndef INPUT_READER_INPUT_READER_TEST_UTILS_HPP
 #define INPUT_READER_INPUT_READER_TEST_UTILS_HPP
 
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <type_traits>
 
 #include "input_reader/input_reader.hpp"
@@ -23,6 +30,26 @@ size_t reader_size(std::unique_ptr<InputReader_t> reader) {
   return size;
 }
 
+/// A temporary file with the given content; removed when out of scope.
+class TempFile {
+ public:
+  TempFile(std::string_view content) {
+    char path[] = "/tmp/input_reader_test.XXXXXX";
+    const int fd = mkstemp(path);
+    EXPECT_GE(fd, 0);
+    close(fd);
+    path_ = path;
+    std::ofstream(path_) << content;
+  }
+
+  ~TempFile() { unlink(path_.c_str()); }
+
+  const std::string& path() const { return path_; }
+
+ private:
+  std::string path_;
+};
+
 }  // namespace input_reader
 }  // namespace kmercounter
 #endif  // INPUT_READER_INPUT_READER_TEST_UTILS_HPP
@@ -2,9 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
 #include <memory>
 #include <sstream>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -14,6 +16,15 @@
 namespace kmercounter {
 namespace input_reader {
 namespace {
+template <size_t K>
+uint64_t encode(std::string_view str) {
+  DNAKMer<K> kmer;
+  for (const char c : str) {
+    EXPECT_TRUE(kmer.push(c));
+  }
+  return kmer.data();
+}
+
 TEST(KmerTest, SimpleTest) {
   const char* data = R"(ATCG
 TAGNAC
@@ -40,6 +51,105 @@ TAGNAC
   EXPECT_FALSE(kmer_reader.next(&kmer));
 }
 
+TEST(KmerTest, ReverseComplementTest) {
+  EXPECT_EQ("CGAT",
+            DNAKMer<4>::decode(DNAKMer<4>::reverse_complement(encode<4>("ATCG"))));
+  EXPECT_EQ("ACCCCCCCCCCCCCCCCCCCCCCCCCCCCCCA",
+            DNAKMer<32>::decode(DNAKMer<32>::reverse_complement(
+                encode<32>("TGGGGGGGGGGGGGGGGGGGGGGGGGGGGGGT"))));
+
+  // The reverse complement is maintained along with the pushes.
+  DNAKMer<5> kmer;
+  for (const char c : std::string_view("GATTACAG")) {
+    kmer.push(c);
+  }
+  EXPECT_EQ("CTGTA", DNAKMer<5>::decode(kmer.rc_data()));
+  EXPECT_EQ(DNAKMer<5>::reverse_complement(kmer.data()), kmer.rc_data());
+}
+
+TEST(KmerTest, CanonicalTest) {
+  const char* data = R"(ACGTT
+AACGT
+)";
+
+  const size_t K = 3;
+  std::unique_ptr<std::istream> file =
+      std::make_unique<std::istringstream>(data);
+  auto file_reader = std::make_unique<FileReader>(std::move(file), 0, 1);
+  KMerReader<K, std::string_view, true> kmer_reader(std::move(file_reader));
+  std::vector<std::string> kmers;
+  for (uint64_t kmer; kmer_reader.next(&kmer);) {
+    kmers.push_back(DNAKMer<K>::decode(kmer));
+  }
+  // Both strands of the same sequence produce the same KMers.
+  EXPECT_EQ((std::vector<std::string>{"ACG", "ACG", "AAC", "AAC", "ACG",
+                                      "ACG"}),
+            kmers);
+}
+
+TEST(KmerTest, WideKMerTest) {
+  // A 70-mer spans three words of a 256-bit KMer.
+  const std::string seq =
+      "ACGTTGCAAGGCTTACCGATNGATTACAGGATTACAGCATGCATGCAAACCCGGGTTTACGTAGCTAGCTAG"
+      "CATCGATCGGCTAGCTAGGATCCAT";
+  for (const uint32_t k : {3u, 32u, 33u, 64u, 70u}) {
+    std::unique_ptr<std::istream> file =
+        std::make_unique<std::istringstream>(seq + "\n");
+    WideKMerReader<4, std::string_view> kmer_reader(
+        std::make_unique<FileReader>(std::move(file), 0, 1),
+        WideDNAKMer<4>(k));
+    std::vector<std::string> kmers;
+    for (WideKey<4> kmer; kmer_reader.next(&kmer);) {
+      kmers.push_back(WideDNAKMer<4>::decode(kmer, k));
+    }
+
+    std::vector<std::string> expected;
+    for (size_t i = 0; i + k <= seq.size(); i++) {
+      const auto kmer = seq.substr(i, k);
+      if (kmer.find('N') == std::string::npos) {
+        expected.push_back(kmer);
+      }
+    }
+    EXPECT_EQ(expected, kmers) << "K=" << k;
+  }
+}
+
+TEST(KmerTest, WideSameAsNarrowTest) {
+  // Up to K = 32, a wide KMer is the narrow one zero extended.
+  const std::string_view seq = "GATTACAGATTACACCGGTTAACGTACGTTGCAAGG";
+  DNAKMer<31> narrow;
+  WideDNAKMer<2> wide(31);
+  for (const char c : seq) {
+    narrow.push(c);
+    wide.push(c);
+    EXPECT_EQ(WideKey<2>(narrow.data()), wide.data());
+    EXPECT_EQ(WideKey<2>(narrow.rc_data()), wide.rc_data());
+  }
+}
+
+TEST(KmerTest, WideCanonicalTest) {
+  const std::string fwd =
+      "ACGTTGCAAGGCTTACCGATGATTACAGGATTACAGCATGCATGCAAACCCGGGTTTACGTAGCTAG";
+  std::string rc;
+  for (auto it = fwd.rbegin(); it != fwd.rend(); it++) {
+    rc.push_back(std::string_view("TGCA")[std::string_view("ACGT").find(*it)]);
+  }
+
+  const uint32_t k = 45;
+  WideDNAKMer<2> fwd_kmer(k), rc_kmer(k);
+  for (const char c : fwd) {
+    fwd_kmer.push(c);
+  }
+  // The reverse complement of the last KMer of `fwd`.
+  for (const char c : rc.substr(0, k)) {
+    rc_kmer.push(c);
+  }
+  EXPECT_EQ(rc.substr(0, k), WideDNAKMer<2>::decode(fwd_kmer.rc_data(), k));
+  EXPECT_EQ(fwd_kmer.canonical_data(), rc_kmer.canonical_data());
+  EXPECT_EQ(std::min(fwd.substr(fwd.size() - k), rc.substr(0, k)),
+            WideDNAKMer<2>::decode(fwd_kmer.canonical_data(), k));
+}
+
 }  // namespace
 }  // namespace input_reader
 }  // namespace kmercounter
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "input_reader/minimizer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "input_reader/container.hpp"
+#include "input_reader/kmer.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+std::vector<std::string> random_sequences(size_t num_seqs, size_t max_len) {
+  std::mt19937 rng(7);
+  const char bases[] = "ACGTACGTACGTACGTacgtN";
+  std::vector<std::string> seqs;
+  for (size_t i = 0; i < num_seqs; i++) {
+    std::string seq(rng() % max_len, 'A');
+    for (auto& base : seq) {
+      base = bases[rng() % (sizeof(bases) - 1)];
+    }
+    seqs.push_back(seq);
+  }
+  // A long low complexity run.
+  seqs.push_back(std::string(500, 'A'));
+  return seqs;
+}
+
+/// The minimizer of `kmer` by brute force.
+template <bool Canonical>
+uint64_t minimizer(std::string_view kmer, uint32_t m) {
+  uint64_t min = ~0ull;
+  for (size_t i = 0; i + m <= kmer.size(); i++) {
+    uint64_t fwd = 0, rc = 0;
+    for (size_t j = 0; j < m; j++) {
+      const uint64_t code = DNAKMer<1>::encode(kmer[i + j]);
+      fwd = (fwd << 2) | code;
+      rc |= (code ^ 3) << (2 * j);
+    }
+    min = std::min(min, MinimizerSplitter<Canonical>::order(
+                            Canonical ? std::min(fwd, rc) : fwd));
+  }
+  return min;
+}
+
+template <size_t K, bool Canonical>
+void check_split(const std::vector<std::string>& seqs, uint32_t m) {
+  KMerReader<K, std::string, Canonical> reader(
+      std::make_unique<VecReader<std::string>>(seqs));
+  std::vector<uint64_t> expected;
+  for (uint64_t kmer; reader.next(&kmer);) {
+    expected.push_back(kmer);
+  }
+
+  MinimizerSplitter<Canonical> splitter(K, m);
+  std::vector<uint64_t> kmers;
+  for (const auto& seq : seqs) {
+    splitter.split(seq, [&](const SuperKMer& skmer) {
+      ASSERT_GE(skmer.bases.size(), K);
+      const size_t num_kmers = skmer.bases.size() - K + 1;
+      EXPECT_LE(num_kmers, MinimizerSplitter<Canonical>::DEFAULT_MAX_KMERS);
+      // Every KMer of a super KMer has its minimizer.
+      for (size_t i = 0; i < num_kmers; i++) {
+        EXPECT_EQ(minimizer<Canonical>(skmer.bases.substr(i, K), m),
+                  skmer.minimizer);
+      }
+
+      uint64_t words[superkmer::MAX_WORDS];
+      ASSERT_EQ(superkmer::num_words(skmer.bases.size()),
+                superkmer::pack(skmer.bases, words));
+      superkmer::for_each_kmer<Canonical>(
+          words, skmer.bases.size(), K,
+          [&](uint64_t kmer) { kmers.push_back(kmer); });
+    });
+  }
+  // Super KMers cover all KMers, in order.
+  EXPECT_EQ(expected, kmers) << "K=" << K << ", m=" << m;
+}
+
+TEST(MinimizerTest, SplitTest) {
+  const auto seqs = random_sequences(300, 200);
+  check_split<1, false>(seqs, 1);
+  check_split<5, false>(seqs, 3);
+  check_split<21, false>(seqs, 7);
+  check_split<31, false>(seqs, 11);
+  check_split<32, false>(seqs, 32);
+}
+
+TEST(MinimizerTest, CanonicalTest) {
+  const auto seqs = random_sequences(300, 200);
+  check_split<5, true>(seqs, 3);
+  check_split<21, true>(seqs, 7);
+  check_split<32, true>(seqs, 15);
+}
+
+TEST(MinimizerTest, FewerMessagesTest) {
+  // Most consecutive KMers share their minimizer.
+  const auto seqs = random_sequences(300, 200);
+  MinimizerSplitter<> splitter(31, 11);
+  size_t num_superkmers = 0, num_kmers = 0;
+  for (const auto& seq : seqs) {
+    splitter.split(seq, [&](const SuperKMer& skmer) {
+      num_superkmers++;
+      num_kmers += skmer.bases.size() - 31 + 1;
+    });
+  }
+  EXPECT_GT(num_kmers, 4 * num_superkmers);
+}
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
@@ -0,0 +1,142 @@
+#include "input_reader/mmap_file.hpp"
+
+#include <absl/strings/str_join.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <boost/range/adaptor/transformed.hpp>
+#include <boost/range/irange.hpp>
+#include <boost/range/numeric.hpp>
+#include <string>
+
+#include "input_reader/fastq.hpp"
+#include "input_reader_test_utils.hpp"
+
+using boost::accumulate;
+using boost::irange;
+using boost::adaptors::transformed;
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+/// Generate comma seperated a CSV file.
+std::string generate_csv(uint64_t num_rows, uint64_t num_cols = 3) {
+  std::string csv;
+  for (uint64_t row = 0; row < num_rows; row++) {
+    std::vector<uint64_t> fields;
+    for (uint64_t col = 0; col < num_cols; col++) {
+      fields.push_back(row + col * col);
+    }
+    csv += absl::StrJoin(fields, ",");
+    csv += '\n';
+  }
+  return csv;
+}
+
+const char ONE_SEQ[] = R"(@ERR024163.1 EAS51_210:1:1:1072:4554/1
+AGGAGGTAAATCTATCTTGAGCNAGTNAGNTNNNNNNNNAGGCATTATNNNANCTGACTTCAANATATATAACACAGCTATAGNAATCANNANANCNTNN
++
+EFFDEFFFFFDAEDBDFD?B@@!@C/!77!7!!!!!!!!6961=7AA;!!!<!AAB>=B?>?@!CAAAACBD5CBC?AEAA?A!#####!!#!#!#!#!!
+)";
+
+TEST(MmapFileTest, SimplePartitionTest) {
+  TempFile file(R"(line 1
+this is line 2
+3
+
+line 4 is me)");
+
+  auto reader = std::make_unique<MmapFileReader>(file.path());
+  std::string_view str;
+  EXPECT_TRUE(reader->next(&str));
+  EXPECT_EQ("line 1", str);
+  EXPECT_TRUE(reader->next(&str));
+  EXPECT_EQ("this is line 2", str);
+  EXPECT_TRUE(reader->next(&str));
+  EXPECT_EQ("3", str);
+  EXPECT_TRUE(reader->next(&str));
+  EXPECT_EQ("", str);
+  EXPECT_TRUE(reader->next(&str));
+  EXPECT_EQ("line 4 is me", str);
+  EXPECT_FALSE(reader->next(&str));
+}
+
+TEST(MmapFileTest, EmptyFileTest) {
+  TempFile file("");
+  std::string_view str;
+  MmapFileReader reader(file.path());
+  EXPECT_FALSE(reader.next(&str));
+}
+
+TEST(MmapFileTest, PartitionTest) {
+  constexpr auto num_liness =
+      std::to_array({1, 2, 3, 4, 6, 9, 13, 17, 19, 21, 22, 24, 100, 1000});
+  constexpr auto num_partss =
+      std::to_array({1, 2, 3, 4, 5, 6, 9, 13, 17, 19, 64});
+
+  for (const auto num_lines : num_liness) {
+    TempFile file(generate_csv(num_lines));
+    auto mapping = std::make_shared<const MmapFile>(file.path());
+    for (const auto num_parts : num_partss) {
+      auto readers = irange(num_parts) |
+                     transformed([&mapping, num_parts](uint64_t part_id) {
+                       return std::make_unique<MmapFileReader>(
+                           mapping, part_id, num_parts);
+                     });
+
+      auto lines_read = readers | transformed([](auto reader) {
+                          const uint64_t lines_read =
+                              reader_size(std::move(reader));
+                          return lines_read;
+                        });
+
+      const uint64_t total_lines_read = accumulate(lines_read, 0ul);
+      ASSERT_EQ(num_lines, total_lines_read)
+          << "Incorrect number of lines read for " << num_parts
+          << " partitions.";
+    }
+  }
+}
+
+TEST(MmapFastqReaderTest, MultiParition) {
+  constexpr auto num_seqss = std::to_array({1, 2, 3, 13, 100, 1000});
+  constexpr auto num_partss = std::to_array<uint64_t>({1, 2, 3, 5, 17, 64});
+
+  for (const auto num_seqs : num_seqss) {
+    std::string seqs;
+    for (int i = 0; i < num_seqs; i++) {
+      seqs += ONE_SEQ;
+    }
+    TempFile file(seqs);
+    for (const auto num_parts : num_partss) {
+      uint64_t total_seqs_read = 0;
+      for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+        MmapFastqReader reader(file.path(), part_id, num_parts);
+        for (std::string_view seq; reader.next(&seq);) {
+          ASSERT_EQ(100, seq.size());
+          total_seqs_read++;
+        }
+      }
+      ASSERT_EQ(num_seqs, total_seqs_read)
+          << "Incorrect number of seqs read for " << num_parts
+          << " partitions.";
+    }
+  }
+}
+
+TEST(MmapFastqKMerReaderTest, SameAsFastqKMerReader) {
+  constexpr size_t K = 4;
+  TempFile file(std::string(ONE_SEQ) + ONE_SEQ);
+  FastqKMerReader<K> expected(file.path());
+  MmapFastqKMerReader<K> actual(file.path());
+  uint64_t expected_kmer, actual_kmer;
+  while (expected.next(&expected_kmer)) {
+    ASSERT_TRUE(actual.next(&actual_kmer));
+    EXPECT_EQ(expected_kmer, actual_kmer);
+  }
+  EXPECT_FALSE(actual.next(&actual_kmer));
+}
+
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
@@ -0,0 +1,88 @@
+#include "input_reader/multi_k.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "input_reader/container.hpp"
+#include "input_reader/kmer.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+std::vector<std::string> random_sequences(size_t num_seqs, size_t max_len) {
+  std::mt19937 rng(11);
+  const char bases[] = "ACGTACGTACGTACGTacgtN";
+  std::vector<std::string> seqs;
+  for (size_t i = 0; i < num_seqs; i++) {
+    std::string seq(rng() % max_len, 'A');
+    for (auto& base : seq) {
+      base = bases[rng() % (sizeof(bases) - 1)];
+    }
+    seqs.push_back(seq);
+  }
+  return seqs;
+}
+
+template <size_t K, bool Canonical>
+std::vector<uint64_t> read_kmers(const std::vector<std::string>& seqs) {
+  KMerReader<K, std::string, Canonical> reader(
+      std::make_unique<VecReader<std::string>>(seqs));
+  std::vector<uint64_t> kmers;
+  for (uint64_t kmer; reader.next(&kmer);) {
+    kmers.push_back(kmer);
+  }
+  return kmers;
+}
+
+template <bool Canonical>
+void check_extract() {
+  const auto seqs = random_sequences(300, 200);
+  // Out of order and with a duplicate.
+  const MultiKExtractor<Canonical> extractor({21, 1, 5, 31, 5});
+  ASSERT_EQ(extractor.ks(), (std::vector<uint32_t>{1, 5, 21, 31}));
+
+  std::vector<std::vector<uint64_t>> kmers(extractor.ks().size());
+  for (const auto& seq : seqs) {
+    extractor.extract(seq, [&](size_t i, uint64_t kmer) {
+      kmers[i].push_back(kmer);
+    });
+  }
+  EXPECT_EQ((read_kmers<1, Canonical>(seqs)), kmers[0]);
+  EXPECT_EQ((read_kmers<5, Canonical>(seqs)), kmers[1]);
+  EXPECT_EQ((read_kmers<21, Canonical>(seqs)), kmers[2]);
+  EXPECT_EQ((read_kmers<31, Canonical>(seqs)), kmers[3]);
+}
+
+TEST(MultiKTest, ExtractTest) { check_extract<false>(); }
+
+TEST(MultiKTest, CanonicalTest) { check_extract<true>(); }
+
+TEST(MultiKTest, TagTest) {
+  using Extractor = MultiKExtractor<>;
+  std::set<uint64_t> keys;
+  for (uint32_t k = 1; k <= Extractor::MAX_K; k++) {
+    for (const uint64_t kmer : {0ull, 1ull, (1ull << (2 * k)) - 1}) {
+      const uint64_t key = Extractor::tag(kmer, k);
+      EXPECT_NE(key, 0);
+      EXPECT_EQ(Extractor::k_of(key), k);
+      EXPECT_EQ(Extractor::untag(key), kmer);
+      keys.insert(key);
+    }
+  }
+  // No two (K, KMer) share a key.
+  EXPECT_EQ(keys.size(), 3 * Extractor::MAX_K);
+}
+
+TEST(MultiKTest, ParseTest) {
+  EXPECT_EQ(parse_k_list("21,25,31"), (std::vector<uint32_t>{21, 25, 31}));
+  EXPECT_EQ(parse_k_list("15"), (std::vector<uint32_t>{15}));
+  EXPECT_TRUE(parse_k_list("").empty());
+}
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
@@ -0,0 +1,177 @@
+#include "input_reader/scheduler.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "input_reader/fastq.hpp"
+#include "input_reader_test_utils.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+/// A FASTQ file of `num_seqs` distinct sequences, tagged with `tag`.
+std::string generate_fastq(uint64_t num_seqs, char tag) {
+  const char bases[] = "ACGT";
+  std::string fastq;
+  for (uint64_t i = 0; i < num_seqs; i++) {
+    std::string seq(1, tag);
+    for (uint64_t n = i; seq.size() < 12; n /= 4) {
+      seq.push_back(bases[n % 4]);
+    }
+    fastq += "@seq" + std::to_string(i) + "\n" + seq + "\n+\n" +
+             std::string(seq.size(), 'I') + "\n";
+  }
+  return fastq;
+}
+
+// `TempFile` removes its file when copied on a reallocation.
+using TempFiles = std::vector<std::unique_ptr<TempFile>>;
+
+std::vector<InputFile> input_files(const TempFiles& files) {
+  std::vector<InputFile> inputs;
+  for (const auto& file : files) {
+    inputs.push_back({file->path(), "",
+                      std::filesystem::file_size(file->path()), true});
+  }
+  return inputs;
+}
+
+ScheduledSequenceReader::Opener mmap_opener() {
+  return [](const std::string& path, uint64_t part_id, uint64_t num_parts) {
+    return std::make_unique<MmapFastqReader>(path, part_id, num_parts);
+  };
+}
+
+TEST(InputSchedulerTest, BalanceTest) {
+  // Files of very different sizes.
+  TempFiles files;
+  for (const uint64_t num_seqs : {10000, 10, 3000, 1, 500}) {
+    files.push_back(
+        std::make_unique<TempFile>(generate_fastq(num_seqs, 'A')));
+  }
+  const uint32_t num_workers = 4;
+  InputScheduler scheduler(input_files(files), num_workers, 4096);
+
+  // Without stealing, every worker gets about the same number of bytes.
+  uint64_t total = 0;
+  std::vector<uint64_t> bytes(num_workers);
+  std::map<std::pair<std::string, uint32_t>, int> taken;
+  for (uint32_t w = 0; w < num_workers; w++) {
+    InputScheduler ws(input_files(files), num_workers, 4096);
+    for (InputRange range; ws.next(w, &range) && ws.num_stolen() == 0;) {
+      bytes[w] += range.file->size / range.num_parts;
+    }
+  }
+  for (InputRange range; scheduler.next(0, &range);) {
+    taken[{range.file->path, range.part_id}]++;
+    total += range.file->size / range.num_parts;
+  }
+  EXPECT_EQ(taken.size(), scheduler.num_ranges());
+  for (const auto& [range, n] : taken) {
+    EXPECT_EQ(n, 1);
+  }
+  for (const auto b : bytes) {
+    EXPECT_NEAR(b, total / num_workers, total / num_workers / 4);
+  }
+}
+
+TEST(InputSchedulerTest, WorkStealingTest) {
+  TempFiles files;
+  for (const uint64_t num_seqs : {20000, 7, 5000, 300}) {
+    files.push_back(
+        std::make_unique<TempFile>(generate_fastq(num_seqs, 'C')));
+  }
+  const uint32_t num_workers = 8;
+  InputScheduler scheduler(input_files(files), num_workers, 4096);
+
+  // Worker 0 is slow; the others take over its ranges.
+  std::mutex mutex;
+  std::vector<std::string> copies;
+  std::vector<std::thread> threads;
+  for (uint32_t w = 0; w < num_workers; w++) {
+    threads.emplace_back([&, w] {
+      ScheduledSequenceReader reader(&scheduler, w, mmap_opener());
+      std::vector<std::string> mine;
+      for (std::string_view seq; reader.next(&seq);) {
+        mine.emplace_back(seq);
+        if (w == 0) {
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+      }
+      const std::lock_guard<std::mutex> lock(mutex);
+      copies.insert(copies.end(), mine.begin(), mine.end());
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_GT(scheduler.num_stolen(), 0);
+
+  // Every sequence is read exactly once.
+  std::vector<std::string> expected;
+  for (const auto& file : files) {
+    MmapFastqReader reader(file->path());
+    for (std::string_view seq; reader.next(&seq);) {
+      expected.emplace_back(seq);
+    }
+  }
+  std::sort(expected.begin(), expected.end());
+  std::sort(copies.begin(), copies.end());
+  EXPECT_EQ(expected, copies);
+}
+
+TEST(InputSchedulerTest, PairedEndTest) {
+  // The mates are read in lockstep.
+  TempFile r1(generate_fastq(100, 'G'));
+  TempFile r2(generate_fastq(100, 'T'));
+  TempFile manifest(r1.path() + " " + r2.path() + "\n");
+  auto inputs = list_input_files("", manifest.path());
+  ASSERT_EQ(inputs.size(), 1);
+  EXPECT_EQ(inputs[0].mate, r2.path());
+
+  InputScheduler scheduler(std::move(inputs), 1);
+  ScheduledSequenceReader reader(&scheduler, 0, mmap_opener());
+  std::vector<std::string> seqs;
+  for (std::string_view seq; reader.next(&seq);) {
+    seqs.emplace_back(seq);
+  }
+  ASSERT_EQ(seqs.size(), 200);
+  for (size_t i = 0; i < seqs.size(); i += 2) {
+    EXPECT_EQ(seqs[i][0], 'G');
+    EXPECT_EQ(seqs[i + 1][0], 'T');
+    EXPECT_EQ(seqs[i].substr(1), seqs[i + 1].substr(1));
+  }
+}
+
+TEST(InputSchedulerTest, GlobTest) {
+  TempFile file(generate_fastq(10, 'A'));
+  EXPECT_TRUE(is_glob("/data/*.fastq"));
+  EXPECT_FALSE(is_glob(file.path()));
+  const auto inputs = list_input_files(file.path().substr(0, 10) + "*", "");
+  EXPECT_TRUE(std::any_of(inputs.begin(), inputs.end(), [&](const auto& in) {
+    return in.path == file.path();
+  }));
+}
+
+TEST(InputSchedulerTest, InvalidInputTest) {
+  TempFile file(generate_fastq(10, 'A'));
+  EXPECT_THROW(list_input_files("", file.path() + ".missing"),
+               std::runtime_error);
+  TempFile manifest(file.path() + "\n" + file.path() + ".missing\n");
+  EXPECT_THROW(list_input_files("", manifest.path()), std::runtime_error);
+  TempFile empty("\n");
+  EXPECT_THROW(list_input_files("", empty.path()), std::runtime_error);
+  EXPECT_THROW(list_input_files(file.path() + ".missing*", ""),
+               std::runtime_error);
+}
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
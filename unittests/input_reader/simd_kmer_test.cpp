@@ -0,0 +1,130 @@
+#include "input_reader/simd_kmer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "input_reader/container.hpp"
+#include "input_reader/fastq.hpp"
+#include "input_reader/kmer.hpp"
+#include "input_reader_test_utils.hpp"
+
+namespace kmercounter {
+namespace input_reader {
+namespace {
+/// Random sequences with a sprinkle of N and lower case bases.
+std::vector<std::string> random_sequences(size_t num_seqs, size_t max_len) {
+  std::mt19937 rng(42);
+  const char bases[] = "ACGTACGTACGTACGTacgtN";
+  std::vector<std::string> seqs;
+  for (size_t i = 0; i < num_seqs; i++) {
+    std::string seq(rng() % max_len, 'A');
+    for (auto& base : seq) {
+      base = bases[rng() % (sizeof(bases) - 1)];
+    }
+    seqs.push_back(seq);
+  }
+  return seqs;
+}
+
+template <size_t K, bool Canonical = false>
+std::vector<uint64_t> reference_kmers(const std::vector<std::string>& seqs) {
+  KMerReader<K, std::string, Canonical> reader(
+      std::make_unique<VecReader<std::string>>(seqs));
+  std::vector<uint64_t> kmers;
+  for (uint64_t kmer; reader.next(&kmer);) {
+    kmers.push_back(kmer);
+  }
+  return kmers;
+}
+
+template <size_t K, bool Canonical = false>
+std::vector<uint64_t> simd_kmers(const std::vector<std::string>& seqs) {
+  SimdKMerReader<K, std::string, Canonical> reader(
+      std::make_unique<VecReader<std::string>>(seqs), 64);
+  std::vector<uint64_t> kmers;
+  for (std::span<const uint64_t> batch; reader.next_batch(&batch);) {
+    EXPECT_FALSE(batch.empty());
+    kmers.insert(kmers.end(), batch.begin(), batch.end());
+  }
+  return kmers;
+}
+
+TEST(SimdKMerTest, EncodeBlockTest) {
+  uint64_t codes;
+  uint32_t invalid;
+  simd::encode_block("ACGTacgtN", 9, &codes, &invalid);
+  EXPECT_EQ(0b00'01'10'11'00'01'10'11ull << 48, codes);
+  EXPECT_EQ(~0u << 8, invalid);
+}
+
+TEST(SimdKMerTest, SimpleTest) {
+  const size_t K = 2;
+  std::vector<std::string> seqs{"ATCG", "TAGNAC"};
+  SimdKMerReader<K, std::string> reader(
+      std::make_unique<VecReader<std::string>>(seqs));
+  std::vector<std::string> kmers;
+  for (uint64_t kmer; reader.next(&kmer);) {
+    kmers.push_back(DNAKMer<K>::decode(kmer));
+  }
+  EXPECT_EQ((std::vector<std::string>{"AT", "TC", "CG", "TA", "AG", "AC"}),
+            kmers);
+}
+
+TEST(SimdKMerTest, SameAsKMerReaderTest) {
+  const auto seqs = random_sequences(500, 300);
+  EXPECT_EQ(reference_kmers<1>(seqs), simd_kmers<1>(seqs));
+  EXPECT_EQ(reference_kmers<5>(seqs), simd_kmers<5>(seqs));
+  EXPECT_EQ(reference_kmers<16>(seqs), simd_kmers<16>(seqs));
+  EXPECT_EQ(reference_kmers<31>(seqs), simd_kmers<31>(seqs));
+  EXPECT_EQ(reference_kmers<32>(seqs), simd_kmers<32>(seqs));
+}
+
+TEST(SimdKMerTest, CanonicalTest) {
+  const auto seqs = random_sequences(500, 300);
+  EXPECT_EQ((reference_kmers<1, true>(seqs)), (simd_kmers<1, true>(seqs)));
+  EXPECT_EQ((reference_kmers<5, true>(seqs)), (simd_kmers<5, true>(seqs)));
+  EXPECT_EQ((reference_kmers<16, true>(seqs)), (simd_kmers<16, true>(seqs)));
+  EXPECT_EQ((reference_kmers<31, true>(seqs)), (simd_kmers<31, true>(seqs)));
+  EXPECT_EQ((reference_kmers<32, true>(seqs)), (simd_kmers<32, true>(seqs)));
+
+  // Canonical KMers are the smaller of the forward ones and their reverse
+  // complements.
+  const auto forward = simd_kmers<21>(seqs);
+  const auto canonical = simd_kmers<21, true>(seqs);
+  ASSERT_EQ(forward.size(), canonical.size());
+  for (size_t i = 0; i < forward.size(); i++) {
+    EXPECT_EQ(DNAKMer<21>::canonical(forward[i]), canonical[i]);
+  }
+}
+
+TEST(SimdKMerTest, FastqTest) {
+  std::string fastq;
+  const auto seqs = random_sequences(200, 150);
+  for (const auto& seq : seqs) {
+    fastq += "@seq\n" + seq + "\n+\n" + std::string(seq.size(), 'F') + "\n";
+  }
+  TempFile file(fastq);
+
+  const size_t K = 21;
+  const auto expected = reference_kmers<K>(seqs);
+  std::vector<uint64_t> kmers;
+  const uint64_t num_parts = 3;
+  for (uint64_t part_id = 0; part_id < num_parts; part_id++) {
+    auto reader =
+        MakeSimdFastqKMerReader<MmapFastqReader>(K, file.path(), part_id, num_parts);
+    for (uint64_t kmer; reader->next(&kmer);) {
+      kmers.push_back(kmer);
+    }
+  }
+  EXPECT_EQ(expected, kmers);
+}
+}  // namespace
+}  // namespace input_reader
+}  // namespace kmercounter
@@ -0,0 +1,87 @@
+#include "queues/mpsc_section_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+// The app defines these with the queue tests.
+const uint64_t PAGESIZE = sysconf(_SC_PAGESIZE);
+const data_t MpscSectionQueue::BQ_MAGIC_KV = data_t(
+    MpscSectionQueue::BQ_MAGIC_64BIT, MpscSectionQueue::BQ_MAGIC_64BIT);
+
+namespace {
+/// Message `i` of producer `p`; never the end of stream.
+data_t message(uint32_t p, uint64_t i) { return data_t(p, i); }
+
+/// Send `num_msgs` messages from each of `nprod` producers to a single
+/// consumer through a ring of `num_sections`, and check that every message
+/// arrives once, in the order of its producer, and that the consumer stops
+/// on the `nprod`th end of stream.
+void check_delivery(uint32_t nprod, size_t num_sections, uint64_t num_msgs) {
+  MpscSectionQueue queue(nprod, 1, num_sections, nullptr);
+
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < nprod; p++) {
+    producers.emplace_back([&queue, p, num_msgs] {
+      auto *pq = &queue.all_pqueues[p][0];
+      for (uint64_t i = 0; i < num_msgs; i++) {
+        queue.enqueue(pq, p, 0, message(p, i));
+      }
+      queue.push_done(p, 0);
+    });
+  }
+
+  // Next message expected from each producer.
+  std::vector<uint64_t> next(nprod, 0);
+  uint32_t num_done = 0;
+  uint64_t num_received = 0;
+  for (uint32_t p = 0; num_done < nprod; p = (p + 1) % nprod) {
+    data_t msg;
+    if (queue.dequeue(&queue.all_cqueues[0][p], p, 0, &msg) != SUCCESS) {
+      continue;
+    }
+    if (msg == MpscSectionQueue::BQ_MAGIC_KV) {
+      num_done++;
+      continue;
+    }
+    // Keep draining on a failure; the producers may be waiting for room.
+    const uint64_t from = msg.key;
+    num_received++;
+    EXPECT_LT(from, nprod);
+    if (from >= nprod) {
+      continue;
+    }
+    EXPECT_EQ(msg.value, next[from]) << "producer " << from;
+    next[from] = msg.value + 1;
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+
+  EXPECT_EQ(num_received, nprod * num_msgs);
+  for (uint32_t p = 0; p < nprod; p++) {
+    EXPECT_EQ(next[p], num_msgs) << "producer " << p;
+  }
+  // Nothing follows the ends of stream.
+  data_t msg;
+  EXPECT_EQ(queue.dequeue(&queue.all_cqueues[0][0], 0, 0, &msg), RETRY);
+}
+
+TEST(MpscSectionQueueTest, DeliversOnceInOrderTest) {
+  // A ring of a few sections, so that the producers wrap around it and wait
+  // on the consumer.
+  check_delivery(4, 4, 20000);
+}
+
+TEST(MpscSectionQueueTest, PartialSectionsTest) {
+  // Every stream fits in a section, which only `push_done` publishes.
+  check_delivery(8, 16, 3);
+}
+
+TEST(MpscSectionQueueTest, EmptyStreamsTest) { check_delivery(4, 2, 0); }
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,82 @@
+#include "hashtables/partition_map.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <set>
+
+namespace kmercounter {
+namespace {
+void check_consistent(const PartitionMap &map) {
+  std::set<uint32_t> seen;
+  for (uint32_t o = 0; o < map.num_owners(); o++) {
+    EXPECT_FALSE(map.partitions_of(o).empty()) << "owner " << o;
+    for (auto p : map.partitions_of(o)) {
+      EXPECT_EQ(map.owner_of(p), o);
+      EXPECT_TRUE(seen.insert(p).second) << "partition " << p;
+    }
+  }
+  EXPECT_EQ(seen.size(), map.num_partitions());
+}
+
+TEST(PartitionMapTest, InitialOwnersTest) {
+  PartitionMap map(10, 4);
+  check_consistent(map);
+  EXPECT_EQ(map.partitions_of(0).size(), 3u);
+  EXPECT_EQ(map.partitions_of(3).size(), 2u);
+  EXPECT_EQ(map.owner_of(5), 1u);
+}
+
+TEST(PartitionMapTest, BalancedStaysTest) {
+  PartitionMap map(16, 4);
+  for (uint32_t p = 0; p < 16; p++) {
+    map.add_load(p, 1000);
+  }
+  EXPECT_EQ(map.rebalance(), 0u);
+  check_consistent(map);
+}
+
+TEST(PartitionMapTest, RebalanceTest) {
+  PartitionMap map(32, 4);
+  // Owner 0 gets all the load.
+  for (auto p : map.partitions_of(0)) {
+    map.add_load(p, 1000);
+  }
+  for (auto p : map.partitions_of(1)) {
+    map.add_load(p, 10);
+  }
+  EXPECT_GT(map.rebalance(0.1), 0u);
+  check_consistent(map);
+
+  // The same load again is now within the tolerance.
+  std::vector<uint64_t> owner_loads(4);
+  for (uint32_t p = 0; p < 32; p++) {
+    const uint64_t load = p % 4 == 0 ? 1000 : p % 4 == 1 ? 10 : 0;
+    owner_loads[map.owner_of(p)] += load;
+    map.add_load(p, load);
+  }
+  const uint64_t total = 8 * 1010;
+  for (auto load : owner_loads) {
+    EXPECT_LE(load, 1.1 * total / 4 + 1000);
+  }
+  // The loads were reset by the first rebalance.
+  EXPECT_EQ(map.load_of(0), 1000u);
+}
+
+TEST(PartitionMapTest, SingleHotPartitionTest) {
+  // One partition carries everything; moving it only shifts the problem.
+  PartitionMap map(8, 2);
+  map.add_load(0, 1000);
+  EXPECT_EQ(map.rebalance(), 0u);
+  check_consistent(map);
+}
+
+TEST(PartitionMapTest, KeepsAPartitionTest) {
+  PartitionMap map(4, 4);
+  map.add_load(0, 1000);
+  map.add_load(1, 1);
+  EXPECT_EQ(map.rebalance(), 0u);
+  check_consistent(map);
+}
+}  // namespace
+}  // namespace kmercounter
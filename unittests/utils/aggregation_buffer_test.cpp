@@ -0,0 +1,61 @@
+#include "utils/aggregation_buffer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+
+namespace kmercounter {
+namespace {
+TEST(AggregationBufferTest, MergeTest) {
+  AggregationBuffer buffer(64);
+  for (uint64_t i = 0; i < 1000; i++) {
+    buffer.add(1 + i % 10, [](uint64_t, uint64_t) { FAIL(); });
+  }
+  std::map<uint64_t, uint64_t> counts;
+  buffer.drain([&](uint64_t key, uint64_t count) { counts[key] += count; });
+  ASSERT_EQ(counts.size(), 10u);
+  for (const auto &[key, count] : counts) {
+    EXPECT_EQ(count, 100u);
+  }
+
+  // Drained means empty.
+  counts.clear();
+  buffer.drain([&](uint64_t key, uint64_t count) { counts[key] += count; });
+  EXPECT_TRUE(counts.empty());
+}
+
+TEST(AggregationBufferTest, EvictionTest) {
+  AggregationBuffer buffer(100);
+  EXPECT_GE(buffer.capacity(), 100u);
+
+  // Far more keys than room; every occurrence comes out exactly once.
+  std::map<uint64_t, uint64_t> counts;
+  auto merge = [&](uint64_t key, uint64_t count) { counts[key] += count; };
+  const uint64_t num_keys = 10000;
+  for (uint64_t round = 0; round < 3; round++) {
+    for (uint64_t key = 1; key <= num_keys; key++) {
+      for (uint64_t i = 0; i < key % 4; i++) {
+        buffer.add(key, merge);
+      }
+    }
+  }
+  EXPECT_GT(buffer.num_evictions(), 0u);
+  buffer.drain(merge);
+  for (uint64_t key = 1; key <= num_keys; key++) {
+    EXPECT_EQ(counts[key], 3 * (key % 4)) << key;
+  }
+}
+
+TEST(AggregationBufferTest, KeepsFrequentKeysTest) {
+  AggregationBuffer buffer(16);
+  uint64_t hot_evictions = 0;
+  auto evict = [&](uint64_t key, uint64_t) { hot_evictions += key == 1; };
+  for (uint64_t i = 1; i <= 10000; i++) {
+    buffer.add(1, evict);
+    buffer.add(1000 + i, evict);
+  }
+  EXPECT_EQ(hot_evictions, 0u);
+}
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,113 @@
+#include "utils/elastic_workers.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+TEST(ElasticPolicyTest, FollowsTheLoadTest) {
+  ElasticPolicy policy(8);
+  // Nothing is known of the workers yet: run them all.
+  auto plan = policy.next({0, 0, 100, 0, 0, 0});
+  EXPECT_EQ(plan.inserters + plan.finders, 8u);
+
+  // 8 workers fall behind at 80 ops a tick: 10 ops a worker.
+  plan = policy.next({80, 8, 80, 0, 20, 0});
+  EXPECT_DOUBLE_EQ(policy.worker_rate(), 10.0);
+  EXPECT_EQ(plan.inserters + plan.finders, 8u);
+
+  // The load drops to 20 a tick; the pool shrinks a worker a tick...
+  for (uint32_t active = 7; active >= 2; active--) {
+    plan = policy.next({20, active + 1, 20, 0, 0, 0});
+    EXPECT_EQ(plan.inserters + plan.finders, active);
+  }
+  // ...and stops at what the load needs.
+  plan = policy.next({20, 2, 20, 0, 0, 0});
+  EXPECT_EQ(plan.inserters + plan.finders, 2u);
+
+  // A burst takes it back up at once.
+  plan = policy.next({20, 2, 100, 0, 0, 0});
+  EXPECT_EQ(plan.inserters + plan.finders, 8u);
+}
+
+TEST(ElasticPolicyTest, SplitsByDemandTest) {
+  ElasticPolicy policy(4);
+  auto plan = policy.next({0, 0, 300, 100, 0, 0});
+  EXPECT_EQ(plan.inserters, 3u);
+  EXPECT_EQ(plan.finders, 1u);
+
+  // A trickle of finds still gets a worker.
+  plan = policy.next({0, 4, 1000, 1, 0, 0});
+  EXPECT_EQ(plan.inserters, 3u);
+  EXPECT_EQ(plan.finders, 1u);
+
+  plan = policy.next({0, 4, 0, 50, 0, 0});
+  EXPECT_EQ(plan.inserters, 0u);
+  EXPECT_EQ(plan.finders, 4u);
+}
+
+TEST(ElasticWorkersTest, ResizeKeepsRolesTest) {
+  ElasticWorkers workers(4);
+  EXPECT_EQ(workers.resize(1, 1), 2u);
+  EXPECT_EQ(workers.role(0), WorkerRole::Insert);
+  EXPECT_EQ(workers.role(1), WorkerRole::Find);
+  EXPECT_EQ(workers.role(2), WorkerRole::Parked);
+
+  // Growing leaves the running workers alone.
+  EXPECT_EQ(workers.resize(2, 2), 2u);
+  EXPECT_EQ(workers.role(0), WorkerRole::Insert);
+  EXPECT_EQ(workers.role(1), WorkerRole::Find);
+  EXPECT_EQ(workers.resize(2, 2), 0u);
+
+  // Shrinking parks the highest-numbered ones.
+  EXPECT_EQ(workers.resize(1, 0), 3u);
+  EXPECT_EQ(workers.role(0), WorkerRole::Insert);
+  for (uint32_t w = 1; w < 4; w++) {
+    EXPECT_EQ(workers.role(w), WorkerRole::Parked);
+  }
+}
+
+TEST(ElasticWorkersTest, ParkAndWakeTest) {
+  constexpr uint32_t NUM_WORKERS = 4;
+  ElasticWorkers workers(NUM_WORKERS);
+  std::vector<std::thread> threads;
+  for (uint32_t w = 0; w < NUM_WORKERS; w++) {
+    threads.emplace_back([&workers, w] {
+      for (;;) {
+        const WorkerRole role = workers.await_role(w);
+        if (role == WorkerRole::Exit) {
+          break;
+        }
+        workers.add_ops(w, 1);
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  workers.resize(1, 0);
+  while (workers.ops(0) < 100) {
+    std::this_thread::yield();
+  }
+  // The others never ran.
+  for (uint32_t w = 1; w < NUM_WORKERS; w++) {
+    EXPECT_EQ(workers.ops(w), 0u);
+  }
+
+  workers.resize(2, 2);
+  for (uint32_t w = 0; w < NUM_WORKERS; w++) {
+    while (workers.ops(w) < 100) {
+      std::this_thread::yield();
+    }
+  }
+
+  workers.resize(0, 0);
+  workers.stop();
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,125 @@
+#include "utils/grace_join.hpp"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "constants.hpp"
+#include "hashtables/batch_runner/batch_runner.hpp"
+#include "hashtables/cas_kht.hpp"
+#include "input_reader/container.hpp"
+
+namespace kmercounter {
+namespace {
+using Reader = input_reader::RangeReader<std::vector<KeyValuePair>::iterator>;
+
+constexpr uint32_t NUM_THREADS = 4;
+constexpr uint64_t R_SIZE = 1 << 20;
+constexpr uint64_t S_SIZE = 1 << 20;
+
+BaseHashTable *make_table(uint64_t capacity) {
+  return new CASHashTable<KVType, ItemQueue>(capacity);
+}
+
+class GraceJoinTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/grace_join_test.XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    dir_ = dir;
+    // The tables answer as many finds per batch as the app lets them.
+    config.batch_len = HT_TESTS_BATCH_LENGTH;
+
+    // Unique build keys, and probe keys of which about half match. Key 0 is
+    // the empty slot.
+    std::mt19937_64 rng(42);
+    r_.resize(R_SIZE);
+    for (uint64_t i = 0; i < R_SIZE; i++) {
+      r_[i] = {i + 1, i};
+    }
+    std::shuffle(r_.begin(), r_.end(), rng);
+    std::uniform_int_distribution<uint64_t> key(1, 2 * R_SIZE);
+    s_.resize(S_SIZE);
+    for (uint64_t i = 0; i < S_SIZE; i++) {
+      s_[i] = {key(rng), i};
+    }
+  }
+
+  void TearDown() override { rmdir(dir_.c_str()); }
+
+  /// The single-table join, as `HashjoinTest::hashjoin` runs it.
+  uint64_t in_memory_join() {
+    std::unique_ptr<BaseHashTable> ht(make_table(2 * R_SIZE));
+    uint64_t num_output = 0;
+    HTBatchRunner batch_runner(ht.get(),
+                               [&](const FindResult &) { num_output++; });
+    for (const auto &kv : r_) {
+      batch_runner.insert(kv);
+    }
+    batch_runner.flush_insert();
+    for (const auto &kv : s_) {
+      if (batch_runner.find(kv)) {
+        num_output++;
+      }
+    }
+    batch_runner.flush_find();
+    return num_output;
+  }
+
+  /// A slice of `rel` per thread.
+  static Reader slice(std::vector<KeyValuePair> &rel, uint32_t tid) {
+    const uint64_t n = rel.size();
+    return Reader(rel.begin() + n * tid / NUM_THREADS,
+                  rel.begin() + n * (tid + 1) / NUM_THREADS);
+  }
+
+  std::string dir_;
+  std::vector<KeyValuePair> r_;
+  std::vector<KeyValuePair> s_;
+};
+
+TEST_F(GraceJoinTest, SameAsInMemoryJoinTest) {
+  std::unordered_set<uint64_t> r_keys;
+  for (const auto &kv : r_) {
+    r_keys.insert(kv.key);
+  }
+  const uint64_t expected = std::count_if(
+      s_.begin(), s_.end(), [&](const auto &kv) { return r_keys.count(kv.key); });
+  ASSERT_EQ(in_memory_join(), expected);
+
+  // A budget far below the table of R, so that partitions are spilled and
+  // joined over several rounds.
+  config.spill_dir = dir_;
+  config.mem_budget = 16;
+  config.num_threads = NUM_THREADS;
+  config.ht_fill = 50;
+  config.relation_r_size = R_SIZE;
+  GraceJoin join(config);
+
+  std::vector<uint64_t> per_thread(NUM_THREADS);
+  std::vector<std::thread> threads;
+  for (uint32_t tid = 0; tid < NUM_THREADS; tid++) {
+    threads.emplace_back([&, tid] {
+      Reader r = slice(r_, tid);
+      Reader s = slice(s_, tid);
+      per_thread[tid] = join.run(tid, &r, &s, make_table);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(join.num_output(), expected);
+  EXPECT_EQ(std::accumulate(per_thread.begin(), per_thread.end(), 0ull),
+            expected);
+}
+}  // namespace
+}  // namespace kmercounter
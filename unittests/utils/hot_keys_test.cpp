@@ -0,0 +1,62 @@
+#include "utils/hot_keys.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+
+namespace kmercounter {
+namespace {
+TEST(HotKeyTrackerTest, PromotesFrequentKeysTest) {
+  HotKeyTracker tracker(0.25);
+  // Key 7 is two thirds of the stream, the rest are all distinct.
+  uint64_t promoted = 0;
+  for (uint64_t i = 1; i <= 100000; i++) {
+    const uint64_t key = (i % 3) ? 7 : 1000 + i;
+    if (!tracker.count(key) && tracker.sample(key)) {
+      EXPECT_EQ(key, 7u);
+      EXPECT_TRUE(tracker.promote(key));
+      promoted++;
+    }
+  }
+  EXPECT_EQ(promoted, 1u);
+  EXPECT_EQ(tracker.num_hot(), 1u);
+}
+
+TEST(HotKeyTrackerTest, IgnoresUniformKeysTest) {
+  HotKeyTracker tracker(0.01);
+  for (uint64_t i = 1; i <= 100000; i++) {
+    const uint64_t key = 1 + i % 1000;
+    EXPECT_FALSE(tracker.count(key));
+    EXPECT_FALSE(tracker.sample(key));
+  }
+}
+
+TEST(HotKeyTrackerTest, DrainTest) {
+  HotKeyTracker tracker(0.25);
+  for (uint64_t key = 1; key <= HotKeyTracker::MAX_HOT; key++) {
+    EXPECT_TRUE(tracker.promote(key));
+  }
+  EXPECT_FALSE(tracker.promote(HotKeyTracker::MAX_HOT + 1));
+  EXPECT_TRUE(tracker.promote(1));
+
+  for (uint64_t key = 1; key <= 2 * HotKeyTracker::MAX_HOT; key++) {
+    for (uint64_t i = 0; i < key; i++) {
+      EXPECT_EQ(tracker.count(key), key <= HotKeyTracker::MAX_HOT);
+    }
+  }
+  std::map<uint64_t, uint64_t> counts;
+  tracker.drain([&](uint64_t key, uint64_t count) { counts[key] += count; });
+  ASSERT_EQ(counts.size(), HotKeyTracker::MAX_HOT);
+  for (const auto &[key, count] : counts) {
+    EXPECT_EQ(count, key);
+  }
+
+  // The counts start over, the hot keys stay.
+  counts.clear();
+  tracker.drain([&](uint64_t key, uint64_t count) { counts[key] += count; });
+  EXPECT_TRUE(counts.empty());
+  EXPECT_TRUE(tracker.count(1));
+}
+}  // namespace
+}  // namespace kmercounter
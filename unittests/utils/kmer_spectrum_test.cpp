@@ -0,0 +1,67 @@
+#include "utils/kmer_spectrum.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+TEST(KmerSpectrumTest, SimpleTest) {
+  KmerSpectrum<> spectrum(2);
+  spectrum.add(10, 1);
+  spectrum.add(11, 1);
+  spectrum.add(12, 5);
+  spectrum.add(13, 3);
+  spectrum.add(14, 100000);
+
+  using Row = std::pair<uint64_t, uint64_t>;
+  EXPECT_EQ((std::vector<Row>{{1, 2}, {3, 1}, {5, 1}, {100000, 1}}),
+            spectrum.histogram());
+  EXPECT_EQ(spectrum.distinct(), 5);
+  EXPECT_EQ(spectrum.total(), 100010);
+  using Entry = KmerSpectrum<>::Entry;
+  EXPECT_EQ((std::vector<Entry>{{100000, 14}, {5, 12}}), spectrum.top());
+}
+
+TEST(KmerSpectrumTest, MergeTest) {
+  std::mt19937_64 rng(42);
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  for (uint64_t key = 1; key <= 20000; key++) {
+    // Mostly small counts, a few beyond the dense range.
+    const uint64_t count = rng() % 50 == 0 ? rng() % 100000 + 1 : rng() % 8 + 1;
+    entries.emplace_back(key, count);
+  }
+
+  // Four threads, each with a slice.
+  const size_t top_k = 25;
+  KmerSpectrum<> merged(top_k);
+  for (size_t t = 0; t < 4; t++) {
+    KmerSpectrum<> spectrum(top_k);
+    for (size_t i = t; i < entries.size(); i += 4) {
+      spectrum.add(entries[i].first, entries[i].second);
+    }
+    merged.merge(spectrum);
+  }
+
+  std::map<uint64_t, uint64_t> hist;
+  std::vector<KmerSpectrum<>::Entry> sorted;
+  for (const auto &[key, count] : entries) {
+    hist[count]++;
+    sorted.emplace_back(count, key);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+    return a.first != b.first ? a.first > b.first : a.second < b.second;
+  });
+  sorted.resize(top_k);
+
+  using Row = std::pair<uint64_t, uint64_t>;
+  EXPECT_EQ(std::vector<Row>(hist.begin(), hist.end()), merged.histogram());
+  EXPECT_EQ(sorted, merged.top());
+  EXPECT_EQ(merged.distinct(), entries.size());
+}
+}  // namespace
+}  // namespace kmercounter
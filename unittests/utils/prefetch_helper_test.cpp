@@ -0,0 +1,61 @@
+#include "utils/prefetch_helper.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+TEST(PrefetchHelperTest, StaysWithinDistanceTest) {
+  constexpr uint64_t end = 20000;
+  constexpr uint32_t distance = 16;
+  std::atomic_uint64_t worker{0};
+  std::vector<uint64_t> seen;
+  bool too_far = false;
+  PrefetchHelper helper(0, distance, end, [&](uint64_t pos) {
+    // The worker only moves forward, so this holds whenever the helper
+    // respected the position it read.
+    if (pos >= worker.load() + distance) too_far = true;
+    seen.push_back(pos);
+  });
+  for (uint64_t i = 1; i <= end; i++) {
+    worker.store(i);
+    helper.advance(i);
+    if (i % 64 == 0) std::this_thread::yield();
+  }
+  helper.finish();
+
+  EXPECT_FALSE(too_far);
+  for (size_t i = 1; i < seen.size(); i++) {
+    EXPECT_LT(seen[i - 1], seen[i]);
+  }
+  EXPECT_EQ(helper.issued(), seen.size());
+  EXPECT_LE(helper.issued() + helper.skipped(), end);
+}
+
+TEST(PrefetchHelperTest, SkipsWhatTheWorkerPassedTest) {
+  std::atomic_bool go{false};
+  PrefetchHelper helper(0, 4, 1000, [&](uint64_t) {
+    while (!go.load()) std::this_thread::yield();
+  });
+  // The helper is stuck on an early position while the worker is done.
+  helper.advance(1000);
+  go = true;
+  // Give it time to notice, before finish stops it.
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  helper.finish();
+  EXPECT_GT(helper.skipped(), 0u);
+  EXPECT_LE(helper.issued(), 4u);
+}
+
+TEST(PrefetchHelperTest, FinishStopsEarlyTest) {
+  PrefetchHelper helper(0, 8, UINT64_MAX, [](uint64_t) {});
+  helper.finish();
+  EXPECT_LE(helper.issued(), 8u);
+}
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,115 @@
+#include "utils/radix_partition.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace kmercounter {
+namespace radix {
+namespace {
+/// Keys with plenty of duplicates.
+std::vector<uint64_t> random_keys(size_t num_keys, uint64_t num_distinct) {
+  std::mt19937_64 rng(42);
+  std::vector<uint64_t> keys(num_keys);
+  for (auto &key : keys) {
+    key = rng() % num_distinct;
+  }
+  return keys;
+}
+
+TEST(RadixPartitionTest, ChooseBitsTest) {
+  EXPECT_EQ(choose_bits(0, 1, 1 << 20), 2);
+  EXPECT_EQ(choose_bits(0, 16, 1 << 20), 6);
+  // 32Ki keys fit a 1 MiB table.
+  EXPECT_EQ(choose_bits(32 << 20, 1, 1 << 20), 10);
+  EXPECT_EQ(choose_bits(~0ull >> 8, 1, 1 << 20), MAX_BITS);
+}
+
+TEST(RadixPartitionTest, ScatterTest) {
+  const auto keys = random_keys(100000, 5000);
+  const uint32_t bits = 6;
+  const uint64_t num_partitions = 1 << bits;
+
+  // Two scatterers sharing the output, as two threads would.
+  const std::span<const uint64_t> halves[] = {
+      std::span(keys).first(keys.size() / 3),
+      std::span(keys).subspan(keys.size() / 3)};
+  std::vector<uint64_t> hists[2];
+  for (int t = 0; t < 2; t++) {
+    hists[t].resize(num_partitions);
+    histogram(halves[t], bits, hists[t].data());
+  }
+  std::vector<uint64_t> begin(num_partitions + 1);
+  for (uint64_t p = 0; p < num_partitions; p++) {
+    begin[p + 1] = begin[p] + hists[0][p] + hists[1][p];
+  }
+  ASSERT_EQ(begin.back(), keys.size());
+
+  std::vector<uint64_t> out(keys.size());
+  for (int t = 0; t < 2; t++) {
+    std::vector<uint64_t> offsets(begin.begin(), begin.end() - 1);
+    if (t == 1) {
+      for (uint64_t p = 0; p < num_partitions; p++) {
+        offsets[p] += hists[0][p];
+      }
+    }
+    Scatter scatter(bits, out.data(), std::move(offsets));
+    for (const auto key : halves[t]) {
+      scatter.push(key);
+    }
+  }
+
+  for (uint64_t p = 0; p < num_partitions; p++) {
+    for (uint64_t i = begin[p]; i < begin[p + 1]; i++) {
+      EXPECT_EQ(partition_of(hash(out[i]), bits), p);
+    }
+  }
+  auto sorted_keys = keys;
+  std::sort(sorted_keys.begin(), sorted_keys.end());
+  std::sort(out.begin(), out.end());
+  EXPECT_EQ(sorted_keys, out);
+}
+
+TEST(RadixPartitionTest, MixIndependentOfHashTest) {
+  // Keys that share the high bits of their CRC spread over all partitions
+  // of `mix`.
+  const uint32_t bits = 4;
+  const uint64_t num_keys = 16000;
+  std::vector<uint64_t> sizes(1 << bits);
+  for (uint64_t key = 0, n = 0; n < num_keys; key++) {
+    if (partition_of(hash(key), bits) == 0) {
+      sizes[partition_of(mix(key), bits)]++;
+      n++;
+    }
+  }
+  for (const auto size : sizes) {
+    EXPECT_GT(size, num_keys / sizes.size() / 2);
+    EXPECT_LT(size, num_keys / sizes.size() * 2);
+  }
+}
+
+TEST(RadixPartitionTest, CountTest) {
+  const auto keys = random_keys(100000, 5000);
+  std::map<uint64_t, uint64_t> expected;
+  for (const auto key : keys) {
+    expected[key]++;
+  }
+
+  PartitionCounter counter;
+  std::map<uint64_t, uint64_t> counts;
+  // The second, smaller count reuses the table of the first one.
+  for (const auto part : {std::span(keys).first(80000),
+                          std::span(keys).subspan(80000)}) {
+    counter.count(part, [&](uint64_t key, uint64_t count) {
+      counts[key] += count;
+    });
+  }
+  EXPECT_EQ(expected, counts);
+}
+}  // namespace
+}  // namespace radix
+}  // namespace kmercounter
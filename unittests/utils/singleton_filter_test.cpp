@@ -0,0 +1,90 @@
+#include "utils/singleton_filter.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+using Sighting = SingletonFilter::Sighting;
+
+TEST(SingletonFilterTest, SightingTest) {
+  SingletonFilter filter(1 << 20);
+  for (uint64_t key = 1; key < 1000; key++) {
+    EXPECT_EQ(filter.see(key), Sighting::First);
+  }
+  for (uint64_t key = 1; key < 1000; key++) {
+    EXPECT_EQ(filter.see(key), Sighting::Second);
+    EXPECT_EQ(filter.see(key), Sighting::Repeat);
+    EXPECT_EQ(filter.see(key), Sighting::Repeat);
+  }
+}
+
+TEST(SingletonFilterTest, FalsePositiveTest) {
+  // 16 bits per key, half of them in the words of the first sighting.
+  const uint64_t num_keys = 1 << 20;
+  SingletonFilter filter(2 * num_keys);
+  for (uint64_t key = 0; key < num_keys; key++) {
+    filter.see(key);
+  }
+  uint64_t false_positives = 0;
+  for (uint64_t key = num_keys; key < 2 * num_keys; key++) {
+    false_positives += filter.see(key) != Sighting::First;
+  }
+  EXPECT_LT(false_positives, num_keys / 20);
+}
+
+TEST(SingletonFilterTest, BatchTest) {
+  SingletonFilter filter(1 << 20);
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 1; key < 100; key++) {
+    keys.push_back(key);
+    keys.push_back(key);
+    keys.push_back(key);
+  }
+  std::vector<Sighting> sightings;
+  filter.see_batch(keys, [&](uint64_t key, Sighting sighting) {
+    sightings.push_back(sighting);
+  });
+  ASSERT_EQ(sightings.size(), keys.size());
+  for (size_t i = 0; i < keys.size(); i += 3) {
+    EXPECT_EQ(sightings[i], Sighting::First);
+    EXPECT_EQ(sightings[i + 1], Sighting::Second);
+    EXPECT_EQ(sightings[i + 2], Sighting::Repeat);
+  }
+}
+
+TEST(SingletonFilterTest, ConcurrentTest) {
+  // Every thread sees every key; exactly one first and one second sighting
+  // per key.
+  SingletonFilter filter(64 << 20);
+  const uint64_t num_keys = 1 << 16;
+  std::atomic_uint64_t firsts{}, seconds{};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (uint64_t key = 0; key < num_keys; key++) {
+        switch (filter.see(key)) {
+          case Sighting::First:
+            firsts++;
+            break;
+          case Sighting::Second:
+            seconds++;
+            break;
+          case Sighting::Repeat:
+            break;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(firsts, num_keys);
+  EXPECT_EQ(seconds, num_keys);
+}
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,103 @@
+#include "utils/spill_buckets.hpp"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+class SpillBucketsTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    char dir[] = "/tmp/spill_buckets_test.XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    dir_ = dir;
+  }
+
+  void TearDown() override { rmdir(dir_.c_str()); }
+
+  std::string dir_;
+};
+
+TEST_F(SpillBucketsTest, RoundTripTest) {
+  const uint32_t num_buckets = 8;
+  const uint64_t num_keys = 100000;
+  SpillBuckets buckets(dir_, num_buckets);
+
+  // Small buffers so that the threads interleave their appends.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      SpillWriter writer(buckets, 64);
+      for (uint64_t key = t; key < num_keys; key += 4) {
+        writer.push(key % num_buckets, key);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<uint64_t> all;
+  for (uint32_t b = 0; b < num_buckets; b++) {
+    std::vector<uint64_t> keys(buckets.size(b));
+    buckets.prefetch(b, 0, keys.size());
+    buckets.read(b, 0, keys);
+    for (const auto key : keys) {
+      EXPECT_EQ(key % num_buckets, b);
+    }
+    all.insert(all.end(), keys.begin(), keys.end());
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all.size(), num_keys);
+  for (uint64_t key = 0; key < num_keys; key++) {
+    EXPECT_EQ(all[key], key);
+  }
+}
+
+TEST_F(SpillBucketsTest, PartialReadTest) {
+  SpillBuckets buckets(dir_, 1);
+  {
+    SpillWriter writer(buckets, 7);
+    for (uint64_t key = 0; key < 100; key++) {
+      writer.push(0, key);
+    }
+  }
+  ASSERT_EQ(buckets.size(0), 100);
+  std::vector<uint64_t> keys(10);
+  buckets.read(0, 0, keys);
+  // A single writer appends in order.
+  for (uint64_t i = 0; i < keys.size(); i++) {
+    EXPECT_EQ(keys[i], i);
+  }
+}
+
+TEST_F(SpillBucketsTest, TupleTest) {
+  struct Tuple {
+    uint64_t key;
+    uint64_t value;
+  };
+  SpillBuckets<Tuple> buckets(dir_, 2, "r-");
+  {
+    SpillWriter<Tuple> writer(buckets, 16);
+    for (uint64_t key = 0; key < 1000; key++) {
+      writer.push(key & 1, {key, key * 3});
+    }
+  }
+  ASSERT_EQ(buckets.size(0), 500);
+  ASSERT_EQ(buckets.size(1), 500);
+  std::vector<Tuple> tuples(500);
+  buckets.read(1, 0, tuples);
+  for (uint64_t i = 0; i < tuples.size(); i++) {
+    EXPECT_EQ(tuples[i].key, 2 * i + 1);
+    EXPECT_EQ(tuples[i].value, 3 * tuples[i].key);
+  }
+}
+}  // namespace
+}  // namespace kmercounter
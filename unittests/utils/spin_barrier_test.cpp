@@ -0,0 +1,68 @@
+#include "utils/spin_barrier.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+/// Every thread bumps a counter per phase; at each barrier they must all
+/// see the same count, and the completion must run once per phase.
+void check_phases(SpinBarrier &barrier, const std::atomic_uint32_t &completions,
+                  uint32_t num_phases) {
+  const uint32_t n = barrier.num_threads();
+  std::atomic_uint64_t arrivals{0};
+  std::atomic_bool mismatch{false};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < n; t++) {
+    threads.emplace_back([&, t] {
+      for (uint32_t phase = 1; phase <= num_phases; phase++) {
+        arrivals++;
+        barrier.arrive_and_wait(t);
+        if (arrivals.load() < uint64_t{phase} * n) {
+          mismatch = true;
+        }
+        // Nobody may arrive at the next phase before everyone has checked
+        // this one.
+        barrier.arrive_and_wait(t);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_FALSE(mismatch);
+  EXPECT_EQ(arrivals, uint64_t{num_phases} * n);
+  EXPECT_EQ(completions, 2 * num_phases);
+}
+
+TEST(SpinBarrierTest, FlatTest) {
+  std::atomic_uint32_t completions{0};
+  SpinBarrier barrier(4, [&] { completions++; });
+  check_phases(barrier, completions, 100);
+}
+
+TEST(SpinBarrierTest, HierarchicalTest) {
+  std::atomic_uint32_t completions{0};
+  // Uneven nodes, numbered out of order.
+  SpinBarrier barrier({1, 0, 1, 3, 1, 0}, [&] { completions++; });
+  check_phases(barrier, completions, 100);
+}
+
+TEST(SpinBarrierTest, CountsWaitsTest) {
+  SpinBarrier barrier({0, 1});
+  std::thread late([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    barrier.arrive_and_wait(1);
+  });
+  barrier.arrive_and_wait(0);
+  late.join();
+  // The early thread waited for the late one, which barely waited.
+  EXPECT_GT(barrier.wait_cycles(0), barrier.wait_cycles(1));
+}
+}  // namespace
+}  // namespace kmercounter
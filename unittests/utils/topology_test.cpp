@@ -0,0 +1,131 @@
+#include "utils/topology.hpp"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "numa.hpp"
+
+namespace kmercounter {
+namespace {
+namespace fs = std::filesystem;
+
+void write(const fs::path &path, const std::string &text) {
+  fs::create_directories(path.parent_path());
+  std::ofstream(path) << text << "\n";
+}
+
+/// Two nodes, each one package with one L3 and two cores of two threads;
+/// the siblings are numbered past 128, as on large machines. Core c is
+/// CPUs c and 130 + c.
+class FakeSysfs : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    root = fs::temp_directory_path() /
+           ("topology_test_" + std::to_string(::getpid()));
+    fs::remove_all(root);
+    write(root / "online", "0-3,130-133");
+    for (uint32_t c = 0; c < 4; c++) {
+      const uint32_t node = c / 2;
+      for (uint32_t cpu : {c, 130 + c}) {
+        const fs::path dir = root / ("cpu" + std::to_string(cpu));
+        fs::create_directories(dir / ("node" + std::to_string(node)));
+        write(dir / "topology/physical_package_id", std::to_string(node));
+        write(dir / "topology/thread_siblings_list",
+              std::to_string(c) + "," + std::to_string(130 + c));
+        write(dir / "cache/index0/level", "1");
+        write(dir / "cache/index0/shared_cpu_list",
+              std::to_string(c) + "," + std::to_string(130 + c));
+        write(dir / "cache/index3/level", "3");
+        write(dir / "cache/index3/shared_cpu_list",
+              std::to_string(2 * node) + "-" + std::to_string(2 * node + 1) +
+                  "," + std::to_string(130 + 2 * node) + "-" +
+                  std::to_string(131 + 2 * node));
+      }
+    }
+  }
+
+  void TearDown() override { fs::remove_all(root); }
+
+  fs::path root;
+};
+
+TEST(CpuListTest, ParseTest) {
+  EXPECT_EQ(CpuTopology::parse_cpulist("0-3,8,200-201"),
+            (std::vector<uint32_t>{0, 1, 2, 3, 8, 200, 201}));
+  EXPECT_EQ(CpuTopology::parse_cpulist("5"), (std::vector<uint32_t>{5}));
+  EXPECT_TRUE(CpuTopology::parse_cpulist("").empty());
+}
+
+TEST_F(FakeSysfs, ReadsTopologyTest) {
+  CpuTopology topo(root.string());
+  ASSERT_EQ(topo.places().size(), 8u);
+  EXPECT_EQ(topo.cores().size(), 4u);
+  EXPECT_EQ(topo.num_l3_domains(), 2u);
+  for (const auto &p : topo.places()) {
+    EXPECT_EQ(p.core, p.cpu % 130);
+    EXPECT_EQ(p.node, p.core / 2);
+    EXPECT_EQ(p.package, p.node);
+    EXPECT_EQ(p.l3, 2 * p.node);
+  }
+}
+
+TEST_F(FakeSysfs, FillsPhysicalCoresFirstTest) {
+  CpuTopology topo(root.string());
+  EXPECT_EQ(topo.fill_cores(6),
+            (std::vector<uint32_t>{0, 1, 2, 3, 130, 131}));
+  EXPECT_EQ(topo.fill_cores(100).size(), 8u);
+}
+
+TEST_F(FakeSysfs, PairsSiblingsTest) {
+  CpuTopology topo(root.string());
+  const std::vector<std::pair<uint32_t, uint32_t>> pairs = {{0, 130},
+                                                            {1, 131}};
+  EXPECT_EQ(topo.smt_pairs(2), pairs);
+  EXPECT_EQ(topo.smt_pairs(10).size(), 4u);
+  EXPECT_EQ(topo.sibling_of(131), 1u);
+  EXPECT_EQ(topo.sibling_of(2), 132u);
+  EXPECT_FALSE(topo.sibling_of(7).has_value());
+}
+
+TEST_F(FakeSysfs, SpreadsOverL3Test) {
+  CpuTopology topo(root.string());
+  EXPECT_EQ(topo.spread_l3(2), (std::vector<uint32_t>{0, 2}));
+  EXPECT_EQ(topo.spread_l3(5), (std::vector<uint32_t>{0, 2, 1, 3, 130}));
+}
+
+// The main thread runs the last producer on CPU 0, whatever the policy.
+TEST_F(FakeSysfs, ProducersGetCpuZeroTest) {
+  std::vector<numa_node_t> nodes(2);
+  nodes[0].cpu_list = {0, 1, 130, 131};
+  nodes[1].cpu_list = {2, 3, 132, 133};
+  for (auto policy :
+       {PROD_CONS_SEQUENTIAL, PROD_CONS_SEPARATE_NODES,
+        PROD_CONS_EQUAL_PARTITION, PROD_CONS_SMT_SIBLINGS,
+        PROD_CONS_CONSUMER_PER_L3}) {
+    NumaPolicyQueues npq(2, 2, policy, nodes, root.string());
+    const auto prod = npq.get_assigned_cpu_list_producers();
+    const auto cons = npq.get_assigned_cpu_list_consumers();
+    EXPECT_EQ(prod.size(), 2u) << "policy " << policy;
+    EXPECT_EQ(cons.size(), 2u) << "policy " << policy;
+    EXPECT_NE(std::find(prod.begin(), prod.end(), 0u), prod.end())
+        << "policy " << policy;
+    EXPECT_EQ(std::find(cons.begin(), cons.end(), 0u), cons.end())
+        << "policy " << policy;
+  }
+}
+
+TEST(CpuTopologyTest, MissingSysfsTest) {
+  CpuTopology topo("/nonexistent");
+  EXPECT_TRUE(topo.places().empty());
+  EXPECT_TRUE(topo.fill_cores(4).empty());
+}
+}  // namespace
+}  // namespace kmercounter
@@ -0,0 +1,55 @@
+#include "utils/worker_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace kmercounter {
+namespace {
+std::vector<uint32_t> some_cpus(uint32_t n) {
+  const uint32_t num_cpus = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<uint32_t> cpus;
+  for (uint32_t i = 0; i < n; i++) {
+    cpus.push_back(i % num_cpus);
+  }
+  return cpus;
+}
+
+TEST(WorkerPoolTest, RunsEveryIndexOnceTest) {
+  WorkerPool pool(some_cpus(4));
+  EXPECT_EQ(pool.size(), 4u);
+  for (uint32_t n = 1; n <= 5; n++) {
+    std::vector<std::atomic_uint32_t> runs(5);
+    pool.run(n, [&](uint32_t i) { runs[i]++; });
+    for (uint32_t i = 0; i < 5; i++) {
+      EXPECT_EQ(runs[i], i < n ? 1u : 0u);
+    }
+  }
+}
+
+TEST(WorkerPoolTest, KeepsItsThreadsTest) {
+  WorkerPool pool(some_cpus(3));
+  std::vector<std::thread::id> first(4), second(4);
+  pool.run(4, [&](uint32_t i) { first[i] = std::this_thread::get_id(); });
+  pool.run(4, [&](uint32_t i) { second[i] = std::this_thread::get_id(); });
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(first[3], std::this_thread::get_id());
+  EXPECT_EQ(std::set<std::thread::id>(first.begin(), first.end()).size(), 4u);
+}
+
+TEST(WorkerPoolTest, ManyShortJobsTest) {
+  WorkerPool pool(some_cpus(4));
+  std::atomic_uint64_t sum{0};
+  for (uint32_t round = 0; round < 10000; round++) {
+    pool.run(1 + round % 5, [&](uint32_t i) { sum += i + 1; });
+  }
+  // Rounds of n = 1..5 workers add 1, 3, 6, 10 and 15.
+  EXPECT_EQ(sum, 2000u * (1 + 3 + 6 + 10 + 15));
+}
+}  // namespace
+}  // namespace kmercounter